@@ -0,0 +1,273 @@
+/**
+ * @file Coroutine.hpp
+ * @author yangqingmiao
+ * @brief 基于C++20协程的连接读写接口
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ * 协程总是在连接所属的EvThread中、由连接的回调直接恢复，没有线程切换，
+ * 单次读没有额外的堆分配（awaiter位于协程帧中），写按消息跟踪完成，
+ * 每次写分配一个完成状态。因此协程需要在连接所属的EvThread中启动，
+ * 例如在OnAccept、OnConnect或定时事件中。
+ *
+ * 需要C++20，低于C++20时本文件为空。
+ */
+#pragma once
+#if __cplusplus >= 202002L && __has_include(<coroutine>)
+#include <coroutine>
+#include <utility>
+#include <vector>
+#include <bbt/network/TcpClient.hpp>
+#include <bbt/network/detail/Connection.hpp>
+
+namespace bbt::network
+{
+
+/**
+ * 立即开始执行的协程，不需要等待结果
+ */
+struct CoTask
+{
+    struct promise_type
+    {
+        CoTask              get_return_object() { return {}; }
+        std::suspend_never  initial_suspend() noexcept { return {}; }
+        std::suspend_never  final_suspend() noexcept { return {}; }
+        void                return_void() {}
+        void                unhandled_exception() { std::terminate(); }
+    };
+};
+
+/**
+ * 协程连接，接管 Connection 的收发回调，关闭、超时、错误回调
+ * 仍然转发给原来的 TcpServer/TcpClient。
+ *
+ * 同一时刻只允许一个协程等待读，一个协程等待写。写通过SendOptions::on_complete
+ * 跟踪，不支持开启了fd传递的连接。
+ */
+class CoConnection:
+    public std::enable_shared_from_this<CoConnection>,
+    boost::noncopyable
+{
+    struct PrivateTag {};
+public:
+    class ReadAwaiter
+    {
+    public:
+        ReadAwaiter(CoConnection& conn, size_t min_bytes): m_conn(conn), m_min_bytes(min_bytes) {}
+        bool await_ready() const { return m_conn.Size() >= m_min_bytes || m_conn.m_err.has_value(); }
+        void await_suspend(std::coroutine_handle<> handle) { m_conn.m_reader = handle; m_conn.m_read_min = m_min_bytes; }
+        /* 返回时如果没有错误，Size() >= min_bytes */
+        core::errcode::ErrOpt await_resume() { return (m_conn.Size() >= m_min_bytes) ? std::nullopt : m_conn.m_err; }
+    private:
+        CoConnection&       m_conn;
+        size_t              m_min_bytes{0};
+    };
+
+    /* 单条消息的完成状态，完成回调可能晚于等待它的协程 */
+    struct WriteState
+    {
+        bool                done{false};
+        core::errcode::ErrOpt err{std::nullopt};
+    };
+
+    class WriteAwaiter
+    {
+    public:
+        WriteAwaiter(CoConnection& conn, std::shared_ptr<WriteState> state): m_conn(conn), m_state(state) {}
+        bool await_ready() const { return m_state->done || m_conn.m_err.has_value(); }
+        void await_suspend(std::coroutine_handle<> handle) { m_conn.m_writer = handle; m_conn.m_write_state = m_state; }
+        /**
+         * 返回时这条消息已经全部写入socket，或者发生错误：发送失败、发送超时、
+         * 超过截止时间被丢弃或者连接关闭。错误只属于这条消息，不影响之后的写
+         */
+        core::errcode::ErrOpt await_resume() { return m_state->done ? m_state->err : m_conn.m_err; }
+    private:
+        CoConnection&       m_conn;
+        std::shared_ptr<WriteState> m_state;
+    };
+
+    CoConnection(PrivateTag, detail::ConnectionSPtr conn): m_conn(conn) {}
+    ~CoConnection() = default;
+
+    /**
+     * @brief 接管连接的收发回调，需要在连接所属线程或连接启动前调用
+     *
+     * @param conn
+     * @return std::shared_ptr<CoConnection>
+     */
+    static std::shared_ptr<CoConnection> Create(detail::ConnectionSPtr conn)
+    {
+        auto co_conn = std::make_shared<CoConnection>(PrivateTag{}, conn);
+        co_conn->Hook();
+        return co_conn;
+    }
+
+    /**
+     * @brief 等待输入缓冲区中至少有min_bytes字节数据
+     * 数据通过Peek/Size访问，处理完毕后调用Consume
+     */
+    ReadAwaiter             Read(size_t min_bytes = 1) { return ReadAwaiter{*this, min_bytes}; }
+
+    /**
+     * @brief 发送数据，并等待数据全部写入socket
+     */
+    WriteAwaiter            Write(const char* data, size_t len)
+    {
+        auto state = std::make_shared<WriteState>();
+        SendOptions opts;
+        opts.on_complete = [weak_this{weak_from_this()}, state](core::errcode::ErrOpt err) {
+            state->done = true;
+            state->err = err;
+            if (auto pthis = weak_this.lock(); pthis != nullptr)
+                pthis->OnWriteDone(state);
+        };
+
+        if (auto err = m_conn->AsyncSend(data, len, opts); err.has_value()) {
+            state->done = true;
+            state->err = err;
+        }
+        return WriteAwaiter{*this, state};
+    }
+
+    WriteAwaiter            Write(const bbt::core::Buffer& buffer) { return Write(buffer.Peek(), buffer.Size()); }
+
+    const char*             Peek() const { return m_input.data() + m_read_pos; }
+    size_t                  Size() const { return m_input.size() - m_read_pos; }
+    void                    Consume(size_t len)
+    {
+        m_read_pos += std::min(len, Size());
+        /* 读空时复用缓冲区，避免反复扩容 */
+        if (m_read_pos == m_input.size()) {
+            m_input.clear();
+            m_read_pos = 0;
+        }
+    }
+
+    void                    Close() { m_conn->Close(); }
+    bool                    IsClosed() const { return m_conn->IsClosed(); }
+    ConnId                  GetConnId() const { return m_conn->GetConnId(); }
+    detail::ConnectionSPtr  GetConnection() const { return m_conn; }
+
+private:
+    void                    Hook()
+    {
+        m_chained = m_conn->GetCallbacks();
+        detail::ConnCallbacks callbacks = m_chained;
+        auto weak_this = weak_from_this();
+
+        callbacks.on_recv_callback = [weak_this](detail::ConnectionSPtr, const char* data, size_t len) {
+            if (auto pthis = weak_this.lock(); pthis != nullptr)
+                pthis->OnRecv(data, len);
+        };
+        /* 写完成通过每条消息的on_complete跟踪 */
+        callbacks.on_send_callback = [](detail::ConnectionSPtr, core::errcode::ErrOpt, size_t) {};
+        callbacks.on_close_callback = [weak_this](ConnId connid, const IPAddress& addr) {
+            if (auto pthis = weak_this.lock(); pthis != nullptr)
+                pthis->OnClose(connid, addr);
+        };
+
+        m_conn->SetOpt_Callbacks(callbacks);
+    }
+
+    void                    OnRecv(const char* data, size_t len)
+    {
+        m_input.insert(m_input.end(), data, data + len);
+        if (m_reader && Size() >= m_read_min)
+            std::exchange(m_reader, nullptr).resume();
+    }
+
+    void                    OnWriteDone(const std::shared_ptr<WriteState>& state)
+    {
+        if (!m_writer || m_write_state != state)
+            return;
+
+        m_write_state = nullptr;
+        std::exchange(m_writer, nullptr).resume();
+    }
+
+    void                    OnClose(ConnId connid, const IPAddress& addr)
+    {
+        /* 先保证自身存活，恢复的协程可能释放最后一个引用 */
+        auto self = shared_from_this();
+        m_err = core::errcode::Errcode{"connection closed!", emErr::ERRTYPE_NETWORK_RECV_EOF};
+        if (m_chained.on_close_callback)
+            m_chained.on_close_callback(connid, addr);
+
+        if (m_reader)
+            std::exchange(m_reader, nullptr).resume();
+        m_write_state = nullptr;
+        if (m_writer)
+            std::exchange(m_writer, nullptr).resume();
+    }
+
+private:
+    detail::ConnectionSPtr  m_conn{nullptr};
+    detail::ConnCallbacks   m_chained;                  // 原来的回调
+
+    std::vector<char>       m_input;
+    size_t                  m_read_pos{0};
+    std::coroutine_handle<> m_reader{nullptr};
+    size_t                  m_read_min{0};
+
+    std::coroutine_handle<> m_writer{nullptr};
+    std::shared_ptr<WriteState> m_write_state{nullptr}; // 等待中的协程所等的消息
+
+    core::errcode::ErrOpt   m_err{std::nullopt};        // 连接关闭
+};
+
+/**
+ * 协程方式发起连接，连接结果在TcpClient所属的EvThread中返回。
+ * 会覆盖TcpClient的OnConnect回调。
+ */
+class ConnectAwaiter
+{
+    struct State
+    {
+        std::coroutine_handle<> handle{nullptr};
+        core::errcode::ErrOpt   err{std::nullopt};
+    };
+public:
+    ConnectAwaiter(std::shared_ptr<TcpClient> client, const IPAddress& addr, int timeout):
+        m_client(client), m_addr(addr), m_timeout(timeout), m_state(std::make_shared<State>()) {}
+
+    bool await_ready() const { return false; }
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+        m_state->handle = handle;
+        m_client->SetOnConnect([state{m_state}](ConnId, core::errcode::ErrOpt err) {
+            /* 只恢复一次，之后的重连回调直接忽略 */
+            if (!state->handle) return;
+            state->err = err;
+            std::exchange(state->handle, nullptr).resume();
+        });
+
+        if (auto err = m_client->AsyncConnect(m_addr, m_timeout); err.has_value()) {
+            m_state->handle = nullptr;
+            m_state->err = err;
+            return false;
+        }
+
+        return true;
+    }
+    core::errcode::ErrOpt await_resume() { return m_state->err; }
+private:
+    std::shared_ptr<TcpClient> m_client{nullptr};
+    IPAddress               m_addr;
+    int                     m_timeout{0};
+    std::shared_ptr<State>  m_state{nullptr};
+};
+
+/**
+ * @brief co_await CoConnect(client, addr, timeout)
+ */
+inline ConnectAwaiter CoConnect(std::shared_ptr<TcpClient> client, const IPAddress& addr, int timeout)
+{
+    return ConnectAwaiter{client, addr, timeout};
+}
+
+} // namespace bbt::network
+
+#endif
@@ -0,0 +1,415 @@
+/**
+ * @file RpcChannel.cc
+ * @author yangqingmiao
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include <endian.h>
+#include <cstring>
+#include <bbt/pollevent/Event.hpp>
+#include <bbt/network/RpcChannel.hpp>
+
+using namespace bbt::core::errcode;
+
+namespace bbt::network
+{
+
+/**
+ * 帧头，多字节字段为网络字节序
+ *  [0, 4)   消息体长度
+ *  [4, 5)   帧类型
+ *  [5, 8)   保留
+ *  [8, 12)  请求帧为方法，错误帧为错误类型，回复帧为0
+ *  [12, 20) 请求id
+ */
+static constexpr size_t RPC_HEADER_SIZE = 20;
+
+enum RpcFrameType : uint8_t
+{
+    emRPC_REQUEST   = 1,
+    emRPC_RESPONSE  = 2,
+    emRPC_ERROR     = 3,
+};
+
+RpcReply::RpcReply(std::weak_ptr<RpcChannel> channel, uint64_t request_id):
+    m_channel(channel),
+    m_request_id(request_id)
+{
+}
+
+ErrOpt RpcReply::Reply(const char* data, size_t len) const
+{
+    auto channel = m_channel.lock();
+    if (channel == nullptr)
+        return FASTERR_ERROR("rpc reply failed! channel is released!");
+
+    return channel->SendFrame(emRPC_RESPONSE, 0, m_request_id, data, len);
+}
+
+ErrOpt RpcReply::Reply(const bbt::core::Buffer& buffer) const
+{
+    return Reply(buffer.Peek(), buffer.Size());
+}
+
+ErrOpt RpcReply::ReplyError(const std::string& msg) const
+{
+    auto channel = m_channel.lock();
+    if (channel == nullptr)
+        return FASTERR_ERROR("rpc reply failed! channel is released!");
+
+    return channel->SendFrame(emRPC_ERROR, emErr::ERRTYPE_RPC_REMOTE_ERROR, m_request_id, msg.data(), msg.size());
+}
+
+uint64_t RpcReply::GetRequestId() const
+{
+    return m_request_id;
+}
+
+void RpcService::Register(uint32_t method, const RpcHandler& handler)
+{
+    m_handlers[method] = handler;
+}
+
+const RpcHandler* RpcService::Find(uint32_t method) const
+{
+    auto it = m_handlers.find(method);
+    return (it != m_handlers.end()) ? &it->second : nullptr;
+}
+
+RpcChannel::RpcChannel(PrivateTag, detail::ConnectionSPtr conn, std::shared_ptr<RpcService> service):
+    m_conn(conn),
+    m_thread(conn->GetBindThread()),
+    m_conn_id(conn->GetConnId()),
+    m_service(service)
+{
+}
+
+RpcChannel::~RpcChannel()
+{
+    if (m_deadline_event)
+        m_deadline_event->CancelListen();
+}
+
+ErrOpt RpcChannel::Create(detail::ConnectionSPtr conn, std::shared_ptr<RpcService> service, std::shared_ptr<RpcChannel>& channel)
+{
+    Assert(conn != nullptr);
+    auto rpc = std::make_shared<RpcChannel>(PrivateTag{}, conn, service);
+    if (auto err = rpc->Hook(); err.has_value())
+        return err;
+
+    channel = rpc;
+    return FASTERR_NOTHING;
+}
+
+ErrOpt RpcChannel::Hook()
+{
+    auto conn = m_conn.lock();
+    if (conn == nullptr)
+        return FASTERR_ERROR("rpc channel create failed! connection is released!");
+
+    /* 替换on_recv_callback对这类连接不生效，通道会收不到任何数据 */
+    if (!conn->DeliversRecvCallback())
+        return FASTERR_ERROR("rpc channel create failed! connection does not deliver data through on recv callback!");
+
+    m_chained = conn->GetCallbacks();
+    detail::ConnCallbacks callbacks = m_chained;
+
+    /* 回调持有通道，通道只持有连接的弱引用，通道随连接一起释放 */
+    callbacks.on_recv_callback = [pthis{shared_from_this()}](detail::ConnectionSPtr, const char* data, size_t len) {
+        pthis->OnRecv(data, len);
+    };
+    callbacks.on_close_callback = [pthis{shared_from_this()}](ConnId connid, const IPAddress& addr) {
+        pthis->OnClose(connid, addr);
+    };
+
+    conn->SetOpt_Callbacks(callbacks);
+    return FASTERR_NOTHING;
+}
+
+ErrOpt RpcChannel::Call(uint32_t method, const char* data, size_t len, int timeout_ms, const RpcCallback& cb)
+{
+    uint64_t request_id = m_next_request_id++;
+
+    {
+        std::lock_guard<std::mutex> _(m_mutex);
+        if (m_closed)
+            return FASTERR_ERROR("rpc call failed! connection is closed!");
+
+        auto& pending = m_pending[request_id];
+        pending.callback = cb;
+        if (timeout_ms > 0) {
+            auto deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+            pending.deadline = m_deadlines.emplace(deadline, request_id);
+            pending.has_deadline = true;
+            if (deadline < m_armed_deadline)
+                ArmDeadline();
+        }
+    }
+
+    /* 先登记再发送，回复可能在发送返回前就在连接线程中到达 */
+    if (auto err = SendFrame(emRPC_REQUEST, method, request_id, data, len); err.has_value()) {
+        std::lock_guard<std::mutex> _(m_mutex);
+        if (auto it = m_pending.find(request_id); it != m_pending.end()) {
+            if (it->second.has_deadline)
+                m_deadlines.erase(it->second.deadline);
+            m_pending.erase(it);
+        }
+        return err;
+    }
+
+    return FASTERR_NOTHING;
+}
+
+std::future<RpcResult> RpcChannel::Call(uint32_t method, const char* data, size_t len, int timeout_ms)
+{
+    auto promise = std::make_shared<std::promise<RpcResult>>();
+    auto future = promise->get_future();
+
+    auto err = Call(method, data, len, timeout_ms, [promise](ErrOpt err, const char* data, size_t len) {
+        RpcResult result;
+        result.err = err;
+        if (!err.has_value())
+            result.data.assign(data, len);
+        promise->set_value(std::move(result));
+    });
+
+    if (err.has_value())
+        promise->set_value(RpcResult{err, {}});
+
+    return future;
+}
+
+size_t RpcChannel::GetInFlight()
+{
+    std::lock_guard<std::mutex> _(m_mutex);
+    return m_pending.size();
+}
+
+ConnId RpcChannel::GetConnId() const
+{
+    return m_conn_id;
+}
+
+detail::ConnectionSPtr RpcChannel::GetConnection() const
+{
+    return m_conn.lock();
+}
+
+ErrOpt RpcChannel::SendFrame(uint8_t type, uint32_t method, uint64_t request_id, const char* data, size_t len)
+{
+    auto conn = m_conn.lock();
+    if (conn == nullptr)
+        return FASTERR_ERROR("rpc send failed! connection is released!");
+
+    if (len > RPC_MAX_FRAME_SIZE)
+        return FASTERR_ERROR("rpc send failed! frame is too large! len=" + std::to_string(len));
+
+    char header[RPC_HEADER_SIZE] = {0};
+    uint32_t be_len = htobe32(len);
+    uint32_t be_method = htobe32(method);
+    uint64_t be_id = htobe64(request_id);
+    memcpy(header, &be_len, sizeof(be_len));
+    header[4] = type;
+    memcpy(header + 8, &be_method, sizeof(be_method));
+    memcpy(header + 12, &be_id, sizeof(be_id));
+
+    /* 帧头和消息体一次追加，多个线程同时发送时帧不会交错 */
+    thread_local std::string frame;
+    frame.assign(header, RPC_HEADER_SIZE);
+    frame.append(data, len);
+    auto err = conn->AsyncSend(frame.data(), frame.size());
+
+    /* 偶尔的大帧不长期占用内存 */
+    if (frame.capacity() > (1 << 20)) {
+        frame.clear();
+        frame.shrink_to_fit();
+    }
+
+    return err;
+}
+
+void RpcChannel::OnRecv(const char* data, size_t len)
+{
+    size_t offset = 0;
+
+    /* 大部分情况下一次读取包含完整的帧，直接在读缓冲上解析，只保存不完整的尾部 */
+    if (m_input.empty()) {
+        while (offset < len) {
+            size_t n = ParseFrame(data + offset, len - offset);
+            if (n == 0) break;
+            offset += n;
+        }
+
+        if (offset < len)
+            m_input.assign(data + offset, data + len);
+        return;
+    }
+
+    m_input.insert(m_input.end(), data, data + len);
+    while (offset < m_input.size()) {
+        size_t n = ParseFrame(m_input.data() + offset, m_input.size() - offset);
+        if (n == 0) break;
+        offset += n;
+    }
+
+    m_input.erase(m_input.begin(), m_input.begin() + offset);
+}
+
+size_t RpcChannel::ParseFrame(const char* data, size_t len)
+{
+    auto conn = m_conn.lock();
+    if (conn == nullptr || conn->IsClosed() || len < RPC_HEADER_SIZE)
+        return 0;
+
+    uint32_t body_len = 0;
+    uint32_t method = 0;
+    uint64_t request_id = 0;
+    memcpy(&body_len, data, sizeof(body_len));
+    memcpy(&method, data + 8, sizeof(method));
+    memcpy(&request_id, data + 12, sizeof(request_id));
+    body_len = be32toh(body_len);
+    method = be32toh(method);
+    request_id = be64toh(request_id);
+    uint8_t type = data[4];
+
+    if (body_len > RPC_MAX_FRAME_SIZE || type < emRPC_REQUEST || type > emRPC_ERROR) {
+        if (m_chained.on_err_callback)
+            m_chained.on_err_callback(m_conn_id, Errcode{"rpc bad frame! len=" + std::to_string(body_len) + " type=" + std::to_string(type), emErr::ERRTYPE_ERROR});
+        conn->Close();
+        return 0;
+    }
+
+    if (len < RPC_HEADER_SIZE + body_len)
+        return 0;
+
+    const char* body = data + RPC_HEADER_SIZE;
+    if (type == emRPC_REQUEST)
+        OnRequest(method, request_id, body, body_len);
+    else
+        OnResponse(type, method, request_id, body, body_len);
+
+    return RPC_HEADER_SIZE + body_len;
+}
+
+void RpcChannel::OnRequest(uint32_t method, uint64_t request_id, const char* data, size_t len)
+{
+    const RpcHandler* handler = m_service ? m_service->Find(method) : nullptr;
+    if (handler == nullptr) {
+        std::string msg = "rpc no such method! method=" + std::to_string(method);
+        SendFrame(emRPC_ERROR, emErr::ERRTYPE_RPC_NO_METHOD, request_id, msg.data(), msg.size());
+        return;
+    }
+
+    (*handler)(RpcReply{weak_from_this(), request_id}, data, len);
+}
+
+void RpcChannel::OnResponse(uint8_t type, uint32_t code, uint64_t request_id, const char* data, size_t len)
+{
+    RpcCallback callback = nullptr;
+    {
+        std::lock_guard<std::mutex> _(m_mutex);
+        auto it = m_pending.find(request_id);
+        /* 已经超时的调用，回复直接丢弃 */
+        if (it == m_pending.end())
+            return;
+
+        callback = std::move(it->second.callback);
+        if (it->second.has_deadline)
+            m_deadlines.erase(it->second.deadline);
+        m_pending.erase(it);
+    }
+
+    if (callback == nullptr)
+        return;
+
+    if (type == emRPC_ERROR)
+        callback(Errcode{std::string{data, len}, (ErrType)code}, nullptr, 0);
+    else
+        callback(FASTERR_NOTHING, data, len);
+}
+
+void RpcChannel::ArmDeadline()
+{
+    if (m_deadlines.empty())
+        return;
+
+    /* 连接迁移到其他线程后，定时器跟着换到新线程 */
+    auto conn = m_conn.lock();
+    auto thread = conn ? conn->GetBindThread() : m_thread.lock();
+    if (thread == nullptr)
+        return;
+
+    if (m_deadline_event != nullptr && thread != m_thread.lock()) {
+        m_deadline_event->CancelListen();
+        m_deadline_event = nullptr;
+    }
+
+    m_thread = thread;
+    if (m_deadline_event == nullptr) {
+        m_deadline_event = thread->RegisterEvent(-1, EventOpt::TIMEOUT,
+        [weak_this{weak_from_this()}](int, short, EventId){
+            if (auto pthis = weak_this.lock(); pthis != nullptr)
+                pthis->OnDeadline();
+        });
+    }
+
+    m_armed_deadline = m_deadlines.begin()->first;
+    auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(m_armed_deadline - Clock::now()).count();
+    /* 向上取整，避免提前触发后空转一次 */
+    m_deadline_event->StartListen(std::max<int64_t>(wait + 1, 1));
+}
+
+void RpcChannel::OnDeadline()
+{
+    std::vector<RpcCallback> expired;
+    {
+        std::lock_guard<std::mutex> _(m_mutex);
+        m_armed_deadline = Clock::time_point::max();
+        auto now = Clock::now();
+        while (!m_deadlines.empty() && m_deadlines.begin()->first <= now) {
+            auto it = m_pending.find(m_deadlines.begin()->second);
+            if (it != m_pending.end()) {
+                expired.push_back(std::move(it->second.callback));
+                m_pending.erase(it);
+            }
+            m_deadlines.erase(m_deadlines.begin());
+        }
+
+        ArmDeadline();
+    }
+
+    for (auto& callback : expired) {
+        if (callback)
+            callback(Errcode{"rpc timeout!", emErr::ERRTYPE_RPC_TIMEOUT}, nullptr, 0);
+    }
+}
+
+void RpcChannel::OnClose(ConnId connid, const IPAddress& addr)
+{
+    /* 回调中可能释放通道的最后一个外部引用 */
+    auto self = shared_from_this();
+    std::unordered_map<uint64_t, Pending> pending;
+    {
+        std::lock_guard<std::mutex> _(m_mutex);
+        m_closed = true;
+        pending.swap(m_pending);
+        m_deadlines.clear();
+        m_armed_deadline = Clock::time_point::max();
+        if (m_deadline_event)
+            m_deadline_event->CancelListen();
+    }
+
+    for (auto& [request_id, call] : pending) {
+        if (call.callback)
+            call.callback(Errcode{"rpc connection closed!", emErr::ERRTYPE_RPC_CONN_CLOSED}, nullptr, 0);
+    }
+
+    if (m_chained.on_close_callback)
+        m_chained.on_close_callback(connid, addr);
+}
+
+} // namespace bbt::network
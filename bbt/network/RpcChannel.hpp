@@ -0,0 +1,164 @@
+/**
+ * @file RpcChannel.hpp
+ * @author yangqingmiao
+ * @brief 基于连接的多路复用rpc
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#pragma once
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <unordered_map>
+#include <bbt/pollevent/EvThread.hpp>
+#include <bbt/network/detail/Connection.hpp>
+
+namespace bbt::network
+{
+
+class RpcChannel;
+
+/**
+ * 服务端的回复句柄，可以拷贝到其他线程中异步回复，每个请求只能回复一次。
+ * 连接关闭后回复返回错误
+ */
+class RpcReply
+{
+public:
+    RpcReply(std::weak_ptr<RpcChannel> channel, uint64_t request_id);
+
+    core::errcode::ErrOpt   Reply(const char* data, size_t len) const;
+    core::errcode::ErrOpt   Reply(const bbt::core::Buffer& buffer) const;
+    /* 调用方收到ERRTYPE_RPC_REMOTE_ERROR，错误信息为msg */
+    core::errcode::ErrOpt   ReplyError(const std::string& msg) const;
+    uint64_t                GetRequestId() const;
+private:
+    std::weak_ptr<RpcChannel> m_channel;
+    uint64_t                m_request_id{0};
+};
+
+// 服务端处理函数，在连接所在线程中执行，数据只在调用期间有效
+typedef std::function<void(RpcReply, const char*, size_t)> RpcHandler;
+// 调用结果回调，在连接所在线程中执行，err为空时data为回复数据
+typedef std::function<void(core::errcode::ErrOpt, const char*, size_t)> RpcCallback;
+
+struct RpcResult
+{
+    core::errcode::ErrOpt   err{std::nullopt};
+    std::string             data;
+};
+
+/**
+ * 方法表，可以被多个RpcChannel共享。需要在创建RpcChannel前注册完毕，
+ * 之后只读
+ */
+class RpcService:
+    boost::noncopyable
+{
+public:
+    void                    Register(uint32_t method, const RpcHandler& handler);
+    const RpcHandler*       Find(uint32_t method) const;
+private:
+    std::unordered_map<uint32_t, RpcHandler> m_handlers;
+};
+
+/**
+ * 一个连接上的双向rpc通道，两端都可以发起调用，也都可以处理请求。
+ *
+ * 每条消息是一个帧：定长帧头（长度、类型、方法、请求id）加上消息体。
+ * 同一连接上可以同时有任意多个调用在途，回复按请求id匹配，允许乱序
+ * 完成。每个调用的截止时间记录在按时间排序的表中，只用一个连接线程
+ * 上的定时器，总是对准最早的截止时间。
+ *
+ * 接管连接的收数据回调，关闭回调在清理在途调用后转发给原来的回调。
+ * 需要在连接启动前创建，例如TcpServer的OnAccept或TcpClient的OnConnect中。
+ * StaticConnection和开启分帧批量交付的连接不经过收数据回调，不能创建通道。
+ */
+class RpcChannel:
+    public std::enable_shared_from_this<RpcChannel>,
+    boost::noncopyable
+{
+    friend class RpcReply;
+    struct PrivateTag {};
+    typedef std::chrono::steady_clock Clock;
+public:
+    BBTATTR_FUNC_CTOR_HIDDEN RpcChannel(PrivateTag, detail::ConnectionSPtr conn, std::shared_ptr<RpcService> service);
+    ~RpcChannel();
+
+    /**
+     * @brief 在连接上创建rpc通道，通道的生命周期跟随连接
+     *
+     * @param conn
+     * @param service 为空时只能发起调用，收到的请求回复ERRTYPE_RPC_NO_METHOD
+     * @param channel 成功时返回通道
+     * @return core::errcode::ErrOpt 连接的数据不经过收数据回调时返回错误
+     */
+    static core::errcode::ErrOpt Create(detail::ConnectionSPtr conn, std::shared_ptr<RpcService> service, std::shared_ptr<RpcChannel>& channel);
+
+    /**
+     * @brief 发起调用，线程安全。返回错误时不会回调
+     *
+     * @param method
+     * @param data
+     * @param len
+     * @param timeout_ms 超时时间，为0时不超时，直到收到回复或连接关闭
+     * @param cb 在连接所在线程中回调，超时返回ERRTYPE_RPC_TIMEOUT，连接关闭返回ERRTYPE_RPC_CONN_CLOSED
+     * @return core::errcode::ErrOpt
+     */
+    core::errcode::ErrOpt   Call(uint32_t method, const char* data, size_t len, int timeout_ms, const RpcCallback& cb);
+
+    /**
+     * @brief 发起调用，通过future取得结果。不能在连接所在线程中等待future
+     */
+    std::future<RpcResult>  Call(uint32_t method, const char* data, size_t len, int timeout_ms);
+
+    /* 在途调用数 */
+    size_t                  GetInFlight();
+    ConnId                  GetConnId() const;
+    detail::ConnectionSPtr  GetConnection() const;
+
+protected:
+    core::errcode::ErrOpt   Hook();
+    void                    OnRecv(const char* data, size_t len);
+    void                    OnClose(ConnId connid, const IPAddress& addr);
+    /* 解析一个完整的帧，返回消耗的字节数，数据不完整时返回0 */
+    size_t                  ParseFrame(const char* data, size_t len);
+    void                    OnRequest(uint32_t method, uint64_t request_id, const char* data, size_t len);
+    void                    OnResponse(uint8_t type, uint32_t code, uint64_t request_id, const char* data, size_t len);
+    core::errcode::ErrOpt   SendFrame(uint8_t type, uint32_t method, uint64_t request_id, const char* data, size_t len);
+    void                    OnDeadline();
+    /* 调整定时器到最早的截止时间，需要持有m_mutex */
+    void                    ArmDeadline();
+
+private:
+    struct Pending
+    {
+        RpcCallback         callback{nullptr};
+        std::multimap<Clock::time_point, uint64_t>::iterator
+                            deadline;
+        bool                has_deadline{false};
+    };
+
+    std::weak_ptr<detail::Connection> m_conn;
+    std::weak_ptr<EvThread> m_thread;
+    const ConnId            m_conn_id{0};
+    std::shared_ptr<RpcService> m_service{nullptr};
+    detail::ConnCallbacks   m_chained;                  // 原来的回调
+
+    /* 接收缓冲，只保存跨多次读取的不完整帧 */
+    std::vector<char>       m_input;
+
+    std::atomic_uint64_t    m_next_request_id{1};
+    std::mutex              m_mutex;
+    bool                    m_closed{false};
+    std::unordered_map<uint64_t, Pending> m_pending;
+    std::multimap<Clock::time_point, uint64_t> m_deadlines;
+    std::shared_ptr<Event>  m_deadline_event{nullptr};
+    Clock::time_point       m_armed_deadline{Clock::time_point::max()};
+};
+
+} // namespace bbt::network
@@ -5,6 +5,9 @@
 #include <bbt/pollevent/EvThread.hpp>
 #include <bbt/network/TcpClient.hpp>
 #include <bbt/network/detail/Connection.hpp>
+#include <bbt/network/detail/SocketOptions.hpp>
+#include <bbt/network/detail/UnixSocket.hpp>
+#include <bbt/network/detail/TlsContext.hpp>
 
 using namespace bbt::core::errcode;
 
@@ -44,7 +47,41 @@ ErrOpt TcpClient::AsyncConnect(const bbt::core::net::IPAddress& addr, int timeou
         return err.Err();
     else
         fd = err.Ok();
-    
+
+    /* 缓冲区大小需要在connect前设置才能影响窗口扩大因子的协商 */
+    if (auto err = detail::ApplySocketOptions(fd, m_socket_opts); err.has_value() && m_on_err)
+        m_on_err(-1, err.value());
+
+    m_unix_path.clear();
+    return _RegistConnectEvent(thread, fd);
+}
+
+ErrOpt TcpClient::AsyncConnectUnix(const std::string& path, int timeout)
+{
+    std::lock_guard<std::mutex> _(m_connect_mtx);
+
+    int fd = -1;
+    m_connect_timeout = timeout >= 0 ? timeout : 0;
+
+    if (IsConnected())
+        return FASTERR_ERROR("is connected!");
+
+    if (m_connect_event != nullptr)
+        return FASTERR_ERROR("already connecting!");
+
+    auto thread = _GetThread();
+    if (thread == nullptr)
+        return FASTERR_ERROR("evthread is null!");
+
+    if (auto err = detail::CreateUnixSocket(true, fd); err.has_value())
+        return err;
+
+    m_unix_path = path;
+    return _RegistConnectEvent(thread, fd);
+}
+
+ErrOpt TcpClient::_RegistConnectEvent(std::shared_ptr<EvThread> thread, int fd)
+{
     m_connect_event = thread->RegisterEvent(fd, EventOpt::WRITEABLE | EventOpt::TIMEOUT | EventOpt::PERSIST,
     [weak_this{weak_from_this()}](int fd, short events, EventId id)
     {
@@ -77,9 +114,39 @@ core::errcode::ErrOpt TcpClient::Connect(const bbt::core::net::IPAddress& addr,
     else
         fd = err.Ok();
 
+    /* 缓冲区大小需要在connect前设置才能影响窗口扩大因子的协商 */
+    if (auto err = detail::ApplySocketOptions(fd, m_socket_opts); err.has_value() && m_on_err)
+        m_on_err(-1, err.value());
+
     m_serv_addr = addr;
     m_connect_timeout = timeout >= 0 ? timeout : 0;
 
+    m_unix_path.clear();
+    _DoConnect(fd, EventOpt::WRITEABLE);
+
+    if (m_conn == nullptr)
+        return FASTERR_ERROR("connect failed!");
+
+    return FASTERR_NOTHING;
+}
+
+ErrOpt TcpClient::ConnectUnix(const std::string& path, int timeout)
+{
+    std::lock_guard<std::mutex> _(m_connect_mtx);
+    int fd = -1;
+
+    if (IsConnected())
+        return FASTERR_ERROR("is connected!");
+
+    if (m_connect_event != nullptr)
+        return FASTERR_ERROR("already connecting!");
+
+    if (auto err = detail::CreateUnixSocket(false, fd); err.has_value())
+        return err;
+
+    m_unix_path = path;
+    m_connect_timeout = timeout >= 0 ? timeout : 0;
+
     _DoConnect(fd, EventOpt::WRITEABLE);
 
     if (m_conn == nullptr)
@@ -90,14 +157,27 @@ core::errcode::ErrOpt TcpClient::Connect(const bbt::core::net::IPAddress& addr,
 
 core::errcode::ErrOpt TcpClient::ReConnect()
 {
+    if (!m_unix_path.empty())
+        return AsyncConnectUnix(m_unix_path, m_connect_timeout);
+
     return AsyncConnect(m_serv_addr, m_connect_timeout);
 }
 
+ErrOpt TcpClient::_GetServAddr(sockaddr* addr, socklen_t& len)
+{
+    if (m_unix_path.empty())
+        return m_serv_addr.GetRawData(addr, len);
+
+    return detail::MakeUnixAddress(m_unix_path, *reinterpret_cast<sockaddr_un*>(addr), len);
+}
+
 
 void TcpClient::_DoConnect(int socket, short events)
 {
-    struct sockaddr_in serv_addr;
+    detail::ConnectionSPtr conn = nullptr;
+    struct sockaddr_storage serv_addr;
     socklen_t addr_len = sizeof(serv_addr);
+    IPAddress peer_addr;
 
     if (events & EventOpt::TIMEOUT) {
         if (m_on_connect) m_on_connect(-1, FASTERR_ERROR("connect timeout!"));
@@ -105,7 +185,7 @@ void TcpClient::_DoConnect(int socket, short events)
     }
 
     if (events & EventOpt::WRITEABLE) {
-        if (auto err = m_serv_addr.GetRawData(reinterpret_cast<sockaddr*>(&serv_addr), addr_len); err.has_value()) {
+        if (auto err = _GetServAddr(reinterpret_cast<sockaddr*>(&serv_addr), addr_len); err.has_value()) {
             if (m_on_err) m_on_err(-1, err.value());
             goto ConnectFinal;
         }
@@ -116,6 +196,12 @@ void TcpClient::_DoConnect(int socket, short events)
                 return;
             }
 
+            /* unix socket在对端backlog满时立即返回EAGAIN，socket一直可写，不能等待下一次可写重试 */
+            if (err == EAGAIN) {
+                if (m_on_connect) m_on_connect(-1, Errcode{"connect failed! peer backlog is full!", emErr::ERRTYPE_CONNECT_TRY_AGAIN});
+                goto ConnectFinal;
+            }
+
             if (err == ECONNREFUSED) {
                 if (m_on_connect) m_on_connect(-1, FASTERR_ERROR("connect refused!"));
                 goto ConnectFinal;
@@ -127,9 +213,29 @@ void TcpClient::_DoConnect(int socket, short events)
         }
     }
 
-    m_conn = detail::Connection::Create(m_ev_thread, socket, m_serv_addr);
-    if (m_on_connect) m_on_connect(m_conn->GetConnId(), FASTERR_NOTHING);
-    _InitConnection(m_conn);
+    /* unix socket的对端没有ip地址 */
+    if (m_unix_path.empty())
+        peer_addr = m_serv_addr;
+
+    conn = m_conn_factory ? m_conn_factory(m_ev_thread, socket, peer_addr) : detail::Connection::Create(m_ev_thread, socket, peer_addr);
+    m_conn = conn;
+    /* 其余选项已在连接前设置，这里只需要让连接记录quickack */
+    if (!m_unix_path.empty()) {
+        conn->SetOpt_PassFd(true);
+        if (m_shm_ring_size > 0)
+            conn->SetOpt_SharedMemory(m_shm_ring_size, true);
+    } else if (m_socket_opts.quickack.has_value()) {
+        SocketOptions quickack_opts;
+        quickack_opts.quickack = m_socket_opts.quickack;
+        conn->SetOpt_SocketOptions(quickack_opts);
+    }
+
+    if (m_unix_path.empty() && m_tls_ctx != nullptr)
+        conn->SetOpt_Tls(m_tls_ctx);
+    /* 先应用默认配置，OnConnect中可以对连接覆盖，之后再启动连接 */
+    _InitConnection(conn);
+    if (m_on_connect) m_on_connect(conn->GetConnId(), FASTERR_NOTHING);
+    if (conn->IsConnected()) conn->RunInEventLoop();
 
 ConnectFinal:
     // connect 处理完毕，销毁事件和连接
@@ -161,18 +267,29 @@ void TcpClient::Init()
     [weak_this{weak_from_this()}](detail::ConnectionSPtr conn, const char* data, size_t len)
     {
         if (auto shared_this = weak_this.lock(); shared_this != nullptr) {
-            if (shared_this->m_on_recv)
+            if (shared_this->m_on_recv_ctx)
+                shared_this->m_on_recv_ctx(conn->GetConnId(), conn->GetContextPtr(), bbt::core::Buffer{data, len});
+            else if (shared_this->m_on_recv)
                 shared_this->m_on_recv(conn->GetConnId(), bbt::core::Buffer{data, len});
             else
                 shared_this->m_on_err(conn->GetConnId(), Errcode{"no register onrecv!", emErr::ERRTYPE_ERROR});
         }
     };
 
+    callbacks.on_recv_batch_callback =
+    [weak_this{weak_from_this()}](detail::ConnectionSPtr conn, const FrameBatch& frames)
+    {
+        if (auto shared_this = weak_this.lock(); shared_this != nullptr && shared_this->m_on_recv_batch)
+            shared_this->m_on_recv_batch(conn->GetConnId(), conn->GetContextPtr(), frames);
+    };
+
     callbacks.on_send_callback =
     [weak_this{weak_from_this()}](detail::ConnectionSPtr conn, ErrOpt err, size_t send_succ_len)
     {
         if (auto shared_this = weak_this.lock(); shared_this != nullptr) {
-            if (shared_this->m_on_send)
+            if (shared_this->m_on_send_ctx)
+                shared_this->m_on_send_ctx(conn->GetConnId(), conn->GetContextPtr(), err, send_succ_len);
+            else if (shared_this->m_on_send)
                 shared_this->m_on_send(conn->GetConnId(), err, send_succ_len);
             else
                 shared_this->m_on_err(conn->GetConnId(), Errcode{"no register onsend!", emErr::ERRTYPE_ERROR});
@@ -189,27 +306,62 @@ void TcpClient::Init()
                 shared_this->m_on_err(conn->GetConnId(), Errcode{"no register ontimeout!", emErr::ERRTYPE_ERROR});
         }
     };
+
+    m_shared_callbacks = std::make_shared<const detail::ConnCallbacks>(callbacks);
+}
+
+ErrOpt TcpClient::SetTls(const TlsOptions& opts)
+{
+    std::shared_ptr<detail::TlsContext> ctx = nullptr;
+    if (auto err = detail::TlsContext::Create(opts, false, ctx); err.has_value())
+        return err;
+
+    m_tls_ctx = ctx;
+    return FASTERR_NOTHING;
+}
+
+TlsStats TcpClient::GetTlsStats() const
+{
+    return m_tls_ctx ? m_tls_ctx->GetStats() : TlsStats{};
 }
 
 void TcpClient::_InitConnection(std::shared_ptr<detail::Connection> conn)
 {
     Assert(conn != nullptr);
-    Assert(callbacks.on_recv_callback != nullptr);
+    Assert(m_shared_callbacks != nullptr);
     conn->SetOpt_CloseTimeoutMS(m_connection_timeout);
-    conn->SetOpt_Callbacks(callbacks);
-    conn->RunInEventLoop();
+    conn->SetOpt_Callbacks(m_shared_callbacks);
+    conn->SetOpt_IOBackend(m_io_backend);
+    conn->SetOpt_EdgeTriggered(m_edge_triggered, m_read_budget);
+    conn->SetOpt_WriteCoalescing(m_write_coalescing);
+    conn->SetOpt_SendDeadline(m_send_deadline_ms);
+    conn->SetOpt_SendTimeout(m_send_timeout_ms);
+    if (m_frame_parser && m_on_recv_batch)
+        conn->SetOpt_FrameParser(m_frame_parser);
+    if (m_rate_limit_opts.has_value())
+        conn->SetOpt_RateLimit(m_rate_limit_opts.value());
+    if (m_rate_limit_group != nullptr)
+        conn->SetOpt_RateLimitGroup(m_rate_limit_group);
+    if (m_memory_budget != nullptr)
+        conn->SetOpt_MemoryBudget(m_memory_budget);
+    conn->SetOpt_BusyPoll(m_busy_poll_opts);
 }
 
 void TcpClient::_OnClose(ConnId id)
 {
+    /* 持有连接直到关闭回调结束，保证上下文在回调中有效 */
+    detail::ConnectionSPtr conn = nullptr;
     {
         std::lock_guard<std::mutex> _(m_connect_mtx);
+        conn = m_conn;
         m_conn = nullptr;
         m_connect_event = nullptr;
     }
-    if (m_on_close)
+    if (m_on_close_ctx)
+        m_on_close_ctx(id, (conn && conn->GetConnId() == id) ? conn->GetContextPtr() : nullptr);
+    else if (m_on_close)
         m_on_close(id);
-    else
+    else if (m_conn_factory == nullptr)
         m_on_err(id, Errcode{"no register onclose!", emErr::ERRTYPE_ERROR});
 }
 
@@ -226,6 +378,38 @@ ErrOpt TcpClient::Send(const bbt::core::Buffer& buffer)
     return m_conn->AsyncSend(buffer.Peek(), buffer.Size());
 }
 
+ErrOpt TcpClient::Send(const bbt::core::Buffer& buffer, const std::vector<int>& fds)
+{
+    if (m_conn == nullptr)
+        return FASTERR_ERROR("connection is null!");
+
+    return m_conn->AsyncSendWithFds(buffer.Peek(), buffer.Size(), fds);
+}
+
+ErrOpt TcpClient::Send(const bbt::core::Buffer& buffer, SendPriority priority)
+{
+    if (m_conn == nullptr)
+        return FASTERR_ERROR("connection is null!");
+
+    return m_conn->AsyncSend(buffer.Peek(), buffer.Size(), priority);
+}
+
+ErrOpt TcpClient::Send(const bbt::core::Buffer& buffer, const SendOptions& opts)
+{
+    if (m_conn == nullptr)
+        return FASTERR_ERROR("connection is null!");
+
+    return m_conn->AsyncSend(buffer.Peek(), buffer.Size(), opts);
+}
+
+ErrOpt TcpClient::SendConflated(uint64_t key, const bbt::core::Buffer& buffer)
+{
+    if (m_conn == nullptr)
+        return FASTERR_ERROR("connection is null!");
+
+    return m_conn->AsyncSendConflated(key, buffer.Peek(), buffer.Size());
+}
+
 ErrOpt TcpClient::Close()
 {
     m_conn->Close();
@@ -233,6 +417,11 @@ ErrOpt TcpClient::Close()
     return FASTERR_NOTHING;
 }
 
+detail::ConnectionSPtr TcpClient::GetConnection()
+{
+    return m_conn;
+}
+
 bool TcpClient::IsConnected()
 {
     return m_conn != nullptr && m_conn->IsConnected();
@@ -1,6 +1,9 @@
 #pragma once
 #include <bbt/pollevent/EvThread.hpp>
 #include <bbt/network/detail/Define.hpp>
+#include <bbt/network/detail/RateLimiter.hpp>
+#include <bbt/network/detail/MemoryBudget.hpp>
+#include <bbt/network/detail/StaticConnection.hpp>
 
 namespace bbt::network
 {
@@ -33,6 +36,40 @@ public:
 
     core::errcode::ErrOpt Connect(const bbt::core::net::IPAddress& addr, int timeout);
 
+    /**
+     * @brief 向AF_UNIX流式socket发起异步连接，其余行为与AsyncConnect一致
+     * 路径以'@'开头时使用抽象命名空间。unix连接支持fd传递，
+     * SetSocketOptions中的选项对unix连接不生效
+     * 
+     * @param path 
+     * @param timeout 
+     * @return core::errcode::ErrOpt 
+     */
+    core::errcode::ErrOpt AsyncConnectUnix(const std::string& path, int timeout);
+
+    core::errcode::ErrOpt ConnectUnix(const std::string& path, int timeout);
+
+    /**
+     * @brief 开启共享内存传输，只对ConnectUnix建立的连接生效，服务端需要
+     * 通过TcpServer::SetSharedMemory同样开启。连接建立后由客户端创建共享
+     * 内存并握手，之后收发经过共享内存环形缓冲区，Send和OnRecv的用法不变
+     * 
+     * @param ring_size 单向环形缓冲区大小，必须是2的幂，为0时关闭
+     */
+    void            SetSharedMemory(size_t ring_size = SHM_RING_DEFAULT_SIZE) { m_shm_ring_size = ring_size; }
+
+    /**
+     * @brief 开启tls，对之后建立的tcp连接生效。OnConnect在握手前回调，
+     * 此时Send的数据在握手完成后发出。开启会话恢复时，重连复用上一次
+     * 握手得到的会话
+     * 
+     * @param opts 默认校验服务端证书和主机名，必须设置server_name，ca_file为空时使用系统CA；
+     *  设置insecure时跳过校验
+     * @return core::errcode::ErrOpt 未设置server_name且未设置insecure，或未开启BBT_NETWORK_WITH_OPENSSL时返回错误
+     */
+    core::errcode::ErrOpt SetTls(const TlsOptions& opts);
+    TlsStats        GetTlsStats() const;
+
     /**
      * @brief 重新发起连接
      * 
@@ -50,6 +87,44 @@ public:
      */
     core::errcode::ErrOpt Send(const bbt::core::Buffer& buffer);
 
+    /**
+     * @brief 向unix连接发送数据，并通过SCM_RIGHTS附带fds
+     * fds附着在buffer的第一个字节上，会被dup，调用方仍持有原fd
+     * 
+     * @param buffer 不能为空
+     * @param fds 
+     * @return core::errcode::ErrOpt 
+     */
+    core::errcode::ErrOpt Send(const bbt::core::Buffer& buffer, const std::vector<int>& fds);
+
+    /**
+     * @brief 发送可合并的消息，同一个key还没写出的旧消息被新数据替换，
+     * 顺序规则同TcpServer::SendConflated
+     * 
+     * @param key 
+     * @param buffer 
+     * @return core::errcode::ErrOpt 
+     */
+    core::errcode::ErrOpt SendConflated(uint64_t key, const bbt::core::Buffer& buffer);
+
+    /**
+     * @brief 按优先级发送，高优先级消息在下一次写出时排到已排队的数据之前
+     * 
+     * @param buffer 
+     * @param priority 
+     * @return core::errcode::ErrOpt 
+     */
+    core::errcode::ErrOpt Send(const bbt::core::Buffer& buffer, SendPriority priority);
+
+    /**
+     * @brief 按选项发送，可以指定优先级、截止时间和完成回调，见TcpServer::Send
+     * 
+     * @param buffer 
+     * @param opts 
+     * @return core::errcode::ErrOpt 返回错误时不会回调
+     */
+    core::errcode::ErrOpt Send(const bbt::core::Buffer& buffer, const SendOptions& opts);
+
     /**
      * @brief 关闭连接
      * 
@@ -72,6 +147,108 @@ public:
      */
     ConnId          GetConnId();
 
+    /**
+     * @brief 获取当前的连接对象
+     * 
+     * @return detail::ConnectionSPtr 未连接时返回nullptr
+     */
+    detail::ConnectionSPtr GetConnection();
+
+    /**
+     * @brief 设置连接级收发限流，在下一次连接建立时生效
+     * 
+     * @param opts 
+     */
+    void            SetRateLimit(const RateLimitOptions& opts) { m_rate_limit_opts = opts; }
+
+    /**
+     * @brief 设置组级收发限流，多个TcpClient可以共享同一个限流器
+     * 
+     * @param group 
+     */
+    void            SetRateLimitGroup(std::shared_ptr<detail::RateLimiter> group) { m_rate_limit_group = group; }
+
+    /**
+     * @brief 设置内存预算，在下一次连接建立时生效，超出时按opts.policy处理
+     * 
+     * @param opts 
+     */
+    void            SetMemoryBudget(const MemoryBudgetOptions& opts) { m_memory_budget = detail::MemoryBudget::Create(opts); }
+
+    /**
+     * @brief 使用已有的内存预算，多个TcpClient、TcpServer可以共享
+     * 
+     * @param budget 
+     */
+    void            SetMemoryBudget(std::shared_ptr<detail::MemoryBudget> budget) { m_memory_budget = budget; }
+    MemoryStats     GetMemoryStats() { return m_memory_budget ? m_memory_budget->GetStats() : MemoryStats{}; }
+
+    /**
+     * @brief 设置socket选项，在发起连接前设置到socket上
+     * 
+     * @param opts 
+     */
+    void            SetSocketOptions(const SocketOptions& opts) { m_socket_opts = opts; }
+
+    /**
+     * @brief 设置io后端，在下一次连接建立时生效
+     * io_uring不可用时回退到libevent，并通过OnErr通知
+     * 
+     * @param backend 
+     */
+    void            SetIOBackend(IOBackend backend) { m_io_backend = backend; }
+
+    /**
+     * @brief 设置边缘触发模式，连接会一直读到EAGAIN，单次唤醒最多读取
+     * read_budget次，用完后排到下一轮事件循环继续读取
+     * 
+     * @param enable 
+     * @param read_budget 
+     */
+    void            SetEdgeTriggered(bool enable, int read_budget = EDGE_TRIGGERED_READ_BUDGET) { m_edge_triggered = enable; m_read_budget = read_budget; }
+
+    /**
+     * @brief 设置写合并，同一轮事件循环中对同一连接的多次Send在本轮末尾
+     * 一次写出。需要在单个连接上显式攒批时使用GetConnection()->Cork/Uncork
+     * 
+     * @param enable 
+     */
+    void            SetWriteCoalescing(bool enable) { m_write_coalescing = enable; }
+
+    /**
+     * @brief 设置默认的消息截止时间，消息排队超过截止时间还没有写出时
+     * 直接丢弃，不再占用带宽。单条消息可以通过SendOptions覆盖
+     * 
+     * @param deadline_ms 为0时（默认）不过期
+     */
+    void            SetSendDeadline(int deadline_ms) { m_send_deadline_ms = deadline_ms; }
+
+    /**
+     * @brief 设置发送超时，socket持续不可写超过这个时间时丢弃在途数据
+     * 并回调ERRTYPE_SEND_TIMEOUT
+     * 
+     * @param timeout_ms 默认SEND_DATA_TIMEOUT_MS
+     */
+    void            SetSendTimeout(int timeout_ms) { m_send_timeout_ms = timeout_ms; }
+
+    /**
+     * @brief 设置静态类型的Handler，下一次建立的连接使用StaticConnection，
+     * 收发、超时、关闭事件直接派发给handler，不再经过OnRecv、OnSend、
+     * OnTimeout回调，OnClose、OnErr回调仍然有效
+     * 
+     * @tparam Handler 需要提供的接口见 detail::StaticHandlerBase
+     * @param handler 所有连接共享
+     */
+    template<class Handler>
+    void            SetStaticHandler(std::shared_ptr<Handler> handler) { m_conn_factory = detail::StaticConnection<Handler>::Factory(handler); }
+
+    /**
+     * @brief 设置自适应忙轮询，在下一次连接建立时生效，只对libevent后端生效
+     * 
+     * @param opts 
+     */
+    void            SetBusyPoll(const BusyPollOptions& opts) { m_busy_poll_opts = opts; }
+
     void            SetConnectionTimeout(int timeout) { m_connection_timeout = timeout; }
     void            SetOnConnect(const OnConnectFunc& on_connect) { m_on_connect = on_connect; }
     void            SetOnTimeout(const OnTimeoutFunc& on_timeout) { m_on_timeout = on_timeout; }
@@ -79,9 +256,40 @@ public:
     void            SetOnSend(const OnSendFunc& on_send) { m_on_send = on_send; }
     void            SetOnRecv(const OnRecvFunc& on_recv) { m_on_recv = on_recv; }
     void            SetOnErr(const OnErrFunc& on_err) {m_on_err = on_err; }
+
+    /**
+     * @brief 设置携带连接上下文的回调，上下文在OnConnect中通过GetConnection()->SetContext设置，
+     * 回调中直接得到上下文指针，不需要再维护ConnId到状态的映射。
+     * 设置后会代替对应的普通回调，未设置上下文时传入nullptr
+     * 
+     * 用法：SetOnRecv<Session>([](ConnId id, Session* s, const bbt::core::Buffer& buf){ ... });
+     */
+    template<class T>
+    void            SetOnRecv(const std::function<void(ConnId, T*, const bbt::core::Buffer&)>& on_recv)
+    { m_on_recv_ctx = [on_recv](ConnId connid, void* ctx, const bbt::core::Buffer& buffer) { on_recv(connid, static_cast<T*>(ctx), buffer); }; }
+    template<class T>
+    void            SetOnSend(const std::function<void(ConnId, T*, core::errcode::ErrOpt, size_t)>& on_send)
+    { m_on_send_ctx = [on_send](ConnId connid, void* ctx, core::errcode::ErrOpt err, size_t len) { on_send(connid, static_cast<T*>(ctx), err, len); }; }
+    template<class T>
+    void            SetOnClose(const std::function<void(ConnId, T*)>& on_close)
+    { m_on_close_ctx = [on_close](ConnId connid, void* ctx) { on_close(connid, static_cast<T*>(ctx)); }; }
+
+    /**
+     * @brief 设置批量收帧回调，收到的数据先由parser切分成帧，一次可读事件中
+     * 解析出的所有完整帧一起回调，同时传入连接上下文。设置后代替OnRecv，
+     * 对之后建立的连接生效，不支持StaticHandler
+     * 
+     * 用法：SetOnRecvBatch(LengthPrefixedFrameParser(1 << 20), [](ConnId id, void* ctx, const FrameBatch& frames){ ... });
+     */
+    void            SetOnRecvBatch(const FrameParser& parser, const OnRecvBatchFunc& on_batch) { m_frame_parser = std::make_shared<const FrameParser>(parser); m_on_recv_batch = on_batch; }
+    template<class T>
+    void            SetOnRecvBatch(const FrameParser& parser, const std::function<void(ConnId, T*, const FrameBatch&)>& on_batch)
+    { SetOnRecvBatch(parser, [on_batch](ConnId connid, void* ctx, const FrameBatch& frames) { on_batch(connid, static_cast<T*>(ctx), frames); }); }
 private:
     std::shared_ptr<pollevent::EvThread> _GetThread();
     void            _DoConnect(int socket, short events);
+    core::errcode::ErrOpt _RegistConnectEvent(std::shared_ptr<pollevent::EvThread> thread, int fd);
+    core::errcode::ErrOpt _GetServAddr(sockaddr* addr, socklen_t& len);
     void            _DoConnectThreadSafe(int socket, short events);
     void            _InitConnection(std::shared_ptr<detail::Connection> conn);
     void            _OnClose(ConnId id);
@@ -89,20 +297,42 @@ private:
     std::shared_ptr<pollevent::EvThread> m_ev_thread{nullptr};
 
     detail::ConnCallbacks callbacks;
+    std::shared_ptr<const detail::ConnCallbacks> m_shared_callbacks{nullptr};   // Init时生成，所有连接共享
 
     IPAddress       m_serv_addr;
+    std::string     m_unix_path;    // 非空时连接的是unix socket
+    size_t          m_shm_ring_size{0}; // unix连接是否使用共享内存传输
+    std::shared_ptr<detail::TlsContext> m_tls_ctx{nullptr}; // 跨重连保留，用于会话恢复
     detail::ConnectionSPtr m_conn{nullptr};
     int             m_connect_timeout{10000};
     int             m_connection_timeout{10000};
     std::shared_ptr<Event> m_connect_event{nullptr};
     std::mutex      m_connect_mtx;
 
+    SocketOptions   m_socket_opts;
+    IOBackend       m_io_backend{emIO_BACKEND_LIBEVENT};
+    bool            m_edge_triggered{false};
+    bool            m_write_coalescing{false};
+    int             m_send_deadline_ms{0};
+    int             m_send_timeout_ms{SEND_DATA_TIMEOUT_MS};
+    int             m_read_budget{EDGE_TRIGGERED_READ_BUDGET};
+    std::optional<RateLimitOptions> m_rate_limit_opts{std::nullopt};
+    std::shared_ptr<detail::RateLimiter> m_rate_limit_group{nullptr};
+    std::shared_ptr<detail::MemoryBudget> m_memory_budget{nullptr};
+    BusyPollOptions m_busy_poll_opts;
+    detail::ConnFactory m_conn_factory{nullptr};  // 为空时使用默认的Connection
+
     OnCloseFunc     m_on_close{nullptr};
     OnSendFunc      m_on_send{nullptr};
     OnRecvFunc      m_on_recv{nullptr};
     OnTimeoutFunc   m_on_timeout{nullptr};
     OnConnectFunc   m_on_connect{nullptr};
     OnErrFunc       m_on_err{nullptr};
+    OnRecvCtxFunc   m_on_recv_ctx{nullptr};
+    OnSendCtxFunc   m_on_send_ctx{nullptr};
+    OnCloseCtxFunc  m_on_close_ctx{nullptr};
+    std::shared_ptr<const FrameParser> m_frame_parser{nullptr}; // 所有连接共享
+    OnRecvBatchFunc m_on_recv_batch{nullptr};
 };
 
 } // namespace bbt::network
\ No newline at end of file
@@ -1,8 +1,18 @@
 #include <iostream>
+#include <algorithm>
+#include <thread>
+#include <condition_variable>
 #include <bbt/network/TcpServer.hpp>
 #include <bbt/core/net/SocketUtil.hpp>
 #include <bbt/pollevent/Event.hpp>
 #include <bbt/network/detail/Connection.hpp>
+#include <bbt/network/detail/SocketOptions.hpp>
+#include <bbt/network/detail/IoUringContext.hpp>
+#include <bbt/network/detail/CpuAffinity.hpp>
+#include <bbt/network/detail/BusyPoller.hpp>
+#include <bbt/network/detail/TlsContext.hpp>
+#include <bbt/network/detail/UnixSocket.hpp>
+#include <bbt/network/detail/HotRestart.hpp>
 
 using namespace bbt::core::errcode;
 
@@ -23,6 +33,7 @@ TcpServer::TcpServer(PrivateTag, int nthread):
 {
     for (int i = 0; i < nthread; ++i) {
         m_thread_pool[i] = std::make_shared<EvThread>();
+        m_owned_threads.insert(m_thread_pool[i].get());
     }
 }
 
@@ -35,6 +46,8 @@ TcpServer::TcpServer(PrivateTag, const std::vector<std::shared_ptr<EvThread>>& e
 
 TcpServer::~TcpServer()
 {
+    /* 交接线程持有TcpServer，这里已经交出过时新进程可能在同一路径上监听 */
+    _CloseHandoffListen(!m_handoff_running.load());
     StopListen();
 }
 
@@ -59,7 +72,7 @@ void TcpServer::Init()
     [weak_this{weak_from_this()}](ConnId connid, const IPAddress& addr)
     {
         if (auto shared_this = weak_this.lock(); shared_this != nullptr) {
-            shared_this->OnClose(connid);
+            shared_this->OnClose(connid, addr);
         }
     };
 
@@ -68,50 +81,198 @@ void TcpServer::Init()
             shared_this->m_on_err(connid, err);
     };
 
+    /* 设置了工作线程池时，回调在连接的strand中执行，否则或者线程池已经停止时直接在EvThread中执行 */
     callbacks.on_recv_callback =
     [weak_this{weak_from_this()}](detail::ConnectionSPtr conn, const char* data, size_t len)
     {
-        if (auto shared_this = weak_this.lock(); shared_this != nullptr) {
-            if (shared_this->m_on_recv)
-                shared_this->m_on_recv(conn->GetConnId(), bbt::core::Buffer{data, len});
-            else
-                shared_this->m_on_err(conn->GetConnId(), Errcode{"no register onrecv!", emErr::ERRTYPE_ERROR});
+        if (!conn->HasWorkerPool()) {
+            if (auto shared_this = weak_this.lock(); shared_this != nullptr)
+                shared_this->OnRecv(conn, bbt::core::Buffer{data, len});
+            return;
+        }
+
+        auto buffer = std::make_shared<bbt::core::Buffer>(data, len);
+        auto task = [weak_this, conn, buffer](){
+            if (auto shared_this = weak_this.lock(); shared_this != nullptr)
+                shared_this->OnRecv(conn, *buffer);
+        };
+        if (!conn->RunInWorker(task))
+            task();
+    };
+
+    callbacks.on_recv_batch_callback =
+    [weak_this{weak_from_this()}](detail::ConnectionSPtr conn, const FrameBatch& frames)
+    {
+        if (!conn->HasWorkerPool()) {
+            if (auto shared_this = weak_this.lock(); shared_this != nullptr)
+                shared_this->OnRecvBatch(conn, frames);
+            return;
         }
+
+        /* 帧视图只在回调期间有效，卸载到线程池前拷贝 */
+        auto copied = std::make_shared<std::vector<std::string>>(frames.begin(), frames.end());
+        auto task = [weak_this, conn, copied](){
+            if (auto shared_this = weak_this.lock(); shared_this != nullptr) {
+                std::vector<std::string_view> views(copied->begin(), copied->end());
+                shared_this->OnRecvBatch(conn, FrameBatch{views.data(), views.size()});
+            }
+        };
+        if (!conn->RunInWorker(task))
+            task();
     };
 
     callbacks.on_send_callback =
     [weak_this{weak_from_this()}](detail::ConnectionSPtr conn, ErrOpt err, size_t send_succ_len)
     {
-        if (auto shared_this = weak_this.lock(); shared_this != nullptr) {
-            if (shared_this->m_on_send)
-                shared_this->m_on_send(conn->GetConnId(), err, send_succ_len);
-            else
-                shared_this->m_on_err(conn->GetConnId(), Errcode{"no register onsend!", emErr::ERRTYPE_ERROR});
+        if (!conn->HasWorkerPool()) {
+            if (auto shared_this = weak_this.lock(); shared_this != nullptr)
+                shared_this->OnSend(conn, err, send_succ_len);
+            return;
         }
+
+        auto task = [weak_this, conn, err, send_succ_len](){
+            if (auto shared_this = weak_this.lock(); shared_this != nullptr)
+                shared_this->OnSend(conn, err, send_succ_len);
+        };
+        if (!conn->RunInWorker(task))
+            task();
     };
 
     callbacks.on_timeout_callback =
     [weak_this{weak_from_this()}](detail::ConnectionSPtr conn)
     {
-        if (auto shared_this = weak_this.lock(); shared_this != nullptr) {
-            if (shared_this->m_on_timeout)
-                shared_this->m_on_timeout(conn->GetConnId());
-            else
-                shared_this->m_on_err(conn->GetConnId(), Errcode{"no register onsend!", emErr::ERRTYPE_ERROR});
+        if (!conn->HasWorkerPool()) {
+            if (auto shared_this = weak_this.lock(); shared_this != nullptr)
+                shared_this->OnTimeout(conn);
+            return;
         }
+
+        auto task = [weak_this, conn](){
+            if (auto shared_this = weak_this.lock(); shared_this != nullptr)
+                shared_this->OnTimeout(conn);
+        };
+        if (!conn->RunInWorker(task))
+            task();
     };
 
+    /* 所有连接共享同一份回调 */
+    m_shared_callbacks = std::make_shared<const detail::ConnCallbacks>(callbacks);
+
     for (auto& thread : m_thread_pool) {
         if (thread != nullptr)
             thread->Start();
     }
+
+    _ApplyCpuAffinity();
+    _StartRebalance();
+}
+
+void TcpServer::SetCpuAffinity(const CpuAffinityOptions& opts)
+{
+    m_affinity_opts = opts;
+    m_cpu_thread.clear();
+    if (opts.cpu_sets.empty())
+        return;
+
+    /* 一个cpu对应第一个绑定到它的线程 */
+    for (size_t i = 0; i < m_thread_count; ++i) {
+        for (int cpu : opts.cpu_sets[i % opts.cpu_sets.size()])
+            m_cpu_thread.emplace(cpu, i);
+    }
+}
+
+void TcpServer::SetBusyPoll(const BusyPollOptions& opts)
+{
+    m_busy_poll_opts = opts;
+    m_busy_pollers.clear();
+    if (!opts.enable)
+        return;
+
+    for (auto& thread : m_thread_pool) {
+        if (auto poller = detail::BusyPoller::GetOrCreate(thread, opts); poller != nullptr)
+            m_busy_pollers.push_back(poller);
+    }
+}
+
+ErrOpt TcpServer::SetTls(const TlsOptions& opts)
+{
+    std::shared_ptr<detail::TlsContext> ctx = nullptr;
+    if (auto err = detail::TlsContext::Create(opts, true, ctx); err.has_value())
+        return err;
+
+    m_tls_ctx = ctx;
+    return FASTERR_NOTHING;
+}
+
+TlsStats TcpServer::GetTlsStats() const
+{
+    return m_tls_ctx ? m_tls_ctx->GetStats() : TlsStats{};
+}
+
+BusyPollStats TcpServer::GetBusyPollStats()
+{
+    BusyPollStats total;
+    for (auto& poller : m_busy_pollers) {
+        auto stats = poller->GetStats();
+        total.spin_ns += stats.spin_ns;
+        total.work_ns += stats.work_ns;
+        total.spin_hits += stats.spin_hits;
+        total.blocking_wakeups += stats.blocking_wakeups;
+        total.spin_window_us = std::max(total.spin_window_us, stats.spin_window_us);
+    }
+
+    return total;
+}
+
+void TcpServer::_ApplyCpuAffinity()
+{
+    if (m_affinity_opts.cpu_sets.empty())
+        return;
+
+    m_affinity_events.clear();
+    for (size_t i = 0; i < m_thread_count; ++i) {
+        if (m_thread_pool[i] != nullptr)
+            _PinThread(i, m_thread_pool[i]);
+    }
+}
+
+void TcpServer::_PinThread(size_t index, std::shared_ptr<EvThread> thread)
+{
+    /* 亲和性只能在线程内部设置，通过0超时的一次性事件在线程中执行 */
+    auto& cpus = m_affinity_opts.cpu_sets[index % m_affinity_opts.cpu_sets.size()];
+    auto event = thread->RegisterEvent(-1, EventOpt::TIMEOUT,
+    [weak_this{weak_from_this()}, cpus, numa_local{m_affinity_opts.numa_local_memory}](int, short, EventId){
+        auto shared_this = weak_this.lock();
+        ErrOpt err = detail::PinCurrentThread(cpus);
+        if (!err.has_value() && numa_local)
+            err = detail::UseLocalNumaMemory();
+
+        if (err.has_value() && shared_this != nullptr && shared_this->m_on_err)
+            shared_this->m_on_err(-1, err.value());
+    });
+
+    event->StartListen(0);
+    m_affinity_events.push_back(event);
+}
+
+std::shared_ptr<EvThread> TcpServer::_SteerThread(int fd, std::shared_ptr<EvThread> thread)
+{
+    if (!m_affinity_opts.steer_by_incoming_cpu || m_cpu_thread.empty())
+        return thread;
+
+    int cpu = detail::GetIncomingCpu(fd);
+    auto it = m_cpu_thread.find(cpu);
+    if (it == m_cpu_thread.end() || it->second >= m_thread_pool.size())
+        return thread;
+
+    return m_thread_pool[it->second];
 }
 
 bbt::core::errcode::ErrOpt TcpServer::AsyncListen(const bbt::core::net::IPAddress& listen_addr, const OnAcceptFunc& onaccept_cb)
 {
     std::lock_guard<std::mutex> _(m_listen_mtx);
 
-    if (m_listen_event != nullptr)
+    if (m_listen_event != nullptr || m_listen_token != 0)
         return Errcode{"already listening!", ERRTYPE_ERROR};
 
     if (auto rlt = CreateListen(listen_addr.GetIP().c_str(), listen_addr.GetPort(), true); rlt.IsErr())
@@ -125,37 +286,101 @@ bbt::core::errcode::ErrOpt TcpServer::AsyncListen(const bbt::core::net::IPAddres
     if (onaccept_cb == nullptr)
         return Errcode{"on accept callback is null!", ERRTYPE_ERROR};
 
-    // 初始化事件
-    m_listen_event = GetThread()->RegisterEvent(m_listen_fd, EventOpt::READABLE | EventOpt::PERSIST,
-    [weak_this{weak_from_this()}, onaccept_cb, thread{GetThread()}](int fd, short events, EventId evetid){
-        if (auto shared_this = weak_this.lock(); shared_this != nullptr) {
-            auto pthis = std::static_pointer_cast<TcpServer>(shared_this);
-            pthis->_Accept(fd, events, onaccept_cb, thread);
-        }
-    });
+    /* 选项设置失败不影响监听，通过错误回调通知 */
+    if (auto err = detail::ApplySocketOptions(m_listen_fd, m_socket_opts); err.has_value() && m_on_err)
+        m_on_err(-1, err.value());
 
-    // 注册事件
-    Assert(m_listen_event->StartListen(0) == 0);
     m_listen_addr = listen_addr;
+    _StartListen(onaccept_cb);
     return FASTERR_NOTHING;
 }
 
+bbt::core::errcode::ErrOpt TcpServer::AsyncListenUnix(const std::string& path, const OnAcceptFunc& onaccept_cb)
+{
+    std::lock_guard<std::mutex> _(m_listen_mtx);
+
+    if (m_listen_event != nullptr || m_listen_token != 0)
+        return Errcode{"already listening!", ERRTYPE_ERROR};
+
+    if (onaccept_cb == nullptr)
+        return Errcode{"on accept callback is null!", ERRTYPE_ERROR};
+
+    if (auto err = detail::CreateUnixListen(path, m_listen_fd); err.has_value())
+        return err;
+
+    m_listen_unix_path = path;
+    _StartListen(onaccept_cb);
+    return FASTERR_NOTHING;
+}
+
+void TcpServer::_StartListen(const OnAcceptFunc& onaccept_cb)
+{
+    bool unix_listen = !m_listen_unix_path.empty();
+    /* io_uring 后端不可用时回退到 libevent */
+    if (m_io_backend != emIO_BACKEND_IO_URING || !_ListenInIoUring(onaccept_cb, unix_listen)) {
+        // 初始化事件
+        m_listen_thread = GetThread();
+        m_listen_event = m_listen_thread->RegisterEvent(m_listen_fd, EventOpt::READABLE | EventOpt::PERSIST,
+        [weak_this{weak_from_this()}, onaccept_cb, unix_listen](int fd, short events, EventId evetid){
+            if (auto shared_this = weak_this.lock(); shared_this != nullptr) {
+                auto pthis = std::static_pointer_cast<TcpServer>(shared_this);
+                pthis->_Accept(fd, events, onaccept_cb, unix_listen);
+            }
+        });
+
+        // 注册事件
+        Assert(m_listen_event->StartListen(0) == 0);
+    }
+
+    std::lock_guard<std::mutex> _(m_admission_mtx);
+    if (m_idle_fd < 0)
+        m_idle_fd = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+}
+
 bbt::core::errcode::ErrOpt TcpServer::StopListen()
 {
     std::lock_guard<std::mutex> _(m_listen_mtx);
+    return _StopListen(true);
+}
 
-    if (m_listen_event == nullptr)
+ErrOpt TcpServer::_StopListen(bool remove_path)
+{
+    if (m_listen_event == nullptr && m_listen_token == 0)
         return Errcode{"not listening!", ERRTYPE_ERROR};
-    
-    auto err = m_listen_event->CancelListen();
-    if (err != 0)
-        return Errcode{"cancel event failed!", ERRTYPE_ERROR};
 
-    m_listen_event = nullptr;
+    if (m_listen_token != 0) {
+        m_listen_uring->Cancel(m_listen_token);
+        m_listen_token = 0;
+        m_listen_uring = nullptr;
+    } else {
+        auto err = m_listen_event->CancelListen();
+        if (err != 0)
+            return Errcode{"cancel event failed!", ERRTYPE_ERROR};
+
+        m_listen_event = nullptr;
+    }
+
+    m_listen_thread = nullptr;
+
     if (m_listen_fd > 0)
         ::close(m_listen_fd);
 
     m_listen_fd = -1;
+
+    /* 文件系统路径的unix socket需要删除socket文件 */
+    if (remove_path && !m_listen_unix_path.empty() && m_listen_unix_path[0] != '@')
+        ::unlink(m_listen_unix_path.c_str());
+
+    m_listen_unix_path.clear();
+
+    {
+        std::lock_guard<std::mutex> _(m_admission_mtx);
+        if (m_idle_fd >= 0)
+            ::close(m_idle_fd);
+
+        m_idle_fd = -1;
+    }
+
     return FASTERR_NOTHING;
 }
 
@@ -168,14 +393,14 @@ bbt::core::net::IPAddress TcpServer::GetListenAddress()
 bool TcpServer::IsListening()
 {
     std::lock_guard<std::mutex> _(m_listen_mtx);
-    return m_listen_event != nullptr;
+    return m_listen_event != nullptr || m_listen_token != 0;
 }
 
 
-void TcpServer::_Accept(int listenfd, short events, const OnAcceptFunc& onaccept, std::shared_ptr<EvThread> thread)
+void TcpServer::_Accept(int listenfd, short events, const OnAcceptFunc& onaccept, bool unix_listen)
 {
     evutil_socket_t fd = -1;
-    sockaddr_in     client_addr;
+    sockaddr_storage client_addr;
     socklen_t       len = sizeof(client_addr);
     IPAddress       endpoint;
     std::shared_ptr<detail::Connection> new_conn_sptr = nullptr;
@@ -187,19 +412,198 @@ void TcpServer::_Accept(int listenfd, short events, const OnAcceptFunc& onaccept
     // 有连接，一直接收
     while (true)
     {
+        len = sizeof(client_addr);
         fd = ::accept(listenfd, reinterpret_cast<sockaddr*>(&client_addr), &len);
-        if (fd < 0) break;
+        if (fd < 0) {
+            if (errno == EMFILE || errno == ENFILE)
+                _AcceptNoFd(listenfd);
+            break;
+        }
 
-        endpoint.From(reinterpret_cast<sockaddr*>(&client_addr), len);
-        new_conn_sptr = detail::Connection::Create(thread, fd, endpoint);
+        /* unix socket的对端没有ip地址 */
+        endpoint.Clear();
+        if (client_addr.ss_family == AF_INET || client_addr.ss_family == AF_INET6)
+            endpoint.From(reinterpret_cast<sockaddr*>(&client_addr), len);
+        _OnNewSocket(fd, endpoint, onaccept, unix_listen);
+    }
+}
+
+void TcpServer::_OnNewSocket(int fd, const IPAddress& endpoint, const OnAcceptFunc& onaccept, bool unix_listen)
+{
+    if (!_Admission(fd, endpoint))
+        return;
+
+    auto new_conn_sptr = _CreateConnection(fd, endpoint, false, unix_listen);
+    /* 先应用默认配置，OnAccept中可以对单个连接覆盖，之后再启动连接 */
+    onaccept(new_conn_sptr->GetConnId());
+    new_conn_sptr->RunInEventLoop();
+}
+
+std::shared_ptr<detail::Connection> TcpServer::_CreateConnection(int fd, const IPAddress& endpoint, bool inherited, bool unix_listen)
+{
+    std::shared_ptr<detail::Connection> new_conn_sptr = nullptr;
+    {
+        /* 新连接按当前的线程池轮询分配 */
+        std::lock_guard<std::mutex> _(m_thread_mtx);
+        auto thread = _SteerThread(fd, _PickThread());
+        new_conn_sptr = m_conn_factory ? m_conn_factory(thread, fd, endpoint) : detail::Connection::Create(thread, fd, endpoint);
         // 保存连接
+        std::lock_guard<std::mutex> __(m_conn_map_mutex);
+        m_conn_map[new_conn_sptr->GetConnId()] = new_conn_sptr;
+    }
+
+    /**
+     *  tcp选项不适用于unix socket，unix socket支持fd传递。从旧进程接管的
+     *  连接已经在收发数据，不再握手，旧进程也不会交出tls和共享内存连接
+     */
+    if (!unix_listen) {
+        if (auto err = new_conn_sptr->SetOpt_SocketOptions(m_socket_opts); err.has_value() && m_on_err)
+            m_on_err(new_conn_sptr->GetConnId(), err.value());
+        if (m_tls_ctx != nullptr && !inherited)
+            new_conn_sptr->SetOpt_Tls(m_tls_ctx);
+    } else {
+        new_conn_sptr->SetOpt_PassFd(true);
+        if (m_shm_ring_size > 0 && !inherited)
+            new_conn_sptr->SetOpt_SharedMemory(m_shm_ring_size, false);
+    }
+
+    _InitConnection(new_conn_sptr);
+    return new_conn_sptr;
+}
+
+bool TcpServer::_ListenInIoUring(const OnAcceptFunc& onaccept_cb, bool unix_listen)
+{
+    auto thread = GetThread();
+    ErrOpt err = std::nullopt;
+    auto uring = detail::IoUringContext::GetOrCreate(thread, err);
+    if (uring == nullptr) {
+        if (err.has_value() && m_on_err)
+            m_on_err(-1, err.value());
+        return false;
+    }
+
+    uint64_t token = uring->AcceptMultishot(m_listen_fd,
+    [weak_this{weak_from_this()}, onaccept_cb, unix_listen](int res, const char*, bool more){
+        if (auto shared_this = weak_this.lock(); shared_this != nullptr)
+            shared_this->_OnUringAccept(res, more, onaccept_cb, unix_listen);
+    });
+
+    if (token == 0)
+        return false;
+
+    m_listen_thread = thread;
+    m_listen_uring = uring;
+    m_listen_token = token;
+    return true;
+}
+
+void TcpServer::_OnUringAccept(int res, bool more, const OnAcceptFunc& onaccept, bool unix_listen)
+{
+    if (res >= 0) {
+        sockaddr_storage client_addr;
+        socklen_t   len = sizeof(client_addr);
+        IPAddress   endpoint;
+        if (::getpeername(res, reinterpret_cast<sockaddr*>(&client_addr), &len) == 0 &&
+            (client_addr.ss_family == AF_INET || client_addr.ss_family == AF_INET6))
+            endpoint.From(reinterpret_cast<sockaddr*>(&client_addr), len);
+
+        _OnNewSocket(res, endpoint, onaccept, unix_listen);
+    } else if (res == -EMFILE || res == -ENFILE) {
+        std::lock_guard<std::mutex> _(m_listen_mtx);
+        if (m_listen_fd >= 0)
+            _AcceptNoFd(m_listen_fd);
+    }
+
+    /* multishot accept 出错后会终止，仍在监听时重新提交 */
+    if (more)
+        return;
+
+    std::lock_guard<std::mutex> _(m_listen_mtx);
+    if (m_listen_token == 0 || m_listen_uring == nullptr)
+        return;
+
+    m_listen_token = m_listen_uring->AcceptMultishot(m_listen_fd,
+    [weak_this{weak_from_this()}, onaccept, unix_listen](int res, const char*, bool more){
+        if (auto shared_this = weak_this.lock(); shared_this != nullptr)
+            shared_this->_OnUringAccept(res, more, onaccept, unix_listen);
+    });
+}
+
+bool TcpServer::_Admission(int fd, const IPAddress& addr)
+{
+    std::lock_guard<std::mutex> _(m_admission_mtx);
+
+    /**
+     *  依次检查总连接数、单ip连接数、接受速率，被前面
+     *  规则拒绝的连接不消耗速率令牌
+     */
+    if (m_admission_opts.max_connections > 0) {
+        size_t conn_num = 0;
         {
             std::lock_guard<std::mutex> _(m_conn_map_mutex);
-            m_conn_map[new_conn_sptr->GetConnId()] = new_conn_sptr;
+            conn_num = m_conn_map.size();
+        }
+
+        if (conn_num >= m_admission_opts.max_connections) {
+            ++m_admission_stats.rejected_max_conn;
+            _Reject(fd);
+            return false;
         }
-        onaccept(new_conn_sptr->GetConnId());
-        _InitConnection(new_conn_sptr);
     }
+
+    auto it = m_ip_conn_count.find(addr);
+    if (m_admission_opts.max_connections_per_ip > 0 && it != m_ip_conn_count.end() &&
+        it->second >= m_admission_opts.max_connections_per_ip) {
+        ++m_admission_stats.rejected_per_ip;
+        _Reject(fd);
+        return false;
+    }
+
+    if (m_accept_bucket != nullptr && !m_accept_bucket->TryConsume()) {
+        ++m_admission_stats.rejected_rate;
+        _Reject(fd);
+        return false;
+    }
+
+    if (it != m_ip_conn_count.end())
+        ++it->second;
+    else
+        m_ip_conn_count[addr] = 1;
+
+    ++m_admission_stats.accepted;
+    return true;
+}
+
+void TcpServer::_Reject(int fd)
+{
+    /* 设置 linger 为0，close时直接发送RST，不占用 TIME_WAIT */
+    if (m_admission_opts.reject_with_rst) {
+        struct linger lg{1, 0};
+        ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+    }
+
+    ::close(fd);
+}
+
+void TcpServer::_AcceptNoFd(int listenfd)
+{
+    /**
+     *  fd耗尽时连接会一直留在全连接队列中，水平触发的监听事件
+     *  会不断唤醒。这里释放预留的fd来接受并关闭一个连接，再重
+     *  新占用预留fd
+     */
+    std::lock_guard<std::mutex> _(m_admission_mtx);
+    ++m_admission_stats.rejected_no_fd;
+
+    if (m_idle_fd < 0)
+        return;
+
+    ::close(m_idle_fd);
+    int fd = ::accept(listenfd, nullptr, nullptr);
+    if (fd >= 0)
+        _Reject(fd);
+
+    m_idle_fd = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
 }
 
 void TcpServer::SetTimeout(int connection_timeout)
@@ -207,6 +611,47 @@ void TcpServer::SetTimeout(int connection_timeout)
     m_connection_timeout = connection_timeout;
 }
 
+void TcpServer::SetAdmissionOptions(const AdmissionOptions& opts)
+{
+    std::lock_guard<std::mutex> _(m_admission_mtx);
+    m_admission_opts = opts;
+    if (opts.accept_rate > 0)
+        m_accept_bucket = std::make_unique<detail::TokenBucket>(opts.accept_rate, opts.accept_burst);
+    else
+        m_accept_bucket = nullptr;
+}
+
+void TcpServer::SetRateLimit(const RateLimitOptions& opts)
+{
+    m_rate_limit_opts = opts;
+}
+
+void TcpServer::SetRateLimitGroup(std::shared_ptr<detail::RateLimiter> group)
+{
+    m_rate_limit_group = group;
+}
+
+void TcpServer::SetMemoryBudget(const MemoryBudgetOptions& opts)
+{
+    m_memory_budget = detail::MemoryBudget::Create(opts);
+}
+
+void TcpServer::SetMemoryBudget(std::shared_ptr<detail::MemoryBudget> budget)
+{
+    m_memory_budget = budget;
+}
+
+MemoryStats TcpServer::GetMemoryStats()
+{
+    return m_memory_budget ? m_memory_budget->GetStats() : MemoryStats{};
+}
+
+AdmissionStats TcpServer::GetAdmissionStats()
+{
+    std::lock_guard<std::mutex> _(m_admission_mtx);
+    return m_admission_stats;
+}
+
 ErrOpt TcpServer::Send(ConnId connid, const bbt::core::Buffer& buffer)
 {
     std::lock_guard<std::mutex> _(m_conn_map_mutex);
@@ -218,6 +663,48 @@ ErrOpt TcpServer::Send(ConnId connid, const bbt::core::Buffer& buffer)
     return conn->AsyncSend(buffer.Peek(), buffer.Size());
 }
 
+ErrOpt TcpServer::Send(ConnId connid, const bbt::core::Buffer& buffer, const std::vector<int>& fds)
+{
+    auto conn = GetConnection(connid);
+    if (conn == nullptr)
+        return Errcode{"connid not found!", ERRTYPE_ERROR};
+
+    return conn->AsyncSendWithFds(buffer.Peek(), buffer.Size(), fds);
+}
+
+ErrOpt TcpServer::SendConflated(ConnId connid, uint64_t key, const bbt::core::Buffer& buffer)
+{
+    auto conn = GetConnection(connid);
+    if (conn == nullptr)
+        return Errcode{"connid not found!", ERRTYPE_ERROR};
+
+    return conn->AsyncSendConflated(key, buffer.Peek(), buffer.Size());
+}
+
+ErrOpt TcpServer::Send(ConnId connid, const bbt::core::Buffer& buffer, SendPriority priority)
+{
+    auto conn = GetConnection(connid);
+    if (conn == nullptr)
+        return Errcode{"connid not found!", ERRTYPE_ERROR};
+
+    return conn->AsyncSend(buffer.Peek(), buffer.Size(), priority);
+}
+
+ErrOpt TcpServer::Send(ConnId connid, const bbt::core::Buffer& buffer, const SendOptions& opts)
+{
+    auto conn = GetConnection(connid);
+    if (conn == nullptr)
+        return Errcode{"connid not found!", ERRTYPE_ERROR};
+
+    return conn->AsyncSend(buffer.Peek(), buffer.Size(), opts);
+}
+
+OutputQueueStats TcpServer::GetOutputQueueStats(ConnId connid)
+{
+    auto conn = GetConnection(connid);
+    return conn ? conn->GetOutputQueueStats() : OutputQueueStats{};
+}
+
 void TcpServer::Close(ConnId connid)
 {
     std::shared_ptr<detail::Connection> conn = nullptr;
@@ -244,52 +731,855 @@ detail::ConnectionSPtr TcpServer::GetConnection(ConnId connid)
     return it->second;
 }
 
-void TcpServer::OnTimeout(ConnId connid)
+void TcpServer::OnTimeout(detail::ConnectionSPtr conn)
 {
     if (m_on_timeout != nullptr)
-        m_on_timeout(connid);
+        m_on_timeout(conn->GetConnId());
+    else
+        m_on_err(conn->GetConnId(), Errcode{"no register ontimeout!", emErr::ERRTYPE_ERROR});
 }
 
-void TcpServer::OnSend(ConnId connid, ErrOpt err, size_t send_len)
+void TcpServer::OnSend(detail::ConnectionSPtr conn, ErrOpt err, size_t send_len)
 {
-    if (m_on_send != nullptr)
-        m_on_send(connid, err, send_len);
+    if (m_on_send_ctx != nullptr)
+        m_on_send_ctx(conn->GetConnId(), conn->GetContextPtr(), err, send_len);
+    else if (m_on_send != nullptr)
+        m_on_send(conn->GetConnId(), err, send_len);
+    else
+        m_on_err(conn->GetConnId(), Errcode{"no register onsend!", emErr::ERRTYPE_ERROR});
 }
 
-void TcpServer::OnRecv(ConnId connid, bbt::core::Buffer& buffer)
+void TcpServer::OnRecv(detail::ConnectionSPtr conn, const bbt::core::Buffer& buffer)
 {
-    if (m_on_recv != nullptr)
-        m_on_recv(connid, buffer);
+    if (m_on_recv_ctx != nullptr)
+        m_on_recv_ctx(conn->GetConnId(), conn->GetContextPtr(), buffer);
+    else if (m_on_recv != nullptr)
+        m_on_recv(conn->GetConnId(), buffer);
+    else
+        m_on_err(conn->GetConnId(), Errcode{"no register onrecv!", emErr::ERRTYPE_ERROR});
 }
 
-void TcpServer::OnClose(ConnId connid)
+void TcpServer::OnRecvBatch(detail::ConnectionSPtr conn, const FrameBatch& frames)
 {
+    if (m_on_recv_batch != nullptr)
+        m_on_recv_batch(conn->GetConnId(), conn->GetContextPtr(), frames);
+}
+
+void TcpServer::OnClose(ConnId connid, const IPAddress& addr)
+{
+    /* 持有连接直到关闭回调结束，保证上下文在回调中有效 */
+    detail::ConnectionSPtr conn = nullptr;
     {
         std::unique_lock<std::mutex> _{m_conn_map_mutex};
         auto it = m_conn_map.find(connid);
-        if (it != m_conn_map.end())
+        if (it != m_conn_map.end()) {
+            conn = it->second;
             m_conn_map.erase(it);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> _(m_admission_mtx);
+        auto it = m_ip_conn_count.find(addr);
+        if (it != m_ip_conn_count.end() && --it->second == 0)
+            m_ip_conn_count.erase(it);
+    }
+
+    /* 关闭回调排在该连接已提交的回调之后，线程池已经停止时直接通知 */
+    if (conn != nullptr && conn->HasWorkerPool()) {
+        bool submitted = conn->RunInWorker([weak_this{weak_from_this()}, connid, conn](){
+            if (auto shared_this = weak_this.lock(); shared_this != nullptr)
+                shared_this->_NotifyClose(connid, conn);
+        });
+        if (submitted)
+            return;
     }
 
-    if (m_on_close != nullptr)
+    _NotifyClose(connid, conn);
+}
+
+void TcpServer::_NotifyClose(ConnId connid, detail::ConnectionSPtr conn)
+{
+    if (m_on_close_ctx != nullptr)
+        m_on_close_ctx(connid, conn ? conn->GetContextPtr() : nullptr);
+    else if (m_on_close != nullptr)
         m_on_close(connid);
-    else
+    else if (m_conn_factory == nullptr)
         m_on_err(connid, Errcode{"no register onclose!", emErr::ERRTYPE_ERROR});
 }
 
 std::shared_ptr<EvThread> TcpServer::GetThread()
+{
+    std::lock_guard<std::mutex> _(m_thread_mtx);
+    return _PickThread();
+}
+
+std::shared_ptr<EvThread> TcpServer::_PickThread()
 {
     m_load_blance = m_load_blance + 1;
     return m_thread_pool[m_load_blance % m_thread_count];
 }
 
+size_t TcpServer::GetThreadCount()
+{
+    std::lock_guard<std::mutex> _(m_thread_mtx);
+    return m_thread_count;
+}
+
+ErrOpt TcpServer::AddThreads(size_t count)
+{
+    if (count == 0)
+        return FASTERR_ERROR("add threads failed! count is 0!");
+
+    std::vector<std::shared_ptr<EvThread>> threads;
+    for (size_t i = 0; i < count; ++i) {
+        auto thread = std::make_shared<EvThread>();
+        /* Init之前加入的线程由Init启动 */
+        if (m_shared_callbacks != nullptr)
+            thread->Start();
+        if (m_busy_poll_opts.enable) {
+            if (auto poller = detail::BusyPoller::GetOrCreate(thread, m_busy_poll_opts); poller != nullptr)
+                m_busy_pollers.push_back(poller);
+        }
+        threads.push_back(thread);
+    }
+
+    std::lock_guard<std::mutex> _(m_thread_mtx);
+    for (auto& thread : threads) {
+        size_t index = m_thread_pool.size();
+        m_owned_threads.insert(thread.get());
+        m_thread_pool.push_back(thread);
+
+        /* 新线程按下标继续轮流使用cpu_sets，Init之前加入的线程由Init绑定 */
+        if (m_affinity_opts.cpu_sets.empty())
+            continue;
+        for (int cpu : m_affinity_opts.cpu_sets[index % m_affinity_opts.cpu_sets.size()])
+            m_cpu_thread.emplace(cpu, index);
+        if (m_shared_callbacks != nullptr)
+            _PinThread(index, thread);
+    }
+    m_thread_count = m_thread_pool.size();
+    return FASTERR_NOTHING;
+}
+
+ErrOpt TcpServer::RemoveThreads(size_t count)
+{
+    /* 一个被移除线程的迁移进度，所有连接迁移结束后决定是否停止线程 */
+    struct Drain
+    {
+        std::shared_ptr<EvThread> thread;
+        bool                owned{false};
+        std::atomic_int     pending{1};
+        std::atomic_bool    failed{false};
+    };
+    std::vector<std::shared_ptr<Drain>> drains;
+    std::vector<std::pair<detail::ConnectionSPtr, std::shared_ptr<Drain>>> conns;
+
+    {
+        /* m_listen_thread由m_listen_mtx保护 */
+        std::lock_guard<std::mutex> listen_lock(m_listen_mtx);
+        std::lock_guard<std::mutex> _(m_thread_mtx);
+        if (count == 0 || count >= m_thread_pool.size())
+            return FASTERR_ERROR("remove threads failed! at least one thread must be kept!");
+
+        for (size_t i = m_thread_pool.size() - count; i < m_thread_pool.size(); ++i) {
+            if (m_thread_pool[i] == m_listen_thread)
+                return FASTERR_ERROR("remove threads failed! can not remove the listening thread!");
+        }
+
+        for (size_t i = m_thread_pool.size() - count; i < m_thread_pool.size(); ++i) {
+            auto drain = std::make_shared<Drain>();
+            drain->thread = m_thread_pool[i];
+            drain->owned = m_owned_threads.erase(m_thread_pool[i].get()) > 0;
+            drains.push_back(drain);
+        }
+        m_thread_pool.resize(m_thread_pool.size() - count);
+        m_thread_count = m_thread_pool.size();
+
+        /* 持有m_thread_mtx，之后接受的连接不会再分配到被移除的线程上 */
+        std::lock_guard<std::mutex> __(m_conn_map_mutex);
+        for (auto& [connid, conn] : m_conn_map) {
+            auto thread = conn->GetBindThread();
+            for (auto& drain : drains) {
+                if (drain->thread == thread) {
+                    conns.emplace_back(conn, drain);
+                    break;
+                }
+            }
+        }
+    }
+
+    auto finish = [weak_this{weak_from_this()}](std::shared_ptr<Drain> drain){
+        if (--drain->pending > 0)
+            return;
+
+        /**
+         * 最后一个连接的迁移可能在被移除的线程中结束（例如迁移失败），
+         * 线程不能停止自己，交给独立的线程停止和回收
+         */
+        if (!drain->failed.load()) {
+            if (drain->owned) {
+                std::thread([thread{drain->thread}](){
+                    thread->Stop();
+                    detail::IoUringContext::Release(thread);
+                }).detach();
+            }
+            return;
+        }
+
+        if (auto shared_this = weak_this.lock(); shared_this != nullptr && shared_this->m_on_err)
+            shared_this->m_on_err(-1, Errcode{"remove threads: some connections failed to migrate, the thread keeps running!", ERRTYPE_MIGRATE_FAILED});
+    };
+
+    for (auto& [conn, drain] : conns) {
+        ++drain->pending;
+        auto err = conn->MigrateTo(GetThread(),
+        [weak_this{weak_from_this()}, weak_conn{std::weak_ptr<detail::Connection>(conn)}, drain, finish](ConnId connid, ErrOpt err){
+            if (auto shared_this = weak_this.lock(); shared_this != nullptr)
+                shared_this->_OnMigrated(connid, err);
+            /* 迁移时已经关闭的连接不再需要这个线程 */
+            if (auto pconn = weak_conn.lock(); err.has_value() && pconn != nullptr && !pconn->IsClosed())
+                drain->failed = true;
+            finish(drain);
+        });
+
+        if (err.has_value()) {
+            _OnMigrated(conn->GetConnId(), err);
+            if (!conn->IsClosed())
+                drain->failed = true;
+            finish(drain);
+        }
+    }
+
+    for (auto& drain : drains)
+        finish(drain);
+
+    return FASTERR_NOTHING;
+}
+
+ErrOpt TcpServer::MigrateConnection(ConnId connid, size_t thread_index, const OnMigrateFunc& on_done)
+{
+    auto conn = GetConnection(connid);
+    if (conn == nullptr)
+        return Errcode{"connid not found!", ERRTYPE_ERROR};
+
+    std::shared_ptr<EvThread> thread = nullptr;
+    {
+        std::lock_guard<std::mutex> _(m_thread_mtx);
+        if (thread_index >= m_thread_pool.size())
+            return FASTERR_ERROR("migrate failed! thread index out of range! index=" + std::to_string(thread_index));
+        thread = m_thread_pool[thread_index];
+    }
+
+    return conn->MigrateTo(thread, [weak_this{weak_from_this()}, on_done](ConnId connid, ErrOpt err){
+        if (auto shared_this = weak_this.lock(); shared_this != nullptr)
+            shared_this->_OnMigrated(connid, err);
+        if (on_done)
+            on_done(connid, err);
+    });
+}
+
+void TcpServer::_OnMigrated(ConnId connid, ErrOpt err)
+{
+    std::lock_guard<std::mutex> _(m_rebalance_mtx);
+    if (err.has_value())
+        ++m_rebalance_stats.failed;
+    else
+        ++m_rebalance_stats.migrations;
+}
+
+void TcpServer::SetRebalance(const RebalanceOptions& opts)
+{
+    m_rebalance_opts = opts;
+    if (m_shared_callbacks != nullptr)
+        _StartRebalance();
+}
+
+void TcpServer::_StartRebalance()
+{
+    if (m_rebalance_event != nullptr) {
+        m_rebalance_event->CancelListen();
+        m_rebalance_event = nullptr;
+    }
+
+    if (!m_rebalance_opts.enable || m_rebalance_opts.interval_ms <= 0)
+        return;
+
+    /* 第一个线程不会被移除 */
+    std::shared_ptr<EvThread> thread = nullptr;
+    {
+        std::lock_guard<std::mutex> _(m_thread_mtx);
+        thread = m_thread_pool[0];
+    }
+
+    m_rebalance_event = thread->RegisterEvent(-1, EventOpt::TIMEOUT | EventOpt::PERSIST,
+    [weak_this{weak_from_this()}](int, short, EventId){
+        if (auto shared_this = weak_this.lock(); shared_this != nullptr)
+            shared_this->_Rebalance();
+    });
+    m_rebalance_event->StartListen(m_rebalance_opts.interval_ms);
+}
+
+void TcpServer::_Rebalance()
+{
+    std::vector<std::shared_ptr<EvThread>> threads;
+    {
+        std::lock_guard<std::mutex> _(m_thread_mtx);
+        threads = m_thread_pool;
+    }
+
+    std::vector<detail::ConnectionSPtr> conns;
+    {
+        std::lock_guard<std::mutex> _(m_conn_map_mutex);
+        conns.reserve(m_conn_map.size());
+        for (auto& [connid, conn] : m_conn_map)
+            conns.push_back(conn);
+    }
+
+    /* 按线程汇总各连接在这个周期内处理的事件数 */
+    std::vector<ThreadLoad> loads(threads.size());
+    std::vector<std::vector<std::pair<uint64_t, detail::ConnectionSPtr>>> candidates(threads.size());
+    std::unordered_map<ConnId, uint64_t> sample;
+    sample.reserve(conns.size());
+    for (auto& conn : conns) {
+        auto it = std::find(threads.begin(), threads.end(), conn->GetBindThread());
+        if (it == threads.end())
+            continue;
+
+        size_t index = it - threads.begin();
+        uint64_t events = conn->GetIoEvents();
+        auto last = m_rebalance_sample.find(conn->GetConnId());
+        uint64_t delta = (last != m_rebalance_sample.end() && events >= last->second) ? events - last->second : events;
+        sample[conn->GetConnId()] = events;
+
+        ++loads[index].connections;
+        loads[index].events += delta;
+        if (delta > 0 && !conn->IsMigrating())
+            candidates[index].emplace_back(delta, conn);
+    }
+    m_rebalance_sample.swap(sample);
+
+    std::vector<uint64_t> load(threads.size());
+    uint64_t total = 0;
+    for (size_t i = 0; i < loads.size(); ++i) {
+        load[i] = loads[i].events;
+        total += load[i];
+    }
+
+    /**
+     *  每次从最忙的线程迁移一个连接到最闲的线程，只选择不超过两者
+     *  负载差一半的连接，迁移后最闲的线程不会变成新的最忙线程
+     */
+    for (size_t round = 0; threads.size() > 1 && round < m_rebalance_opts.max_migrations; ++round) {
+        size_t hot = std::max_element(load.begin(), load.end()) - load.begin();
+        size_t cold = std::min_element(load.begin(), load.end()) - load.begin();
+        double avg = (double)total / threads.size();
+        if (load[hot] < m_rebalance_opts.min_events || load[hot] < avg * m_rebalance_opts.imbalance_ratio)
+            break;
+
+        uint64_t limit = (load[hot] - load[cold]) / 2;
+        auto& list = candidates[hot];
+        auto best = list.end();
+        for (auto it = list.begin(); it != list.end(); ++it) {
+            if (it->first <= limit && (best == list.end() || it->first > best->first))
+                best = it;
+        }
+
+        if (best == list.end())
+            break;
+
+        auto [delta, conn] = *best;
+        list.erase(best);
+        auto err = conn->MigrateTo(threads[cold], [weak_this{weak_from_this()}](ConnId connid, ErrOpt err){
+            if (auto shared_this = weak_this.lock(); shared_this != nullptr)
+                shared_this->_OnMigrated(connid, err);
+        });
+
+        if (err.has_value()) {
+            _OnMigrated(conn->GetConnId(), err);
+            continue;
+        }
+
+        load[hot] -= delta;
+        load[cold] += delta;
+    }
+
+    std::lock_guard<std::mutex> _(m_rebalance_mtx);
+    m_thread_load.swap(loads);
+    ++m_rebalance_stats.rounds;
+}
+
+std::vector<ThreadLoad> TcpServer::GetThreadLoad()
+{
+    std::lock_guard<std::mutex> _(m_rebalance_mtx);
+    return m_thread_load;
+}
+
+RebalanceStats TcpServer::GetRebalanceStats()
+{
+    std::lock_guard<std::mutex> _(m_rebalance_mtx);
+    return m_rebalance_stats;
+}
+
+/* 交接线程等待各连接在自己的线程中交出socket */
+struct HandoffWait
+{
+    struct Detached
+    {
+        ConnId          connid{0};
+        int             fd{-1};
+        std::string     input;
+        std::string     state;
+    };
+
+    std::mutex          mtx;
+    std::condition_variable cv;
+    size_t              pending{0};
+    size_t              skipped{0};
+    bool                abandoned{false};   // 等待超时后交出的socket直接关闭
+    std::vector<Detached> detached;
+};
+
+ErrOpt TcpServer::EnableHotRestart(const std::string& path, const HotRestartOptions& opts)
+{
+    if (m_shared_callbacks == nullptr)
+        return FASTERR_ERROR("enable hot restart failed! call Init first!");
+
+    std::shared_ptr<EvThread> thread = nullptr;
+    {
+        std::lock_guard<std::mutex> _(m_thread_mtx);
+        thread = m_thread_pool[0];
+    }
+
+    std::lock_guard<std::mutex> _(m_hot_restart_mtx);
+    if (m_handoff_fd >= 0)
+        return Errcode{"hot restart is already enabled!", ERRTYPE_ERROR};
+
+    if (auto err = detail::CreateHandoffListen(path, m_handoff_fd); err.has_value())
+        return err;
+
+    m_handoff_path = path;
+    m_hot_restart_opts = opts;
+    m_handoff_event = thread->RegisterEvent(m_handoff_fd, EventOpt::READABLE | EventOpt::PERSIST,
+    [weak_this{weak_from_this()}](int fd, short, EventId){
+        if (auto shared_this = weak_this.lock(); shared_this != nullptr)
+            shared_this->_OnHandoffRequest(fd);
+    });
+    m_handoff_event->StartListen(0);
+    return FASTERR_NOTHING;
+}
+
+void TcpServer::_OnHandoffRequest(int listenfd)
+{
+    int fd = ::accept4(listenfd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0)
+        return;
+
+    /* 只允许同一用户的进程接管 */
+    if (auto err = detail::CheckHandoffPeer(fd); err.has_value()) {
+        ::close(fd);
+        if (m_on_err)
+            m_on_err(-1, err.value());
+        return;
+    }
+
+    bool running = false;
+    if (!m_handoff_running.compare_exchange_strong(running, true)) {
+        ::close(fd);
+        return;
+    }
+
+    HotRestartOptions opts;
+    {
+        std::lock_guard<std::mutex> _(m_hot_restart_mtx);
+        opts = m_hot_restart_opts;
+    }
+
+    /* 控制连接是阻塞的，交接放到单独的线程中，不阻塞事件循环 */
+    std::thread([shared_this{shared_from_this()}, fd, opts](){
+        bool handed_off = false;
+        detail::SetHandoffTimeout(fd, HOT_RESTART_IO_TIMEOUT_MS);
+        auto err = shared_this->_Handoff(fd, opts, handed_off);
+        ::close(fd);
+
+        /* 交出监听前失败时继续服务，新进程可以重试 */
+        if (!handed_off)
+            shared_this->m_handoff_running.exchange(false);
+        if (err.has_value() && shared_this->m_on_err)
+            shared_this->m_on_err(-1, err.value());
+    }).detach();
+}
+
+ErrOpt TcpServer::_Handoff(int fd, const HotRestartOptions& opts, bool& handed_off)
+{
+    detail::HandoffMsg msg;
+    if (auto err = detail::RecvHandoffMsg(fd, msg); err.has_value())
+        return err;
+
+    detail::CloseHandoffFds(msg);
+    if (msg.type != detail::emHANDOFF_HELLO)
+        return Errcode{"hot restart failed! unexpected message from new process!", ERRTYPE_HOT_RESTART_FAILED};
+
+    /* 复制一份监听socket，交出期间不受StopListen影响 */
+    int listen_fd = -1;
+    std::string unix_path;
+    {
+        std::lock_guard<std::mutex> _(m_listen_mtx);
+        if (m_listen_fd < 0)
+            return Errcode{"hot restart failed! not listening!", ERRTYPE_HOT_RESTART_FAILED};
+
+        listen_fd = ::fcntl(m_listen_fd, F_DUPFD_CLOEXEC, 0);
+        unix_path = m_listen_unix_path;
+    }
+
+    if (listen_fd < 0)
+        return Errcode{"hot restart failed! dup listen socket failed! " + std::string{strerror(errno)}, ERRTYPE_HOT_RESTART_FAILED};
+
+    auto err = detail::SendHandoffMsg(fd, detail::emHANDOFF_LISTEN, unix_path, {listen_fd});
+    ::close(listen_fd);
+    if (err.has_value())
+        return err;
+
+    /* 新进程已经在同一个监听队列上接受连接，之后本进程才停止接受 */
+    if (auto err = detail::RecvHandoffMsg(fd, msg); err.has_value())
+        return err;
+
+    detail::CloseHandoffFds(msg);
+    if (msg.type != detail::emHANDOFF_READY)
+        return Errcode{"hot restart failed! unexpected message from new process!", ERRTYPE_HOT_RESTART_FAILED};
+
+    {
+        std::lock_guard<std::mutex> _(m_listen_mtx);
+        _StopListen(false);
+    }
+
+    handed_off = true;
+    {
+        std::lock_guard<std::mutex> _(m_hot_restart_mtx);
+        ++m_hot_restart_stats.handoffs;
+    }
+
+    if (opts.handoff_connections)
+        err = _HandoffConnections(fd, opts);
+
+    /* 先关闭控制socket，新进程收到DONE后可以在同一路径上重新开启 */
+    _CloseHandoffListen(false);
+    if (!err.has_value())
+        err = detail::SendHandoffMsg(fd, detail::emHANDOFF_DONE, "");
+
+    _StartDrain();
+    return err;
+}
+
+ErrOpt TcpServer::_HandoffConnections(int fd, const HotRestartOptions& opts)
+{
+    std::vector<detail::ConnectionSPtr> conns;
+    {
+        std::lock_guard<std::mutex> _(m_conn_map_mutex);
+        conns.reserve(m_conn_map.size());
+        for (auto& [connid, conn] : m_conn_map)
+            conns.push_back(conn);
+    }
+
+    /* 各连接在自己的线程中同时交出，这里统一等待 */
+    auto wait = std::make_shared<HandoffWait>();
+    wait->pending = conns.size();
+    for (auto& conn : conns) {
+        ConnId connid = conn->GetConnId();
+        auto err = conn->Detach([wait, connid, export_state{opts.export_state}](int sockfd, std::string input){
+            HandoffWait::Detached detached{connid, sockfd, std::move(input), ""};
+            /* 连接还没有关闭，用户状态仍然有效 */
+            if (sockfd >= 0 && export_state)
+                detached.state = export_state(connid);
+
+            std::lock_guard<std::mutex> _(wait->mtx);
+            if (wait->abandoned) {
+                if (sockfd >= 0)
+                    ::close(sockfd);
+                return;
+            }
+
+            if (sockfd >= 0)
+                wait->detached.push_back(std::move(detached));
+            else
+                ++wait->skipped;
+
+            if (--wait->pending == 0)
+                wait->cv.notify_all();
+        });
+
+        if (err.has_value()) {
+            std::lock_guard<std::mutex> _(wait->mtx);
+            ++wait->skipped;
+            --wait->pending;
+        }
+    }
+
+    std::vector<HandoffWait::Detached> detached;
+    size_t skipped = 0;
+    {
+        std::unique_lock<std::mutex> lock(wait->mtx);
+        wait->cv.wait_for(lock, std::chrono::milliseconds(HOT_RESTART_IO_TIMEOUT_MS), [wait](){ return wait->pending == 0; });
+        wait->abandoned = true;
+        skipped = wait->skipped + wait->pending;
+        detached.swap(wait->detached);
+    }
+
+    /* 发送失败后剩余的socket只能关闭，对应的连接在本进程中已经关闭 */
+    ErrOpt err = std::nullopt;
+    size_t sent = 0;
+    for (auto& conn : detached) {
+        if (!err.has_value()) {
+            uint32_t input_len = conn.input.size();
+            std::string payload;
+            payload.reserve(sizeof(input_len) + conn.input.size() + conn.state.size());
+            payload.append(reinterpret_cast<const char*>(&input_len), sizeof(input_len));
+            payload.append(conn.input);
+            payload.append(conn.state);
+
+            err = detail::SendHandoffMsg(fd, detail::emHANDOFF_CONN, payload, {conn.fd});
+            if (!err.has_value())
+                ++sent;
+        }
+
+        ::close(conn.fd);
+    }
+
+    std::lock_guard<std::mutex> _(m_hot_restart_mtx);
+    m_hot_restart_stats.conns_sent += sent;
+    m_hot_restart_stats.conns_skipped += skipped;
+    return err;
+}
+
+void TcpServer::_CloseHandoffListen(bool remove_path)
+{
+    std::lock_guard<std::mutex> _(m_hot_restart_mtx);
+    if (m_handoff_event != nullptr) {
+        m_handoff_event->CancelListen();
+        m_handoff_event = nullptr;
+    }
+
+    if (m_handoff_fd >= 0)
+        ::close(m_handoff_fd);
+
+    m_handoff_fd = -1;
+
+    if (remove_path && !m_handoff_path.empty() && m_handoff_path[0] != '@')
+        ::unlink(m_handoff_path.c_str());
+
+    m_handoff_path.clear();
+}
+
+void TcpServer::_StartDrain()
+{
+    std::shared_ptr<EvThread> thread = nullptr;
+    {
+        std::lock_guard<std::mutex> _(m_thread_mtx);
+        thread = m_thread_pool[0];
+    }
+
+    std::lock_guard<std::mutex> _(m_hot_restart_mtx);
+    m_draining = true;
+    m_drain_begin = std::chrono::steady_clock::now();
+    m_drain_event = thread->RegisterEvent(-1, EventOpt::TIMEOUT | EventOpt::PERSIST,
+    [weak_this{weak_from_this()}](int, short, EventId){
+        if (auto shared_this = weak_this.lock(); shared_this != nullptr)
+            shared_this->_CheckDrain();
+    });
+    m_drain_event->StartListen(HOT_RESTART_DRAIN_CHECK_MS);
+}
+
+void TcpServer::_CheckDrain()
+{
+    std::vector<detail::ConnectionSPtr> conns;
+    {
+        std::lock_guard<std::mutex> _(m_conn_map_mutex);
+        conns.reserve(m_conn_map.size());
+        for (auto& [connid, conn] : m_conn_map)
+            conns.push_back(conn);
+    }
+
+    std::function<void()> on_drained = nullptr;
+    {
+        std::lock_guard<std::mutex> _(m_hot_restart_mtx);
+        if (!m_draining)
+            return;
+
+        int timeout_ms = m_hot_restart_opts.drain_timeout_ms;
+        bool expired = timeout_ms > 0 && std::chrono::steady_clock::now() - m_drain_begin >= std::chrono::milliseconds(timeout_ms);
+        if (!conns.empty() && !expired)
+            return;
+
+        /* 在自己的回调中，只注销不释放 */
+        m_drain_event->CancelListen();
+        m_draining = false;
+        on_drained = m_hot_restart_opts.on_drained;
+    }
+
+    /* 超过排空时间还没有关闭的连接强制关闭 */
+    for (auto& conn : conns)
+        conn->Close();
+
+    if (on_drained)
+        on_drained();
+}
+
+ErrOpt TcpServer::TakeoverListen(const std::string& path, const OnAcceptFunc& onaccept_cb, int timeout_ms)
+{
+    if (onaccept_cb == nullptr)
+        return Errcode{"on accept callback is null!", ERRTYPE_ERROR};
+
+    if (m_shared_callbacks == nullptr)
+        return FASTERR_ERROR("takeover listen failed! call Init first!");
+
+    if (IsListening())
+        return Errcode{"already listening!", ERRTYPE_ERROR};
+
+    int fd = -1;
+    if (auto err = detail::ConnectHandoff(path, timeout_ms, fd); err.has_value())
+        return err;
+
+    auto err = _Takeover(fd, onaccept_cb);
+    ::close(fd);
+    return err;
+}
+
+ErrOpt TcpServer::_Takeover(int fd, const OnAcceptFunc& onaccept_cb)
+{
+    detail::HandoffMsg msg;
+    if (auto err = detail::SendHandoffMsg(fd, detail::emHANDOFF_HELLO, ""); err.has_value())
+        return err;
+
+    if (auto err = detail::RecvHandoffMsg(fd, msg); err.has_value())
+        return err;
+
+    if (msg.type != detail::emHANDOFF_LISTEN || msg.fds.size() != 1) {
+        detail::CloseHandoffFds(msg);
+        return Errcode{"hot restart failed! unexpected message from old process!", ERRTYPE_HOT_RESTART_FAILED};
+    }
+
+    int listen_fd = msg.fds[0];
+    bool unix_listen = !msg.payload.empty();
+    {
+        std::lock_guard<std::mutex> _(m_listen_mtx);
+        if (m_listen_event != nullptr || m_listen_token != 0) {
+            ::close(listen_fd);
+            return Errcode{"already listening!", ERRTYPE_ERROR};
+        }
+
+        /* tcp的监听地址从socket上取得，unix socket使用旧进程的路径 */
+        if (msg.payload.empty()) {
+            sockaddr_storage addr;
+            socklen_t len = sizeof(addr);
+            if (::getsockname(listen_fd, reinterpret_cast<sockaddr*>(&addr), &len) == 0)
+                m_listen_addr.From(reinterpret_cast<sockaddr*>(&addr), len);
+        } else {
+            m_listen_unix_path = msg.payload;
+        }
+
+        evutil_make_socket_nonblocking(listen_fd);
+        m_listen_fd = listen_fd;
+        _StartListen(onaccept_cb);
+    }
+
+    /* 从这里开始两个进程同时在接受连接，旧进程收到READY后停止 */
+    if (auto err = detail::SendHandoffMsg(fd, detail::emHANDOFF_READY, ""); err.has_value()) {
+        if (m_on_err)
+            m_on_err(-1, err.value());
+        return FASTERR_NOTHING;
+    }
+
+    while (true) {
+        if (auto err = detail::RecvHandoffMsg(fd, msg); err.has_value()) {
+            if (m_on_err)
+                m_on_err(-1, err.value());
+            break;
+        }
+
+        if (msg.type == detail::emHANDOFF_DONE) {
+            detail::CloseHandoffFds(msg);
+            break;
+        }
+
+        uint32_t input_len = 0;
+        if (msg.payload.size() >= sizeof(input_len))
+            memcpy(&input_len, msg.payload.data(), sizeof(input_len));
+
+        if (msg.type != detail::emHANDOFF_CONN || msg.fds.size() != 1 ||
+            msg.payload.size() < sizeof(input_len) + input_len) {
+            detail::CloseHandoffFds(msg);
+            if (m_on_err)
+                m_on_err(-1, Errcode{"hot restart failed! unexpected message from old process!", ERRTYPE_HOT_RESTART_FAILED});
+            break;
+        }
+
+        _OnInheritedSocket(msg.fds[0], msg.payload.substr(sizeof(input_len), input_len),
+                           msg.payload.substr(sizeof(input_len) + input_len), onaccept_cb, unix_listen);
+    }
+
+    return FASTERR_NOTHING;
+}
+
+void TcpServer::_OnInheritedSocket(int fd, const std::string& input, const std::string& state, const OnAcceptFunc& onaccept, bool unix_listen)
+{
+    sockaddr_storage client_addr;
+    socklen_t   len = sizeof(client_addr);
+    IPAddress   endpoint;
+    if (::getpeername(fd, reinterpret_cast<sockaddr*>(&client_addr), &len) == 0 &&
+        (client_addr.ss_family == AF_INET || client_addr.ss_family == AF_INET6))
+        endpoint.From(reinterpret_cast<sockaddr*>(&client_addr), len);
+
+    /* 旧进程中已经通过准入，这里只计入来源ip的连接数，关闭时对称扣减 */
+    {
+        std::lock_guard<std::mutex> _(m_admission_mtx);
+        ++m_ip_conn_count[endpoint];
+    }
+
+    auto conn = _CreateConnection(fd, endpoint, true, unix_listen);
+    if (!input.empty()) {
+        if (auto err = conn->SetOpt_FrameInput(input); err.has_value() && m_on_err)
+            m_on_err(conn->GetConnId(), err.value());
+    }
+
+    {
+        std::lock_guard<std::mutex> _(m_hot_restart_mtx);
+        ++m_hot_restart_stats.conns_inherited;
+    }
+
+    onaccept(conn->GetConnId());
+    if (m_on_inherit)
+        m_on_inherit(conn->GetConnId(), state);
+    conn->RunInEventLoop();
+}
+
+HotRestartStats TcpServer::GetHotRestartStats()
+{
+    std::lock_guard<std::mutex> _(m_hot_restart_mtx);
+    return m_hot_restart_stats;
+}
+
 void TcpServer::_InitConnection(std::shared_ptr<detail::Connection> conn)
 {
     Assert(conn != nullptr);
-    Assert(callbacks.on_recv_callback != nullptr);
+    Assert(m_shared_callbacks != nullptr);
     conn->SetOpt_CloseTimeoutMS(m_connection_timeout);
-    conn->SetOpt_Callbacks(callbacks);
-    conn->RunInEventLoop();
+    conn->SetOpt_Callbacks(m_shared_callbacks);
+    conn->SetOpt_IOBackend(m_io_backend);
+    conn->SetOpt_EdgeTriggered(m_edge_triggered, m_read_budget);
+    conn->SetOpt_WriteCoalescing(m_write_coalescing);
+    conn->SetOpt_SendDeadline(m_send_deadline_ms);
+    conn->SetOpt_SendTimeout(m_send_timeout_ms);
+    if (m_frame_parser && m_on_recv_batch)
+        conn->SetOpt_FrameParser(m_frame_parser);
+    if (m_rate_limit_opts.has_value())
+        conn->SetOpt_RateLimit(m_rate_limit_opts.value());
+    if (m_rate_limit_group != nullptr)
+        conn->SetOpt_RateLimitGroup(m_rate_limit_group);
+    if (m_worker_pool != nullptr)
+        conn->SetOpt_WorkerPool(m_worker_pool);
+    if (m_memory_budget != nullptr)
+        conn->SetOpt_MemoryBudget(m_memory_budget);
+    conn->SetOpt_BusyPoll(m_busy_poll_opts);
 }
 
 
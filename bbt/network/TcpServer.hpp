@@ -1,7 +1,13 @@
 #pragma once
+#include <atomic>
+#include <chrono>
+#include <unordered_set>
 #include <bbt/pollevent/EvThread.hpp>
 #include <bbt/network/detail/Define.hpp>
 #include <bbt/core/crypto/BKDR.hpp>
+#include <bbt/network/detail/RateLimiter.hpp>
+#include <bbt/network/detail/MemoryBudget.hpp>
+#include <bbt/network/detail/StaticConnection.hpp>
 
 namespace bbt::network
 {
@@ -31,6 +37,85 @@ public:
      */
     void            Init();
 
+    /**
+     * @brief 设置EvThread的cpu亲和性，需要在Init前调用
+     * Init启动线程后，每个线程在自己的事件循环中绑定cpu并设置numa
+     * 本地内存策略。开启steer_by_incoming_cpu后，新连接根据网卡队列
+     * 所在的cpu（SO_INCOMING_CPU）分配给绑定到该cpu的线程，没有对应
+     * 线程时仍然轮询分配
+     * 
+     * @param opts 
+     */
+    void            SetCpuAffinity(const CpuAffinityOptions& opts);
+
+    /**
+     * @brief 设置自适应忙轮询，以占用cpu换取更低的延迟
+     * 有连接事件后EvThread在空转窗口内非阻塞地轮询，窗口随流量自适应，
+     * 超过窗口没有事件则退回阻塞等待。只对libevent后端生效
+     * 
+     * @param opts 
+     */
+    void            SetBusyPoll(const BusyPollOptions& opts);
+
+    /**
+     * @brief 获取所有EvThread忙轮询统计的汇总，spin_window_us为各线程的最大值
+     * 
+     * @return BusyPollStats 
+     */
+    BusyPollStats   GetBusyPollStats();
+
+    /**
+     * @brief 运行时增加EvThread，之后接受的连接也会分配到新线程上，
+     * 已有连接可以通过再均衡或MigrateConnection迁移过来。设置了cpu亲和性
+     * 时，新线程按下标继续轮流绑定cpu_sets
+     * 
+     * @param count 
+     * @return core::errcode::ErrOpt 
+     */
+    core::errcode::ErrOpt AddThreads(size_t count);
+
+    /**
+     * @brief 运行时移除末尾的count个EvThread，至少保留一个，不能移除监听
+     * 所在的线程。移除后不再分配新连接，上面的连接迁移到其余线程；全部
+     * 迁移成功后，TcpServer自己创建的线程被停止，外部传入的线程只是不再
+     * 使用。有连接迁移失败时线程保持运行，通过OnErr通知
+     * 
+     * @param count 
+     * @return core::errcode::ErrOpt 
+     */
+    core::errcode::ErrOpt RemoveThreads(size_t count);
+    size_t          GetThreadCount();
+
+    /**
+     * @brief 把连接迁移到第thread_index个EvThread，迁移异步进行，期间的
+     * 收发在迁移完成后继续，见 detail::Connection::MigrateTo
+     * 
+     * @param connid 
+     * @param thread_index 
+     * @param on_done 在新线程（失败时在原线程）中回调，可以为空
+     * @return core::errcode::ErrOpt 
+     */
+    core::errcode::ErrOpt MigrateConnection(ConnId connid, size_t thread_index, const OnMigrateFunc& on_done = nullptr);
+
+    /**
+     * @brief 设置连接自动再均衡，需要在Init后调用。每个周期统计各线程上
+     * 连接处理的io事件数，最忙线程超过平均值的imbalance_ratio倍时，把
+     * 上面的连接迁移到最闲的线程，每次只迁移不超过两者负载差一半的连接，
+     * 避免来回迁移
+     * 
+     * @param opts 
+     */
+    void            SetRebalance(const RebalanceOptions& opts);
+
+    /**
+     * @brief 获取各线程上一个再均衡周期的负载，下标和线程池一致，未开启
+     * 再均衡时为空
+     * 
+     * @return std::vector<ThreadLoad> 
+     */
+    std::vector<ThreadLoad> GetThreadLoad();
+    RebalanceStats  GetRebalanceStats();
+
     /**
      * @brief 启动监听
      * 
@@ -40,6 +125,68 @@ public:
      */
     core::errcode::ErrOpt AsyncListen(const bbt::core::net::IPAddress& addr, const OnAcceptFunc& onaccept_cb);
 
+    /**
+     * @brief 在AF_UNIX流式socket上启动监听，连接、回调和统计与tcp一致
+     * 路径以'@'开头时使用抽象命名空间，否则为文件系统路径，已存在的
+     * socket文件会被删除，StopListen时也会删除。unix连接支持fd传递，
+     * SetSocketOptions中的tcp选项对unix连接不生效
+     * 
+     * @param path 
+     * @param onaccept_cb 
+     * @return core::errcode::ErrOpt 
+     */
+    core::errcode::ErrOpt AsyncListenUnix(const std::string& path, const OnAcceptFunc& onaccept_cb);
+
+    /**
+     * @brief 开启共享内存传输，只对AsyncListenUnix接受的连接生效
+     * 客户端需要通过TcpClient::SetSharedMemory同样开启。握手完成后
+     * 收发经过共享内存环形缓冲区，Send和OnRecv的用法不变
+     * 
+     * @param ring_size 单向环形缓冲区大小，必须是2的幂，由客户端决定，这里为0时关闭
+     */
+    void            SetSharedMemory(size_t ring_size = SHM_RING_DEFAULT_SIZE) { m_shm_ring_size = ring_size; }
+
+    /**
+     * @brief 开启tls，对之后接受的tcp连接生效。连接建立后先握手，
+     * 握手完成前Send的数据暂存，完成后再发出，OnRecv收到的是明文。
+     * 开启ktls且内核支持时，握手后加解密交给内核
+     * 
+     * @param opts 服务端必须提供证书和私钥
+     * @return core::errcode::ErrOpt 证书加载失败或未开启BBT_NETWORK_WITH_OPENSSL
+     */
+    core::errcode::ErrOpt SetTls(const TlsOptions& opts);
+    TlsStats        GetTlsStats() const;
+
+    /**
+     * @brief 开启热重启交接，在path上等待新进程接管，需要在Init后调用。
+     * 新进程通过TakeoverListen连接后先交出监听socket，新进程开始接受连接
+     * 后本进程才停止接受，两个进程共享同一个监听队列，重启期间不会拒绝
+     * 连接。开启handoff_connections时再把空闲连接连同接收缓冲中不完整的
+     * 帧和export_state导出的状态一起交出，这些连接在本进程中按关闭处理。
+     * 剩余连接照常收发直到关闭，超过drain_timeout_ms后强制关闭。
+     * 交接完成后控制socket被关闭但不删除，新进程可以在同一路径上再次开启。
+     * 只接受euid相同的进程接管，其他进程的连接被关闭并通过OnErr通知
+     * 
+     * @param path 控制socket的路径，规则同AsyncListenUnix，文件系统路径的权限为0600
+     * @param opts 
+     * @return core::errcode::ErrOpt 
+     */
+    core::errcode::ErrOpt EnableHotRestart(const std::string& path, const HotRestartOptions& opts = HotRestartOptions{});
+
+    /**
+     * @brief 从path上的旧进程接管监听socket和连接，代替AsyncListen、AsyncListenUnix。
+     * 阻塞直到交接完成，接管的连接通过onaccept_cb通知，旧进程导出的状态
+     * 通过SetOnInherit设置的回调取回。没有旧进程时返回错误，调用方可以
+     * 回退到AsyncListen；开始监听后的错误通过OnErr通知，不影响监听
+     * 
+     * @param path 旧进程EnableHotRestart的路径
+     * @param onaccept_cb 
+     * @param timeout_ms 控制连接上单次读写的超时时间
+     * @return core::errcode::ErrOpt 
+     */
+    core::errcode::ErrOpt TakeoverListen(const std::string& path, const OnAcceptFunc& onaccept_cb, int timeout_ms = HOT_RESTART_IO_TIMEOUT_MS);
+    HotRestartStats GetHotRestartStats();
+
     /**
      * @brief 停止监听
      * 
@@ -72,6 +219,123 @@ public:
      */
     void            SetTimeout(int connection_timeout);
 
+    /**
+     * @brief 设置连接准入控制
+     * 超过最大连接数、单ip最大连接数或接受速率的新连接会在
+     * accept后被立即关闭，并计入拒绝统计
+     * 
+     * @param opts 
+     */
+    void            SetAdmissionOptions(const AdmissionOptions& opts);
+
+    /**
+     * @brief 获取连接准入统计，用于容量评估
+     * 
+     * @return AdmissionStats 
+     */
+    AdmissionStats  GetAdmissionStats();
+
+    /**
+     * @brief 设置新连接默认的连接级收发限流
+     * 如需对单个连接单独设置，可以在OnAccept回调中通过
+     * GetConnection(connid)->SetOpt_RateLimit覆盖
+     * 
+     * @param opts 
+     */
+    void            SetRateLimit(const RateLimitOptions& opts);
+
+    /**
+     * @brief 设置组级收发限流，所有新连接共享同一个限流器
+     * 
+     * @param group 可以跨多个TcpServer、TcpClient共享
+     */
+    void            SetRateLimitGroup(std::shared_ptr<detail::RateLimiter> group);
+
+    /**
+     * @brief 设置内存预算，统计所有新连接的输出缓存和分帧接收缓冲区，
+     * 超出全局预算或单连接上限时按opts.policy处理
+     * 
+     * @param opts 
+     */
+    void            SetMemoryBudget(const MemoryBudgetOptions& opts);
+
+    /**
+     * @brief 使用已有的内存预算，可以跨多个TcpServer、TcpClient共享
+     * 
+     * @param budget 
+     */
+    void            SetMemoryBudget(std::shared_ptr<detail::MemoryBudget> budget);
+
+    /**
+     * @brief 获取内存占用统计，未设置内存预算时返回空统计
+     * 
+     * @return MemoryStats 
+     */
+    MemoryStats     GetMemoryStats();
+
+    /**
+     * @brief 设置socket选项，在监听socket和每个新接受的socket上生效
+     * 如需对单个连接单独设置，可以在OnAccept回调中通过
+     * GetConnection(connid)->SetOpt_SocketOptions覆盖
+     * 
+     * @param opts 
+     */
+    void            SetSocketOptions(const SocketOptions& opts) { m_socket_opts = opts; }
+
+    /**
+     * @brief 设置io后端，需要在AsyncListen前调用
+     * io_uring后端下accept、recv、send通过io_uring提交，回调接口不变；
+     * io_uring不可用时回退到libevent，并通过OnErr通知
+     * 
+     * @param backend 
+     */
+    void            SetIOBackend(IOBackend backend) { m_io_backend = backend; }
+
+    /**
+     * @brief 设置边缘触发模式，连接会一直读到EAGAIN，单次唤醒最多读取
+     * read_budget次，用完后排到下一轮事件循环继续读取
+     * 
+     * @param enable 
+     * @param read_budget 
+     */
+    void            SetEdgeTriggered(bool enable, int read_budget = EDGE_TRIGGERED_READ_BUDGET) { m_edge_triggered = enable; m_read_budget = read_budget; }
+
+    /**
+     * @brief 设置写合并，同一轮事件循环中对同一连接的多次Send在本轮末尾
+     * 一次写出。需要在单个连接上显式攒批时使用GetConnection()->Cork/Uncork
+     * 
+     * @param enable 
+     */
+    void            SetWriteCoalescing(bool enable) { m_write_coalescing = enable; }
+
+    /**
+     * @brief 设置默认的消息截止时间，消息排队超过截止时间还没有写出时
+     * 直接丢弃，不再占用带宽。单条消息可以通过SendOptions覆盖
+     * 
+     * @param deadline_ms 为0时（默认）不过期
+     */
+    void            SetSendDeadline(int deadline_ms) { m_send_deadline_ms = deadline_ms; }
+
+    /**
+     * @brief 设置发送超时，socket持续不可写超过这个时间时丢弃在途数据
+     * 并回调ERRTYPE_SEND_TIMEOUT
+     * 
+     * @param timeout_ms 默认SEND_DATA_TIMEOUT_MS
+     */
+    void            SetSendTimeout(int timeout_ms) { m_send_timeout_ms = timeout_ms; }
+
+    /**
+     * @brief 设置回调的执行策略，需要在AsyncListen前调用
+     * 为nullptr时（默认）回调直接在EvThread中执行；否则收发、超时、
+     * 关闭回调被卸载到工作线程池中执行，同一连接的回调保持顺序。
+     * 工作线程中可以直接调用Send回复，数据通过连接所属EvThread的
+     * 跨线程事件发送。线程池积压达到高水位时暂停读取，形成背压。
+     * 静态Handler（SetStaticHandler）不受影响，始终在EvThread中执行
+     * 
+     * @param pool 可以被多个TcpServer共享
+     */
+    void            SetWorkerPool(std::shared_ptr<detail::WorkerPool> pool) { m_worker_pool = pool; }
+
     /**
      * @brief 向指定的连接发送数据，这个接口是异步且线程安全的
      * 
@@ -81,6 +345,63 @@ public:
      */
     core::errcode::ErrOpt Send(ConnId connid, const bbt::core::Buffer& buffer);
 
+    /**
+     * @brief 向指定的unix连接发送数据，并通过SCM_RIGHTS附带fds
+     * fds附着在buffer的第一个字节上，会被dup，调用方仍持有原fd。
+     * 大块数据可以写入detail::CreateSealedMemfd创建的memfd后只传递fd，
+     * 对端在OnRecv中通过GetConnection(connid)->TakeRecvFds取出
+     * 
+     * @param connid 
+     * @param buffer 不能为空
+     * @param fds 
+     * @return core::errcode::ErrOpt 
+     */
+    core::errcode::ErrOpt Send(ConnId connid, const bbt::core::Buffer& buffer, const std::vector<int>& fds);
+
+    /**
+     * @brief 发送可合并的消息，同一个key还没写出的旧消息被新数据替换，
+     * 适合行情等只关心最新值的推送。慢速连接的积压以key的数量为上限。
+     * 之后的Send会先把还没写出的合并消息移入输出，保证它们先于该Send的
+     * 数据写出，之后不再被替换；高优先级的消息不受此约束
+     * 
+     * @param connid 
+     * @param key 
+     * @param buffer 
+     * @return core::errcode::ErrOpt 
+     */
+    core::errcode::ErrOpt SendConflated(ConnId connid, uint64_t key, const bbt::core::Buffer& buffer);
+
+    /**
+     * @brief 按优先级发送，高优先级消息在下一次写出时排到已排队的数据之前，
+     * 大块数据使用emSEND_PRIORITY_BULK分块写出，避免阻塞控制消息
+     * 
+     * @param connid 
+     * @param buffer 
+     * @param priority 
+     * @return core::errcode::ErrOpt 
+     */
+    core::errcode::ErrOpt Send(ConnId connid, const bbt::core::Buffer& buffer, SendPriority priority);
+
+    /**
+     * @brief 按选项发送，可以指定优先级、截止时间和完成回调。过期的消息
+     * 在写出前丢弃，回调ERRTYPE_SEND_EXPIRED；写入socket后回调成功；连接
+     * 关闭时回调ERRTYPE_SEND_CONN_CLOSED。回调在连接所在线程中执行
+     * 
+     * @param connid 
+     * @param buffer 
+     * @param opts 
+     * @return core::errcode::ErrOpt 返回错误时不会回调
+     */
+    core::errcode::ErrOpt Send(ConnId connid, const bbt::core::Buffer& buffer, const SendOptions& opts);
+
+    /**
+     * @brief 获取连接各优先级的排队深度
+     * 
+     * @param connid 
+     * @return OutputQueueStats 连接不存在时返回空统计
+     */
+    OutputQueueStats GetOutputQueueStats(ConnId connid);
+
     /**
      * @brief 关闭指定连接
      * 
@@ -96,48 +417,209 @@ public:
      */
     detail::ConnectionSPtr GetConnection(ConnId connid);
 
+    /**
+     * @brief 设置静态类型的Handler，新接受的连接使用StaticConnection，
+     * 收发、超时、关闭事件直接派发给handler，不再经过OnRecv、OnSend、
+     * OnTimeout回调，OnClose、OnErr回调仍然有效
+     * 
+     * @tparam Handler 需要提供的接口见 detail::StaticHandlerBase
+     * @param handler 所有连接共享
+     */
+    template<class Handler>
+    void            SetStaticHandler(std::shared_ptr<Handler> handler) { m_conn_factory = detail::StaticConnection<Handler>::Factory(handler); }
+
     // 设置回调
     void            SetOnTimeout(const OnTimeoutFunc& on_timeout) { m_on_timeout = on_timeout; }
     void            SetOnClose(const OnCloseFunc& on_close) { m_on_close = on_close; }
     void            SetOnSend(const OnSendFunc& on_send) { m_on_send = on_send; }
     void            SetOnRecv(const OnRecvFunc& on_recv) { m_on_recv = on_recv; }
     void            SetOnErr(const OnErrFunc& on_err) { m_on_err = on_err; }
+    /* 接管旧进程交出的连接时，在OnAccept之后、连接启动前回调 */
+    void            SetOnInherit(const OnInheritFunc& on_inherit) { m_on_inherit = on_inherit; }
+
+    /**
+     * @brief 设置携带连接上下文的回调，上下文在OnAccept中通过GetConnection(connid)->SetContext设置，
+     * 回调中直接得到上下文指针，不需要再维护ConnId到状态的映射。
+     * 设置后会代替对应的普通回调，未设置上下文时传入nullptr
+     * 
+     * 用法：SetOnRecv<Session>([](ConnId id, Session* s, const bbt::core::Buffer& buf){ ... });
+     */
+    template<class T>
+    void            SetOnRecv(const std::function<void(ConnId, T*, const bbt::core::Buffer&)>& on_recv)
+    { m_on_recv_ctx = [on_recv](ConnId connid, void* ctx, const bbt::core::Buffer& buffer) { on_recv(connid, static_cast<T*>(ctx), buffer); }; }
+    template<class T>
+    void            SetOnSend(const std::function<void(ConnId, T*, core::errcode::ErrOpt, size_t)>& on_send)
+    { m_on_send_ctx = [on_send](ConnId connid, void* ctx, core::errcode::ErrOpt err, size_t len) { on_send(connid, static_cast<T*>(ctx), err, len); }; }
+    template<class T>
+    void            SetOnClose(const std::function<void(ConnId, T*)>& on_close)
+    { m_on_close_ctx = [on_close](ConnId connid, void* ctx) { on_close(connid, static_cast<T*>(ctx)); }; }
+
+    /**
+     * @brief 设置批量收帧回调，收到的数据先由parser切分成帧，一次可读事件中
+     * 解析出的所有完整帧一起回调，同时传入连接上下文。设置后代替OnRecv，
+     * 对之后建立的连接生效，不支持StaticHandler
+     * 
+     * 用法：SetOnRecvBatch(LengthPrefixedFrameParser(1 << 20), [](ConnId id, void* ctx, const FrameBatch& frames){ ... });
+     */
+    void            SetOnRecvBatch(const FrameParser& parser, const OnRecvBatchFunc& on_batch) { m_frame_parser = std::make_shared<const FrameParser>(parser); m_on_recv_batch = on_batch; }
+    template<class T>
+    void            SetOnRecvBatch(const FrameParser& parser, const std::function<void(ConnId, T*, const FrameBatch&)>& on_batch)
+    { SetOnRecvBatch(parser, [on_batch](ConnId connid, void* ctx, const FrameBatch& frames) { on_batch(connid, static_cast<T*>(ctx), frames); }); }
 
 private:
-    void            OnTimeout(ConnId connid);
-    void            OnClose(ConnId connid);
-    void            OnSend(ConnId connid, core::errcode::ErrOpt err, size_t send_len);
-    void            OnRecv(ConnId connid, bbt::core::Buffer& buffer);
+    void            OnTimeout(detail::ConnectionSPtr conn);
+    void            OnClose(ConnId connid, const IPAddress& addr);
+    void            OnSend(detail::ConnectionSPtr conn, core::errcode::ErrOpt err, size_t send_len);
+    void            OnRecv(detail::ConnectionSPtr conn, const bbt::core::Buffer& buffer);
+    void            OnRecvBatch(detail::ConnectionSPtr conn, const FrameBatch& frames);
+    void            _NotifyClose(ConnId connid, detail::ConnectionSPtr conn);
 
     std::shared_ptr<EvThread> GetThread();
-    void            _Accept(int fd, short events, const OnAcceptFunc& onaccept_cb, std::shared_ptr<EvThread> thread);
+    /* 轮询选择线程，需要持有m_thread_mtx */
+    std::shared_ptr<EvThread> _PickThread();
+    void            _StartListen(const OnAcceptFunc& onaccept_cb);
+    /* 需要持有m_listen_mtx，热重启交出监听后不删除unix socket文件 */
+    core::errcode::ErrOpt _StopListen(bool remove_path);
+    std::shared_ptr<EvThread> _SteerThread(int fd, std::shared_ptr<EvThread> thread);
+    void            _ApplyCpuAffinity();
+    /* 在线程中按下标对应的cpu_sets绑定，运行时增加的线程需要持有m_thread_mtx */
+    void            _PinThread(size_t index, std::shared_ptr<EvThread> thread);
+    /**
+     * 以下的unix_listen是开始监听时记录在接受回调中的监听类型，
+     * 交接线程会在接受连接的同时修改m_listen_unix_path，不能直接读取
+     */
+    void            _Accept(int fd, short events, const OnAcceptFunc& onaccept_cb, bool unix_listen);
+    void            _OnNewSocket(int fd, const IPAddress& endpoint, const OnAcceptFunc& onaccept_cb, bool unix_listen);
+    /* 创建连接并应用默认配置，inherited为true时是从旧进程接管的连接，不使用tls和共享内存 */
+    std::shared_ptr<detail::Connection> _CreateConnection(int fd, const IPAddress& endpoint, bool inherited, bool unix_listen);
+    bool            _ListenInIoUring(const OnAcceptFunc& onaccept_cb, bool unix_listen);
+    void            _OnUringAccept(int res, bool more, const OnAcceptFunc& onaccept_cb, bool unix_listen);
+    void            _StartRebalance();
+    void            _Rebalance();
+    void            _OnMigrated(ConnId connid, core::errcode::ErrOpt err);
+    void            _OnHandoffRequest(int listenfd);
+    /* 以下三个在交接线程中阻塞执行 */
+    core::errcode::ErrOpt _Handoff(int fd, const HotRestartOptions& opts, bool& handed_off);
+    core::errcode::ErrOpt _HandoffConnections(int fd, const HotRestartOptions& opts);
+    core::errcode::ErrOpt _Takeover(int fd, const OnAcceptFunc& onaccept_cb);
+    void            _OnInheritedSocket(int fd, const std::string& input, const std::string& state, const OnAcceptFunc& onaccept_cb, bool unix_listen);
+    void            _CloseHandoffListen(bool remove_path);
+    void            _StartDrain();
+    void            _CheckDrain();
     void            _InitConnection(std::shared_ptr<detail::Connection> conn);
+    bool            _Admission(int fd, const IPAddress& addr);
+    void            _Reject(int fd);
+    void            _AcceptNoFd(int listenfd);
 
     struct ConnectEventMapImpl;
     struct AddressHash { std::size_t operator()(const IPAddress& addr) const { return core::crypto::BKDR::BKDRHash(addr.GetIPPort());}; };
+    // 只按ip区分，忽略端口，用于统计来源ip的连接数
+    struct IPHash { std::size_t operator()(const IPAddress& addr) const { return core::crypto::BKDR::BKDRHash(addr.GetIP());}; };
+    struct IPEqual { bool operator()(const IPAddress& l, const IPAddress& r) const { return l.GetIP() == r.GetIP(); }; };
 
 private:
+    /**
+     * 线程池可以在运行时增减，m_thread_mtx保护线程池和轮询下标。接受
+     * 连接时持有m_thread_mtx直到连接保存到m_conn_map，移除线程时不会
+     * 漏掉正在接受的连接
+     */
     std::vector<pollevent::EvThread::SPtr>          m_thread_pool;
-    const size_t                                    m_thread_count{0};
-    uint8_t                                         m_load_blance{0};
+    size_t                                          m_thread_count{0};
+    size_t                                          m_load_blance{0};
+    std::unordered_set<EvThread*>                   m_owned_threads;    // TcpServer自己创建的线程，移除时停止
+    std::shared_ptr<EvThread>                       m_listen_thread{nullptr};  // 由m_listen_mtx保护
+    std::mutex                                      m_thread_mtx;
+
+    /* 再均衡，采样和迁移都在第一个线程的定时器中进行 */
+    RebalanceOptions                m_rebalance_opts;
+    std::shared_ptr<Event>          m_rebalance_event{nullptr};
+    std::unordered_map<ConnId, uint64_t> m_rebalance_sample;  // 上一次采样时各连接的事件数
+    std::vector<ThreadLoad>         m_thread_load;
+    RebalanceStats                  m_rebalance_stats;
+    std::mutex                      m_rebalance_mtx;
+
+    /**
+     * 热重启，旧进程在控制socket上接受新进程的请求，交接在单独的线程中
+     * 阻塞进行，不占用事件循环。m_handoff_running保证只交接一次，失败时
+     * 复位，可以重试
+     */
+    HotRestartOptions               m_hot_restart_opts;
+    HotRestartStats                 m_hot_restart_stats;
+    std::string                     m_handoff_path;
+    int                             m_handoff_fd{-1};
+    std::shared_ptr<Event>          m_handoff_event{nullptr};
+    std::atomic_bool                m_handoff_running{false};
+    std::shared_ptr<Event>          m_drain_event{nullptr};   // 交接后在第一个线程中检查剩余连接
+    bool                            m_draining{false};
+    std::chrono::steady_clock::time_point m_drain_begin;
+    std::mutex                      m_hot_restart_mtx;
 
     detail::ConnCallbacks           callbacks;
+    std::shared_ptr<const detail::ConnCallbacks>
+                                    m_shared_callbacks{nullptr};    // Init时生成，所有连接共享
 
     std::unordered_map<ConnId, detail::ConnectionSPtr> m_conn_map;
     std::mutex                      m_conn_map_mutex;
 
     IPAddress                       m_listen_addr;
     int                             m_listen_fd{-1};
+    std::string                     m_listen_unix_path;       // 非空时监听的是unix socket
+    size_t                          m_shm_ring_size{0};       // unix连接是否使用共享内存传输
+    std::shared_ptr<detail::TlsContext>
+                                    m_tls_ctx{nullptr};       // 为空时不使用tls
     std::shared_ptr<Event>          m_listen_event{nullptr};
+    std::shared_ptr<detail::IoUringContext>
+                                    m_listen_uring{nullptr};
+    uint64_t                        m_listen_token{0};  // io_uring multishot accept 请求
     std::mutex                      m_listen_mtx;
 
     int                             m_connection_timeout{10000};
 
+    AdmissionOptions                m_admission_opts;
+    AdmissionStats                  m_admission_stats;
+    std::unique_ptr<detail::TokenBucket>
+                                    m_accept_bucket{nullptr};
+    std::unordered_map<IPAddress, size_t, IPHash, IPEqual>
+                                    m_ip_conn_count;
+    std::mutex                      m_admission_mtx;
+    int                             m_idle_fd{-1};      // 预留fd，fd耗尽时用于接受并关闭新连接，由m_admission_mtx保护
+
+    SocketOptions                   m_socket_opts;
+    IOBackend                       m_io_backend{emIO_BACKEND_LIBEVENT};
+    bool                            m_edge_triggered{false};
+    bool                            m_write_coalescing{false};
+    int                             m_send_deadline_ms{0};
+    int                             m_send_timeout_ms{SEND_DATA_TIMEOUT_MS};
+    int                             m_read_budget{EDGE_TRIGGERED_READ_BUDGET};
+    std::optional<RateLimitOptions> m_rate_limit_opts{std::nullopt};
+    std::shared_ptr<detail::RateLimiter>
+                                    m_rate_limit_group{nullptr};
+    std::shared_ptr<detail::MemoryBudget>
+                                    m_memory_budget{nullptr};
+    detail::ConnFactory             m_conn_factory{nullptr};  // 为空时使用默认的Connection
+    std::shared_ptr<detail::WorkerPool>
+                                    m_worker_pool{nullptr};   // 为空时回调在EvThread中执行
+
+    BusyPollOptions                 m_busy_poll_opts;
+    std::vector<std::shared_ptr<detail::BusyPoller>>
+                                    m_busy_pollers;           // 持有各线程的忙轮询器，保留统计
+
+    CpuAffinityOptions              m_affinity_opts;
+    std::vector<std::shared_ptr<Event>>
+                                    m_affinity_events;        // 在各线程中执行绑定的一次性事件
+    std::unordered_map<int, size_t> m_cpu_thread;             // cpu -> 绑定到该cpu的线程下标，运行时由m_thread_mtx保护
+
     OnTimeoutFunc   m_on_timeout{nullptr};
     OnCloseFunc     m_on_close{nullptr};
     OnSendFunc      m_on_send{nullptr};
     OnRecvFunc      m_on_recv{nullptr};
     OnErrFunc       m_on_err{nullptr};
+    OnInheritFunc   m_on_inherit{nullptr};
+    OnRecvCtxFunc   m_on_recv_ctx{nullptr};
+    OnSendCtxFunc   m_on_send_ctx{nullptr};
+    OnCloseCtxFunc  m_on_close_ctx{nullptr};
+    std::shared_ptr<const FrameParser> m_frame_parser{nullptr}; // 所有连接共享
+    OnRecvBatchFunc m_on_recv_batch{nullptr};
 };
 
 } // namespace bbt::network
\ No newline at end of file
@@ -0,0 +1,170 @@
+/**
+ * @file UdpServer.cc
+ * @author yangqingmiao
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include <iostream>
+#include <bbt/network/UdpServer.hpp>
+
+using namespace bbt::core::errcode;
+
+namespace bbt::network
+{
+
+UdpServer::UdpServer(PrivateTag, std::shared_ptr<EvThread> evthread):
+    m_thread_pool({evthread}),
+    m_on_err([](auto, auto& err){ std::cerr << "[UdpServer::DefaultErr] err=" << err.CWhat() << std::endl; })
+{
+}
+
+UdpServer::UdpServer(PrivateTag, int nthread):
+    m_thread_pool(std::vector<std::shared_ptr<EvThread>>(nthread)),
+    m_on_err([](auto, auto& err){ std::cerr << "[UdpServer::DefaultErr] err=" << err.CWhat() << std::endl; })
+{
+    for (int i = 0; i < nthread; ++i) {
+        m_thread_pool[i] = std::make_shared<EvThread>();
+    }
+}
+
+UdpServer::UdpServer(PrivateTag, const std::vector<std::shared_ptr<EvThread>>& evthreads):
+    m_thread_pool(evthreads),
+    m_on_err([](auto, auto& err){ std::cerr << "[UdpServer::DefaultErr] err=" << err.CWhat() << std::endl; })
+{
+}
+
+UdpServer::~UdpServer()
+{
+    StopListen();
+}
+
+std::shared_ptr<UdpServer> UdpServer::Create(std::shared_ptr<EvThread> evthread)
+{
+    return std::make_shared<UdpServer>(PrivateTag{}, evthread);
+}
+
+std::shared_ptr<UdpServer> UdpServer::Create(int nthread)
+{
+    return std::make_shared<UdpServer>(PrivateTag{}, nthread);
+}
+
+std::shared_ptr<UdpServer> UdpServer::Create(const std::vector<std::shared_ptr<EvThread>>& evthreads)
+{
+    return std::make_shared<UdpServer>(PrivateTag{}, evthreads);
+}
+
+void UdpServer::Init()
+{
+    for (auto& thread : m_thread_pool) {
+        if (thread != nullptr)
+            thread->Start();
+    }
+}
+
+void UdpServer::SetOptions(const UdpOptions& opts)
+{
+    m_opts = opts;
+}
+
+ErrOpt UdpServer::AsyncListen(const IPAddress& addr)
+{
+    std::lock_guard<std::mutex> _(m_sockets_mtx);
+
+    if (!m_sockets.empty())
+        return FASTERR_ERROR("already listening!");
+
+    if (m_on_recv == nullptr)
+        return FASTERR_ERROR("on recv callback is null!");
+
+    UdpOptions opts = m_opts;
+    if (m_thread_pool.size() > 1)
+        opts.reuseport = true;
+
+    /* 0端口时每个socket会分到不同的端口，其余socket绑定到第一个socket实际分配的地址 */
+    IPAddress bind_addr = addr;
+    for (auto& thread : m_thread_pool) {
+        if (thread == nullptr)
+            continue;
+
+        auto socket = UdpSocket::Create(thread, opts);
+        socket->SetOnRecv(m_on_recv);
+        socket->SetOnErr(m_on_err);
+
+        if (auto err = socket->Bind(bind_addr); err.has_value()) {
+            for (auto& bound : m_sockets)
+                bound->Close();
+            m_sockets.clear();
+            return err;
+        }
+
+        if (m_sockets.empty())
+            bind_addr = socket->GetLocalAddress();
+        m_sockets.push_back(socket);
+    }
+
+    m_listen_addr = bind_addr;
+    return FASTERR_NOTHING;
+}
+
+ErrOpt UdpServer::StopListen()
+{
+    std::lock_guard<std::mutex> _(m_sockets_mtx);
+
+    if (m_sockets.empty())
+        return FASTERR_ERROR("not listening!");
+
+    for (auto& socket : m_sockets)
+        socket->Close();
+
+    m_sockets.clear();
+    m_listen_addr.Clear();
+    return FASTERR_NOTHING;
+}
+
+bool UdpServer::IsListening()
+{
+    std::lock_guard<std::mutex> _(m_sockets_mtx);
+    return !m_sockets.empty();
+}
+
+IPAddress UdpServer::GetListenAddress()
+{
+    std::lock_guard<std::mutex> _(m_sockets_mtx);
+    return m_listen_addr;
+}
+
+void UdpServer::SetOnRecv(const OnUdpRecvFunc& on_recv)
+{
+    m_on_recv = on_recv;
+}
+
+void UdpServer::SetOnErr(const OnErrFunc& on_err)
+{
+    m_on_err = on_err;
+}
+
+UdpStats UdpServer::GetStats()
+{
+    std::lock_guard<std::mutex> _(m_sockets_mtx);
+    UdpStats total;
+
+    for (auto& socket : m_sockets) {
+        auto stats = socket->GetStats();
+        total.rx_packets += stats.rx_packets;
+        total.rx_bytes += stats.rx_bytes;
+        total.rx_batches += stats.rx_batches;
+        total.rx_truncated += stats.rx_truncated;
+        total.tx_packets += stats.tx_packets;
+        total.tx_bytes += stats.tx_bytes;
+        total.tx_batches += stats.tx_batches;
+        total.tx_dropped += stats.tx_dropped;
+    }
+
+    return total;
+}
+
+} // namespace bbt::network
@@ -0,0 +1,100 @@
+/**
+ * @file UdpServer.hpp
+ * @author yangqingmiao
+ * @brief udp服务端，多线程reuseport分流
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#pragma once
+#include <bbt/pollevent/EvThread.hpp>
+#include <bbt/network/UdpSocket.hpp>
+
+namespace bbt::network
+{
+
+class UdpServer final:
+    public std::enable_shared_from_this<UdpServer>
+{
+    struct PrivateTag {};
+public:
+    BBTATTR_FUNC_CTOR_HIDDEN
+    UdpServer(PrivateTag, std::shared_ptr<EvThread> evthread);
+
+    BBTATTR_FUNC_CTOR_HIDDEN
+    UdpServer(PrivateTag, int nthread);
+
+    BBTATTR_FUNC_CTOR_HIDDEN
+    UdpServer(PrivateTag, const std::vector<std::shared_ptr<EvThread>>& evthreads);
+
+    ~UdpServer();
+
+    static std::shared_ptr<UdpServer> Create(std::shared_ptr<EvThread> evthread);
+    static std::shared_ptr<UdpServer> Create(int nthread);
+    static std::shared_ptr<UdpServer> Create(const std::vector<std::shared_ptr<EvThread>>& evthreads);
+
+    /**
+     * @brief 启动线程
+     */
+    void            Init();
+
+    /**
+     * @brief 设置socket选项，需要在AsyncListen前调用
+     *
+     * @param opts
+     */
+    void            SetOptions(const UdpOptions& opts);
+
+    /**
+     * @brief 启动监听
+     * 每个EvThread创建一个绑定到addr的socket，多于一个线程时强制开启
+     * SO_REUSEPORT，由内核按四元组哈希把数据报分到各个socket，同一
+     * 对端的数据报总是由同一个线程处理。端口为0时所有socket共用第一
+     * 个socket分配到的端口，通过GetListenAddress取回
+     *
+     * @param addr
+     * @return core::errcode::ErrOpt
+     */
+    core::errcode::ErrOpt AsyncListen(const IPAddress& addr);
+
+    /**
+     * @brief 停止监听，关闭所有socket
+     *
+     * @return core::errcode::ErrOpt
+     */
+    core::errcode::ErrOpt StopListen();
+
+    bool            IsListening();
+    IPAddress       GetListenAddress();
+
+    /**
+     * @brief 设置接收回调，在收到数据报的socket所属的EvThread中执行
+     * 回复时直接调用回调参数中socket的SendTo，保持在同一个线程
+     *
+     * @param on_recv
+     */
+    void            SetOnRecv(const OnUdpRecvFunc& on_recv);
+    void            SetOnErr(const OnErrFunc& on_err);
+
+    /**
+     * @brief 获取所有socket统计的汇总
+     *
+     * @return UdpStats
+     */
+    UdpStats        GetStats();
+
+private:
+    std::vector<std::shared_ptr<EvThread>>  m_thread_pool;
+    UdpOptions                              m_opts;
+    IPAddress                               m_listen_addr;
+
+    std::mutex                              m_sockets_mtx;
+    std::vector<std::shared_ptr<UdpSocket>> m_sockets;
+
+    OnUdpRecvFunc                           m_on_recv{nullptr};
+    OnErrFunc                               m_on_err{nullptr};
+};
+
+} // namespace bbt::network
@@ -0,0 +1,499 @@
+/**
+ * @file UdpSocket.cc
+ * @author yangqingmiao
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+#include <netinet/udp.h>
+#include <bbt/pollevent/Event.hpp>
+#include <bbt/network/UdpSocket.hpp>
+
+using namespace bbt::core::errcode;
+
+namespace bbt::network
+{
+
+// GRO合并后的包和GSO单次发送的总长度上限，略小于udp最大载荷
+static constexpr size_t UDP_MAX_GSO_BYTES = 65000;
+
+UdpSocket::UdpSocket(PrivateTag, std::shared_ptr<EvThread> thread, const UdpOptions& opts):
+    m_opts(opts),
+    m_thread(thread),
+    m_on_err([](auto, auto& err){ std::cerr << "[UdpSocket::DefaultErr] err=" << err.CWhat() << std::endl; })
+{
+}
+
+UdpSocket::~UdpSocket()
+{
+    Close();
+}
+
+std::shared_ptr<UdpSocket> UdpSocket::Create(std::shared_ptr<EvThread> thread, const UdpOptions& opts)
+{
+    return std::make_shared<UdpSocket>(PrivateTag{}, thread, opts);
+}
+
+ErrOpt UdpSocket::Bind(const IPAddress& addr)
+{
+    if (m_socket >= 0)
+        return FASTERR_ERROR("udp socket already bound!");
+
+    auto thread = m_thread.lock();
+    if (thread == nullptr)
+        return FASTERR_ERROR("evthread is released!");
+
+    sockaddr_storage raw_addr;
+    socklen_t len = sizeof(raw_addr);
+    if (auto err = addr.GetRawData(reinterpret_cast<sockaddr*>(&raw_addr), len); err.has_value())
+        return err;
+
+    m_socket = ::socket(raw_addr.ss_family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_socket < 0)
+        return FASTERR_ERROR("create udp socket failed! " + std::string{strerror(errno)});
+
+    if (auto err = SetSocketOpts(); err.has_value()) {
+        ::close(m_socket);
+        m_socket = -1;
+        return err;
+    }
+
+    if (::bind(m_socket, reinterpret_cast<sockaddr*>(&raw_addr), len) != 0) {
+        std::string errstr = strerror(errno);
+        ::close(m_socket);
+        m_socket = -1;
+        return FASTERR_ERROR("udp bind failed! addr=" + addr.GetIPPort() + " " + errstr);
+    }
+
+    /* 绑定0端口时由内核分配，取回实际地址 */
+    sockaddr_storage local;
+    socklen_t local_len = sizeof(local);
+    if (::getsockname(m_socket, reinterpret_cast<sockaddr*>(&local), &local_len) == 0)
+        m_local_addr.From(reinterpret_cast<sockaddr*>(&local), local_len);
+
+    InitRecvSlots();
+
+    m_recv_event = thread->RegisterEvent(m_socket, EventOpt::READABLE | EventOpt::PERSIST,
+    [weak_this{weak_from_this()}](int, short, EventId){
+        if (auto pthis = weak_this.lock(); pthis != nullptr)
+            pthis->OnReadable();
+    });
+
+    Assert(m_recv_event->StartListen(0) == 0);
+    return FASTERR_NOTHING;
+}
+
+ErrOpt UdpSocket::SetSocketOpts()
+{
+    int on = 1;
+    if (::setsockopt(m_socket, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) != 0)
+        return FASTERR_ERROR("set SO_REUSEADDR failed! " + std::string{strerror(errno)});
+
+    if (m_opts.reuseport && ::setsockopt(m_socket, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) != 0)
+        return FASTERR_ERROR("set SO_REUSEPORT failed! " + std::string{strerror(errno)});
+
+    if (m_opts.recv_buffer.has_value()) {
+        int size = m_opts.recv_buffer.value();
+        if (::setsockopt(m_socket, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)) != 0)
+            return FASTERR_ERROR("set SO_RCVBUF failed! " + std::string{strerror(errno)});
+    }
+
+    if (m_opts.send_buffer.has_value()) {
+        int size = m_opts.send_buffer.value();
+        if (::setsockopt(m_socket, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size)) != 0)
+            return FASTERR_ERROR("set SO_SNDBUF failed! " + std::string{strerror(errno)});
+    }
+
+    /* GRO/GSO是优化，内核不支持时退回逐包收发，不作为错误 */
+    m_gro_enabled = false;
+#ifdef UDP_GRO
+    if (m_opts.gro && ::setsockopt(m_socket, SOL_UDP, UDP_GRO, &on, sizeof(on)) == 0)
+        m_gro_enabled = true;
+#endif
+
+#ifdef UDP_SEGMENT
+    m_gso_enabled = m_opts.gso;
+#else
+    m_gso_enabled = false;
+#endif
+
+    return FASTERR_NOTHING;
+}
+
+void UdpSocket::InitRecvSlots()
+{
+    const size_t control_size = CMSG_SPACE(sizeof(int));
+
+    m_slot_size = m_gro_enabled ? UDP_MAX_GSO_BYTES : m_opts.max_datagram;
+    m_recv_buffer.resize(m_slot_size * UDP_MMSG_BATCH);
+    m_recv_msgs.resize(UDP_MMSG_BATCH);
+    m_recv_iovs.resize(UDP_MMSG_BATCH);
+    m_recv_addrs.resize(UDP_MMSG_BATCH);
+    m_recv_control.resize(control_size * UDP_MMSG_BATCH);
+
+    for (size_t i = 0; i < UDP_MMSG_BATCH; ++i) {
+        m_recv_iovs[i].iov_base = m_recv_buffer.data() + i * m_slot_size;
+        m_recv_iovs[i].iov_len = m_slot_size;
+
+        auto& hdr = m_recv_msgs[i].msg_hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.msg_iov = &m_recv_iovs[i];
+        hdr.msg_iovlen = 1;
+        hdr.msg_name = &m_recv_addrs[i];
+        hdr.msg_control = m_recv_control.data() + i * control_size;
+    }
+}
+
+void UdpSocket::OnReadable()
+{
+    const size_t control_size = CMSG_SPACE(sizeof(int));
+
+    for (int round = 0; round < UDP_RECV_ROUNDS; ++round) {
+        /* 地址和控制消息的长度会被内核改写，每次收取前重置 */
+        for (auto& msg : m_recv_msgs) {
+            msg.msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+            msg.msg_hdr.msg_controllen = m_gro_enabled ? control_size : 0;
+            msg.msg_hdr.msg_flags = 0;
+            msg.msg_len = 0;
+        }
+
+        int n = 0, err = 0;
+        {
+            /* 持锁收取，Close不会在收取过程中关闭socket，fd也不会被复用 */
+            std::lock_guard<std::mutex> _(m_recv_mutex);
+            if (m_socket < 0)
+                return;
+            n = ::recvmmsg(m_socket, m_recv_msgs.data(), UDP_MMSG_BATCH, MSG_DONTWAIT, nullptr);
+            err = errno;
+        }
+
+        if (n < 0) {
+            if (err != EAGAIN && err != EWOULDBLOCK && err != EINTR)
+                OnError("recvmmsg failed! " + std::string{strerror(err)});
+            return;
+        }
+
+        ++m_rx_batches;
+        for (int i = 0; i < n; ++i)
+            DeliverMessage(m_recv_msgs[i], i);
+
+        /* 没有收满说明已经读空 */
+        if (n < UDP_MMSG_BATCH)
+            return;
+    }
+}
+
+void UdpSocket::DeliverMessage(const mmsghdr& msg, size_t slot)
+{
+    const char* data = m_recv_buffer.data() + slot * m_slot_size;
+    size_t len = msg.msg_len;
+    size_t segment = len;
+
+    if (msg.msg_hdr.msg_flags & MSG_TRUNC)
+        ++m_rx_truncated;
+
+#ifdef UDP_GRO
+    if (m_gro_enabled) {
+        auto* hdr = const_cast<msghdr*>(&msg.msg_hdr);
+        for (cmsghdr* cmsg = CMSG_FIRSTHDR(hdr); cmsg != nullptr; cmsg = CMSG_NXTHDR(hdr, cmsg)) {
+            if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+                int gso_size = 0;
+                memcpy(&gso_size, CMSG_DATA(cmsg), sizeof(gso_size));
+                if (gso_size > 0)
+                    segment = gso_size;
+            }
+        }
+    }
+#endif
+
+    IPAddress from;
+    from.From(reinterpret_cast<sockaddr*>(msg.msg_hdr.msg_name), msg.msg_hdr.msg_namelen);
+
+    /* 空数据报也是合法的，同样需要回调一次 */
+    size_t offset = 0;
+    do {
+        size_t seg_len = std::min(segment, len - offset);
+        ++m_rx_packets;
+        m_rx_bytes += seg_len;
+        if (m_on_recv)
+            m_on_recv(*this, from, data + offset, seg_len);
+        offset += seg_len;
+    } while (offset < len && segment > 0);
+}
+
+ErrOpt UdpSocket::SendTo(const IPAddress& to, const char* data, size_t len)
+{
+    if (len > m_opts.max_datagram)
+        return FASTERR_ERROR("datagram too large! len=" + std::to_string(len));
+
+    Datagram datagram;
+    datagram.addrlen = sizeof(datagram.addr);
+    if (auto err = to.GetRawData(reinterpret_cast<sockaddr*>(&datagram.addr), datagram.addrlen); err.has_value())
+        return err;
+
+    datagram.data.assign(data, len);
+
+    std::lock_guard<std::mutex> _(m_send_mutex);
+    if (m_socket < 0)
+        return FASTERR_ERROR("udp socket not bound!");
+
+    if (m_opts.max_send_queue > 0 && m_send_queue.size() >= m_opts.max_send_queue) {
+        ++m_tx_dropped;
+        return FASTERR_ERROR("udp send queue is full! size=" + std::to_string(m_send_queue.size()));
+    }
+
+    m_send_queue.emplace_back(std::move(datagram));
+    if (!m_flush_scheduled)
+        StartFlush(false);
+
+    return FASTERR_NOTHING;
+}
+
+ErrOpt UdpSocket::SendTo(const IPAddress& to, const bbt::core::Buffer& buffer)
+{
+    return SendTo(to, buffer.Peek(), buffer.Size());
+}
+
+void UdpSocket::StartFlush(bool wait_writable)
+{
+    auto thread = m_thread.lock();
+    if (thread == nullptr)
+        return;
+
+    m_flush_scheduled = true;
+    m_flush_event = thread->RegisterEvent(wait_writable ? m_socket : -1,
+        wait_writable ? EventOpt::WRITEABLE : EventOpt::TIMEOUT,
+    [weak_this{weak_from_this()}](int, short, EventId){
+        if (auto pthis = weak_this.lock(); pthis != nullptr)
+            pthis->Flush();
+    });
+
+    m_flush_event->StartListen(0);
+}
+
+void UdpSocket::Flush()
+{
+    /* 持锁发送，其他线程的Close等本次发送结束后再关闭socket，不会写到被复用的fd上 */
+    std::unique_lock<std::mutex> lock(m_send_mutex);
+    m_flush_scheduled = false;
+    m_flush_event = nullptr;
+    if (m_socket < 0)
+        return;
+
+    std::vector<Datagram> sending;
+    sending.swap(m_send_queue);
+    /* 错误回调中可能调用SendTo，解锁后再回调 */
+    std::vector<std::string> errors;
+
+    const size_t control_size = CMSG_SPACE(sizeof(uint16_t));
+    mmsghdr     msgs[UDP_MMSG_BATCH];
+    size_t      counts[UDP_MMSG_BATCH];         // 每条消息包含的数据报数
+    size_t      bytes[UDP_MMSG_BATCH];
+    char        control[UDP_MMSG_BATCH][control_size];
+    std::vector<iovec> iovs;
+
+    size_t begin = 0;
+    size_t no_gso_end = 0;                      // 此前的数据报GSO发送失败过，逐个发送
+    while (begin < sending.size()) {
+        int nmsg = 0;
+        size_t index = begin;
+        iovs.clear();
+        memset(msgs, 0, sizeof(msgs));
+
+        while (nmsg < UDP_MMSG_BATCH && index < sending.size()) {
+            const Datagram& first = sending[index];
+            size_t count = 1;
+            size_t total = first.data.size();
+
+            /**
+             * 开启GSO时，发往同一地址的连续数据报，除最后一个可以更短外
+             * 长度必须相同，合并为一条消息，由内核按first的长度分段
+             */
+            while (m_gso_enabled && index >= no_gso_end && !first.data.empty() &&
+                   index + count < sending.size() && count < UDP_GSO_MAX_SEGMENTS) {
+                const Datagram& next = sending[index + count];
+                if (next.addrlen != first.addrlen || memcmp(&next.addr, &first.addr, first.addrlen) != 0)
+                    break;
+                if (next.data.empty() || next.data.size() > first.data.size() || total + next.data.size() > UDP_MAX_GSO_BYTES)
+                    break;
+
+                total += next.data.size();
+                ++count;
+                if (next.data.size() < first.data.size())
+                    break;
+            }
+
+            for (size_t i = 0; i < count; ++i) {
+                const Datagram& datagram = sending[index + i];
+                iovs.push_back(iovec{const_cast<char*>(datagram.data.data()), datagram.data.size()});
+            }
+
+            auto& hdr = msgs[nmsg].msg_hdr;
+            hdr.msg_name = const_cast<sockaddr_storage*>(&first.addr);
+            hdr.msg_namelen = first.addrlen;
+            hdr.msg_iovlen = count;
+
+#ifdef UDP_SEGMENT
+            if (count > 1) {
+                hdr.msg_control = control[nmsg];
+                hdr.msg_controllen = control_size;
+                cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr);
+                cmsg->cmsg_level = SOL_UDP;
+                cmsg->cmsg_type = UDP_SEGMENT;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                uint16_t gso_size = first.data.size();
+                memcpy(CMSG_DATA(cmsg), &gso_size, sizeof(gso_size));
+            }
+#endif
+
+            counts[nmsg] = count;
+            bytes[nmsg] = total;
+            index += count;
+            ++nmsg;
+        }
+
+        /* iovs在填充过程中可能扩容，全部填完后再设置指针 */
+        size_t iov_offset = 0;
+        for (int i = 0; i < nmsg; ++i) {
+            msgs[i].msg_hdr.msg_iov = iovs.data() + iov_offset;
+            iov_offset += counts[i];
+        }
+
+        int n = ::sendmmsg(m_socket, msgs, nmsg, 0);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+
+            /* 发送缓冲区满，剩余的数据报放回队列头部，等可写后继续 */
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) {
+                m_send_queue.insert(m_send_queue.begin(),
+                    std::make_move_iterator(sending.begin() + begin),
+                    std::make_move_iterator(sending.end()));
+                StartFlush(true);
+                break;
+            }
+
+            /**
+             * 网卡不支持校验和卸载或分段不满足要求时GSO返回EIO/EINVAL，
+             * 这一批逐个重发，之后的批次仍然尝试GSO
+             */
+            if (counts[0] > 1 && (errno == EIO || errno == EINVAL)) {
+                no_gso_end = index;
+                continue;
+            }
+
+            /* sendmmsg只在第一条消息失败时返回-1，丢弃这条继续发送 */
+            m_tx_dropped += counts[0];
+            errors.emplace_back("sendmmsg failed! " + std::string{strerror(errno)});
+            begin += counts[0];
+            continue;
+        }
+
+        ++m_tx_batches;
+        for (int i = 0; i < n; ++i) {
+            m_tx_packets += counts[i];
+            m_tx_bytes += bytes[i];
+            begin += counts[i];
+        }
+    }
+
+    lock.unlock();
+    for (auto& err : errors)
+        OnError(err);
+}
+
+ErrOpt UdpSocket::Close()
+{
+    if (m_socket < 0)
+        return FASTERR_ERROR("udp socket not bound!");
+
+    if (m_recv_event != nullptr) {
+        m_recv_event->CancelListen();
+        m_recv_event = nullptr;
+    }
+
+    /**
+     *  持两把锁置为-1后，收取和发送都不会再使用socket。注销发送事件时
+     *  不能持锁，正在执行的Flush需要拿到锁后才能返回；等事件注销后再
+     *  关闭fd，避免epoll中残留已经关闭或被复用的fd
+     */
+    std::shared_ptr<Event> flush_event = nullptr;
+    evutil_socket_t fd = -1;
+    {
+        std::lock_guard<std::mutex> recv_lock(m_recv_mutex);
+        std::lock_guard<std::mutex> send_lock(m_send_mutex);
+        flush_event = std::move(m_flush_event);
+        m_flush_scheduled = false;
+        m_tx_dropped += m_send_queue.size();
+        m_send_queue.clear();
+
+        fd = m_socket;
+        m_socket = -1;
+    }
+
+    if (flush_event != nullptr)
+        flush_event->CancelListen();
+    if (fd >= 0)
+        ::close(fd);
+
+    m_local_addr.Clear();
+    return FASTERR_NOTHING;
+}
+
+void UdpSocket::OnError(const std::string& msg)
+{
+    if (m_on_err)
+        m_on_err(-1, Errcode{msg, ERRTYPE_ERROR});
+}
+
+void UdpSocket::SetOnRecv(const OnUdpRecvFunc& on_recv)
+{
+    m_on_recv = on_recv;
+}
+
+void UdpSocket::SetOnErr(const OnErrFunc& on_err)
+{
+    m_on_err = on_err;
+}
+
+bool UdpSocket::IsBound() const
+{
+    return m_socket >= 0;
+}
+
+IPAddress UdpSocket::GetLocalAddress() const
+{
+    return m_local_addr;
+}
+
+evutil_socket_t UdpSocket::GetSocket() const
+{
+    return m_socket;
+}
+
+std::shared_ptr<EvThread> UdpSocket::GetThread() const
+{
+    return m_thread.lock();
+}
+
+UdpStats UdpSocket::GetStats() const
+{
+    UdpStats stats;
+    stats.rx_packets = m_rx_packets;
+    stats.rx_bytes = m_rx_bytes;
+    stats.rx_batches = m_rx_batches;
+    stats.rx_truncated = m_rx_truncated;
+    stats.tx_packets = m_tx_packets;
+    stats.tx_bytes = m_tx_bytes;
+    stats.tx_batches = m_tx_batches;
+    stats.tx_dropped = m_tx_dropped;
+    return stats;
+}
+
+} // namespace bbt::network
@@ -0,0 +1,140 @@
+/**
+ * @file UdpSocket.hpp
+ * @author yangqingmiao
+ * @brief udp socket，批量收发
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#pragma once
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <sys/socket.h>
+#include <bbt/pollevent/EvThread.hpp>
+#include <bbt/network/detail/Define.hpp>
+
+namespace bbt::network
+{
+
+typedef std::function<void(UdpSocket&, const IPAddress& /*from*/, const char*, size_t)> OnUdpRecvFunc;
+
+/**
+ * 基于 EvThread 的非阻塞udp socket。
+ *
+ * 可读时通过recvmmsg一次收取多个数据报到预分配的接收缓冲区，回调
+ * 中的数据指针只在回调期间有效。开启GRO后内核会把同一流的多个数据
+ * 报合并为一个大包交付，这里按分段大小拆开后逐个回调，对使用方透明。
+ *
+ * SendTo线程安全，数据报先进入发送队列，在所属 EvThread 中通过
+ * sendmmsg批量发出。开启GSO后，发往同一地址的连续等长数据报合并为
+ * 一条带UDP_SEGMENT的消息，由内核（或网卡）分段。
+ */
+class UdpSocket final:
+    public std::enable_shared_from_this<UdpSocket>
+{
+    struct PrivateTag {};
+public:
+    BBTATTR_FUNC_CTOR_HIDDEN
+    UdpSocket(PrivateTag, std::shared_ptr<EvThread> thread, const UdpOptions& opts);
+    ~UdpSocket();
+
+    static std::shared_ptr<UdpSocket> Create(std::shared_ptr<EvThread> thread, const UdpOptions& opts = UdpOptions{});
+
+    /**
+     * @brief 创建socket，绑定到addr并开始接收
+     * 作为客户端使用时可以绑定0端口，由内核分配
+     *
+     * @param addr
+     * @return core::errcode::ErrOpt
+     */
+    core::errcode::ErrOpt Bind(const IPAddress& addr);
+
+    /**
+     * @brief 停止接收并关闭socket，发送队列中未发出的数据报被丢弃
+     *
+     * @return core::errcode::ErrOpt
+     */
+    core::errcode::ErrOpt Close();
+
+    /**
+     * @brief 发送一个数据报，线程安全
+     *
+     * @param to
+     * @param data
+     * @param len 不能超过max_datagram
+     * @return core::errcode::ErrOpt 发送队列达到max_send_queue时返回错误，数据报被丢弃
+     */
+    core::errcode::ErrOpt SendTo(const IPAddress& to, const char* data, size_t len);
+    core::errcode::ErrOpt SendTo(const IPAddress& to, const bbt::core::Buffer& buffer);
+
+    void            SetOnRecv(const OnUdpRecvFunc& on_recv);
+    void            SetOnErr(const OnErrFunc& on_err);
+
+    bool            IsBound() const;
+    IPAddress       GetLocalAddress() const;
+    evutil_socket_t GetSocket() const;
+    std::shared_ptr<EvThread> GetThread() const;
+
+    /* 线程安全 */
+    UdpStats        GetStats() const;
+
+protected:
+    core::errcode::ErrOpt SetSocketOpts();
+    void            InitRecvSlots();
+    void            OnReadable();
+    /* 处理一条recvmmsg收到的消息，GRO合并的消息在这里拆分 */
+    void            DeliverMessage(const mmsghdr& msg, size_t slot);
+    void            Flush();
+    /* 调度一次Flush，wait_writable为true时等socket可写后再发送，需持有m_send_mutex */
+    void            StartFlush(bool wait_writable);
+    void            OnError(const std::string& msg);
+
+private:
+    /* 待发送的数据报 */
+    struct Datagram
+    {
+        sockaddr_storage    addr;
+        socklen_t           addrlen{0};
+        std::string         data;
+    };
+
+    const UdpOptions        m_opts;
+    std::weak_ptr<EvThread> m_thread;
+    bool                    m_gro_enabled{false};
+    bool                    m_gso_enabled{false};       // 单批GSO发送失败时只对这一批逐个重发
+    evutil_socket_t         m_socket{-1};
+    IPAddress               m_local_addr;
+    std::shared_ptr<Event>  m_recv_event{nullptr};
+
+    OnUdpRecvFunc           m_on_recv{nullptr};
+    OnErrFunc               m_on_err{nullptr};
+
+    /* 接收缓冲区，每个slot一个数据报（开启GRO时是合并后的大包），只在EvThread中访问 */
+    size_t                  m_slot_size{0};
+    std::vector<char>       m_recv_buffer;
+    std::vector<mmsghdr>    m_recv_msgs;
+    std::vector<iovec>      m_recv_iovs;
+    std::vector<sockaddr_storage> m_recv_addrs;
+    std::vector<char>       m_recv_control;
+    /* Close可能在其他线程中调用，收取和关闭socket互斥，锁内不回调用户 */
+    std::mutex              m_recv_mutex;
+
+    std::mutex              m_send_mutex;
+    std::vector<Datagram>   m_send_queue;
+    bool                    m_flush_scheduled{false};
+    std::shared_ptr<Event>  m_flush_event{nullptr};
+
+    std::atomic_uint64_t    m_rx_packets{0};
+    std::atomic_uint64_t    m_rx_bytes{0};
+    std::atomic_uint64_t    m_rx_batches{0};
+    std::atomic_uint64_t    m_rx_truncated{0};
+    std::atomic_uint64_t    m_tx_packets{0};
+    std::atomic_uint64_t    m_tx_bytes{0};
+    std::atomic_uint64_t    m_tx_batches{0};
+    std::atomic_uint64_t    m_tx_dropped{0};
+};
+
+} // namespace bbt::network
@@ -0,0 +1,70 @@
+/**
+ * @file BufferPool.cc
+ * @author yangqingmiao
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include <bbt/network/detail/BufferPool.hpp>
+
+namespace bbt::network::detail
+{
+
+/* 线程退出时池先于其他thread_local对象析构，之后归还的缓冲区直接释放 */
+static thread_local bool _cache_destroyed = false;
+
+struct ThreadCache
+{
+    std::vector<BufferPool::BufferPtr> buffers;
+    ~ThreadCache() { _cache_destroyed = true; }
+};
+
+static std::vector<BufferPool::BufferPtr>* GetThreadCache()
+{
+    static thread_local ThreadCache _cache;
+    return _cache_destroyed ? nullptr : &_cache.buffers;
+}
+
+BufferPool::BufferPtr BufferPool::Acquire()
+{
+    auto cache = GetThreadCache();
+    if (cache == nullptr || cache->empty())
+        return std::make_unique<bbt::core::Buffer>();
+
+    auto buffer = std::move(cache->back());
+    cache->pop_back();
+    return buffer;
+}
+
+void BufferPool::Release(BufferPtr&& buffer)
+{
+    if (buffer == nullptr)
+        return;
+
+    auto cache = GetThreadCache();
+    if (cache == nullptr || cache->size() >= BUFFER_POOL_THREAD_CACHE) {
+        buffer.reset();
+        return;
+    }
+
+    buffer->Clear();
+    cache->push_back(std::move(buffer));
+}
+
+std::shared_ptr<bbt::core::Buffer> BufferPool::Share(BufferPtr&& buffer)
+{
+    return std::shared_ptr<bbt::core::Buffer>(buffer.release(), [](bbt::core::Buffer* raw){
+        Release(BufferPtr{raw});
+    });
+}
+
+size_t BufferPool::CachedCount()
+{
+    auto cache = GetThreadCache();
+    return cache ? cache->size() : 0;
+}
+
+} // namespace bbt::network::detail
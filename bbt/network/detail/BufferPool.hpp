@@ -0,0 +1,40 @@
+/**
+ * @file BufferPool.hpp
+ * @author yangqingmiao
+ * @brief 连接输出缓冲区池
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#pragma once
+#include <bbt/network/detail/Define.hpp>
+
+namespace bbt::network::detail
+{
+
+/**
+ * 输出缓冲区池，每个线程一个空闲链表，不需要加锁。
+ *
+ * 连接只在有待发送数据时持有输出缓冲区，发送完后归还，空闲连接不
+ * 占用缓冲区。归还的缓冲区可能被其他线程取走，缓冲区本身不属于任
+ * 何线程。Clear后保留的空间大小由Buffer决定，所以每个线程只缓存有
+ * 限个，超出的直接释放
+ */
+class BufferPool
+{
+public:
+    typedef std::unique_ptr<bbt::core::Buffer> BufferPtr;
+
+    /* 取一个空的缓冲区，池为空时新建 */
+    static BufferPtr        Acquire();
+    /* 清空后归还到当前线程的池中 */
+    static void             Release(BufferPtr&& buffer);
+    /* 转换为共享的缓冲区，最后一个引用释放时归还到池中 */
+    static std::shared_ptr<bbt::core::Buffer> Share(BufferPtr&& buffer);
+    /* 当前线程池中的空闲缓冲区数 */
+    static size_t           CachedCount();
+};
+
+} // namespace bbt::network::detail
@@ -0,0 +1,136 @@
+/**
+ * @file BusyPoller.cc
+ * @author yangqingmiao
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include <mutex>
+#include <algorithm>
+#include <unordered_map>
+#include <bbt/pollevent/Event.hpp>
+#include <bbt/network/detail/BusyPoller.hpp>
+
+namespace bbt::network::detail
+{
+
+BusyPoller::BusyPoller(const BusyPollOptions& opts):
+    m_opts(opts),
+    m_window_us(std::clamp(opts.initial_spin_us, opts.min_spin_us, opts.max_spin_us))
+{
+}
+
+BusyPoller::~BusyPoller()
+{
+    if (m_spin_event)
+        m_spin_event->CancelListen();
+}
+
+std::shared_ptr<BusyPoller> BusyPoller::GetOrCreate(std::shared_ptr<EvThread> thread, const BusyPollOptions& opts)
+{
+    static std::mutex mutex;
+    static std::unordered_map<EvThread*, std::weak_ptr<BusyPoller>> pollers;
+
+    if (thread == nullptr)
+        return nullptr;
+
+    std::lock_guard<std::mutex> _(mutex);
+    if (auto it = pollers.find(thread.get()); it != pollers.end()) {
+        if (auto poller = it->second.lock(); poller != nullptr)
+            return poller;
+    }
+
+    auto poller = std::make_shared<BusyPoller>(opts);
+    poller->Init(thread);
+    pollers[thread.get()] = poller;
+    return poller;
+}
+
+void BusyPoller::Init(std::shared_ptr<EvThread> thread)
+{
+    m_spin_event = thread->RegisterEvent(-1, EventOpt::TIMEOUT,
+    [weak_this{weak_from_this()}](int, short, EventId){
+        if (auto pthis = weak_this.lock(); pthis != nullptr)
+            pthis->OnSpin();
+    });
+}
+
+BusyPoller::Clock::time_point BusyPoller::OnWorkBegin()
+{
+    auto now = Clock::now();
+    if (m_spinning) {
+        ++m_spin_hits;
+        return now;
+    }
+
+    /* 从阻塞等待中被唤醒，根据阻塞时长调整窗口后重新开始空转 */
+    ++m_blocking_wakeups;
+    AdaptWindow(now);
+    StartSpin(now);
+    return now;
+}
+
+void BusyPoller::OnWorkEnd(Clock::time_point begin)
+{
+    m_last_work = Clock::now();
+    m_work_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(m_last_work - begin).count();
+}
+
+BusyPollStats BusyPoller::GetStats() const
+{
+    BusyPollStats stats;
+    stats.spin_ns = m_spin_ns;
+    stats.work_ns = m_work_ns;
+    stats.spin_hits = m_spin_hits;
+    stats.blocking_wakeups = m_blocking_wakeups;
+    stats.spin_window_us = m_window_us;
+    return stats;
+}
+
+void BusyPoller::StartSpin(Clock::time_point now)
+{
+    m_spinning = true;
+    m_last_spin = now;
+    m_spin_event->StartListen(0);
+}
+
+void BusyPoller::OnSpin()
+{
+    auto now = Clock::now();
+
+    /* 两次检查之间扣除处理连接事件的时间，剩下的是空转时间 */
+    auto idle_begin = std::max(m_last_spin, m_last_work);
+    if (now > idle_begin)
+        m_spin_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(now - idle_begin).count();
+    m_last_spin = now;
+
+    if (now - m_last_work > std::chrono::microseconds(m_window_us.load())) {
+        m_spinning = false;
+        m_spin_stop = now;
+        return;
+    }
+
+    m_spin_event->StartListen(0);
+}
+
+void BusyPoller::AdaptWindow(Clock::time_point now)
+{
+    /* 第一次唤醒没有可参考的阻塞时长 */
+    if (m_spin_stop == Clock::time_point{})
+        return;
+
+    int window = m_window_us;
+    auto gap = std::chrono::duration_cast<std::chrono::microseconds>(now - m_spin_stop).count();
+
+    if (gap < 2 * window)
+        window = std::min(window * 2, m_opts.max_spin_us);
+    else if (gap > 8 * window)
+        window = std::max(window / 2, m_opts.min_spin_us);
+
+    m_window_us = window;
+}
+
+} // namespace bbt::network::detail
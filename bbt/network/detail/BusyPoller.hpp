@@ -0,0 +1,82 @@
+/**
+ * @file BusyPoller.hpp
+ * @author yangqingmiao
+ * @brief 自适应忙轮询，每个EvThread一个
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <boost/noncopyable.hpp>
+#include <bbt/pollevent/EvThread.hpp>
+#include <bbt/network/detail/Define.hpp>
+
+namespace bbt::network::detail
+{
+
+/**
+ * 自适应忙轮询。
+ *
+ * 开启后在 EvThread 上挂一个不断重新注册的0超时定时事件，事件循环
+ * 因为存在已到期的定时器而以0超时调用epoll_wait，即非阻塞地轮询，
+ * 省去阻塞等待后被唤醒的开销。
+ *
+ * 距离上一次连接事件超过空转窗口后停止注册定时事件，事件循环退回
+ * 阻塞等待，下一次连接事件到达时重新开始空转。空转窗口根据流量自
+ * 适应：阻塞后很快又有事件到达说明窗口太短，窗口加倍；阻塞很久才
+ * 有事件到达说明流量稀疏，窗口减半。
+ *
+ * 除 GetStats 外，所有接口都只能在所属 EvThread 中调用。
+ */
+class BusyPoller:
+    public std::enable_shared_from_this<BusyPoller>,
+    boost::noncopyable
+{
+    typedef std::chrono::steady_clock Clock;
+public:
+    BBTATTR_FUNC_CTOR_HIDDEN BusyPoller(const BusyPollOptions& opts);
+    ~BusyPoller();
+
+    /**
+     * @brief 获取EvThread对应的忙轮询器，不存在则创建，已存在时opts被忽略
+     *
+     * @param thread
+     * @param opts
+     * @return std::shared_ptr<BusyPoller>
+     */
+    static std::shared_ptr<BusyPoller> GetOrCreate(std::shared_ptr<EvThread> thread, const BusyPollOptions& opts);
+
+    /* 连接事件开始，返回开始时间，用于统计处理时间 */
+    Clock::time_point       OnWorkBegin();
+    /* 连接事件处理结束 */
+    void                    OnWorkEnd(Clock::time_point begin);
+
+    /* 线程安全 */
+    BusyPollStats           GetStats() const;
+
+protected:
+    void                    Init(std::shared_ptr<EvThread> thread);
+    void                    OnSpin();
+    void                    StartSpin(Clock::time_point now);
+    void                    AdaptWindow(Clock::time_point now);
+
+private:
+    const BusyPollOptions   m_opts;
+    std::shared_ptr<Event>  m_spin_event{nullptr};
+    bool                    m_spinning{false};
+    Clock::time_point       m_last_work;                // 最近一次连接事件结束的时间
+    Clock::time_point       m_last_spin;                // 最近一次空转检查的时间
+    Clock::time_point       m_spin_stop;                // 最近一次停止空转的时间
+
+    std::atomic_int         m_window_us{0};
+    std::atomic_uint64_t    m_spin_ns{0};
+    std::atomic_uint64_t    m_work_ns{0};
+    std::atomic_uint64_t    m_spin_hits{0};
+    std::atomic_uint64_t    m_blocking_wakeups{0};
+};
+
+} // namespace bbt::network::detail
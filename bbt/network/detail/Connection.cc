@@ -9,10 +9,20 @@
  * 
  */
 #include <string>
+#include <algorithm>
+#include <sys/sendfile.h>
 #include <bbt/core/clock/Clock.hpp>
 #include <bbt/core/thread/Lock.hpp>
 #include <bbt/pollevent/Event.hpp>
 #include <bbt/network/detail/Connection.hpp>
+#include <bbt/network/detail/SocketOptions.hpp>
+#include <bbt/network/detail/IoUringContext.hpp>
+#include <bbt/network/detail/BusyPoller.hpp>
+#include <bbt/network/detail/UnixSocket.hpp>
+#include <bbt/network/detail/ShmChannel.hpp>
+#include <bbt/network/detail/TlsContext.hpp>
+#include <bbt/network/detail/BufferPool.hpp>
+#include <bbt/network/detail/MemoryBudget.hpp>
 
 using namespace bbt::core::errcode;
 
@@ -21,6 +31,13 @@ namespace bbt::network::detail
 
 typedef bbt::pollevent::EventOpt EventOpt;
 
+/* 未设置回调的连接共享一份空回调，m_callbacks不会为空 */
+static const std::shared_ptr<const ConnCallbacks>& EmptyCallbacks()
+{
+    static const auto _empty = std::make_shared<const ConnCallbacks>();
+    return _empty;
+}
+
 ConnId Connection::GenerateConnId()
 {
     static std::atomic_uint64_t _id = 0;    // 返回值从1开始，0是非法值
@@ -34,13 +51,20 @@ std::shared_ptr<Connection> Connection::Create(std::weak_ptr<EvThread> thread, e
 
 Connection::Connection(std::weak_ptr<EvThread> thread, evutil_socket_t socket, const IPAddress& ipaddr):
     m_bind_thread(thread),
+    m_callbacks(EmptyCallbacks()),
     m_socket_fd(socket),
-    m_peer_addr(ipaddr),
     m_conn_status(ConnStatus::emCONN_CONNECTED),
     m_conn_id(GenerateConnId())
 {
     Assert(m_socket_fd >= 0);
     Assert(m_conn_id > 0);
+
+    m_peer_addr.sa.sa_family = AF_UNSPEC;
+    socklen_t len = sizeof(m_peer_addr);
+    if (!ipaddr.GetRawData(&m_peer_addr.sa, len).has_value() && len <= sizeof(m_peer_addr))
+        m_peer_addr_len = len;
+    else
+        m_peer_addr.sa.sa_family = AF_UNSPEC;
 }
 
 Connection::~Connection()
@@ -56,52 +80,256 @@ void Connection::SetOpt_CloseTimeoutMS(int timeout_ms)
 
 void Connection::SetOpt_Callbacks(const ConnCallbacks& callbacks)
 {
-    m_callbacks = callbacks;
+    m_callbacks = std::make_shared<const ConnCallbacks>(callbacks);
+}
+
+void Connection::SetOpt_Callbacks(std::shared_ptr<const ConnCallbacks> callbacks)
+{
+    m_callbacks = callbacks ? callbacks : EmptyCallbacks();
+}
+
+const ConnCallbacks& Connection::GetCallbacks() const
+{
+    return *m_callbacks;
+}
+
+void Connection::SetOpt_RateLimit(const RateLimitOptions& opts)
+{
+    m_rate_limiter = RateLimiter::Create(opts);
+}
+
+void Connection::SetOpt_RateLimitGroup(std::shared_ptr<RateLimiter> group)
+{
+    m_group_rate_limiter = group;
+}
+
+void Connection::SetContext(std::shared_ptr<void> context)
+{
+    m_context = context;
+}
+
+void* Connection::GetContextPtr() const
+{
+    return m_context.get();
+}
+
+bool Connection::HasRateLimit() const
+{
+    return m_rate_limiter != nullptr || m_group_rate_limiter != nullptr;
+}
+
+void Connection::SetOpt_WorkerPool(std::shared_ptr<WorkerPool> pool)
+{
+    m_worker_pool = pool;
+    m_strand = (pool != nullptr) ? pool->NewStrand() : nullptr;
+}
+
+bool Connection::HasWorkerPool() const
+{
+    return m_worker_pool != nullptr;
+}
+
+bool Connection::RunInWorker(WorkerPool::Task&& task)
+{
+    if (m_worker_pool == nullptr)
+        return false;
+
+    return m_worker_pool->Submit(m_strand, std::move(task));
+}
+
+bool Connection::HasRecvGate() const
+{
+    return HasRateLimit() || HasWorkerPool() ||
+        (m_memory_budget && m_memory_budget->GetPolicy() == emMEMORY_POLICY_PAUSE_RECV);
+}
+
+void Connection::SetOpt_MemoryBudget(std::shared_ptr<MemoryBudget> budget)
+{
+    if (IsClosed())
+        return;
+
+    if (m_memory_budget != nullptr)
+        m_memory_budget->Unregister(m_conn_id);
+
+    m_memory_budget = budget;
+    if (m_memory_budget != nullptr)
+        m_memory_budget->Register(this);
+}
+
+size_t Connection::GetMemoryUsage() const
+{
+    return m_memory_used.load();
+}
+
+bool Connection::ChargeMemory(size_t n, bool rejectable)
+{
+    if (m_memory_budget == nullptr || n == 0 || IsClosed())
+        return true;
+
+    if (!m_memory_budget->Charge(m_memory_used.load(), n, rejectable))
+        return false;
+
+    size_t used = (m_memory_used += n);
+    if (m_memory_budget->GetPolicy() != emMEMORY_POLICY_CLOSE_LARGEST)
+        return true;
+
+    /* 超出连接级上限时关闭自己，超出全局预算时关闭占用最大的连接 */
+    if (m_memory_budget->ConnExceeded(used))
+        Evict();
+    else if (m_memory_budget->GlobalExceeded())
+        m_memory_budget->EvictLargest();
+
+    return true;
+}
+
+void Connection::ReleaseMemory(size_t n)
+{
+    if (m_memory_budget == nullptr || n == 0)
+        return;
+
+    /* 关闭时已经归还了全部占用，之后的归还不能减到负数 */
+    size_t used = m_memory_used.load();
+    size_t released = 0;
+    do {
+        released = std::min(used, n);
+    } while (!m_memory_used.compare_exchange_weak(used, used - released));
+
+    m_memory_budget->Release(released);
+}
+
+void Connection::Evict()
+{
+    bool evicting = false;
+    if (IsClosed() || !m_evicting.compare_exchange_strong(evicting, true))
+        return;
+
+    auto thread = GetBindThread();
+    if (thread == nullptr)
+        return;
+
+    m_evict_event = thread->RegisterEvent(-1, EventOpt::TIMEOUT,
+    [weak_this{weak_from_this()}](int, short, EventId){
+        auto pthis = weak_this.lock();
+        if (pthis == nullptr || pthis->IsClosed())
+            return;
+
+        pthis->m_memory_budget->OnEvicted();
+        pthis->OnError(Errcode{"memory budget exceeded! connection closed! peer:" + pthis->GetPeerAddress().GetIPPort(), ERRTYPE_MEMORY_BUDGET_EXCEEDED});
+        pthis->Close();
+    });
+    m_evict_event->StartListen(0);
+}
+
+void Connection::SetOpt_BusyPoll(const BusyPollOptions& opts)
+{
+    m_busy_poll_opts = opts;
+}
+
+void Connection::SetOpt_IOBackend(IOBackend backend)
+{
+    m_io_backend = backend;
+}
+
+IOBackend Connection::GetIOBackend() const
+{
+    return m_io_backend;
+}
+
+void Connection::SetOpt_EdgeTriggered(bool enable, int read_budget)
+{
+    AssertWithInfo(read_budget > 0, "read budget must be greater than 0!");
+    m_edge_triggered = enable;
+    m_read_budget = read_budget;
+}
+
+ErrOpt Connection::SetOpt_SocketOptions(const SocketOptions& opts)
+{
+    if (IsClosed())
+        return FASTERR_ERROR("set socket options failed! connection is closed!");
+
+    if (opts.quickack.has_value())
+        m_quickack = opts.quickack.value();
+
+    return ApplySocketOptions(GetSocket(), opts);
+}
+
+void Connection::SetOpt_FrameParser(const FrameParser& parser)
+{
+    m_frame_parser = parser ? std::make_shared<const FrameParser>(parser) : nullptr;
+}
+
+void Connection::SetOpt_FrameParser(std::shared_ptr<const FrameParser> parser)
+{
+    m_frame_parser = (parser && *parser) ? parser : nullptr;
+}
+
+ErrOpt Connection::SetOpt_FrameInput(const std::string& input)
+{
+    if (!m_frame_parser)
+        return FASTERR_ERROR("set frame input failed! frame parser is not set!");
+
+    m_frame_input.assign(input.begin(), input.end());
+    ChargeMemory(input.size(), false);
+    return FASTERR_NOTHING;
+}
+
+bool Connection::DeliversRecvCallback() const
+{
+    return !(m_frame_parser && m_callbacks->on_recv_batch_callback);
 }
 
 void Connection::OnRecv(const char* data, size_t len)
 {
-    if (!m_callbacks.on_recv_callback) {
+    if (m_frame_parser && m_callbacks->on_recv_batch_callback) {
+        m_frame_input.insert(m_frame_input.end(), data, data + len);
+        ChargeMemory(len, false);
+        /* 可读事件中的多次读取攒到事件结束后一起交付 */
+        if (!m_in_read_event)
+            DeliverFrames();
+        return;
+    }
+
+    if (!m_callbacks->on_recv_callback) {
         OnError(Errcode{"on recv!, but no recv callback!", ERRTYPE_ERROR});
         return;
     }
 
-    m_callbacks.on_recv_callback(shared_from_this(), data, len);
+    m_callbacks->on_recv_callback(shared_from_this(), data, len);
 }
 
 void Connection::OnSend(ErrOpt err, size_t succ_len)
 {
-    if (!m_callbacks.on_send_callback) {
+    if (!m_callbacks->on_send_callback) {
         OnError(Errcode{"on send!, but no send callback!", ERRTYPE_ERROR});
         return;
     }
 
-    m_callbacks.on_send_callback(shared_from_this(), err, succ_len);
+    m_callbacks->on_send_callback(shared_from_this(), err, succ_len);
 }
 
 void Connection::OnClose()
 {
-    if (!m_callbacks.on_close_callback) {
+    if (!m_callbacks->on_close_callback) {
         OnError(Errcode{"on closed!, but no close callback!", ERRTYPE_ERROR});
         return;
     }
 
-    m_callbacks.on_close_callback(GetConnId(), GetPeerAddress());
+    m_callbacks->on_close_callback(GetConnId(), GetPeerAddress());
 }
 
 void Connection::OnTimeout()
 {
-    if (!m_callbacks.on_timeout_callback) {
+    if (!m_callbacks->on_timeout_callback) {
         OnError(Errcode{"on timeout!, but no timeout callback!", ERRTYPE_ERROR});
         return;
     }
-    m_callbacks.on_timeout_callback(shared_from_this());
+    m_callbacks->on_timeout_callback(shared_from_this());
 }
 
 void Connection::OnError(const Errcode& err)
 {
-    if (m_callbacks.on_err_callback) {
-        m_callbacks.on_err_callback(m_conn_id, err);
+    if (m_callbacks->on_err_callback) {
+        m_callbacks->on_err_callback(m_conn_id, err);
     }
 }
 
@@ -114,10 +342,41 @@ void Connection::Close()
         m_event->CancelListen();
     if (m_send_event)
         m_send_event->CancelListen();
+    if (m_uring)
+        m_uring->Cancel(m_uring_recv_token);
+    if (m_recv_resume_event)
+        m_recv_resume_event->CancelListen();
+    if (m_requeue_event)
+        m_requeue_event->CancelListen();
+    if (m_send_resume_event)
+        m_send_resume_event->CancelListen();
+    if (m_shm_event)
+        m_shm_event->CancelListen();
+    if (m_flush_event)
+        m_flush_event->CancelListen();
+    if (m_tls_event)
+        m_tls_event->CancelListen();
+    if (m_completion_event)
+        m_completion_event->CancelListen();
+    if (m_expire_event)
+        m_expire_event->CancelListen();
+    /* 发送close_notify，否则会话会被标记为不可恢复 */
+    if (m_tls)
+        m_tls->Shutdown();
     // if (ret != 0) OnError(Errcode{"event cancel listen failed!", ERRTYPE_ERROR});
     
     CloseSocket();
+    ClosePassedFds();
     SetStatus(ConnStatus::emCONN_DECONNECTED);
+    /* 状态已经是关闭，持锁归还后AppendOutputBuffer不会再记账 */
+    if (m_memory_budget) {
+        {
+            std::lock_guard<bbt::core::thread::Mutex> lock(m_output_mutex);
+            ReleaseMemory(m_memory_used.load());
+        }
+        m_memory_budget->Unregister(m_conn_id);
+    }
+    AbortCompletions();
     OnClose();
 }
 
@@ -131,28 +390,83 @@ bool Connection::IsClosed() const
     return (m_conn_status == ConnStatus::emCONN_DECONNECTED);
 }
 
-const IPAddress& Connection::GetPeerAddress() const
+IPAddress Connection::GetPeerAddress() const
 {
-    return m_peer_addr;
+    IPAddress addr;
+    if (m_peer_addr_len > 0)
+        addr.From(const_cast<sockaddr*>(&m_peer_addr.sa), m_peer_addr_len);
+
+    return addr;
 }
 
 void Connection::RunInEventLoop()
 {
-    auto weak_this = weak_from_this();
     if (!BindThreadIsRunning())
         return;
 
-    auto thread = GetBindThread();
+    /* 和迁移互斥，启动前迁移只改绑定线程，这里读到的是迁移后的线程 */
+    std::shared_ptr<EvThread> thread = nullptr;
+    {
+        std::lock_guard<bbt::core::thread::Mutex> lock(m_output_mutex);
+        m_started = true;
+        thread = GetBindThread();
+    }
 
     Assert(thread != nullptr);
     if (thread == nullptr)
         return;
 
+    if (m_io_backend == emIO_BACKEND_IO_URING && RunInIoUring(thread))
+        return;
+
+    if (m_busy_poll_opts.enable)
+        m_busy_poller = BusyPoller::GetOrCreate(thread, m_busy_poll_opts);
+
+    /* 边缘触发需要读到EAGAIN，socket必须是非阻塞的 */
+    if (m_edge_triggered)
+        evutil_make_socket_nonblocking(GetSocket());
+
+    /* 会话要在读事件注册前创建，否则第一个可读事件可能读到握手数据 */
+    if (m_tls_ctx != nullptr) {
+        auto err = TlsSession::Create(m_tls_ctx, GetSocket(), m_tls);
+        if (err.has_value()) {
+            OnError(err.value());
+            Close();
+            return;
+        }
+    }
+
+    RegistRecvEvent(thread);
+
+    /* 客户端先发ClientHello，放到可写事件中开始握手，两端统一在连接所在线程推进 */
+    if (m_tls != nullptr)
+        WaitTlsWritable();
+
+    /* 共享内存由发起方创建并立即握手，接收方在socket上收到握手消息后映射 */
+    if (m_shm_ring_size > 0 && m_shm_initiator) {
+        std::shared_ptr<ShmChannel> channel = nullptr;
+        auto err = ShmChannel::Create(m_shm_ring_size, channel);
+        if (!err.has_value())
+            err = channel->SendHello(GetSocket());
+
+        if (err.has_value()) {
+            OnError(err.value());
+            Close();
+            return;
+        }
+
+        AttachShm(channel);
+    }
+}
+
+void Connection::RegistRecvEvent(std::shared_ptr<EvThread> thread)
+{
     m_event = thread->RegisterEvent(GetSocket(),
         EventOpt::CLOSE |       // 关闭事件
         EventOpt::PERSIST |     // 持久化
-        EventOpt::READABLE,     // 可读事件
-    [weak_this](int fd, short events, EventId eventid){
+        EventOpt::READABLE |    // 可读事件
+        (m_edge_triggered ? EV_ET : 0),
+    [weak_this{weak_from_this()}](int fd, short events, EventId eventid){
         auto pthis = weak_this.lock();
         if (!pthis) return;
         pthis->OnEvent(fd, events);
@@ -162,145 +476,1654 @@ void Connection::RunInEventLoop()
     Assert(ret == 0);
 }
 
-void Connection::OnEvent(evutil_socket_t sockfd, short event)
-{
-    if (event & EventOpt::READABLE) {
-        /* 尝试读取套接字数据，如果对端关闭，一并关闭此连接 */
-        auto err = Recv(sockfd);
-        if (err.has_value()) OnError(err.value());
-        if (err.has_value() && err.value().Type() == emErr::ERRTYPE_NETWORK_RECV_EOF)
-            Close();
-    } else if (event & EventOpt::TIMEOUT) {
-        /* 当连接空闲超时时，直接通过用户注册的回调通知用户 */
-        Timeout();
-    } else if (event & EventOpt::CLOSE) {
-        Close();
-    }
-}
-
-ErrOpt Connection::Recv(evutil_socket_t sockfd)
+ErrOpt Connection::MigrateTo(std::shared_ptr<EvThread> thread, const OnMigrateFunc& on_done)
 {
-    int                 err          = 0;
-    int                 read_len     = 0;
-    bbt::core::Buffer   buffer;
-    char*               buffer_begin = nullptr;
-    size_t              buffer_len   = 4096;
-    ErrOpt errcode = std::nullopt;
-
-    if (IsClosed()) {
-        return FASTERR_ERROR("conn is closed, but event was not cancel! peer:" + GetPeerAddress().GetIPPort());
-    }
+    if (thread == nullptr || !thread->IsRunning())
+        return Errcode{"migrate failed! target thread is not running!", ERRTYPE_MIGRATE_FAILED};
 
-    buffer.WriteNull(buffer_len);
-    buffer_begin = buffer.Peek();
-    read_len = ::read(sockfd, buffer_begin, buffer_len);
+    if (!IsConnected())
+        return Errcode{"migrate failed! connection is disconnect!", ERRTYPE_MIGRATE_FAILED};
 
-    if (read_len == -1) {
-        if (errno == EINTR || errno == EAGAIN) {
-            errcode = std::make_optional<Errcode>("please try again!", ERRTYPE_NETWORK_RECV_TRY_AGAIN);
-        } else if (errno == ECONNREFUSED) {
-            errcode = std::make_optional<Errcode>("connect refused!", ERRTYPE_NETWORK_RECV_CONNREFUSED);
-        } else {
-            errcode = std::make_optional<Errcode>("other errno! errno=" + std::to_string(errno), ERRTYPE_NETWORK_RECV_OTHER_ERR);
-        }
+    auto current = GetBindThread();
+    if (current == nullptr)
+        return FASTERR_ERROR("bind thread is nullptr!");
 
-    } else if (read_len == 0) {
-        errcode = std::make_optional<Errcode>("peer connect closed!", ERRTYPE_NETWORK_RECV_EOF);
-    } else if (read_len < -1) {
-        errcode = std::make_optional<Errcode>("other error! please debug!", ERRTYPE_NETWORK_RECV_OTHER_ERR);
-    }
+    if (current == thread)
+        return Errcode{"migrate failed! connection is already bound to the thread!", ERRTYPE_MIGRATE_FAILED};
 
-    if (errcode.has_value())
-        return errcode;
+    bool migrating = false;
+    if (!m_migrating.compare_exchange_strong(migrating, true))
+        return Errcode{"migrate failed! another migration is in progress!", ERRTYPE_MIGRATE_FAILED};
 
-    OnRecv(buffer_begin, read_len);
+    m_migration = std::make_unique<Migration>();
+    m_migration->target = thread;
+    m_migration->on_done = on_done;
 
+    /* 其余检查和迁移本身都在连接所在线程中进行 */
+    m_migrate_event = current->RegisterEvent(-1, EventOpt::TIMEOUT,
+    [weak_this{weak_from_this()}](int, short, EventId){
+        if (auto pthis = weak_this.lock(); pthis != nullptr)
+            pthis->DoMigrate();
+    });
+    m_migrate_event->StartListen(0);
     return FASTERR_NOTHING;
 }
 
-size_t Connection::Send(const char* buf, size_t len)
+bool Connection::IsMigrating() const
 {
-    int remain = len;
-    while (remain > 0) {
-        int n = ::send(GetSocket(), (buf + (len - remain)), remain, MSG_NOSIGNAL);
-        if (n < 0) {
-            if (errno == EPIPE) {
-                Close();
-                return -1;
-            }
-        }
-        remain -= n;
-    }
+    return m_migrating.load();
+}
 
-    return (len - remain);
+uint64_t Connection::GetIoEvents() const
+{
+    return m_io_events.load(std::memory_order_relaxed);
 }
 
-ErrOpt Connection::AsyncSend(const char* buf, size_t len)
+void Connection::DoMigrate()
 {
-    /**
-     *  此函数大概率是跨线程发送的，因此内部保证线程安全
-     *  异步发送数据时有下列情况：
-     *  （1）当有正在发送中的数据，则将数据追加到输出缓存中
-     *  （2）当没有发送中的数据，则触发一次发送数据
-     * 
-     *  同时在发送事件完成后，会检测output buffer中是否有
-     *  待发送数据，如果有，则继续上述循环直到buffer为空.
-     */
-    if (!IsConnected()) {
-        return FASTERR_ERROR("send error! connection is disconnect! sockfd=" + std::to_string(GetSocket()) +  " status=" + std::to_string(IsConnected() ? 1 : 0));
+    auto target = m_migration->target.lock();
+    if (IsClosed() || m_evicting.load() || target == nullptr || !target->IsRunning()) {
+        EndMigrate(Errcode{"migrate failed! connection is closed or target thread is stopped!", ERRTYPE_MIGRATE_FAILED});
+        return;
+    }
+
+    /* 还没有启动的连接没有注册任何事件，只改绑定线程，启动时直接在新线程中注册 */
+    bool started = true;
+    {
+        std::lock_guard<bbt::core::thread::Mutex> lock(m_output_mutex);
+        started = m_started;
+        if (!started)
+            SetBindThread(target);
+    }
+
+    if (!started) {
+        EndMigrate(std::nullopt);
+        return;
+    }
+
+    /* io_uring的请求和共享内存的门铃都绑定在原线程上 */
+    if (m_uring != nullptr || m_shm_ring_size > 0) {
+        EndMigrate(Errcode{"migrate failed! connection uses io_uring or shared memory!", ERRTYPE_MIGRATE_FAILED});
+        return;
     }
 
     /**
-     *  后续调用不可以注册发送事件，只能追写output buffer，除非
-     *  上一个发送事件已经结束
+     * 取得发送权，发送中的数据和握手中的tls等待完成后再迁移。
+     * m_event为空时连接正在其他线程中启动，同样稍后重试
      */
-    bool not_free = true;
-    int append_len = AppendOutputBuffer(buf, len);
-    if (!m_output_buffer_is_free.compare_exchange_strong(not_free, false)) {
-        return (append_len != len) ? FASTERR_ERROR("output buffer failed! remain=" + std::to_string(len - append_len)) : FASTERR_NOTHING;
+    bool is_free = true;
+    bool starting = (m_event == nullptr);
+    bool handshaking = (m_tls != nullptr && !m_tls->IsEstablished());
+    if (starting || handshaking || !m_output_buffer_is_free.compare_exchange_strong(is_free, false)) {
+        if (m_migration->waited_ms >= CONNECTION_MIGRATE_TIMEOUT_MS) {
+            EndMigrate(Errcode{"migrate failed! wait for pending send timeout!", ERRTYPE_MIGRATE_FAILED});
+            return;
+        }
+
+        m_migration->waited_ms += CONNECTION_MIGRATE_RETRY_MS;
+        m_migrate_event->StartListen(CONNECTION_MIGRATE_RETRY_MS);
+        return;
     }
 
-    /* 如果此时没有进行中的发送事件，则注册一个新的发送事件 */
-    return RegistASendEvent();
-}
+    /* 持有发送权后，连接的事件都在本线程中，全部注销，在新线程中按需重建 */
+    m_migration->recv_paused = m_recv_paused;
+    for (auto* event : {&m_event, &m_send_event, &m_recv_resume_event, &m_requeue_event,
+                        &m_send_resume_event, &m_flush_event, &m_tls_event}) {
+        if (*event == nullptr)
+            continue;
+        (*event)->CancelListen();
+        *event = nullptr;
+    }
 
-int Connection::AppendOutputBuffer(const char* data, size_t len)
-{
-    std::lock_guard<bbt::core::thread::Mutex> lock(m_output_mutex);
-    auto before_size = m_output_buffer.Size();
-    m_output_buffer.WriteString(data, len);
-    auto after_size = m_output_buffer.Size();
+    {
+        std::lock_guard<bbt::core::thread::Mutex> lock(m_output_mutex);
+        if (m_completion_event != nullptr)
+            m_completion_event->CancelListen();
+        m_completion_event = nullptr;
+        if (m_expire_event != nullptr)
+            m_expire_event->CancelListen();
+        m_expire_event = nullptr;
+        m_armed_expire = Clock::time_point::max();
+        SetBindThread(target);
+    }
 
-    int change_num = after_size - before_size;
+    m_busy_poller = m_busy_poll_opts.enable ? BusyPoller::GetOrCreate(target, m_busy_poll_opts) : nullptr;
 
-    return change_num > 0 ? change_num : 0;
+    m_migrate_finish_event = target->RegisterEvent(-1, EventOpt::TIMEOUT,
+    [weak_this{weak_from_this()}](int, short, EventId){
+        if (auto pthis = weak_this.lock(); pthis != nullptr)
+            pthis->FinishMigrate();
+    });
+    m_migrate_finish_event->StartListen(0);
 }
 
-ErrOpt Connection::RegistASendEvent()
+void Connection::FinishMigrate()
 {
-    /**
-     *  此事件只同时存在一个，其作用是每次发送结束后，检测一下
-     *  输出缓存是否会有数据，并做以下行为：
-     *      （1）output buffer 有数据，交换buffer，该事件继续运行；
-     *      （2）output buffer 没有数据，取消此事件，允许下次追加output
-     *          buffer时注册发送事件.
-     */
-    AssertWithInfo(!m_output_buffer_is_free.load(), "output buffer must be false!");
-    AssertWithInfo(!m_send_event , "has a wrong!");
-    auto buffer_sptr = std::make_shared<bbt::core::Buffer>();
-    /* Swap 是无额外开销的 */
+    if (IsClosed()) {
+        m_output_buffer_is_free.exchange(true);
+        EndMigrate(Errcode{"migrate failed! connection is closed!", ERRTYPE_MIGRATE_FAILED});
+        return;
+    }
+
+    /* 重新加入epoll时会立即报告已经就绪的数据，边缘触发也不会丢失 */
+    RegistRecvEvent(GetBindThread());
+    /* 迁移前被限流、内存预算或线程池背压暂停的读取保持暂停，由新线程的定时器检查恢复 */
+    m_recv_paused = false;
+    if (m_migration->recv_paused)
+        PauseRecv();
+
     {
         std::lock_guard<bbt::core::thread::Mutex> lock(m_output_mutex);
-        buffer_sptr->Swap(m_output_buffer);
+        if (!m_ready_completions.empty())
+            ScheduleCompletions();
+        RearmExpire();
     }
 
-    auto weak_this = weak_from_this();
-    if (!BindThreadIsRunning())
-        return FASTERR_ERROR("bind thread is stop!");
-    
-    auto thread = GetBindThread();
-    if (thread == nullptr)
-        return FASTERR_ERROR("bind thread is nullptr!");
+    /* 迁移期间追加的数据在这里开始发送 */
+    ReleaseOutput();
+    EndMigrate(std::nullopt);
+}
+
+void Connection::EndMigrate(ErrOpt err)
+{
+    auto migration = std::move(m_migration);
+    m_migrating.exchange(false);
+    if (migration != nullptr && migration->on_done)
+        migration->on_done(m_conn_id, err);
+}
+
+ErrOpt Connection::Detach(const OnDetachFunc& on_detach)
+{
+    if (on_detach == nullptr)
+        return FASTERR_ERROR("detach failed! callback is null!");
+
+    if (!IsConnected())
+        return Errcode{"detach failed! connection is disconnect!", ERRTYPE_HOT_RESTART_FAILED};
+
+    auto current = GetBindThread();
+    if (current == nullptr)
+        return FASTERR_ERROR("bind thread is nullptr!");
+
+    /* 和迁移互斥，交出期间连接不会换线程 */
+    bool migrating = false;
+    if (!m_migrating.compare_exchange_strong(migrating, true))
+        return Errcode{"detach failed! connection is migrating!", ERRTYPE_HOT_RESTART_FAILED};
+
+    m_migrate_event = current->RegisterEvent(-1, EventOpt::TIMEOUT,
+    [weak_this{weak_from_this()}, on_detach](int, short, EventId){
+        if (auto pthis = weak_this.lock(); pthis != nullptr)
+            pthis->DoDetach(on_detach);
+        else
+            on_detach(-1, std::string{});
+    });
+    m_migrate_event->StartListen(0);
+    return FASTERR_NOTHING;
+}
+
+void Connection::DoDetach(const OnDetachFunc& on_detach)
+{
+    /* tls会话、io_uring的请求和共享内存都无法随socket带走 */
+    if (IsClosed() || m_evicting.load() || m_event == nullptr || m_uring != nullptr ||
+        m_shm_ring_size > 0 || m_tls != nullptr) {
+        m_migrating.exchange(false);
+        on_detach(-1, std::string{});
+        return;
+    }
+
+    /* 只交出空闲的连接，发送中的数据留在本进程写完 */
+    bool is_free = true;
+    if (!m_output_buffer_is_free.compare_exchange_strong(is_free, false)) {
+        m_migrating.exchange(false);
+        on_detach(-1, std::string{});
+        return;
+    }
+
+    {
+        std::lock_guard<bbt::core::thread::Mutex> lock(m_output_mutex);
+        if (OutputBufferSize() > 0 || (m_pending_fds != nullptr && !m_pending_fds->empty())) {
+            m_output_buffer_is_free.exchange(true);
+            m_migrating.exchange(false);
+            on_detach(-1, std::string{});
+            return;
+        }
+    }
+
+    /* socket交给调用方，Close只注销事件、回调关闭，不再关闭socket */
+    int fd = m_socket_fd;
+    m_socket_fd = -1;
+    std::string input(m_frame_input.begin(), m_frame_input.end());
+    m_migrating.exchange(false);
+    on_detach(fd, std::move(input));
+    Close();
+}
+
+bool Connection::RunInIoUring(std::shared_ptr<EvThread> thread)
+{
+    /* 限流和线程池背压依赖暂停读事件，fd传递和共享内存握手依赖sendmsg/recvmsg，io_uring后端下回退到libevent */
+    if (HasRecvGate() || m_pass_fd || m_shm_ring_size > 0 || m_tls_ctx != nullptr) {
+        OnError(Errcode{"rate limit, worker pool, memory budget pause, fd passing, shared memory and tls are not supported by io_uring backend, fallback to libevent!", ERRTYPE_ERROR});
+        m_io_backend = emIO_BACKEND_LIBEVENT;
+        return false;
+    }
+
+    ErrOpt err = std::nullopt;
+    m_uring = IoUringContext::GetOrCreate(thread, err);
+    if (m_uring == nullptr) {
+        if (err.has_value()) OnError(err.value());
+        m_io_backend = emIO_BACKEND_LIBEVENT;
+        return false;
+    }
+
+    /* 只用于空闲超时，每次收到数据后重置 */
+    m_event = thread->RegisterEvent(-1, EventOpt::TIMEOUT | EventOpt::PERSIST,
+    [weak_this{weak_from_this()}](int fd, short events, EventId eventid){
+        auto pthis = weak_this.lock();
+        if (!pthis) return;
+        pthis->OnEvent(fd, events);
+    });
+
+    int ret = m_event->StartListen(m_timeout_ms);
+    Assert(ret == 0);
+
+    UringRecv();
+    return true;
+}
+
+void Connection::UringRecv()
+{
+    m_uring_recv_token = m_uring->RecvMultishot(GetSocket(),
+    [weak_this{weak_from_this()}](int res, const char* data, bool more){
+        auto pthis = weak_this.lock();
+        if (!pthis) return;
+        pthis->OnUringRecv(res, data, more);
+    });
+
+    if (m_uring_recv_token == 0) {
+        OnError(Errcode{"io_uring submit recv failed!", ERRTYPE_NETWORK_RECV_OTHER_ERR});
+        Close();
+    }
+}
+
+void Connection::OnUringRecv(int res, const char* data, bool more)
+{
+    if (IsClosed())
+        return;
+
+    if (res > 0) {
+        m_event->StartListen(m_timeout_ms);     // 重置空闲超时
+        if (m_quickack) ReArmQuickAck(GetSocket());
+        OnRecv(data, res);
+    } else if (res == 0) {
+        OnError(Errcode{"peer connect closed!", ERRTYPE_NETWORK_RECV_EOF});
+        Close();
+        return;
+    } else if (res != -ENOBUFS && res != -EINTR && res != -EAGAIN) {
+        OnError(Errcode{"other errno! errno=" + std::to_string(-res), ERRTYPE_NETWORK_RECV_OTHER_ERR});
+        Close();
+        return;
+    }
+
+    /* 缓冲区耗尽等情况下 multishot 会终止，需要重新提交 */
+    if (!more && !IsClosed())
+        UringRecv();
+}
+
+ErrOpt Connection::UringSend(std::shared_ptr<bbt::core::Buffer> output_buffer)
+{
+    uint64_t token = m_uring->Send(GetSocket(), output_buffer->Peek(), output_buffer->Size(),
+    [weak_this{weak_from_this()}, output_buffer](int res, const char*, bool){
+        auto pthis = weak_this.lock();
+        if (!pthis) return;
+        pthis->OnUringSend(output_buffer, res);
+    });
+
+    if (token == 0) {
+        m_output_buffer_is_free.exchange(true);
+        return FASTERR_ERROR("io_uring submit send failed!");
+    }
+
+    return FASTERR_NOTHING;
+}
+
+void Connection::OnUringSend(std::shared_ptr<bbt::core::Buffer> output_buffer, int res)
+{
+    if (IsClosed())
+        return;
+
+    if (res < 0) {
+        OnSend(Errcode{"send failed! errno=" + std::to_string(-res), ERRTYPE_ERROR}, 0);
+        if (res == -EPIPE || res == -ECONNRESET) {
+            Close();
+            return;
+        }
+        OnOutputConsumed(output_buffer->Size(), Errcode{"send failed! errno=" + std::to_string(-res), ERRTYPE_ERROR});
+        output_buffer->Clear();
+    } else {
+        OnOutputConsumed(res, std::nullopt);
+        OnSend(std::nullopt, res);
+        /* 部分发送，继续发送剩余部分 */
+        if ((size_t)res < output_buffer->Size()) {
+            bbt::core::Buffer remain{output_buffer->Peek() + res, output_buffer->Size() - res};
+            output_buffer->Swap(remain);
+            UringSend(output_buffer);
+            return;
+        }
+        output_buffer->Clear();
+    }
+
+    /* 在锁内释放标志位，保证AsyncSend追加的数据一定会被发送 */
+    {
+        std::lock_guard<bbt::core::thread::Mutex> lock(m_output_mutex);
+        if (OutputBufferSize() <= 0) {
+            m_output_buffer_is_free.exchange(true);
+            return;
+        }
+
+        SwapOutputBuffer(*output_buffer);
+    }
+
+    UringSend(output_buffer);
+}
+
+void Connection::OnEvent(evutil_socket_t sockfd, short event)
+{
+    m_io_events.store(m_io_events.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    /* 忙轮询开启时记录连接事件，驱动线程的空转窗口 */
+    if (m_busy_poller) {
+        auto poller = m_busy_poller;
+        auto begin = poller->OnWorkBegin();
+        DispatchEvent(sockfd, event);
+        poller->OnWorkEnd(begin);
+        return;
+    }
+
+    DispatchEvent(sockfd, event);
+}
+
+void Connection::DispatchEvent(evutil_socket_t sockfd, short event)
+{
+    if ((event & EventOpt::READABLE) && m_edge_triggered) {
+        m_readable = true;
+        m_in_read_event = true;
+        DrainRecv();
+        m_in_read_event = false;
+        DeliverFrames();
+    } else if (event & EventOpt::READABLE) {
+        /* 尝试读取套接字数据，如果对端关闭，一并关闭此连接 */
+        m_in_read_event = true;
+        auto err = Recv(sockfd);
+        m_in_read_event = false;
+        DeliverFrames();
+        if (err.has_value()) OnError(err.value());
+        if (err.has_value() && err.value().Type() == emErr::ERRTYPE_NETWORK_RECV_EOF) {
+            /* 对端关闭前写入共享内存的数据先交付 */
+            if (m_shm) ShmRecv();
+            Close();
+        }
+        else if (err.has_value() && err.value().Type() == emErr::ERRTYPE_NETWORK_RECV_FDS_TRUNCATED)
+            Close();
+        else if (HasRecvGate() && RecvQuota(1) == 0)
+            PauseRecv();
+    } else if (event & EventOpt::TIMEOUT) {
+        /* 当连接空闲超时时，直接通过用户注册的回调通知用户 */
+        Timeout();
+    } else if (event & EventOpt::CLOSE) {
+        Close();
+    }
+}
+
+void Connection::DrainRecv()
+{
+    for (int i = 0; i < m_read_budget && m_readable; ++i) {
+        if (IsClosed())
+            return;
+
+        if (HasRecvGate() && RecvQuota(1) == 0) {
+            PauseRecv();
+            return;
+        }
+
+        auto err = Recv(GetSocket());
+        if (!err.has_value())
+            continue;
+
+        /* 读到EAGAIN说明内核缓冲区已经读空，等待下一次边缘通知 */
+        m_readable = false;
+        if (err->Type() == ERRTYPE_NETWORK_RECV_TRY_AGAIN)
+            break;
+
+        OnError(err.value());
+        if (err->Type() == ERRTYPE_NETWORK_RECV_EOF) {
+            if (m_shm) ShmRecv();
+            /* 同一次事件中已经读到的帧先交付 */
+            m_in_read_event = false;
+            DeliverFrames();
+            Close();
+        } else if (err->Type() == ERRTYPE_NETWORK_RECV_FDS_TRUNCATED) {
+            Close();
+        }
+        return;
+    }
+
+    if (m_readable && !IsClosed())
+        RequeueRecv();
+}
+
+void Connection::DeliverFrames()
+{
+    if (m_frame_input.empty() || IsClosed())
+        return;
+
+    size_t offset = 0;
+    m_frame_views.clear();
+    while (offset < m_frame_input.size()) {
+        size_t remain = m_frame_input.size() - offset;
+        ssize_t n = (*m_frame_parser)(m_frame_input.data() + offset, remain);
+        if (n < 0) {
+            OnError(Errcode{"frame parse failed! peer:" + GetPeerAddress().GetIPPort(), ERRTYPE_ERROR});
+            Close();
+            return;
+        }
+
+        if (n == 0 || (size_t)n > remain)
+            break;
+
+        m_frame_views.emplace_back(m_frame_input.data() + offset, n);
+        offset += n;
+    }
+
+    if (!m_frame_views.empty())
+        m_callbacks->on_recv_batch_callback(shared_from_this(), FrameBatch{m_frame_views.data(), m_frame_views.size()});
+
+    /* 不完整的尾部留到下次，读空后释放偶尔的大帧占用的内存 */
+    m_frame_input.erase(m_frame_input.begin(), m_frame_input.begin() + offset);
+    ReleaseMemory(offset);
+    if (m_frame_input.empty() && m_frame_input.capacity() > 64 * 1024)
+        std::vector<char>().swap(m_frame_input);
+}
+
+void Connection::RequeueRecv()
+{
+    /* 0超时的定时器在下一轮循环触发，让同一轮中其他就绪的连接先处理 */
+    auto thread = GetBindThread();
+    if (thread == nullptr)
+        return;
+
+    if (m_requeue_event == nullptr) {
+        m_requeue_event = thread->RegisterEvent(-1, EventOpt::TIMEOUT,
+        [weak_this{weak_from_this()}](int, short, EventId){
+            if (auto pthis = weak_this.lock(); pthis != nullptr)
+                pthis->DrainRecv();
+        });
+    }
+
+    m_requeue_event->StartListen(0);
+}
+
+ErrOpt Connection::Recv(evutil_socket_t sockfd)
+{
+    int                 err          = 0;
+    int                 read_len     = 0;
+    char                buffer_begin[4096];         // 读到的数据在OnRecv中同步处理完，不需要堆上的缓冲区
+    size_t              buffer_len   = sizeof(buffer_begin);
+    ErrOpt errcode = std::nullopt;
+
+    if (IsClosed()) {
+        return FASTERR_ERROR("conn is closed, but event was not cancel! peer:" + GetPeerAddress().GetIPPort());
+    }
+
+    /* 共享内存握手完成前，socket上只会收到握手消息 */
+    if (m_shm_ring_size > 0 && !m_shm_initiator && m_shm == nullptr)
+        return AcceptShm(sockfd);
+
+    if (m_tls != nullptr)
+        return TlsRecv();
+
+    buffer_len = RecvQuota(buffer_len);
+    if (buffer_len == 0) {
+        PauseRecv();
+        return FASTERR_NOTHING;
+    }
+
+    if (m_pass_fd) {
+        std::vector<int> fds;
+        read_len = RecvWithFds(sockfd, buffer_begin, buffer_len, fds);
+        if (!fds.empty()) {
+            std::lock_guard<std::mutex> _(m_recv_fds_mutex);
+            m_recv_fds.insert(m_recv_fds.end(), fds.begin(), fds.end());
+        }
+    } else {
+        read_len = ::read(sockfd, buffer_begin, buffer_len);
+    }
+
+    if (read_len == -1) {
+        if (errno == EINTR || errno == EAGAIN) {
+            errcode = std::make_optional<Errcode>("please try again!", ERRTYPE_NETWORK_RECV_TRY_AGAIN);
+        } else if (errno == ECONNREFUSED) {
+            errcode = std::make_optional<Errcode>("connect refused!", ERRTYPE_NETWORK_RECV_CONNREFUSED);
+        } else if (m_pass_fd && errno == EMSGSIZE) {
+            /* 同一次读到的数据已经被丢弃，字节流出现空洞，只能关闭连接 */
+            errcode = std::make_optional<Errcode>("recv fds truncated! data dropped!", ERRTYPE_NETWORK_RECV_FDS_TRUNCATED);
+        } else {
+            errcode = std::make_optional<Errcode>("other errno! errno=" + std::to_string(errno), ERRTYPE_NETWORK_RECV_OTHER_ERR);
+        }
+
+    } else if (read_len == 0) {
+        errcode = std::make_optional<Errcode>("peer connect closed!", ERRTYPE_NETWORK_RECV_EOF);
+    } else if (read_len < -1) {
+        errcode = std::make_optional<Errcode>("other error! please debug!", ERRTYPE_NETWORK_RECV_OTHER_ERR);
+    }
+
+    if (errcode.has_value())
+        return errcode;
+
+    if (m_quickack) ReArmQuickAck(sockfd);
+    if (m_rate_limiter) m_rate_limiter->OnRecv(read_len);
+    if (m_group_rate_limiter) m_group_rate_limiter->OnRecv(read_len);
+
+    OnRecv(buffer_begin, read_len);
+
+    return FASTERR_NOTHING;
+}
+
+size_t Connection::Send(const char* buf, size_t len)
+{
+    if (m_tls != nullptr)
+        return TlsSend(buf, len);
+
+    int remain = len;
+    while (remain > 0) {
+        const char* data = buf + (len - remain);
+        int n = m_pass_fd ? SendWithPendingFds(data, remain) : ::send(GetSocket(), data, remain, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EPIPE) {
+                Close();
+                return -1;
+            }
+            /* 非阻塞socket发送缓冲区已满，剩余数据等待下一次可写事件 */
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                m_writable = false;
+            break;
+        }
+        remain -= n;
+    }
+
+    return (len - remain);
+}
+
+ErrOpt Connection::AsyncSend(const char* buf, size_t len)
+{
+    /* 设置了默认截止时间时按消息跟踪 */
+    if (m_send_deadline_ms > 0 && !m_pass_fd)
+        return AsyncSend(buf, len, SendOptions{});
+
+    return AppendAndSend(buf, len);
+}
+
+ErrOpt Connection::AppendAndSend(const char* buf, size_t len)
+{
+    /**
+     *  此函数大概率是跨线程发送的，因此内部保证线程安全
+     *  异步发送数据时有下列情况：
+     *  （1）当有正在发送中的数据，则将数据追加到输出缓存中
+     *  （2）当没有发送中的数据，则触发一次发送数据
+     * 
+     *  同时在发送事件完成后，会检测output buffer中是否有
+     *  待发送数据，如果有，则继续上述循环直到buffer为空.
+     */
+    if (!IsConnected()) {
+        return FASTERR_ERROR("send error! connection is disconnect! sockfd=" + std::to_string(GetSocket()) +  " status=" + std::to_string(IsConnected() ? 1 : 0));
+    }
+
+    /**
+     *  后续调用不可以注册发送事件，只能追写output buffer，除非
+     *  上一个发送事件已经结束
+     */
+    if (m_rate_limiter) m_rate_limiter->OnSendMessage();
+    if (m_group_rate_limiter) m_group_rate_limiter->OnSendMessage();
+
+    bool not_free = true;
+    int append_len = AppendOutputBuffer(buf, len);
+    if (append_len < 0)
+        return Errcode{"send rejected! memory budget exceeded! used=" + std::to_string(GetMemoryUsage()), ERRTYPE_MEMORY_BUDGET_EXCEEDED};
+
+    if (m_corked.load() > 0 || !m_output_buffer_is_free.compare_exchange_strong(not_free, false)) {
+        return (append_len != len) ? FASTERR_ERROR("output buffer failed! remain=" + std::to_string(len - append_len)) : FASTERR_NOTHING;
+    }
+
+    /* 如果此时没有进行中的发送事件，则注册一个新的发送事件 */
+    return StartSend();
+}
+
+ErrOpt Connection::AsyncSend(const char* buf, size_t len, SendPriority priority)
+{
+    SendOptions opts;
+    opts.priority = priority;
+    return AsyncSend(buf, len, opts);
+}
+
+ErrOpt Connection::AsyncSend(const char* buf, size_t len, const SendOptions& opts)
+{
+    int deadline_ms = (opts.deadline_ms < 0) ? m_send_deadline_ms : opts.deadline_ms;
+    /* 不需要跟踪的普通消息直接追加到输出缓存 */
+    if (opts.priority == emSEND_PRIORITY_NORMAL && deadline_ms == 0 && opts.on_complete == nullptr)
+        return AppendAndSend(buf, len);
+
+    if (opts.priority < emSEND_PRIORITY_HIGH || opts.priority >= emSEND_PRIORITY_COUNT)
+        return FASTERR_ERROR("send error! unknown priority=" + std::to_string(opts.priority));
+
+    if (!IsConnected())
+        return FASTERR_ERROR("send error! connection is disconnect! sockfd=" + std::to_string(GetSocket()));
+
+    if (m_pass_fd)
+        return FASTERR_ERROR("priority or tracked send is not supported with fd passing!");
+
+    if (m_rate_limiter) m_rate_limiter->OnSendMessage();
+    if (m_group_rate_limiter) m_group_rate_limiter->OnSendMessage();
+
+    {
+        std::lock_guard<bbt::core::thread::Mutex> lock(m_output_mutex);
+        if (IsClosed())
+            return FASTERR_ERROR("send error! connection is closed!");
+
+        if (!ChargeMemory(len, true))
+            return Errcode{"send rejected! memory budget exceeded! used=" + std::to_string(GetMemoryUsage()), ERRTYPE_MEMORY_BUDGET_EXCEEDED};
+
+        if (m_lanes == nullptr)
+            m_lanes = std::make_unique<OutputLanes>();
+
+        /* 普通优先级和AppendOutputBuffer一样，排在之前的合并消息之后 */
+        if (opts.priority == emSEND_PRIORITY_NORMAL)
+            MergeConflated();
+
+        OutputFrame frame;
+        frame.data.assign(buf, len);
+        frame.deadline = (deadline_ms > 0) ? Clock::now() + std::chrono::milliseconds(deadline_ms) : Clock::time_point::max();
+        frame.on_complete = opts.on_complete;
+        auto deadline = frame.deadline;
+        m_lanes->frames[opts.priority].emplace_back(std::move(frame));
+        m_lanes->bytes[opts.priority] += len;
+        if (deadline_ms > 0)
+            ArmExpire(deadline);
+    }
+
+    bool not_free = true;
+    if (m_corked.load() > 0 || !m_output_buffer_is_free.compare_exchange_strong(not_free, false))
+        return FASTERR_NOTHING;
+
+    return StartSend();
+}
+
+void Connection::SetOpt_SendDeadline(int deadline_ms)
+{
+    m_send_deadline_ms = std::max(deadline_ms, 0);
+}
+
+void Connection::SetOpt_SendTimeout(int timeout_ms)
+{
+    m_send_timeout_ms = (timeout_ms > 0) ? timeout_ms : SEND_DATA_TIMEOUT_MS;
+}
+
+void Connection::OnOutputConsumed(size_t len, ErrOpt err)
+{
+    ReleaseMemory(len);
+
+    std::vector<SendCompletion> done;
+    {
+        std::lock_guard<bbt::core::thread::Mutex> lock(m_output_mutex);
+        m_consumed_total += len;
+        while (m_lanes != nullptr && !m_lanes->inflight.empty() && m_lanes->inflight.front().first <= m_consumed_total) {
+            done.emplace_back(std::move(m_lanes->inflight.front().second));
+            m_lanes->inflight.pop_front();
+        }
+    }
+
+    for (auto& cb : done)
+        cb(err);
+}
+
+void Connection::ScheduleCompletions()
+{
+    auto thread = GetBindThread();
+    if (thread == nullptr)
+        return;
+
+    /* 持有m_output_mutex，不会并发创建 */
+    if (m_completion_event == nullptr) {
+        m_completion_event = thread->RegisterEvent(-1, EventOpt::TIMEOUT,
+        [weak_this{weak_from_this()}](int, short, EventId){
+            if (auto pthis = weak_this.lock(); pthis != nullptr)
+                pthis->FireCompletions();
+        });
+    }
+
+    m_completion_event->StartListen(0);
+}
+
+void Connection::FireCompletions()
+{
+    std::vector<std::pair<SendCompletion, ErrOpt>> ready;
+    {
+        std::lock_guard<bbt::core::thread::Mutex> lock(m_output_mutex);
+        ready.swap(m_ready_completions);
+    }
+
+    for (auto& [cb, err] : ready)
+        cb(err);
+}
+
+void Connection::AbortCompletions()
+{
+    std::vector<SendCompletion> aborted;
+    std::vector<std::pair<SendCompletion, ErrOpt>> ready;
+    {
+        std::lock_guard<bbt::core::thread::Mutex> lock(m_output_mutex);
+        ready.swap(m_ready_completions);
+        if (m_lanes != nullptr) {
+            for (auto& [offset, cb] : m_lanes->inflight)
+                aborted.emplace_back(std::move(cb));
+            m_lanes->inflight.clear();
+
+            /* 内存已经随连接关闭一起归还 */
+            for (int i = 0; i < emSEND_PRIORITY_COUNT; ++i) {
+                for (auto& frame : m_lanes->frames[i])
+                    if (frame.on_complete)
+                        aborted.emplace_back(std::move(frame.on_complete));
+                m_lanes->frames[i].clear();
+                m_lanes->bytes[i] = 0;
+            }
+        }
+    }
+
+    for (auto& [cb, err] : ready)
+        cb(err);
+    for (auto& cb : aborted)
+        cb(Errcode{"send aborted! connection is closed!", ERRTYPE_SEND_CONN_CLOSED});
+}
+
+OutputQueueStats Connection::GetOutputQueueStats()
+{
+    std::lock_guard<bbt::core::thread::Mutex> lock(m_output_mutex);
+    OutputQueueStats stats = m_lanes ? m_lanes->stats : OutputQueueStats{};
+    if (m_lanes != nullptr) {
+        for (int i = 0; i < emSEND_PRIORITY_COUNT; ++i) {
+            stats.queued_frames[i] = m_lanes->frames[i].size();
+            stats.queued_bytes[i] = m_lanes->bytes[i];
+        }
+    }
+    stats.queued_frames[emSEND_PRIORITY_NORMAL] += m_normal_frames + m_conflated.size();
+    stats.queued_bytes[emSEND_PRIORITY_NORMAL] += (m_output_buffer ? m_output_buffer->Size() : 0) + m_conflated_bytes;
+
+    return stats;
+}
+
+void Connection::SetOpt_WriteCoalescing(bool enable)
+{
+    m_write_coalescing = enable;
+}
+
+void Connection::Cork()
+{
+    ++m_corked;
+}
+
+void Connection::Uncork()
+{
+    if (--m_corked > 0 || !IsConnected())
+        return;
+
+    {
+        std::lock_guard<bbt::core::thread::Mutex> lock(m_output_mutex);
+        if (OutputBufferSize() <= 0)
+            return;
+    }
+
+    bool not_free = true;
+    if (!m_output_buffer_is_free.compare_exchange_strong(not_free, false))
+        return;
+
+    if (auto err = StartSend(); err.has_value())
+        OnError(err.value());
+}
+
+ErrOpt Connection::StartSend()
+{
+    /* io_uring和共享内存有自己的发送路径 */
+    if (!m_write_coalescing || m_uring != nullptr || m_shm_ring_size > 0)
+        return RegistASendEvent();
+
+    auto thread = GetBindThread();
+    if (thread == nullptr)
+        return FASTERR_ERROR("bind thread is nullptr!");
+
+    /* 持有发送权的只有一个线程，这里不会并发创建 */
+    if (m_flush_event == nullptr) {
+        m_flush_event = thread->RegisterEvent(-1, EventOpt::TIMEOUT,
+        [weak_this{weak_from_this()}](int, short, EventId){
+            if (auto pthis = weak_this.lock(); pthis != nullptr)
+                pthis->FlushOutput();
+        });
+    }
+
+    m_flush_event->StartListen(0);
+    return FASTERR_NOTHING;
+}
+
+void Connection::FlushOutput()
+{
+    if (IsClosed()) {
+        m_output_buffer_is_free.exchange(true);
+        return;
+    }
+
+    /* 需要按字节跟踪或者限流的路径，以及socket已经写满时，交给可写事件 */
+    if (m_pass_fd || m_rate_limiter || m_group_rate_limiter || !m_writable || (m_tls && !m_tls->IsEstablished())) {
+        if (auto err = RegistASendEvent(); err.has_value())
+            OnError(err.value());
+        return;
+    }
+
+    bbt::core::Buffer output;
+    {
+        std::lock_guard<bbt::core::thread::Mutex> lock(m_output_mutex);
+        SwapOutputBuffer(output);
+    }
+
+    int size = Send(output.Peek(), output.Size());
+    if (size < 0)
+        return;
+
+    OnOutputConsumed(size, std::nullopt);
+    OnSend(FASTERR_NOTHING, size);
+
+    /* 写不完的部分放回输出缓存头部，等待可写事件 */
+    if ((size_t)size < output.Size() && !IsClosed()) {
+        {
+            std::lock_guard<bbt::core::thread::Mutex> lock(m_output_mutex);
+            bbt::core::Buffer remain{output.Peek() + size, output.Size() - size};
+            m_output_pinned = remain.Size();
+            if (m_output_buffer != nullptr)
+                remain.WriteString(m_output_buffer->Peek(), m_output_buffer->Size());
+            else
+                m_output_buffer = BufferPool::Acquire();
+            m_output_buffer->Swap(remain);
+        }
+
+        if (auto err = RegistASendEvent(); err.has_value())
+            OnError(err.value());
+        return;
+    }
+
+    ReleaseOutput();
+}
+
+void Connection::ReleaseOutput()
+{
+    /* 在锁内释放标志位，保证AsyncSend追加的数据一定会被发送 */
+    {
+        std::lock_guard<bbt::core::thread::Mutex> lock(m_output_mutex);
+        if (IsClosed() || m_corked.load() > 0 || OutputBufferSize() <= 0) {
+            m_output_buffer_is_free.exchange(true);
+            return;
+        }
+    }
+
+    /* 回调中又追加了数据，保留发送权到下一轮继续发送 */
+    if (auto err = StartSend(); err.has_value())
+        OnError(err.value());
+}
+
+int Connection::AppendOutputBuffer(const char* data, size_t len, std::vector<int>* fds)
+{
+    std::lock_guard<bbt::core::thread::Mutex> lock(m_output_mutex);
+    /* 关闭后追加的数据不会再发送，也不再记账 */
+    if (m_memory_budget && !IsClosed() && !ChargeMemory(len, true))
+        return -1;
+
+    /* fd附着在本次追加的第一个字节上 */
+    if (fds != nullptr && !fds->empty()) {
+        if (m_pending_fds == nullptr)
+            m_pending_fds = std::make_unique<std::deque<std::pair<uint64_t, std::vector<int>>>>();
+        m_pending_fds->emplace_back(m_output_total, std::move(*fds));
+    }
+
+    /* 之前的合并消息先于本次数据写出，此后不再参与合并 */
+    MergeConflated();
+
+    /* 普通优先级队列中还有消息时排在后面，保持发送顺序 */
+    if (m_lanes != nullptr && !m_lanes->frames[emSEND_PRIORITY_NORMAL].empty()) {
+        OutputFrame frame;
+        frame.data.assign(data, len);
+        frame.deadline = Clock::time_point::max();
+        m_lanes->frames[emSEND_PRIORITY_NORMAL].emplace_back(std::move(frame));
+        m_lanes->bytes[emSEND_PRIORITY_NORMAL] += len;
+        return len;
+    }
+
+    if (m_output_buffer == nullptr)
+        m_output_buffer = BufferPool::Acquire();
+
+    auto before_size = m_output_buffer->Size();
+    m_output_buffer->WriteString(data, len);
+    auto after_size = m_output_buffer->Size();
+    ++m_normal_frames;
+
+    int change_num = after_size - before_size;
+    if (change_num > 0)
+        m_output_total += change_num;
+
+    return change_num > 0 ? change_num : 0;
+}
+
+size_t Connection::OutputBufferSize() const
+{
+    size_t size = (m_output_buffer ? m_output_buffer->Size() : 0) + m_conflated_bytes;
+    if (m_lanes != nullptr)
+        for (int i = 0; i < emSEND_PRIORITY_COUNT; ++i)
+            size += m_lanes->bytes[i];
+
+    return size;
+}
+
+std::shared_ptr<bbt::core::Buffer> Connection::TakeOutputBuffer()
+{
+    ComposeOutput();
+    auto buffer = m_output_buffer ? std::move(m_output_buffer) : BufferPool::Acquire();
+    return BufferPool::Share(std::move(buffer));
+}
+
+void Connection::SwapOutputBuffer(bbt::core::Buffer& out)
+{
+    ComposeOutput();
+    if (m_output_buffer == nullptr)
+        return;
+
+    out.Swap(*m_output_buffer);
+    BufferPool::Release(std::move(m_output_buffer));
+}
+
+void Connection::MergeConflated()
+{
+    if (m_conflated.empty())
+        return;
+
+    /* 已经记过账，这里只是换个位置，写出时再归还。普通优先级队列中还有消息时排在后面 */
+    if (m_lanes != nullptr && !m_lanes->frames[emSEND_PRIORITY_NORMAL].empty()) {
+        for (auto& [key, data] : m_conflated) {
+            OutputFrame frame;
+            frame.data = std::move(data);
+            frame.deadline = Clock::time_point::max();
+            m_lanes->frames[emSEND_PRIORITY_NORMAL].emplace_back(std::move(frame));
+        }
+        m_lanes->bytes[emSEND_PRIORITY_NORMAL] += m_conflated_bytes;
+    } else {
+        if (m_output_buffer == nullptr)
+            m_output_buffer = BufferPool::Acquire();
+
+        for (auto& [key, data] : m_conflated)
+            m_output_buffer->WriteString(data.data(), data.size());
+
+        m_output_total += m_conflated_bytes;
+        m_normal_frames += m_conflated.size();
+    }
+
+    m_conflated.clear();
+    m_conflated_index.clear();
+    m_conflated_bytes = 0;
+}
+
+void Connection::ComposeOutput()
+{
+    MergeConflated();
+    if (m_lanes != nullptr)
+        m_lanes->stats.sent_frames[emSEND_PRIORITY_NORMAL] += m_normal_frames;
+    m_normal_frames = 0;
+    size_t pinned = m_output_pinned;
+    m_output_pinned = 0;
+    /* 已经写出一部分的数据在上一次取出时计过数 */
+    uint64_t base = m_taken_total - pinned;
+
+    if (m_lanes == nullptr || (m_lanes->frames[emSEND_PRIORITY_HIGH].empty() &&
+        m_lanes->frames[emSEND_PRIORITY_NORMAL].empty() && m_lanes->frames[emSEND_PRIORITY_BULK].empty())) {
+        if (m_output_buffer != nullptr)
+            m_taken_total = base + m_output_buffer->Size();
+        return;
+    }
+
+    auto& frames = m_lanes->frames;
+    auto now = Clock::now();
+    size_t normal_size = m_output_buffer ? m_output_buffer->Size() : 0;
+    size_t taken = normal_size;
+
+    /* 高优先级消息插到已经写出一部分的数据之后、其他普通数据之前 */
+    if (!frames[emSEND_PRIORITY_HIGH].empty()) {
+        auto buffer = BufferPool::Acquire();
+        if (pinned > 0)
+            buffer->WriteString(m_output_buffer->Peek(), pinned);
+
+        taken += PopFrames(emSEND_PRIORITY_HIGH, *buffer, base, SIZE_MAX, now);
+
+        if (normal_size > pinned)
+            buffer->WriteString(m_output_buffer->Peek() + pinned, normal_size - pinned);
+        BufferPool::Release(std::move(m_output_buffer));
+        m_output_buffer = std::move(buffer);
+    } else if (m_output_buffer == nullptr) {
+        m_output_buffer = BufferPool::Acquire();
+    }
+
+    taken += PopFrames(emSEND_PRIORITY_NORMAL, *m_output_buffer, base, SIZE_MAX, now);
+
+    /* 低优先级按块带上，被挤掉太多次时至少带一条 */
+    const size_t chunk = SEND_BULK_CHUNK_SIZE;
+    if (!frames[emSEND_PRIORITY_BULK].empty() &&
+        (taken < chunk || ++m_lanes->bulk_skipped >= SEND_BULK_STARVATION_ROUNDS)) {
+        if (taken >= chunk)
+            ++m_lanes->stats.starvation_breaks;
+        m_lanes->bulk_skipped = 0;
+        PopFrames(emSEND_PRIORITY_BULK, *m_output_buffer, base, (taken < chunk) ? chunk - taken : 1, now);
+    }
+
+    m_taken_total = base + m_output_buffer->Size();
+    if (!m_ready_completions.empty())
+        ScheduleCompletions();
+}
+
+size_t Connection::PopFrames(int lane, bbt::core::Buffer& out, uint64_t base, size_t limit, Clock::time_point now)
+{
+    auto& frames = m_lanes->frames[lane];
+    auto& stats = m_lanes->stats;
+    size_t taken = 0;
+
+    /* 过期的消息直接丢弃，不占用本次的额度 */
+    while (!frames.empty() && taken < limit) {
+        auto& frame = frames.front();
+        size_t len = frame.data.size();
+        if (frame.deadline <= now) {
+            ExpireFrame(lane, frame);
+        } else {
+            m_lanes->bytes[lane] -= len;
+            out.WriteString(frame.data.data(), len);
+            taken += len;
+            ++stats.sent_frames[lane];
+            /* 消息结尾在字节流中的位置，写出的字节数越过这里时完成 */
+            if (frame.on_complete)
+                m_lanes->inflight.emplace_back(base + out.Size(), std::move(frame.on_complete));
+        }
+        frames.pop_front();
+    }
+
+    return taken;
+}
+
+void Connection::ExpireFrame(int lane, OutputFrame& frame)
+{
+    size_t len = frame.data.size();
+    m_lanes->bytes[lane] -= len;
+    ++m_lanes->stats.expired;
+    ReleaseMemory(len);
+    if (frame.on_complete)
+        m_ready_completions.emplace_back(std::move(frame.on_complete),
+            Errcode{"send expired! deadline exceeded before write", ERRTYPE_SEND_EXPIRED});
+}
+
+void Connection::ArmExpire(Clock::time_point deadline)
+{
+    if (deadline >= m_armed_expire)
+        return;
+
+    auto thread = GetBindThread();
+    if (thread == nullptr)
+        return;
+
+    if (m_expire_event == nullptr) {
+        m_expire_event = thread->RegisterEvent(-1, EventOpt::TIMEOUT,
+        [weak_this{weak_from_this()}](int, short, EventId){
+            if (auto pthis = weak_this.lock(); pthis != nullptr)
+                pthis->OnExpire();
+        });
+    }
+
+    m_armed_expire = deadline;
+    auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+    /* 向上取整，避免提前触发后空转一次 */
+    m_expire_event->StartListen(std::max<int64_t>(wait + 1, 1));
+}
+
+void Connection::RearmExpire()
+{
+    if (m_lanes == nullptr)
+        return;
+
+    /* 不同消息的截止时间不一定随入队顺序递增，需要扫描所有队列 */
+    auto next = Clock::time_point::max();
+    for (int i = 0; i < emSEND_PRIORITY_COUNT; ++i)
+        for (auto& frame : m_lanes->frames[i])
+            next = std::min(next, frame.deadline);
+
+    if (next != Clock::time_point::max())
+        ArmExpire(next);
+}
+
+void Connection::OnExpire()
+{
+    {
+        std::lock_guard<bbt::core::thread::Mutex> lock(m_output_mutex);
+        m_armed_expire = Clock::time_point::max();
+        if (IsClosed() || m_lanes == nullptr)
+            return;
+
+        /* 写不出去时过期的消息也按时丢弃，不必等到下一次取出或发送超时 */
+        auto now = Clock::now();
+        for (int i = 0; i < emSEND_PRIORITY_COUNT; ++i) {
+            auto& frames = m_lanes->frames[i];
+            for (auto it = frames.begin(); it != frames.end();) {
+                if (it->deadline <= now) {
+                    ExpireFrame(i, *it);
+                    it = frames.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+
+        RearmExpire();
+    }
+
+    FireCompletions();
+}
+
+ErrOpt Connection::AsyncSendConflated(uint64_t key, const char* buf, size_t len)
+{
+    if (!IsConnected())
+        return FASTERR_ERROR("send error! connection is disconnect! sockfd=" + std::to_string(GetSocket()));
+
+    if (m_pass_fd)
+        return FASTERR_ERROR("conflated send is not supported with fd passing!");
+
+    if (m_rate_limiter) m_rate_limiter->OnSendMessage();
+    if (m_group_rate_limiter) m_group_rate_limiter->OnSendMessage();
+
+    {
+        std::lock_guard<bbt::core::thread::Mutex> lock(m_output_mutex);
+        if (IsClosed())
+            return FASTERR_ERROR("send error! connection is closed!");
+
+        auto it = m_conflated_index.find(key);
+        size_t old_len = (it != m_conflated_index.end()) ? m_conflated[it->second].second.size() : 0;
+        /* 替换时只按增量记账，变小的部分直接归还 */
+        if (len > old_len && !ChargeMemory(len - old_len, true))
+            return Errcode{"send rejected! memory budget exceeded! used=" + std::to_string(GetMemoryUsage()), ERRTYPE_MEMORY_BUDGET_EXCEEDED};
+        if (len < old_len)
+            ReleaseMemory(old_len - len);
+
+        if (it != m_conflated_index.end()) {
+            m_conflated[it->second].second.assign(buf, len);
+            ++m_conflated_dropped;
+        } else {
+            m_conflated_index.emplace(key, m_conflated.size());
+            m_conflated.emplace_back(key, std::string(buf, len));
+        }
+        m_conflated_bytes = m_conflated_bytes + len - old_len;
+    }
+
+    bool not_free = true;
+    if (m_corked.load() > 0 || !m_output_buffer_is_free.compare_exchange_strong(not_free, false))
+        return FASTERR_NOTHING;
+
+    return StartSend();
+}
+
+uint64_t Connection::GetConflatedDropped() const
+{
+    return m_conflated_dropped.load();
+}
+
+void Connection::SetOpt_PassFd(bool enable)
+{
+    m_pass_fd = enable;
+}
+
+ErrOpt Connection::AsyncSendWithFds(const char* buf, size_t len, const std::vector<int>& fds)
+{
+    if (!m_pass_fd)
+        return FASTERR_ERROR("fd passing is not enabled! only unix socket supports it!");
+
+    /* 数据走共享内存而fd走socket，无法保证两者的顺序 */
+    if (m_shm_ring_size > 0)
+        return FASTERR_ERROR("fd passing is not supported by shared memory transport!");
+
+    if (len == 0)
+        return FASTERR_ERROR("fds must be attached to at least one byte!");
+
+    if (!IsConnected())
+        return FASTERR_ERROR("send error! connection is disconnect! sockfd=" + std::to_string(GetSocket()));
+
+    std::vector<int> dup_fds;
+    for (int fd : fds) {
+        int dup_fd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+        if (dup_fd < 0) {
+            for (int f : dup_fds) ::close(f);
+            return FASTERR_ERROR("dup fd failed! fd=" + std::to_string(fd) + " " + std::string{strerror(errno)});
+        }
+        dup_fds.push_back(dup_fd);
+    }
+
+    if (m_rate_limiter) m_rate_limiter->OnSendMessage();
+    if (m_group_rate_limiter) m_group_rate_limiter->OnSendMessage();
+
+    bool not_free = true;
+    int append_len = AppendOutputBuffer(buf, len, &dup_fds);
+    if (append_len < 0) {
+        for (int fd : dup_fds) ::close(fd);
+        return Errcode{"send rejected! memory budget exceeded! used=" + std::to_string(GetMemoryUsage()), ERRTYPE_MEMORY_BUDGET_EXCEEDED};
+    }
+
+    if (!m_output_buffer_is_free.compare_exchange_strong(not_free, false)) {
+        return (append_len != len) ? FASTERR_ERROR("output buffer failed! remain=" + std::to_string(len - append_len)) : FASTERR_NOTHING;
+    }
+
+    return RegistASendEvent();
+}
+
+std::vector<int> Connection::TakeRecvFds()
+{
+    std::lock_guard<std::mutex> _(m_recv_fds_mutex);
+    std::vector<int> fds;
+    fds.swap(m_recv_fds);
+    return fds;
+}
+
+ssize_t Connection::SendWithPendingFds(const char* data, size_t len)
+{
+    /* 发送到待发送fd的偏移前截断，到达偏移时把fd附着在这次发送上 */
+    std::vector<int> fds;
+    {
+        std::lock_guard<bbt::core::thread::Mutex> lock(m_output_mutex);
+        if (m_pending_fds != nullptr && !m_pending_fds->empty()) {
+            auto& front = m_pending_fds->front();
+            if (front.first > m_sent_total) {
+                len = std::min<uint64_t>(len, front.first - m_sent_total);
+            } else {
+                fds.swap(front.second);
+                m_pending_fds->pop_front();
+                /* 一次sendmsg只附带一组fd，在下一组的偏移前截断，避免接收方把两组fd合并到同一次读取中 */
+                if (!m_pending_fds->empty())
+                    len = std::min<uint64_t>(len, m_pending_fds->front().first - m_sent_total);
+            }
+        }
+    }
+
+    ssize_t n = SendWithFds(GetSocket(), data, len, fds);
+    if (n > 0)
+        m_sent_total += n;
+
+    if (fds.empty())
+        return n;
+
+    /* 发送成功后内核持有fd的引用，关闭dup出来的fd；失败则放回队首 */
+    if (n > 0) {
+        for (int fd : fds) ::close(fd);
+    } else {
+        std::lock_guard<bbt::core::thread::Mutex> lock(m_output_mutex);
+        m_pending_fds->emplace_front(m_sent_total, std::move(fds));
+    }
+
+    return n;
+}
+
+void Connection::DropOutput(size_t len)
+{
+    if (!m_pass_fd)
+        return;
+
+    /* 附着在被丢弃数据上的fd也一起丢弃 */
+    m_sent_total += len;
+    std::lock_guard<bbt::core::thread::Mutex> lock(m_output_mutex);
+    while (m_pending_fds != nullptr && !m_pending_fds->empty() && m_pending_fds->front().first < m_sent_total) {
+        for (int fd : m_pending_fds->front().second) ::close(fd);
+        m_pending_fds->pop_front();
+    }
+}
+
+void Connection::ClosePassedFds()
+{
+    {
+        std::lock_guard<bbt::core::thread::Mutex> lock(m_output_mutex);
+        if (m_pending_fds != nullptr) {
+            for (auto& [offset, fds] : *m_pending_fds)
+                for (int fd : fds) ::close(fd);
+            m_pending_fds.reset();
+        }
+    }
+
+    for (int fd : TakeRecvFds())
+        ::close(fd);
+}
+
+void Connection::SetOpt_SharedMemory(size_t ring_size, bool initiator)
+{
+    m_shm_ring_size = ring_size;
+    m_shm_initiator = initiator;
+}
+
+bool Connection::IsSharedMemory() const
+{
+    return m_shm != nullptr;
+}
+
+ErrOpt Connection::AcceptShm(evutil_socket_t sockfd)
+{
+    char hello[64];
+    std::vector<int> fds;
+
+    /* 只读握手消息的长度，发起方握手后不会再往socket写数据 */
+    ssize_t n = RecvWithFds(sockfd, hello, ShmChannel::HelloSize(), fds);
+    if (n < 0) {
+        for (int fd : fds) ::close(fd);
+        if (errno == EINTR || errno == EAGAIN)
+            return std::make_optional<Errcode>("please try again!", ERRTYPE_NETWORK_RECV_TRY_AGAIN);
+        return std::make_optional<Errcode>("recv shm hello failed! errno=" + std::to_string(errno), ERRTYPE_NETWORK_RECV_OTHER_ERR);
+    } else if (n == 0) {
+        for (int fd : fds) ::close(fd);
+        return std::make_optional<Errcode>("peer connect closed!", ERRTYPE_NETWORK_RECV_EOF);
+    }
+
+    std::shared_ptr<ShmChannel> channel = nullptr;
+    if (auto err = ShmChannel::Accept(hello, n, fds, channel); err.has_value()) {
+        OnError(err.value());
+        Close();
+        return FASTERR_NOTHING;
+    }
+
+    AttachShm(channel);
+    return FASTERR_NOTHING;
+}
+
+void Connection::AttachShm(std::shared_ptr<ShmChannel> channel)
+{
+    auto thread = GetBindThread();
+    if (thread == nullptr)
+        return;
+
+    m_shm = channel;
+    m_shm_event = thread->RegisterEvent(channel->GetNotifyFd(), EventOpt::READABLE | EventOpt::PERSIST,
+    [weak_this{weak_from_this()}](int, short, EventId){
+        if (auto pthis = weak_this.lock(); pthis != nullptr)
+            pthis->OnShmEvent();
+    });
+
+    Assert(m_shm_event->StartListen(0) == 0);
+
+    /* 对端可能已经写入了数据，握手前追加的数据也需要继续发送。通过门铃
+    触发而不是直接调用，保证回调在连接所在的线程中执行 */
+    channel->NotifySelf();
+}
+
+void Connection::OnShmEvent()
+{
+    if (IsClosed() || m_shm == nullptr)
+        return;
+
+    m_shm->DrainNotify();
+
+    /* 数据不经过socket，需要手动重置空闲超时。暂停读取期间不重新注册读事件 */
+    if (m_event && !m_recv_paused)
+        m_event->StartListen(m_timeout_ms);
+
+    /* 和socket读取一样受限流、内存预算和线程池背压约束，暂停期间数据留在环中 */
+    if (!m_recv_paused) {
+        size_t quota = HasRecvGate() ? RecvQuota(m_shm->GetRingSize()) : m_shm->GetRingSize();
+        if (quota > 0)
+            ShmRecv(quota);
+        else
+            PauseRecv();
+    }
+
+    if (!IsClosed() && m_shm_pending != nullptr)
+        OnShmSend(m_shm_pending);
+}
+
+void Connection::ShmRecv(size_t limit)
+{
+    auto shm = m_shm;
+
+    /* 数据直接从共享内存交给上层，单次最多读一个环的大小，避免饿死其他连接 */
+    size_t read_len = shm->Read(std::min(limit, shm->GetRingSize()), [this](const char* data, size_t len){
+        if (!IsClosed())
+            OnRecv(data, len);
+    });
+
+    if (m_rate_limiter) m_rate_limiter->OnRecv(read_len);
+    if (m_group_rate_limiter) m_group_rate_limiter->OnRecv(read_len);
+
+    /* 还有数据时敲自己的门铃，在下一轮事件循环继续读 */
+    if (!IsClosed() && !shm->WaitForData())
+        shm->NotifySelf();
+}
+
+void Connection::OnShmSend(std::shared_ptr<bbt::core::Buffer> output_buffer)
+{
+    m_shm_pending = nullptr;
+    if (IsClosed())
+        return;
+
+    while (true) {
+        /* 握手未完成时先保留数据，AttachShm后继续发送 */
+        size_t size = (m_shm != nullptr) ? m_shm->Write(output_buffer->Peek(), output_buffer->Size()) : 0;
+        if (size > 0) {
+            if (size < output_buffer->Size()) {
+                bbt::core::Buffer remain{output_buffer->Peek() + size, output_buffer->Size() - size};
+                output_buffer->Swap(remain);
+            } else {
+                output_buffer->Clear();
+            }
+
+            OnOutputConsumed(size, std::nullopt);
+            OnSend(FASTERR_NOTHING, size);
+            if (IsClosed())
+                return;
+        }
+
+        /* 发送环已满，等对端腾出空间后通过门铃唤醒 */
+        if (output_buffer->Size() > 0) {
+            m_shm_pending = output_buffer;
+            if (m_shm != nullptr && !m_shm->WaitForSpace())
+                m_shm->NotifySelf();
+            return;
+        }
+
+        std::lock_guard<bbt::core::thread::Mutex> lock(m_output_mutex);
+        if (OutputBufferSize() <= 0) {
+            m_send_event = nullptr;
+            m_output_buffer_is_free.exchange(true); // 允许注册发送事件
+            return;
+        }
+
+        SwapOutputBuffer(*output_buffer);
+    }
+}
+
+void Connection::SetOpt_Tls(std::shared_ptr<TlsContext> ctx)
+{
+    m_tls_ctx = ctx;
+}
+
+bool Connection::IsTlsEstablished() const
+{
+    return m_tls != nullptr && m_tls->IsEstablished();
+}
+
+void Connection::WaitTlsWritable()
+{
+    auto thread = GetBindThread();
+    if (thread == nullptr)
+        return;
+
+    m_tls_event = thread->RegisterEvent(GetSocket(), EventOpt::WRITEABLE,
+    [weak_this{weak_from_this()}](int, short, EventId){
+        if (auto pthis = weak_this.lock(); pthis != nullptr)
+            pthis->TlsHandshake();
+    });
+
+    m_tls_event->StartListen(0);
+}
+
+void Connection::TlsHandshake()
+{
+    if (IsClosed() || m_tls == nullptr || m_tls->IsEstablished())
+        return;
+
+    ErrOpt err = std::nullopt;
+    auto status = m_tls->Handshake(err);
+
+    /* 等待对端数据，由m_event的可读事件继续 */
+    if (status == emTLS_WANT_READ)
+        return;
+
+    if (status == emTLS_WANT_WRITE) {
+        WaitTlsWritable();
+        return;
+    }
+
+    if (status != emTLS_OK) {
+        OnError(err.has_value() ? err.value() : Errcode{"tls handshake failed! peer closed!", ERRTYPE_ERROR});
+        Close();
+        return;
+    }
+
+    /* 握手期间追加的数据，发送事件已经暂停，这里恢复 */
+    if (m_send_event)
+        ResumeSend();
+}
+
+ErrOpt Connection::TlsRecv()
+{
+    char    buffer[4096];
+    size_t  buffer_len = sizeof(buffer);
+
+    if (!m_tls->IsEstablished()) {
+        TlsHandshake();
+        if (IsClosed() || !m_tls->IsEstablished())
+            return m_edge_triggered ? std::make_optional<Errcode>("please try again!", ERRTYPE_NETWORK_RECV_TRY_AGAIN) : FASTERR_NOTHING;
+    }
+
+    /* 已经解密的数据不会再触发可读事件，需要一次读完 */
+    do {
+        buffer_len = RecvQuota(sizeof(buffer));
+        if (buffer_len == 0) {
+            PauseRecv();
+            return FASTERR_NOTHING;
+        }
+
+        size_t read_len = 0;
+        ErrOpt err = std::nullopt;
+        auto status = m_tls->Read(buffer, buffer_len, read_len, err);
+        if (status == emTLS_CLOSED)
+            return std::make_optional<Errcode>("peer connect closed!", ERRTYPE_NETWORK_RECV_EOF);
+
+        if (status == emTLS_ERROR) {
+            if (err.has_value()) OnError(err.value());
+            Close();
+            return FASTERR_NOTHING;
+        }
+
+        /* 记录不完整，等待更多密文 */
+        if (status != emTLS_OK)
+            return m_edge_triggered ? std::make_optional<Errcode>("please try again!", ERRTYPE_NETWORK_RECV_TRY_AGAIN) : FASTERR_NOTHING;
+
+        if (m_rate_limiter) m_rate_limiter->OnRecv(read_len);
+        if (m_group_rate_limiter) m_group_rate_limiter->OnRecv(read_len);
+
+        OnRecv(buffer, read_len);
+    } while (!IsClosed() && m_tls->Pending() > 0);
+
+    return FASTERR_NOTHING;
+}
+
+size_t Connection::TlsSend(const char* buf, size_t len)
+{
+    size_t written = 0;
+    ErrOpt err = std::nullopt;
+    auto status = m_tls->Write(buf, len, written, err);
+
+    if (status == emTLS_WANT_WRITE || status == emTLS_WANT_READ) {
+        m_writable = false;
+    } else if (status != emTLS_OK) {
+        if (err.has_value()) OnError(err.value());
+        Close();
+        return -1;
+    }
+
+    return written;
+}
+
+ErrOpt Connection::SendFile(int fd, off_t offset, size_t len, size_t& sent)
+{
+    sent = 0;
+    if (!IsConnected())
+        return FASTERR_ERROR("send error! connection is disconnect!");
+
+    /* 输出缓存中还有数据时直接发送会打乱顺序 */
+    if (!m_output_buffer_is_free.load())
+        return FASTERR_ERROR("send file failed! output buffer is busy!");
+
+    if (m_tls && !m_tls->IsEstablished())
+        return FASTERR_ERROR("send file failed! tls handshake is not finished!");
+
+    ssize_t n = m_tls ? m_tls->SendFile(fd, offset, len) : ::sendfile(GetSocket(), fd, &offset, len);
+    if (n < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+            return FASTERR_NOTHING;
+
+        return FASTERR_ERROR("send file failed! " + std::string{strerror(errno)});
+    }
+
+    sent = n;
+    return FASTERR_NOTHING;
+}
+
+ErrOpt Connection::RegistASendEvent()
+{
+    /**
+     *  此事件只同时存在一个，其作用是每次发送结束后，检测一下
+     *  输出缓存是否会有数据，并做以下行为：
+     *      （1）output buffer 有数据，交换buffer，该事件继续运行；
+     *      （2）output buffer 没有数据，取消此事件，允许下次追加output
+     *          buffer时注册发送事件.
+     */
+    AssertWithInfo(!m_output_buffer_is_free.load(), "output buffer must be false!");
+    AssertWithInfo(!m_send_event , "has a wrong!");
+    /* 直接取走输出缓存，发送完后归还缓冲池 */
+    std::shared_ptr<bbt::core::Buffer> buffer_sptr = nullptr;
+    {
+        std::lock_guard<bbt::core::thread::Mutex> lock(m_output_mutex);
+        buffer_sptr = TakeOutputBuffer();
+    }
+
+    auto weak_this = weak_from_this();
+    if (!BindThreadIsRunning())
+        return FASTERR_ERROR("bind thread is stop!");
+    
+    auto thread = GetBindThread();
+    if (thread == nullptr)
+        return FASTERR_ERROR("bind thread is nullptr!");
+
+    if (m_uring != nullptr)
+        return UringSend(buffer_sptr);
+
+    /* 共享内存模式下在事件循环中写入发送环，不需要等待socket可写 */
+    if (m_shm_ring_size > 0) {
+        m_send_event = thread->RegisterEvent(-1, EventOpt::TIMEOUT,
+        [weak_this, buffer_sptr](int, short, EventId){
+            if (auto pthis = weak_this.lock(); pthis != nullptr)
+                pthis->OnShmSend(buffer_sptr);
+        });
+
+        m_send_event->StartListen(0);
+        return FASTERR_NOTHING;
+    }
 
     m_send_event = thread->RegisterEvent(GetSocket(), EventOpt::WRITEABLE | EventOpt::PERSIST,
     [weak_this, buffer_sptr](int fd, short events, EventId eventid){
@@ -309,7 +2132,7 @@ ErrOpt Connection::RegistASendEvent()
         pthis->OnSendEvent(buffer_sptr, events);
     });
 
-    m_send_event->StartListen(SEND_DATA_TIMEOUT_MS);
+    m_send_event->StartListen(m_send_timeout_ms);
     return FASTERR_NOTHING;
 }
 
@@ -319,28 +2142,174 @@ void Connection::OnSendEvent(std::shared_ptr<bbt::core::Buffer> output_buffer, s
     int size = 0;
 
     if (IsClosed()) return;
+    m_io_events.store(m_io_events.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
     if (events & EventOpt::TIMEOUT) {
         err = std::make_optional<Errcode>("send timeout!", ERRTYPE_SEND_TIMEOUT);
+        DropOutput(output_buffer->Size());
+        OnOutputConsumed(output_buffer->Size(), err);
+        output_buffer->Clear();
     } else if (events & EventOpt::WRITEABLE) {
-        size = Send(output_buffer->Peek(), output_buffer->Size());
+        m_writable = true;
+        /* 限流时只发送令牌允许的部分，剩余部分留在 output_buffer 中等待下次发送 */
+        size_t quota = SendQuota(output_buffer->Size());
+        if (quota == 0 && output_buffer->Size() > 0) {
+            PauseSend();
+            return;
+        }
+
+        size = Send(output_buffer->Peek(), quota);
+        if (size > 0 && m_rate_limiter) m_rate_limiter->OnSend(size);
+        if (size > 0 && m_group_rate_limiter) m_group_rate_limiter->OnSend(size);
+        if (size > 0) OnOutputConsumed(size, std::nullopt);
+
+        /* 未发送完的部分（限流或者发送缓冲区已满）留到下一次可写事件 */
+        if (size >= 0 && (size_t)size < output_buffer->Size()) {
+            if (size > 0) {
+                bbt::core::Buffer remain{output_buffer->Peek() + size, output_buffer->Size() - size};
+                output_buffer->Swap(remain);
+            }
+        } else {
+            output_buffer->Clear();
+        }
     }
 
     OnSend(err, size);
 
-    /* 当连接已经关闭后，也退出事件；
+    /* 当连接已经关闭后，也退出事件；被限流剩余的数据继续发送；
     有待发送数据，交换buffer，继续发送；否则取消监听事件，释放标志位 */
-    if (IsClosed() || m_output_buffer.Size() <= 0) {
+    if (!IsClosed() && output_buffer->Size() > 0)
+        return;
+
+    std::lock_guard<bbt::core::thread::Mutex> lock(m_output_mutex);
+    if (IsClosed() || m_corked.load() > 0 || OutputBufferSize() <= 0) {
         m_send_event->CancelListen();
         m_send_event = nullptr;
         m_output_buffer_is_free.exchange(true); // 允许注册发送事件
     } else {
-        std::lock_guard<bbt::core::thread::Mutex> lock(m_output_mutex);
-        Assert(output_buffer->Size() >= 0);
-        output_buffer->Swap(m_output_buffer);
-        m_output_buffer.Clear();
+        SwapOutputBuffer(*output_buffer);
+    }
+}
+
+
+size_t Connection::RecvQuota(size_t want)
+{
+    if (m_worker_pool && m_worker_pool->Saturated())
+        return 0;
+    if (m_memory_budget && m_memory_budget->GetPolicy() == emMEMORY_POLICY_PAUSE_RECV &&
+        m_memory_budget->Exceeded(m_memory_used.load())) {
+        m_memory_budget->OnRecvThrottled();
+        return 0;
+    }
+    if (m_rate_limiter)
+        want = m_rate_limiter->RecvQuota(want);
+    if (m_group_rate_limiter && want > 0)
+        want = m_group_rate_limiter->RecvQuota(want);
+
+    return want;
+}
+
+size_t Connection::SendQuota(size_t want)
+{
+    /* tls握手完成前不发送应用数据 */
+    if (m_tls && !m_tls->IsEstablished())
+        return 0;
+
+    /* tls未完成的写已经加密进OpenSSL的缓冲区，重试必须带上同样的长度，不受限流约束 */
+    size_t retry = m_tls ? std::min(m_tls->RetryLen(), want) : 0;
+
+    if (m_rate_limiter)
+        want = m_rate_limiter->SendQuota(want);
+    if (m_group_rate_limiter && want > 0)
+        want = m_group_rate_limiter->SendQuota(want);
+
+    return std::max(want, retry);
+}
+
+void Connection::PauseRecv()
+{
+    /**
+     *  取消读事件后数据会积压在内核接收缓冲区，对端的发送窗口
+     *  随之缩小，以此实现背压。令牌恢复后由定时器重新注册读事件
+     */
+    auto thread = GetBindThread();
+    if (thread == nullptr || IsClosed())
+        return;
+
+    if (m_event)
+        m_event->CancelListen();
+    m_recv_paused = true;
+
+    if (m_recv_resume_event == nullptr) {
+        m_recv_resume_event = thread->RegisterEvent(-1, EventOpt::TIMEOUT,
+        [weak_this{weak_from_this()}](int, short, EventId){
+            if (auto pthis = weak_this.lock(); pthis != nullptr)
+                pthis->ResumeRecv();
+        });
+    }
+
+    int wait_ms = 1;
+    if (m_rate_limiter) wait_ms = std::max(wait_ms, m_rate_limiter->RecvWaitMS());
+    if (m_group_rate_limiter) wait_ms = std::max(wait_ms, m_group_rate_limiter->RecvWaitMS());
+    if (m_worker_pool && m_worker_pool->Saturated()) wait_ms = std::max(wait_ms, WORKER_POOL_BACKPRESSURE_RETRY_MS);
+    if (m_memory_budget && m_memory_budget->Exceeded(m_memory_used.load())) wait_ms = std::max(wait_ms, MEMORY_BUDGET_RETRY_MS);
+    m_recv_resume_event->StartListen(wait_ms);
+}
+
+void Connection::ResumeRecv()
+{
+    if (IsClosed() || m_event == nullptr)
+        return;
+
+    if (RecvQuota(1) == 0) {
+        PauseRecv();
+        return;
+    }
+
+    m_event->StartListen(m_timeout_ms);
+    m_recv_paused = false;
+
+    /* 边缘触发下暂停期间到达的数据不会再次通知，需要主动读取 */
+    if (m_edge_triggered && m_readable)
+        RequeueRecv();
+    /* 暂停期间共享内存中积压的数据通过门铃继续读取 */
+    if (m_shm)
+        m_shm->NotifySelf();
+}
+
+void Connection::PauseSend()
+{
+    auto thread = GetBindThread();
+    if (thread == nullptr || IsClosed())
+        return;
+
+    if (m_send_event)
+        m_send_event->CancelListen();
+
+    /* 等待tls握手时由握手完成后恢复，不需要定时重试 */
+    if (m_tls && !m_tls->IsEstablished())
+        return;
+
+    if (m_send_resume_event == nullptr) {
+        m_send_resume_event = thread->RegisterEvent(-1, EventOpt::TIMEOUT,
+        [weak_this{weak_from_this()}](int, short, EventId){
+            if (auto pthis = weak_this.lock(); pthis != nullptr)
+                pthis->ResumeSend();
+        });
     }
+
+    int wait_ms = 1;
+    if (m_rate_limiter) wait_ms = std::max(wait_ms, m_rate_limiter->SendWaitMS());
+    if (m_group_rate_limiter) wait_ms = std::max(wait_ms, m_group_rate_limiter->SendWaitMS());
+    m_send_resume_event->StartListen(wait_ms);
 }
 
+void Connection::ResumeSend()
+{
+    if (IsClosed() || m_send_event == nullptr)
+        return;
+
+    m_send_event->StartListen(m_send_timeout_ms);
+}
 
 ErrOpt Connection::Timeout()
 {
@@ -351,15 +2320,22 @@ ErrOpt Connection::Timeout()
 
 std::shared_ptr<EvThread> Connection::GetBindThread()
 {
-    return m_bind_thread.lock();
+    while (m_bind_lock.test_and_set(std::memory_order_acquire));
+    auto thread = m_bind_thread.lock();
+    m_bind_lock.clear(std::memory_order_release);
+    return thread;
+}
+
+void Connection::SetBindThread(std::shared_ptr<EvThread> thread)
+{
+    while (m_bind_lock.test_and_set(std::memory_order_acquire));
+    m_bind_thread = thread;
+    m_bind_lock.clear(std::memory_order_release);
 }
 
 bool Connection::BindThreadIsRunning()
 {
-    if (m_bind_thread.expired())
-        return false;
-    
-    auto thread = m_bind_thread.lock();
+    auto thread = GetBindThread();
     if (thread == nullptr)
         return false;
     
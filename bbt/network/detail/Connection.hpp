@@ -9,10 +9,14 @@
  * 
  */
 #pragma once
+#include <deque>
+#include <unordered_map>
 #include <bbt/core/buffer/Buffer.hpp>
 #include <bbt/core/thread/Lock.hpp>
 #include <bbt/pollevent/EvThread.hpp>
 #include <bbt/network/detail/Define.hpp>
+#include <bbt/network/detail/RateLimiter.hpp>
+#include <bbt/network/detail/WorkerPool.hpp>
 
 namespace bbt::network::detail
 {
@@ -22,6 +26,7 @@ class Connection:
     boost::noncopyable
 {
     friend class EvThread;
+    friend class MemoryBudget;
 public:
     BBTATTR_FUNC_CTOR_HIDDEN Connection(
         std::weak_ptr<EvThread> thread,
@@ -39,47 +44,282 @@ public:
     );
     /* 设置Connection的回调行为 */
     void                    SetOpt_Callbacks(const ConnCallbacks& callbacks);
+    /* 共享同一份回调，TcpServer、TcpClient下所有连接的回调相同，不需要每个连接拷贝一份 */
+    void                    SetOpt_Callbacks(std::shared_ptr<const ConnCallbacks> callbacks);
+    const ConnCallbacks&    GetCallbacks() const;
+    /* 收到的数据是否经过on_recv_callback交付，StaticConnection和分帧批量交付时不经过 */
+    virtual bool            DeliversRecvCallback() const;
     /* 设置空闲超时关闭Connection的时间 */
     void                    SetOpt_CloseTimeoutMS(int timeout_ms);
+    /* 设置连接级收发限流，需要在连接所在线程或RunInEventLoop前调用 */
+    void                    SetOpt_RateLimit(const RateLimitOptions& opts);
+    /* 设置组级收发限流，多个连接共享同一个限流器 */
+    void                    SetOpt_RateLimitGroup(std::shared_ptr<RateLimiter> group);
+    bool                    HasRateLimit() const;
+    /**
+     * 设置内存预算，统计输出缓存和分帧接收缓冲区的占用，超出后按预算的
+     * 策略暂停读取、拒绝发送或者关闭连接。需要在RunInEventLoop前调用
+     */
+    void                    SetOpt_MemoryBudget(std::shared_ptr<MemoryBudget> budget);
+    /* 当前缓冲区占用的字节数，只在设置了内存预算时统计 */
+    size_t                  GetMemoryUsage() const;
+    /* 设置工作线程池，回调可以通过RunInWorker卸载到线程池中按序执行，线程池饱和时暂停读取 */
+    void                    SetOpt_WorkerPool(std::shared_ptr<WorkerPool> pool);
+    bool                    HasWorkerPool() const;
+    /* 在连接的strand中执行，同一连接的任务按提交顺序执行。未设置线程池或线程池已停止返回false */
+    bool                    RunInWorker(WorkerPool::Task&& task);
+    /* 设置io后端，需要在RunInEventLoop前调用，io_uring不可用时回退到libevent */
+    void                    SetOpt_IOBackend(IOBackend backend);
+    IOBackend               GetIOBackend() const;
+    /**
+     * 设置分帧函数，需要在RunInEventLoop前调用。设置后收到的数据先按帧切分，
+     * 一次可读事件中解析出的所有完整帧通过on_recv_batch_callback一起回调，
+     * 不完整的尾部留到下次。StaticConnection不支持
+     */
+    void                    SetOpt_FrameParser(const FrameParser& parser);
+    void                    SetOpt_FrameParser(std::shared_ptr<const FrameParser> parser);
+    /* 预置接收缓冲中不完整的帧，用于接管其他进程交出的连接。需要先设置分帧，在RunInEventLoop前调用 */
+    core::errcode::ErrOpt   SetOpt_FrameInput(const std::string& input);
+    /* 设置边缘触发模式，需要在RunInEventLoop前调用 */
+    void                    SetOpt_EdgeTriggered(bool enable, int read_budget = EDGE_TRIGGERED_READ_BUDGET);
+    /* 设置自适应忙轮询，需要在RunInEventLoop前调用，同一EvThread上的连接共享空转状态 */
+    void                    SetOpt_BusyPoll(const BusyPollOptions& opts);
+    /* 设置socket选项，会覆盖TcpServer、TcpClient设置的默认选项 */
+    core::errcode::ErrOpt   SetOpt_SocketOptions(const SocketOptions& opts);
+    /* 设置用户上下文，随连接一起释放，回调中直接通过连接获取，不需要额外的ConnId映射 */
+    void                    SetContext(std::shared_ptr<void> context);
+    void*                   GetContextPtr() const;
+    template<class T>
+    T*                      GetContext() const { return static_cast<T*>(m_context.get()); }
     /* 异步发送数据给对端 */
     core::errcode::ErrOpt   AsyncSend(const char* buf, size_t len);
+    /**
+     * 按优先级异步发送，一次调用是一条消息。每次取走输出缓存时，高优先级
+     * 消息排在普通数据之前，低优先级消息最多带上SEND_BULK_CHUNK_SIZE，所以
+     * 高优先级消息最多等待已经在发送中的数据写完。不支持fd传递
+     */
+    core::errcode::ErrOpt   AsyncSend(const char* buf, size_t len, SendPriority priority);
+    /**
+     * 按选项异步发送一条消息，可以设置截止时间和完成回调。截止时间在消息
+     * 被取出写socket时检查，过期的消息直接丢弃，不占用带宽。消息写入
+     * socket、过期或者连接关闭时回调一次
+     */
+    core::errcode::ErrOpt   AsyncSend(const char* buf, size_t len, const SendOptions& opts);
+    OutputQueueStats        GetOutputQueueStats();
+    /* 设置AsyncSend默认的消息截止时间，0表示不过期。设置后普通发送也按消息跟踪 */
+    void                    SetOpt_SendDeadline(int deadline_ms);
+    /* 设置socket持续不可写时丢弃在途数据的时间，默认SEND_DATA_TIMEOUT_MS */
+    void                    SetOpt_SendTimeout(int timeout_ms);
+    /**
+     * 设置写合并，同一轮事件循环中的多次AsyncSend只追加到输出缓存，
+     * 在本轮结束时直接写一次socket，写不完的部分再交给可写事件
+     */
+    void                    SetOpt_WriteCoalescing(bool enable);
+    /**
+     * 暂停发送，之后AsyncSend的数据只追加到输出缓存，直到对应的Uncork
+     * 才一起发出。可以嵌套，线程安全。已经在发送中的数据不受影响
+     */
+    void                    Cork();
+    void                    Uncork();
+    /**
+     * 异步发送可合并的消息，线程安全。同一个key还没有写出的消息会被新
+     * 数据原地替换，慢速对端积压的只是每个key的最新值，积压量以key的
+     * 数量为上限。消息在下一次取走输出缓存或下一次普通优先级的AsyncSend
+     * 时按key首次出现的顺序移入输出，之后不再参与合并。因此先于某次
+     * AsyncSend提交的合并消息一定先写出，快照之后的增量不会跑到前面；
+     * 高优先级消息仍然可能先于合并消息写出
+     */
+    core::errcode::ErrOpt   AsyncSendConflated(uint64_t key, const char* buf, size_t len);
+    /* 还没写出就被新数据替换掉的消息数 */
+    uint64_t                GetConflatedDropped() const;
+    /* 设置是否支持fd传递，只对AF_UNIX连接有效，需要在RunInEventLoop前调用 */
+    void                    SetOpt_PassFd(bool enable);
+    /**
+     * 异步发送数据，并通过SCM_RIGHTS附带fds，fds附着在data的第一个字节上。
+     * fds会被dup，调用方仍然持有原fd。len必须大于0
+     */
+    core::errcode::ErrOpt   AsyncSendWithFds(const char* buf, size_t len, const std::vector<int>& fds);
+    /* 取走已经收到的fd，按到达顺序排列，取走后由调用方负责关闭 */
+    std::vector<int>        TakeRecvFds();
+    /**
+     * 设置共享内存传输，只对AF_UNIX连接有效，需要在RunInEventLoop前调用。
+     * 双方都需要开启，initiator一方创建共享内存并发起握手。握手完成后
+     * 收发都经过共享内存环形缓冲区，socket只用于握手和感知对端关闭，
+     * 不经过收发限流，也不支持fd传递
+     */
+    void                    SetOpt_SharedMemory(size_t ring_size, bool initiator);
+    /* 共享内存握手是否已经完成 */
+    bool                    IsSharedMemory() const;
+    /**
+     * 设置tls，需要在RunInEventLoop前调用。连接建立后先完成握手，握手
+     * 完成前追加的数据暂存在输出缓存中。开启tls时回退到libevent后端
+     */
+    void                    SetOpt_Tls(std::shared_ptr<TlsContext> ctx);
+    /* tls握手是否已经完成 */
+    bool                    IsTlsEstablished() const;
+    /**
+     * 直接发送文件，非阻塞，sent返回实际发送的字节数，剩余部分由调用方稍后重试。
+     * 只能在连接所在线程调用，且输出缓存中不能有待发送数据。
+     * tls连接只有发送方向切换到内核TLS后才能使用
+     */
+    core::errcode::ErrOpt   SendFile(int fd, off_t offset, size_t len, size_t& sent);
     /* 关闭此连接 */
     void                    Close();
     bool                    IsConnected() const;
     bool                    IsClosed() const;
-    const IPAddress&        GetPeerAddress() const;
+    IPAddress               GetPeerAddress() const;
     evutil_socket_t         GetSocket() const;
     ConnId                  GetConnId() const;
+    /* 连接所在的EvThread，可以在上面注册和连接同线程的定时器。迁移后会变化 */
+    std::shared_ptr<EvThread> GetBindThread();
     void                    RunInEventLoop();
+    /**
+     * 把连接迁移到另一个EvThread，线程安全，连接启动后才能迁移。迁移在
+     * 连接所在线程中进行：等待发送中的数据写完，注销原线程上的事件，
+     * 切换绑定线程后在新线程中重新注册。输出缓存、接收缓冲和其他状态
+     * 随连接一起迁移，期间AsyncSend的数据在迁移完成后发出，收到的数据
+     * 留在内核中。on_done在新线程（失败时在原线程）中回调一次。
+     * io_uring、共享内存连接和握手中的tls连接不能迁移
+     */
+    core::errcode::ErrOpt   MigrateTo(std::shared_ptr<EvThread> thread, const OnMigrateFunc& on_done = nullptr);
+    bool                    IsMigrating() const;
+    /* 连接处理过的io事件数，用来衡量连接给所在线程带来的负载 */
+    uint64_t                GetIoEvents() const;
+    /**
+     * 交出socket，用于热重启时把连接交给新进程，线程安全。在连接所在线程
+     * 中进行：连接空闲（没有发送中或排队的数据）时，把socket和接收缓冲中
+     * 不完整的帧交给on_detach，之后连接按关闭处理，但socket不会被关闭，
+     * 由on_detach负责。连接忙、迁移中、使用tls、io_uring或共享内存时
+     * on_detach收到-1，连接不受影响。on_detach在连接所在线程中回调一次
+     */
+    core::errcode::ErrOpt   Detach(const OnDetachFunc& on_detach);
 
 protected:
     /* 启动Connection */
     void                    OnEvent(evutil_socket_t sockfd, short events);
+    void                    DispatchEvent(evutil_socket_t sockfd, short events);
     void                    OnSendEvent(std::shared_ptr<bbt::core::Buffer> output_buffer, short events);
 
     core::errcode::ErrOpt   Recv(evutil_socket_t sockfd);
     size_t                  Send(const char* buf, size_t len);
     core::errcode::ErrOpt   Timeout();
 
-    void                    OnRecv(const char* data, size_t len);
-    void                    OnSend(core::errcode::ErrOpt err, size_t succ_len);
-    void                    OnClose();
-    void                    OnTimeout();
+    /**
+     * 事件派发，默认通过ConnCallbacks回调。StaticConnection会覆盖
+     * 这些函数，直接调用静态类型的Handler
+     */
+    virtual void            OnRecv(const char* data, size_t len);
+    virtual void            OnSend(core::errcode::ErrOpt err, size_t succ_len);
+    virtual void            OnClose();
+    virtual void            OnTimeout();
     void                    OnError(const core::errcode::Errcode& err);
 
     core::errcode::ErrOpt   RegistASendEvent();
-    int                     AppendOutputBuffer(const char* data, size_t len);
+    /* 已经取得输出缓存的发送权后，按写合并或发送事件发出 */
+    core::errcode::ErrOpt   StartSend();
+    void                    FlushOutput();
+    /* 释放发送权，期间有新数据时重新发起发送 */
+    void                    ReleaseOutput();
+    /* 不按消息跟踪，直接追加到输出缓存并发起发送 */
+    core::errcode::ErrOpt   AppendAndSend(const char* buf, size_t len);
+    /* 输出的数据写入socket或者被丢弃，归还内存并回调已经结束的消息 */
+    void                    OnOutputConsumed(size_t len, core::errcode::ErrOpt err);
+    /* 在连接线程中回调已经过期的消息 */
+    void                    ScheduleCompletions();
+    void                    FireCompletions();
+    /* 连接关闭时回调所有还没结束的消息 */
+    void                    AbortCompletions();
+    /* 返回追加的字节数，超出内存预算被拒绝时返回-1 */
+    int                     AppendOutputBuffer(const char* data, size_t len, std::vector<int>* fds = nullptr);
+    /* 以下需要持有m_output_mutex */
+    size_t                  OutputBufferSize() const;
+    /* 把输出缓存整个取走，m_output_buffer置空 */
+    std::shared_ptr<bbt::core::Buffer> TakeOutputBuffer();
+    /* 把输出缓存中的数据换到out中，换出的空缓冲区归还缓冲池 */
+    void                    SwapOutputBuffer(bbt::core::Buffer& out);
+    /* 把待合并的消息移入输出，需要持有m_output_mutex */
+    void                    MergeConflated();
+    /* 按优先级组织下一批要写出的数据，放到m_output_buffer中，丢弃过期的消息 */
+    void                    ComposeOutput();
+    ssize_t                 SendWithPendingFds(const char* data, size_t len);
+    void                    DropOutput(size_t len);
+    void                    ClosePassedFds();
+
+    core::errcode::ErrOpt   AcceptShm(evutil_socket_t sockfd);
+    void                    AttachShm(std::shared_ptr<ShmChannel> channel);
+    void                    OnShmEvent();
+    /* 从共享内存读取不超过limit字节，不超过一个环的大小 */
+    void                    ShmRecv(size_t limit = SIZE_MAX);
+    void                    OnShmSend(std::shared_ptr<bbt::core::Buffer> output_buffer);
+
+    void                    TlsHandshake();
+    void                    WaitTlsWritable();
+    core::errcode::ErrOpt   TlsRecv();
+    size_t                  TlsSend(const char* buf, size_t len);
+
+    void                    DrainRecv();
+    /* 交付接收缓冲区中所有完整的帧 */
+    void                    DeliverFrames();
+    void                    RequeueRecv();
+
+    /* 读取前是否需要检查限流或线程池背压 */
+    bool                    HasRecvGate() const;
+    size_t                  RecvQuota(size_t want);
+    size_t                  SendQuota(size_t want);
+    void                    PauseRecv();
+    void                    ResumeRecv();
+    void                    PauseSend();
+    void                    ResumeSend();
+
+    /* 记账，rejectable为true时可能按策略被拒绝，返回false */
+    bool                    ChargeMemory(size_t n, bool rejectable);
+    void                    ReleaseMemory(size_t n);
+    /* 投递到连接所在线程关闭，可以在任意线程调用 */
+    void                    Evict();
+
+    bool                    RunInIoUring(std::shared_ptr<EvThread> thread);
+    void                    UringRecv();
+    void                    OnUringRecv(int res, const char* data, bool more);
+    core::errcode::ErrOpt   UringSend(std::shared_ptr<bbt::core::Buffer> output_buffer);
+    void                    OnUringSend(std::shared_ptr<bbt::core::Buffer> output_buffer, int res);
 
-    std::shared_ptr<EvThread> GetBindThread();
     bool                    BindThreadIsRunning();
+    void                    SetBindThread(std::shared_ptr<EvThread> thread);
+    /* 在线程上注册连接的读、关闭和空闲超时事件 */
+    void                    RegistRecvEvent(std::shared_ptr<EvThread> thread);
+    /* 迁移的两个阶段，分别在原线程和新线程中执行 */
+    void                    DoMigrate();
+    void                    FinishMigrate();
+    void                    EndMigrate(core::errcode::ErrOpt err);
+    void                    DoDetach(const OnDetachFunc& on_detach);
 
     virtual void            CloseSocket() final; 
     virtual void            SetStatus(ConnStatus status) final;
     static ConnId           GenerateConnId();
 private:
     std::weak_ptr<EvThread> m_bind_thread;
+    mutable std::atomic_flag m_bind_lock = ATOMIC_FLAG_INIT;    // 迁移时m_bind_thread可能被其他线程读取
+
+    /**
+     * 连接迁移，m_migrating保证同时只有一次迁移。迁移期间持有发送权，
+     * 其他线程的AsyncSend只追加输出缓存，不会在任何线程上注册事件。
+     * m_migration在迁移结束时释放，空闲连接不占用
+     */
+    struct Migration
+    {
+        std::weak_ptr<EvThread> target;
+        OnMigrateFunc       on_done{nullptr};
+        int                 waited_ms{0};
+        bool                recv_paused{false};         // 迁移前读取被暂停，新线程中保持暂停
+    };
+    std::unique_ptr<Migration> m_migration{nullptr};
+    std::atomic_bool        m_migrating{false};
+    std::shared_ptr<Event>  m_migrate_event{nullptr};           // 原线程中的一次性事件
+    std::shared_ptr<Event>  m_migrate_finish_event{nullptr};    // 新线程中的一次性事件
+    std::atomic_uint64_t    m_io_events{0};                     // 只在连接线程中增加
+    bool                    m_started{false};                   // 是否已经RunInEventLoop，由m_output_mutex保护
 
-    ConnCallbacks           m_callbacks;                // 回调函数
+    std::shared_ptr<const ConnCallbacks> m_callbacks;   // 回调函数，同一个服务的连接共享
     /**
      * 一连接一事件，
      * 1、如果使用多个事件会有时序问题
@@ -90,16 +330,186 @@ private:
 
     /**
      * 异步写需要做输出缓存，这里策略是无限扩张的输出缓存。
+     * 只在有待发送数据时从缓冲池取，被发送路径取走后置空，空闲连接不占用
      */
-    bbt::core::Buffer       m_output_buffer;
+    std::unique_ptr<bbt::core::Buffer> m_output_buffer{nullptr};
     std::atomic_bool        m_output_buffer_is_free{true}; // 是否被发送事件占用
     bbt::core::thread::Mutex
                             m_output_mutex;
 
     int                     m_timeout_ms{CONNECTION_FREE_TIMEOUT_MS};           // 连接空闲超时事件
 
+    /**
+     * fd传递，待发送的fd按其附着字节在输出流中的偏移排队，发送到该
+     * 偏移时通过sendmsg一起发出。偏移由m_output_mutex保护。
+     * 队列在第一次传递fd时才创建，std::deque默认构造就会分配内存
+     */
+    bool                    m_pass_fd{false};
+    uint64_t                m_output_total{0};          // 追加到输出缓存的总字节数
+    uint64_t                m_sent_total{0};            // 已写入socket或丢弃的总字节数
+    std::unique_ptr<std::deque<std::pair<uint64_t, std::vector<int>>>>
+                            m_pending_fds{nullptr};
+    std::vector<int>        m_recv_fds;
+    std::mutex              m_recv_fds_mutex;
+
+    /**
+     * 共享内存传输，m_event仍然监听socket，用于接收握手消息、感知对端
+     * 关闭和空闲超时；m_shm_event监听自己的门铃。发送环满时剩余数据
+     * 保存在m_shm_pending中，对端腾出空间后通过门铃继续发送
+     */
+    size_t                  m_shm_ring_size{0};         // 为0时不使用共享内存
+    bool                    m_shm_initiator{false};
+    std::shared_ptr<ShmChannel> m_shm{nullptr};
+    std::shared_ptr<Event>  m_shm_event{nullptr};
+    std::shared_ptr<bbt::core::Buffer> m_shm_pending{nullptr};
+
+    /**
+     * tls，握手由m_event的可读事件和m_tls_event的一次性可写事件推进，
+     * 握手完成前发送事件暂停，完成后恢复
+     */
+    std::shared_ptr<TlsContext> m_tls_ctx{nullptr};
+    std::unique_ptr<TlsSession> m_tls{nullptr};
+    std::shared_ptr<Event>  m_tls_event{nullptr};
+
+    /**
+     * 限流，读令牌耗尽时取消读事件，由定时器在令牌恢复后重新监听，
+     * 使数据积压在内核接收缓冲区中，形成tcp层面的背压。写同理。
+     */
+    std::shared_ptr<RateLimiter> m_rate_limiter{nullptr};       // 连接级限流
+    std::shared_ptr<RateLimiter> m_group_rate_limiter{nullptr}; // 组级限流
+    std::shared_ptr<Event>  m_recv_resume_event{nullptr};
+    bool                    m_recv_paused{false};       // 读事件被PauseRecv取消，等待恢复
+    std::shared_ptr<Event>  m_send_resume_event{nullptr};
+
+    /**
+     * 工作线程池，回调在连接自己的strand中执行。线程池饱和时
+     * 和限流一样暂停读取，定时检查线程池是否恢复
+     */
+    std::shared_ptr<WorkerPool> m_worker_pool{nullptr};
+    WorkerPool::StrandSPtr  m_strand{nullptr};
+
+    /**
+     * 内存预算，m_memory_used在追加输出时跨线程增加（持有m_output_mutex），
+     * 在连接线程中减少。关闭时持锁归还全部占用，之后不再记账
+     */
+    std::shared_ptr<MemoryBudget> m_memory_budget{nullptr};
+    std::atomic_size_t      m_memory_used{0};
+    std::atomic_bool        m_evicting{false};
+    std::shared_ptr<Event>  m_evict_event{nullptr};
+
+    BusyPollOptions         m_busy_poll_opts;
+    std::shared_ptr<BusyPoller> m_busy_poller{nullptr};
+
+    bool                    m_quickack{false};          // 每次读取后重新打开TCP_QUICKACK
+
+    /**
+     * 批量收帧，可读事件中的多次读取先追加到m_frame_input，事件处理
+     * 结束后一次性切分并回调，m_frame_views在多次回调间复用
+     */
+    std::shared_ptr<const FrameParser> m_frame_parser{nullptr};
+    std::vector<char>       m_frame_input;
+    std::vector<std::string_view> m_frame_views;
+    bool                    m_in_read_event{false};
+
+    /**
+     * 写合并，取得发送权后不立即注册可写事件，而是由0超时的定时器
+     * 在本轮事件循环末尾直接写socket，常见情况下不需要epoll_ctl
+     */
+    bool                    m_write_coalescing{false};
+    std::shared_ptr<Event>  m_flush_event{nullptr};
+    std::atomic_int         m_corked{0};
+
+    /**
+     * 合并发送，待写出的消息按key首次出现的顺序保存，m_conflated_index
+     * 记录key在其中的位置，由m_output_mutex保护
+     */
+    std::vector<std::pair<uint64_t, std::string>> m_conflated;
+    std::unordered_map<uint64_t, size_t> m_conflated_index;
+    size_t                  m_conflated_bytes{0};
+    std::atomic_uint64_t    m_conflated_dropped{0};
+
+    /**
+     * 按消息发送，带优先级、截止时间或完成回调的消息按优先级分别排队，
+     * 其他数据仍然直接追加到m_output_buffer；普通优先级的队列不为空时，
+     * 其他数据也排到队列中，保持先后顺序。第一次使用时才创建，由
+     * m_output_mutex保护。m_output_pinned是m_output_buffer头部已经写出
+     * 一部分的数据长度，必须最先写出，不能被高优先级消息插到前面
+     */
+    typedef std::chrono::steady_clock Clock;
+    struct OutputFrame
+    {
+        std::string         data;
+        Clock::time_point   deadline;
+        SendCompletion      on_complete;
+    };
+    struct OutputLanes
+    {
+        std::deque<OutputFrame> frames[emSEND_PRIORITY_COUNT];
+        size_t              bytes[emSEND_PRIORITY_COUNT]{};
+        int                 bulk_skipped{0};
+        OutputQueueStats    stats;
+        /* 已取出发送、等待完成回调的消息，按消息结尾的偏移排列 */
+        std::deque<std::pair<uint64_t, SendCompletion>> inflight;
+    };
+    std::unique_ptr<OutputLanes> m_lanes{nullptr};
+    /* 从一个队列中取出不超过limit字节的消息写到out，需要持有m_output_mutex */
+    size_t                  PopFrames(int lane, bbt::core::Buffer& out, uint64_t base, size_t limit, Clock::time_point now);
+    /* 丢弃一条过期的消息，完成回调排入m_ready_completions，需要持有m_output_mutex */
+    void                    ExpireFrame(int lane, OutputFrame& frame);
+    /**
+     * 过期定时器，在最早的截止时间触发，不等写就绪就丢弃所有队列中过期
+     * 的消息。Arm/Rearm需要持有m_output_mutex
+     */
+    void                    ArmExpire(Clock::time_point deadline);
+    void                    RearmExpire();
+    void                    OnExpire();
+    size_t                  m_output_pinned{0};
+    size_t                  m_normal_frames{0};
+
+    /**
+     * 消息完成跟踪，按取出发送的字节流偏移记录每条消息的结尾，写出或
+     * 丢弃的总字节数越过结尾时回调，都由m_output_mutex保护。带回调的
+     * 消息都经过m_lanes，等待中的回调也放在其中，不为每个连接分配队列
+     */
+    int                     m_send_deadline_ms{0};
+    int                     m_send_timeout_ms{SEND_DATA_TIMEOUT_MS};
+    uint64_t                m_taken_total{0};
+    uint64_t                m_consumed_total{0};
+    std::vector<std::pair<SendCompletion, core::errcode::ErrOpt>> m_ready_completions;
+    std::shared_ptr<Event>  m_completion_event{nullptr};
+    std::shared_ptr<Event>  m_expire_event{nullptr};
+    Clock::time_point       m_armed_expire{Clock::time_point::max()};
+
+    /**
+     * 边缘触发模式，连接自己维护读写就绪状态：
+     * 可读事件到达后一直读到EAGAIN，单次唤醒最多读m_read_budget次，
+     * 用完后仍然可读则通过m_requeue_event排到下一轮循环，避免饿死
+     * 其他连接。写遇到EAGAIN时清除可写状态，等待可写事件。
+     */
+    bool                    m_edge_triggered{false};
+    int                     m_read_budget{EDGE_TRIGGERED_READ_BUDGET};
+    bool                    m_readable{false};
+    bool                    m_writable{true};
+    std::shared_ptr<Event>  m_requeue_event{nullptr};
+
+    /**
+     * io_uring后端下，读由multishot recv完成，m_event只用于空闲超时；
+     * 写直接提交send请求，不使用m_send_event
+     */
+    IOBackend               m_io_backend{emIO_BACKEND_LIBEVENT};
+    std::shared_ptr<IoUringContext> m_uring{nullptr};
+    uint64_t                m_uring_recv_token{0};
+
+    std::shared_ptr<void>   m_context{nullptr};         // 用户上下文
+
     int                     m_socket_fd{-1};
-    IPAddress               m_peer_addr;
+    /* 对端地址只保存原始的sockaddr，需要时再构造IPAddress，unix连接为AF_UNSPEC */
+    union {
+        sockaddr            sa;
+        sockaddr_in         in4;
+        sockaddr_in6        in6;
+    }                       m_peer_addr;
+    socklen_t               m_peer_addr_len{0};
     volatile ConnStatus     m_conn_status{ConnStatus::emCONN_DEFAULT};
     const ConnId            m_conn_id{0};
 };
@@ -0,0 +1,64 @@
+/**
+ * @file CpuAffinity.cc
+ * @author yangqingmiao
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include <string>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <bbt/network/detail/CpuAffinity.hpp>
+
+using namespace bbt::core::errcode;
+
+namespace bbt::network::detail
+{
+
+ErrOpt PinCurrentThread(const std::vector<int>& cpus)
+{
+    if (cpus.empty())
+        return FASTERR_NOTHING;
+
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    for (int cpu : cpus) {
+        if (cpu < 0 || cpu >= CPU_SETSIZE)
+            return FASTERR_ERROR("invalid cpu! cpu=" + std::to_string(cpu));
+        CPU_SET(cpu, &cpuset);
+    }
+
+    int ret = pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+    if (ret != 0)
+        return FASTERR_ERROR("pthread_setaffinity_np failed! " + std::string{strerror(ret)});
+
+    return FASTERR_NOTHING;
+}
+
+ErrOpt UseLocalNumaMemory()
+{
+    /* 直接使用系统调用，避免依赖libnuma */
+    if (::syscall(SYS_set_mempolicy, MPOL_LOCAL, nullptr, 0) != 0)
+        return FASTERR_ERROR("set_mempolicy failed! " + std::string{strerror(errno)});
+
+    return FASTERR_NOTHING;
+}
+
+int GetIncomingCpu(evutil_socket_t fd)
+{
+#ifdef SO_INCOMING_CPU
+    int cpu = -1;
+    socklen_t len = sizeof(cpu);
+    if (::getsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len) == 0)
+        return cpu;
+#endif
+    return -1;
+}
+
+} // namespace bbt::network::detail
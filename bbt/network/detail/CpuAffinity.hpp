@@ -0,0 +1,41 @@
+/**
+ * @file CpuAffinity.hpp
+ * @author yangqingmiao
+ * @brief 线程cpu亲和性和numa内存策略
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#pragma once
+#include <bbt/network/detail/Define.hpp>
+
+namespace bbt::network::detail
+{
+
+/**
+ * @brief 把当前线程绑定到cpus上
+ *
+ * @param cpus 为空时不做任何事
+ * @return core::errcode::ErrOpt
+ */
+core::errcode::ErrOpt PinCurrentThread(const std::vector<int>& cpus);
+
+/**
+ * @brief 当前线程之后分配的内存优先从所在的numa节点分配（MPOL_LOCAL）
+ * 配合线程绑定使用，内存页在首次访问时分配到线程所在节点
+ *
+ * @return core::errcode::ErrOpt
+ */
+core::errcode::ErrOpt UseLocalNumaMemory();
+
+/**
+ * @brief 获取接收该连接数据包的cpu（SO_INCOMING_CPU）
+ *
+ * @param fd
+ * @return int 不支持或失败时返回-1
+ */
+int GetIncomingCpu(evutil_socket_t fd);
+
+} // namespace bbt::network::detail
@@ -21,6 +21,9 @@
 #include <map>
 #include <vector>
 #include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
 
 #include <event2/event.h>
 #include <event2/thread.h>
@@ -43,10 +46,48 @@ using namespace bbt::pollevent;
 
 // 空闲断开连接时间
 #define CONNECTION_FREE_TIMEOUT_MS 5000
-// 发送超时失败
+// 发送超时失败，socket持续不可写超过这个时间时丢弃在途数据，可以通过SetOpt_SendTimeout修改
 #define SEND_DATA_TIMEOUT_MS 2000
 // 连接超时
 #define CONNECT_TIMEOUT_MS 2000
+// 边缘触发模式下单次唤醒最多读取次数，用完后重新排队
+#define EDGE_TRIGGERED_READ_BUDGET 16
+// AF_UNIX单次接收最多携带的fd数
+#define UNIX_MAX_PASS_FDS 16
+// 共享内存传输默认的单向环形缓冲区大小，必须是2的幂
+#define SHM_RING_DEFAULT_SIZE (1 << 20)
+// udp单次recvmmsg/sendmmsg的最大消息数
+#define UDP_MMSG_BATCH 32
+// udp单次可读事件中最多调用recvmmsg的次数，避免饿死其他事件
+#define UDP_RECV_ROUNDS 8
+// udp GSO单次发送的最大分段数，内核上限为64
+#define UDP_GSO_MAX_SEGMENTS 64
+// rpc单帧最大长度，超过时认为对端数据错误并关闭连接
+#define RPC_MAX_FRAME_SIZE (16 << 20)
+// 工作线程池饱和时，暂停读取后重新检查的间隔
+#define WORKER_POOL_BACKPRESSURE_RETRY_MS 5
+// 工作线程单次连续执行同一个连接的任务数，用完后让出给其他连接
+#define WORKER_POOL_STRAND_BATCH 64
+// 每个线程缓存的空闲输出缓冲区数，超出的直接释放
+#define BUFFER_POOL_THREAD_CACHE 64
+// 内存超出预算暂停读取后，重新检查的间隔
+#define MEMORY_BUDGET_RETRY_MS 5
+// 超出全局预算时，两次淘汰最大连接之间的最小间隔
+#define MEMORY_BUDGET_EVICT_INTERVAL_MS 10
+// 每次取输出缓存时最多带上的低优先级数据量，高优先级消息最多排在这么多数据之后
+#define SEND_BULK_CHUNK_SIZE (64 * 1024)
+// 低优先级数据连续被挤掉这么多次后，强制带上一条，防止饿死
+#define SEND_BULK_STARVATION_ROUNDS 4
+// 连接迁移时还有发送中的数据，等待发送完成后重试的间隔
+#define CONNECTION_MIGRATE_RETRY_MS 1
+// 连接迁移等待发送完成的最长时间，超过后放弃迁移
+#define CONNECTION_MIGRATE_TIMEOUT_MS 3000
+// 热重启控制连接上单次读写的超时时间
+#define HOT_RESTART_IO_TIMEOUT_MS 3000
+// 热重启控制消息的最大长度，超过时认为对端数据错误
+#define HOT_RESTART_MAX_MSG_SIZE (16 << 20)
+// 热重启交接后检查剩余连接是否排空的间隔
+#define HOT_RESTART_DRAIN_CHECK_MS 100
 
 enum emErr : bbt::core::errcode::ErrType
 {
@@ -60,13 +101,27 @@ enum emErr : bbt::core::errcode::ErrType
     ERRTYPE_NETWORK_RECV_CONNREFUSED            = 202,          // 连接被服务器拒绝
     ERRTYPE_NETWORK_RECV_EOF                    = 203,          // 连接关闭
     ERRTYPE_NETWORK_RECV_OTHER_ERR              = 204,          // 其他错误
+    ERRTYPE_NETWORK_RECV_FDS_TRUNCATED          = 205,          // 附带的fd被截断，同时读到的数据已丢弃，连接随后关闭
 
     ERRTYPE_SEND_TIMEOUT                        = 301,          // 发送超时
+    ERRTYPE_SEND_EXPIRED                        = 302,          // 消息超过截止时间还没有写出，已丢弃
+    ERRTYPE_SEND_CONN_CLOSED                    = 303,          // 消息写出前连接关闭
 
     ERRTYPE_CONNECT_TIMEOUT                     = 401,          // 连接对端超时
     ERRTYPE_CONNECT_CONNREFUSED                 = 402,          // 连接被拒绝
     ERRTYPE_CONNECT_SUCCESS                     = 403,          // 连接成功
     ERRTYPE_CONNECT_TRY_AGAIN                   = 404,          // 忙，请稍后重试
+
+    ERRTYPE_RPC_TIMEOUT                         = 501,          // rpc调用超时
+    ERRTYPE_RPC_CONN_CLOSED                     = 502,          // rpc完成前连接关闭
+    ERRTYPE_RPC_NO_METHOD                       = 503,          // 对端没有注册该方法
+    ERRTYPE_RPC_REMOTE_ERROR                    = 504,          // 对端回复错误
+
+    ERRTYPE_MEMORY_BUDGET_EXCEEDED              = 601,          // 超出内存预算
+
+    ERRTYPE_MIGRATE_FAILED                      = 701,          // 连接迁移失败，连接仍在原来的线程中
+
+    ERRTYPE_HOT_RESTART_FAILED                  = 801,          // 热重启交接失败
 };
 
 // 连接状态枚举
@@ -86,8 +141,309 @@ enum NetworkStatus
     emNETWORK_STOP        = 3,
 };
 
+// io后端
+enum IOBackend
+{
+    emIO_BACKEND_LIBEVENT  = 0,    // libevent 就绪通知 + read/send
+    emIO_BACKEND_IO_URING  = 1,    // io_uring 提交收发，需要编译时开启 BBT_NETWORK_WITH_IO_URING
+};
+
+// 连接准入控制配置，数值为0表示不限制
+struct AdmissionOptions
+{
+    size_t      max_connections{0};         // 最大连接数
+    size_t      max_connections_per_ip{0};  // 单个来源ip的最大连接数
+    double      accept_rate{0};             // 每秒允许接受的新连接数
+    size_t      accept_burst{0};            // 接受新连接的突发容量，为0时取accept_rate
+    bool        reject_with_rst{true};      // 拒绝时直接发送RST，不进入TIME_WAIT
+};
+
+// 连接准入统计
+struct AdmissionStats
+{
+    uint64_t    accepted{0};                // 接受的连接数
+    uint64_t    rejected_max_conn{0};       // 因超过最大连接数拒绝
+    uint64_t    rejected_per_ip{0};         // 因超过单ip连接数拒绝
+    uint64_t    rejected_rate{0};           // 因超过接受速率拒绝
+    uint64_t    rejected_no_fd{0};          // 因文件描述符耗尽拒绝
+};
+
+// 发送优先级，数值越小越先写出。AsyncSend不带优先级时为emSEND_PRIORITY_NORMAL
+enum SendPriority
+{
+    emSEND_PRIORITY_HIGH    = 0,    // 心跳、取消、确认等控制消息，排到所有待发送数据之前
+    emSEND_PRIORITY_NORMAL  = 1,
+    emSEND_PRIORITY_BULK    = 2,    // 大块数据，每次最多写出SEND_BULK_CHUNK_SIZE
+    emSEND_PRIORITY_COUNT   = 3,
+};
+
+// 输出队列统计，按SendPriority下标，只统计还没有取走发送的消息
+struct OutputQueueStats
+{
+    size_t      queued_frames[emSEND_PRIORITY_COUNT]{};
+    size_t      queued_bytes[emSEND_PRIORITY_COUNT]{};
+    uint64_t    sent_frames[emSEND_PRIORITY_COUNT]{};   // 已经取走发送的消息数
+    uint64_t    starvation_breaks{0};       // 为防止饿死强制带上低优先级消息的次数
+    uint64_t    expired{0};                 // 超过截止时间被丢弃的消息数
+};
+
+// 单条消息写入socket、过期丢弃或者连接关闭时回调一次，err为空表示已经全部写入socket
+typedef std::function<void(core::errcode::ErrOpt)> SendCompletion;
+
+// 单条消息的发送选项
+struct SendOptions
+{
+    SendPriority priority{emSEND_PRIORITY_NORMAL};
+    int         deadline_ms{-1};            // 多久之内必须开始写出，过期后丢弃并以ERRTYPE_SEND_EXPIRED回调；小于0使用连接的默认值，0表示不过期
+    SendCompletion on_complete{nullptr};    // 在连接所在线程中回调
+};
+
+// 超出内存预算时的处理策略
+enum MemoryPolicy
+{
+    emMEMORY_POLICY_PAUSE_RECV    = 0,    // 暂停读取，直到占用回落到预算内，发送不受影响
+    emMEMORY_POLICY_REJECT_SEND   = 1,    // 拒绝发送，AsyncSend返回ERRTYPE_MEMORY_BUDGET_EXCEEDED
+    emMEMORY_POLICY_CLOSE_LARGEST = 2,    // 关闭占用最大的连接，超出连接级上限时关闭该连接
+};
+
+// 内存预算配置，统计输出缓存和分帧接收缓冲区，数值为0表示不限制
+struct MemoryBudgetOptions
+{
+    size_t      global_limit{0};            // 所有连接合计
+    size_t      conn_limit{0};              // 单个连接
+    MemoryPolicy policy{emMEMORY_POLICY_PAUSE_RECV};
+};
+
+struct MemoryStats
+{
+    size_t      used{0};                    // 当前占用字节数
+    size_t      peak{0};                    // 历史最大占用
+    size_t      global_limit{0};
+    size_t      conn_limit{0};
+    size_t      connections{0};             // 使用该预算的连接数
+    uint64_t    recv_throttled{0};          // 因超出预算推迟读取的次数，包括暂停期间的重试
+    uint64_t    rejected_sends{0};          // 被拒绝的发送次数
+    uint64_t    evicted{0};                 // 被关闭的连接数
+};
+
+// 连接自动再均衡配置，按周期内各线程处理的io事件数衡量负载
+struct RebalanceOptions
+{
+    bool        enable{false};
+    int         interval_ms{1000};          // 采样和迁移的周期
+    double      imbalance_ratio{1.5};       // 最忙线程的负载超过平均值的这么多倍时迁移
+    uint64_t    min_events{1000};           // 最忙线程一个周期内的事件数低于这个值时不迁移
+    size_t      max_migrations{4};          // 每个周期最多迁移的连接数
+};
+
+// 单个EvThread上一个再均衡周期的负载
+struct ThreadLoad
+{
+    size_t      connections{0};             // 绑定在该线程上的连接数
+    uint64_t    events{0};                  // 周期内连接处理的io事件数
+};
+
+struct RebalanceStats
+{
+    uint64_t    rounds{0};                  // 采样次数
+    uint64_t    migrations{0};              // 成功迁移的连接数，包括缩减线程时的迁移
+    uint64_t    failed{0};                  // 迁移失败的次数
+};
+
+// 收发限流配置，速率为0表示不限制
+struct RateLimitOptions
+{
+    double      recv_bytes_per_sec{0};      // 每秒接收字节数
+    double      recv_msgs_per_sec{0};       // 每秒接收次数，一次读取视为一条消息
+    double      send_bytes_per_sec{0};      // 每秒发送字节数
+    double      send_msgs_per_sec{0};       // 每秒发送消息数，一次AsyncSend视为一条消息
+    size_t      burst_bytes{0};             // 字节突发容量，为0时取对应速率
+    size_t      burst_msgs{0};              // 消息突发容量，为0时取对应速率
+};
+
+// EvThread的cpu亲和性配置
+struct CpuAffinityOptions
+{
+    std::vector<std::vector<int>> cpu_sets;     // 第i个线程绑定到 cpu_sets[i % cpu_sets.size()]，为空不绑定
+    bool        numa_local_memory{true};        // 线程内存优先从所在numa节点分配
+    bool        steer_by_incoming_cpu{false};   // 按SO_INCOMING_CPU把新连接分配给绑定到该cpu的线程
+
+    // 每个线程绑定到一个cpu
+    static CpuAffinityOptions OnePerCpu(const std::vector<int>& cpus)
+    {
+        CpuAffinityOptions opts;
+        for (int cpu : cpus)
+            opts.cpu_sets.push_back({cpu});
+        return opts;
+    }
+};
+
+// udp socket配置
+struct UdpOptions
+{
+    bool        reuseport{false};           // SO_REUSEPORT，多个socket绑定同一地址，由内核按四元组分流
+    bool        gro{false};                 // UDP_GRO，内核合并同流的数据报，接收后按分段大小拆开
+    bool        gso{false};                 // UDP_SEGMENT，发往同一地址的等长数据报合并为一次发送
+    size_t      max_datagram{2048};         // 单个数据报最大长度，超过的部分被截断
+    size_t      max_send_queue{4096};       // 发送队列中最多排队的数据报数，队列满时SendTo返回错误；0表示不限制
+    std::optional<int> recv_buffer;         // SO_RCVBUF(byte)
+    std::optional<int> send_buffer;         // SO_SNDBUF(byte)
+};
+
+// udp统计
+struct UdpStats
+{
+    uint64_t    rx_packets{0};              // 接收的数据报数（GRO拆分后）
+    uint64_t    rx_bytes{0};
+    uint64_t    rx_batches{0};              // recvmmsg调用次数
+    uint64_t    rx_truncated{0};            // 被截断的数据报数
+    uint64_t    tx_packets{0};
+    uint64_t    tx_bytes{0};
+    uint64_t    tx_batches{0};              // sendmmsg调用次数
+    uint64_t    tx_dropped{0};              // 发送失败或队列满丢弃的数据报数
+};
+
+// 自适应忙轮询配置
+struct BusyPollOptions
+{
+    bool        enable{false};
+    int         initial_spin_us{50};        // 初始空转窗口
+    int         min_spin_us{5};             // 空转窗口下限
+    int         max_spin_us{1000};          // 空转窗口上限
+};
+
+// 忙轮询统计，同一个EvThread上的连接共享
+struct BusyPollStats
+{
+    uint64_t    spin_ns{0};                 // 没有事件时空转的时间
+    uint64_t    work_ns{0};                 // 处理连接事件的时间
+    uint64_t    spin_hits{0};               // 空转期间到达的事件数，即省掉的阻塞唤醒
+    uint64_t    blocking_wakeups{0};        // 从阻塞等待中被唤醒的次数
+    int         spin_window_us{0};          // 当前空转窗口
+};
+
+// tls配置，需要编译时开启 BBT_NETWORK_WITH_OPENSSL
+struct TlsOptions
+{
+    std::string cert_file;                  // 证书链(PEM)，服务端必须设置
+    std::string key_file;                   // 私钥(PEM)
+    std::string ca_file;                    // 校验对端证书的CA(PEM)，为空时使用系统默认
+    bool        verify_peer{false};         // 服务端是否要求并校验客户端证书，客户端总是校验服务端证书
+    bool        insecure{false};            // 客户端跳过证书和主机名校验，只用于测试
+    std::string server_name;                // 客户端的SNI和主机名校验，客户端校验对端时必须设置
+    std::string ciphers;                    // TLS1.2密码套件，为空时使用OpenSSL默认
+    bool        session_resumption{true};   // 会话恢复，服务端签发session ticket，客户端缓存最近的会话
+    bool        ktls{true};                 // 握手完成后切换到内核TLS，内核或OpenSSL不支持时仍由OpenSSL加解密
+};
+
+// tls统计
+struct TlsStats
+{
+    uint64_t    handshakes{0};              // 完成的握手数
+    uint64_t    resumed{0};                 // 其中通过会话恢复完成的
+    uint64_t    failed{0};                  // 失败的握手数
+    uint64_t    ktls_send{0};               // 发送方向切换到内核TLS的连接数
+    uint64_t    ktls_recv{0};               // 接收方向切换到内核TLS的连接数
+};
+
+// 工作线程池配置
+struct WorkerPoolOptions
+{
+    size_t      threads{4};                 // 工作线程数
+    size_t      high_watermark{65536};      // 积压任务数达到后视为饱和，暂停所有相关连接的读取
+};
+
+// 工作线程池统计
+struct WorkerPoolStats
+{
+    uint64_t    submitted{0};               // 提交的任务数
+    uint64_t    completed{0};               // 完成的任务数
+    uint64_t    stolen{0};                  // 被其他工作线程窃取执行的次数
+    uint64_t    saturated{0};               // 进入饱和状态的次数
+    size_t      pending{0};                 // 当前积压的任务数
+};
+
+// socket选项，未设置的字段保持系统默认值
+struct SocketOptions
+{
+    std::optional<bool> tcp_nodelay;            // TCP_NODELAY，关闭Nagle算法
+    std::optional<int>  send_buffer;            // SO_SNDBUF(byte)
+    std::optional<int>  recv_buffer;            // SO_RCVBUF(byte)
+    std::optional<bool> keepalive;              // SO_KEEPALIVE
+    std::optional<int>  keepalive_idle_s;       // TCP_KEEPIDLE，空闲多久开始探测
+    std::optional<int>  keepalive_interval_s;   // TCP_KEEPINTVL，探测间隔
+    std::optional<int>  keepalive_count;        // TCP_KEEPCNT，探测次数
+    std::optional<int>  notsent_lowat;          // TCP_NOTSENT_LOWAT(byte)
+    std::optional<int>  busy_poll_us;           // SO_BUSY_POLL(us)，部分取值需要CAP_NET_ADMIN
+    std::optional<bool> quickack;               // TCP_QUICKACK，非持久选项，每次读取后重新设置
+
+    // 低延迟配置，适合小包请求响应
+    static SocketOptions LowLatency()
+    {
+        SocketOptions opts;
+        opts.tcp_nodelay = true;
+        opts.quickack = true;
+        opts.notsent_lowat = 16 * 1024;
+        return opts;
+    }
+
+    // 高吞吐配置，适合大块数据传输
+    static SocketOptions Throughput()
+    {
+        SocketOptions opts;
+        opts.tcp_nodelay = false;
+        opts.send_buffer = 4 * 1024 * 1024;
+        opts.recv_buffer = 4 * 1024 * 1024;
+        return opts;
+    }
+};
+
+/**
+ * 一次可读事件中解析出的所有完整帧，视图指向连接的接收缓冲区，
+ * 只在回调期间有效
+ */
+struct FrameBatch
+{
+    const std::string_view* frames{nullptr};
+    size_t                  count{0};
+
+    const std::string_view* begin() const { return frames; }
+    const std::string_view* end() const { return frames + count; }
+    size_t                  size() const { return count; }
+    bool                    empty() const { return count == 0; }
+    const std::string_view& operator[](size_t i) const { return frames[i]; }
+};
+
+/**
+ * 分帧函数，从data开头切出一个完整帧，返回帧长度（包含帧头）。
+ * 数据不完整时返回0，数据错误时返回-1，连接会被关闭
+ */
+typedef std::function<ssize_t(const char* /*data*/, size_t /*len*/)> FrameParser;
+
+/**
+ * @brief 4字节大端长度前缀的分帧函数，长度不包含前缀本身
+ *
+ * @param max_frame_len 超过时认为数据错误
+ */
+inline FrameParser LengthPrefixedFrameParser(uint32_t max_frame_len)
+{
+    return [max_frame_len](const char* data, size_t len) -> ssize_t {
+        if (len < sizeof(uint32_t))
+            return 0;
+
+        uint32_t body_len = ((uint8_t)data[0] << 24) | ((uint8_t)data[1] << 16) | ((uint8_t)data[2] << 8) | (uint8_t)data[3];
+        if (body_len > max_frame_len)
+            return -1;
+
+        size_t frame_len = sizeof(uint32_t) + body_len;
+        return (len >= frame_len) ? (ssize_t)frame_len : 0;
+    };
+}
+
 class TcpServer;
 class TcpClient;
+class UdpSocket;
+class UdpServer;
 
 // 连接id
 typedef int64_t ConnId;
@@ -97,6 +453,14 @@ typedef int64_t EventId;
 namespace detail
 {
 class Connection;
+class RateLimiter;
+class IoUringContext;
+class WorkerPool;
+class BusyPoller;
+class ShmChannel;
+class TlsContext;
+class TlsSession;
+class MemoryBudget;
 
 typedef std::shared_ptr<Connection> ConnectionSPtr;
 typedef std::function<void(ConnectionSPtr, const char*, size_t)>  OnRecvCallback;
@@ -104,6 +468,7 @@ typedef std::function<void(ConnectionSPtr, core::errcode::ErrOpt, size_t)>   OnS
 typedef std::function<void(ConnId, const IPAddress& )>  OnCloseCallback;
 typedef std::function<void(ConnectionSPtr)>             OnTimeoutCallback;
 typedef std::function<void(ConnId, const core::errcode::Errcode&)>             OnConnErrorCallback;
+typedef std::function<void(ConnectionSPtr, const FrameBatch&)>                  OnRecvBatchCallback;
 
 struct ConnCallbacks
 {
@@ -112,6 +477,7 @@ struct ConnCallbacks
     OnCloseCallback     on_close_callback{nullptr};
     OnTimeoutCallback   on_timeout_callback{nullptr};
     OnConnErrorCallback on_err_callback{nullptr};
+    OnRecvBatchCallback on_recv_batch_callback{nullptr};   // 设置了分帧函数时代替on_recv_callback
 };
 
 } // namespace detail
@@ -123,6 +489,37 @@ typedef std::function<void(ConnId, const bbt::core::Buffer&)> OnRecvFunc;
 typedef std::function<void(ConnId, const core::errcode::Errcode&)> OnErrFunc;
 typedef std::function<void(ConnId)> OnAcceptFunc;
 typedef std::function<void(ConnId, core::errcode::ErrOpt)> OnConnectFunc;
+typedef std::function<void(ConnId, core::errcode::ErrOpt)> OnMigrateFunc;
+// 连接交出socket的回调，fd为-1表示连接不能交出；input为接收缓冲中不完整的帧
+typedef std::function<void(int, std::string)> OnDetachFunc;
+// 接管旧进程交出的连接，state为旧进程导出的用户状态
+typedef std::function<void(ConnId, const std::string&)> OnInheritFunc;
+
+// 携带连接上下文的回调，上下文为 Connection::SetContext 设置的对象
+typedef std::function<void(ConnId, void*, const bbt::core::Buffer&)> OnRecvCtxFunc;
+typedef std::function<void(ConnId, void*, core::errcode::ErrOpt, size_t)> OnSendCtxFunc;
+typedef std::function<void(ConnId, void*)> OnCloseCtxFunc;
+// 批量收帧回调，携带连接上下文
+typedef std::function<void(ConnId, void*, const FrameBatch&)> OnRecvBatchFunc;
+
+// 热重启时旧进程的交接配置
+struct HotRestartOptions
+{
+    bool        handoff_connections{false}; // 是否把空闲连接也交给新进程，否则只交出监听socket
+    int         drain_timeout_ms{30000};    // 交接后剩余连接的排空时间，超过后强制关闭；0表示不限制
+    std::function<std::string(ConnId)>
+                export_state{nullptr};      // 交出连接前在连接所在线程中导出用户状态，新进程在OnInherit中取回
+    std::function<void()>
+                on_drained{nullptr};        // 剩余连接全部关闭后回调
+};
+
+struct HotRestartStats
+{
+    uint64_t    handoffs{0};                // 交出监听socket的次数
+    uint64_t    conns_sent{0};              // 交给新进程的连接数
+    uint64_t    conns_skipped{0};           // 不空闲、留在本进程排空的连接数
+    uint64_t    conns_inherited{0};         // 从旧进程接管的连接数
+};
 
 } // namespace bbt::network
 
@@ -0,0 +1,177 @@
+/**
+ * @file HotRestart.cc
+ * @author yangqingmiao
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include <cstring>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <bbt/network/detail/HotRestart.hpp>
+#include <bbt/network/detail/UnixSocket.hpp>
+
+using namespace bbt::core::errcode;
+
+namespace bbt::network::detail
+{
+
+static const uint32_t HANDOFF_MAGIC = 0x42425452;  // "BBTR"
+
+struct HandoffHeader
+{
+    uint32_t    magic{HANDOFF_MAGIC};
+    uint32_t    type{0};
+    uint32_t    len{0};
+};
+
+static void CloseFds(std::vector<int>& fds)
+{
+    for (int fd : fds)
+        ::close(fd);
+    fds.clear();
+}
+
+/* 读满len字节，收到的fd追加到fds中 */
+static ErrOpt RecvFull(int fd, char* data, size_t len, std::vector<int>& fds)
+{
+    size_t received = 0;
+    while (received < len) {
+        ssize_t n = RecvWithFds(fd, data + received, len - received, fds);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n == 0)
+            return Errcode{"hot restart failed! control connection closed by peer!", ERRTYPE_HOT_RESTART_FAILED};
+        if (n < 0)
+            return Errcode{"hot restart failed! recv failed! " + std::string{strerror(errno)}, ERRTYPE_HOT_RESTART_FAILED};
+
+        received += n;
+    }
+
+    return FASTERR_NOTHING;
+}
+
+ErrOpt CreateHandoffListen(const std::string& path, int& fd)
+{
+    if (auto err = CreateUnixListen(path, fd); err.has_value())
+        return err;
+
+    /* bind后立即收紧权限，之间的连接由CheckHandoffPeer拒绝 */
+    if (path[0] != '@' && ::chmod(path.c_str(), S_IRUSR | S_IWUSR) != 0) {
+        std::string errstr = strerror(errno);
+        ::close(fd);
+        fd = -1;
+        ::unlink(path.c_str());
+        return Errcode{"enable hot restart failed! chmod failed! path=" + path + " " + errstr, ERRTYPE_HOT_RESTART_FAILED};
+    }
+
+    return FASTERR_NOTHING;
+}
+
+ErrOpt CheckHandoffPeer(int fd)
+{
+    ucred cred;
+    socklen_t len = sizeof(cred);
+    if (::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0)
+        return Errcode{"hot restart refused! get peer credentials failed! " + std::string{strerror(errno)}, ERRTYPE_HOT_RESTART_FAILED};
+
+    if (cred.uid != ::geteuid())
+        return Errcode{"hot restart refused! peer uid " + std::to_string(cred.uid) + " pid " + std::to_string(cred.pid) + " is not allowed!", ERRTYPE_HOT_RESTART_FAILED};
+
+    return FASTERR_NOTHING;
+}
+
+void SetHandoffTimeout(int fd, int timeout_ms)
+{
+    timeval tv{timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+ErrOpt ConnectHandoff(const std::string& path, int timeout_ms, int& fd)
+{
+    sockaddr_un addr;
+    socklen_t   len = 0;
+    if (auto err = MakeUnixAddress(path, addr, len); err.has_value())
+        return err;
+
+    if (auto err = CreateUnixSocket(false, fd); err.has_value())
+        return err;
+
+    /* 阻塞socket的connect也受发送超时限制 */
+    SetHandoffTimeout(fd, timeout_ms);
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), len) != 0) {
+        std::string errstr = strerror(errno);
+        ::close(fd);
+        fd = -1;
+        return Errcode{"hot restart failed! connect to old process failed! path=" + path + " " + errstr, ERRTYPE_HOT_RESTART_FAILED};
+    }
+
+    return FASTERR_NOTHING;
+}
+
+ErrOpt SendHandoffMsg(int fd, uint32_t type, const std::string& payload, const std::vector<int>& fds)
+{
+    if (payload.size() > HOT_RESTART_MAX_MSG_SIZE)
+        return Errcode{"hot restart failed! message too large!", ERRTYPE_HOT_RESTART_FAILED};
+
+    HandoffHeader header;
+    header.type = type;
+    header.len = payload.size();
+
+    std::string msg;
+    msg.reserve(sizeof(header) + payload.size());
+    msg.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    msg.append(payload);
+
+    /* fd随第一次sendmsg发出，剩余部分普通发送 */
+    size_t sent = 0;
+    while (sent < msg.size()) {
+        ssize_t n = (sent == 0) ? SendWithFds(fd, msg.data(), msg.size(), fds) :
+                                  ::send(fd, msg.data() + sent, msg.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return Errcode{"hot restart failed! send failed! " + std::string{strerror(errno)}, ERRTYPE_HOT_RESTART_FAILED};
+
+        sent += n;
+    }
+
+    return FASTERR_NOTHING;
+}
+
+void CloseHandoffFds(HandoffMsg& msg)
+{
+    CloseFds(msg.fds);
+}
+
+ErrOpt RecvHandoffMsg(int fd, HandoffMsg& msg)
+{
+    HandoffHeader header;
+    msg.fds.clear();
+    msg.payload.clear();
+
+    if (auto err = RecvFull(fd, reinterpret_cast<char*>(&header), sizeof(header), msg.fds); err.has_value()) {
+        CloseFds(msg.fds);
+        return err;
+    }
+
+    if (header.magic != HANDOFF_MAGIC || header.len > HOT_RESTART_MAX_MSG_SIZE) {
+        CloseFds(msg.fds);
+        return Errcode{"hot restart failed! bad message header!", ERRTYPE_HOT_RESTART_FAILED};
+    }
+
+    msg.type = header.type;
+    msg.payload.resize(header.len);
+    if (auto err = RecvFull(fd, msg.payload.data(), msg.payload.size(), msg.fds); err.has_value()) {
+        CloseFds(msg.fds);
+        return err;
+    }
+
+    return FASTERR_NOTHING;
+}
+
+} // namespace bbt::network::detail
@@ -0,0 +1,94 @@
+/**
+ * @file HotRestart.hpp
+ * @author yangqingmiao
+ * @brief 热重启时新旧进程之间的交接协议
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#pragma once
+#include <string>
+#include <vector>
+#include <bbt/network/detail/Define.hpp>
+
+namespace bbt::network::detail
+{
+
+/**
+ * 新旧进程在AF_UNIX控制连接上交换的消息，控制连接是阻塞的，读写都有
+ * 超时。每条消息是定长消息头加消息体，fd附着在消息的第一个字节上：
+ *  新进程 -> HELLO
+ *  旧进程 -> LISTEN，附带监听socket，unix socket的消息体为监听路径，tcp为空
+ *  新进程 -> READY，已经开始接受连接，旧进程停止接受
+ *  旧进程 -> CONN * n，每条附带一个空闲连接的socket，消息体为4字节的
+ *            接收缓冲长度、接收缓冲中不完整的帧、导出的用户状态
+ *  旧进程 -> DONE
+ */
+enum HandoffMsgType : uint32_t
+{
+    emHANDOFF_HELLO     = 1,
+    emHANDOFF_LISTEN    = 2,
+    emHANDOFF_READY     = 3,
+    emHANDOFF_CONN      = 4,
+    emHANDOFF_DONE      = 5,
+};
+
+struct HandoffMsg
+{
+    uint32_t            type{0};
+    std::string         payload;
+    std::vector<int>    fds;            // 收到的fd归接收方所有
+};
+
+/**
+ * @brief 连接到path上的控制socket，返回阻塞的socket，并设置读写超时
+ *
+ * @param path
+ * @param timeout_ms
+ * @param fd 成功时返回socket
+ * @return core::errcode::ErrOpt 没有进程在path上监听时返回错误
+ */
+core::errcode::ErrOpt ConnectHandoff(const std::string& path, int timeout_ms, int& fd);
+
+/**
+ * @brief 在path上创建控制socket，文件系统路径的权限改为0600，
+ * 抽象命名空间没有权限，只能依赖CheckHandoffPeer
+ *
+ * @param path
+ * @param fd 成功时返回监听socket
+ * @return core::errcode::ErrOpt
+ */
+core::errcode::ErrOpt CreateHandoffListen(const std::string& path, int& fd);
+
+/* 检查控制连接对端的uid，只接受和本进程euid相同的进程 */
+core::errcode::ErrOpt CheckHandoffPeer(int fd);
+
+/* 设置控制连接的读写超时 */
+void SetHandoffTimeout(int fd, int timeout_ms);
+
+/**
+ * @brief 发送一条消息，阻塞直到全部写出或超时
+ *
+ * @param fd
+ * @param type
+ * @param payload
+ * @param fds 附带的fd会被dup，调用方仍持有原fd
+ * @return core::errcode::ErrOpt
+ */
+core::errcode::ErrOpt SendHandoffMsg(int fd, uint32_t type, const std::string& payload, const std::vector<int>& fds = {});
+
+/**
+ * @brief 接收一条完整的消息，出错时已经收到的fd会被关闭
+ *
+ * @param fd
+ * @param msg
+ * @return core::errcode::ErrOpt
+ */
+core::errcode::ErrOpt RecvHandoffMsg(int fd, HandoffMsg& msg);
+
+/* 关闭消息中收到但不需要的fd */
+void CloseHandoffFds(HandoffMsg& msg);
+
+} // namespace bbt::network::detail
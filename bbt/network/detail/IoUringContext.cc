@@ -0,0 +1,414 @@
+/**
+ * @file IoUringContext.cc
+ * @author yangqingmiao
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include <chrono>
+#include <unordered_map>
+#include <bbt/pollevent/Event.hpp>
+#include <bbt/network/detail/IoUringContext.hpp>
+
+#ifdef BBT_NETWORK_WITH_IO_URING
+#include <sys/eventfd.h>
+#include <liburing.h>
+#endif
+
+using namespace bbt::core::errcode;
+
+namespace bbt::network::detail
+{
+
+#ifdef BBT_NETWORK_WITH_IO_URING
+
+// ring的sq深度
+#define IO_URING_QUEUE_DEPTH        4096
+// 提供给内核的接收缓冲区数量，必须是2的幂
+#define IO_URING_RECV_BUF_COUNT     4096
+// 单个接收缓冲区大小，和 Connection::Recv 一致
+#define IO_URING_RECV_BUF_SIZE      4096
+// 接收缓冲区组id
+#define IO_URING_RECV_BUF_GROUP     0
+// 销毁ring前等待在途请求完成的最长时间
+#define IO_URING_DRAIN_TIMEOUT_MS   1000
+
+struct IoUringContext::Impl
+{
+    typedef std::shared_ptr<CompleteHandler> HandlerSPtr;
+
+    struct io_uring         ring;
+    bool                    ring_inited{false};
+    struct io_uring_buf_ring* buf_ring{nullptr};
+    std::vector<char>       buf_mem;
+    int                     event_fd{-1};
+
+    std::shared_ptr<Event>  completion_event{nullptr};
+    std::shared_ptr<Event>  flush_event{nullptr};
+    std::atomic_bool        flush_pending{false};
+
+    std::mutex              mutex;                  // 保护 sq 和 handlers
+    std::unordered_map<uint64_t, HandlerSPtr> handlers;
+    uint64_t                next_token{0};          // 0 保留给取消请求
+    size_t                  inflight{0};            // 已经准备、还没有最终完成的请求数，包括取消请求
+
+    /* 需要持有锁，sq满时先提交再获取 */
+    io_uring_sqe*           GetSqe()
+    {
+        auto* sqe = io_uring_get_sqe(&ring);
+        if (sqe == nullptr) {
+            io_uring_submit(&ring);
+            sqe = io_uring_get_sqe(&ring);
+        }
+        if (sqe != nullptr)
+            ++inflight;
+        return sqe;
+    }
+
+    char*                   BufferAt(int bid) { return buf_mem.data() + (size_t)bid * IO_URING_RECV_BUF_SIZE; }
+
+    void                    RecycleBuffer(int bid)
+    {
+        io_uring_buf_ring_add(buf_ring, BufferAt(bid), IO_URING_RECV_BUF_SIZE, bid,
+            io_uring_buf_ring_mask(IO_URING_RECV_BUF_COUNT), 0);
+        io_uring_buf_ring_advance(buf_ring, 1);
+    }
+};
+
+IoUringContext::IoUringContext():
+    m_impl(std::make_unique<Impl>())
+{
+}
+
+IoUringContext::~IoUringContext()
+{
+    if (m_impl->completion_event)
+        m_impl->completion_event->CancelListen();
+    if (m_impl->flush_event)
+        m_impl->flush_event->CancelListen();
+    /* 内核可能还在使用接收缓冲区和发送数据，释放前等待在途请求结束 */
+    Drain();
+    if (m_impl->buf_ring)
+        io_uring_free_buf_ring(&m_impl->ring, m_impl->buf_ring, IO_URING_RECV_BUF_COUNT, IO_URING_RECV_BUF_GROUP);
+    if (m_impl->ring_inited)
+        io_uring_queue_exit(&m_impl->ring);
+    if (m_impl->event_fd >= 0)
+        ::close(m_impl->event_fd);
+}
+
+ErrOpt IoUringContext::Init(std::shared_ptr<EvThread> thread)
+{
+    int ret = io_uring_queue_init(IO_URING_QUEUE_DEPTH, &m_impl->ring, 0);
+    if (ret < 0)
+        return FASTERR_ERROR("io_uring_queue_init failed! errno=" + std::to_string(-ret));
+    m_impl->ring_inited = true;
+
+    /* 需要内核 5.19+ */
+    m_impl->buf_ring = io_uring_setup_buf_ring(&m_impl->ring, IO_URING_RECV_BUF_COUNT, IO_URING_RECV_BUF_GROUP, 0, &ret);
+    if (m_impl->buf_ring == nullptr)
+        return FASTERR_ERROR("io_uring_setup_buf_ring failed! errno=" + std::to_string(-ret));
+
+    m_impl->buf_mem.resize((size_t)IO_URING_RECV_BUF_COUNT * IO_URING_RECV_BUF_SIZE);
+    for (int bid = 0; bid < IO_URING_RECV_BUF_COUNT; ++bid)
+        io_uring_buf_ring_add(m_impl->buf_ring, m_impl->BufferAt(bid), IO_URING_RECV_BUF_SIZE, bid,
+            io_uring_buf_ring_mask(IO_URING_RECV_BUF_COUNT), bid);
+    io_uring_buf_ring_advance(m_impl->buf_ring, IO_URING_RECV_BUF_COUNT);
+
+    m_impl->event_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_impl->event_fd < 0)
+        return FASTERR_ERROR("eventfd failed! errno=" + std::to_string(errno));
+
+    if ((ret = io_uring_register_eventfd(&m_impl->ring, m_impl->event_fd)) < 0)
+        return FASTERR_ERROR("io_uring_register_eventfd failed! errno=" + std::to_string(-ret));
+
+    auto weak_this = weak_from_this();
+    m_impl->completion_event = thread->RegisterEvent(m_impl->event_fd, EventOpt::READABLE | EventOpt::PERSIST,
+    [weak_this](int, short, EventId){
+        if (auto pthis = weak_this.lock(); pthis != nullptr)
+            pthis->OnCompletion();
+    });
+
+    m_impl->flush_event = thread->RegisterEvent(-1, EventOpt::TIMEOUT,
+    [weak_this](int, short, EventId){
+        if (auto pthis = weak_this.lock(); pthis != nullptr)
+            pthis->Flush();
+    });
+
+    if (m_impl->completion_event->StartListen(0) != 0)
+        return FASTERR_ERROR("io_uring completion event start listen failed!");
+
+    return FASTERR_NOTHING;
+}
+
+uint64_t IoUringContext::RecvMultishot(evutil_socket_t fd, const CompleteHandler& handler)
+{
+    uint64_t token = 0;
+    {
+        std::lock_guard<std::mutex> _(m_impl->mutex);
+        auto* sqe = m_impl->GetSqe();
+        if (sqe == nullptr)
+            return 0;
+
+        token = ++m_impl->next_token;
+        io_uring_prep_recv_multishot(sqe, fd, nullptr, 0, 0);
+        sqe->flags |= IOSQE_BUFFER_SELECT;
+        sqe->buf_group = IO_URING_RECV_BUF_GROUP;
+        io_uring_sqe_set_data64(sqe, token);
+        m_impl->handlers[token] = std::make_shared<CompleteHandler>(handler);
+    }
+
+    ScheduleFlush();
+    return token;
+}
+
+uint64_t IoUringContext::AcceptMultishot(evutil_socket_t fd, const CompleteHandler& handler)
+{
+    uint64_t token = 0;
+    {
+        std::lock_guard<std::mutex> _(m_impl->mutex);
+        auto* sqe = m_impl->GetSqe();
+        if (sqe == nullptr)
+            return 0;
+
+        token = ++m_impl->next_token;
+        io_uring_prep_multishot_accept(sqe, fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        io_uring_sqe_set_data64(sqe, token);
+        m_impl->handlers[token] = std::make_shared<CompleteHandler>(handler);
+    }
+
+    ScheduleFlush();
+    return token;
+}
+
+uint64_t IoUringContext::Send(evutil_socket_t fd, const char* data, size_t len, const CompleteHandler& handler)
+{
+    uint64_t token = 0;
+    {
+        std::lock_guard<std::mutex> _(m_impl->mutex);
+        auto* sqe = m_impl->GetSqe();
+        if (sqe == nullptr)
+            return 0;
+
+        token = ++m_impl->next_token;
+        io_uring_prep_send(sqe, fd, data, len, MSG_NOSIGNAL);
+        io_uring_sqe_set_data64(sqe, token);
+        m_impl->handlers[token] = std::make_shared<CompleteHandler>(handler);
+    }
+
+    ScheduleFlush();
+    return token;
+}
+
+void IoUringContext::Cancel(uint64_t token)
+{
+    if (token == 0)
+        return;
+
+    {
+        std::lock_guard<std::mutex> _(m_impl->mutex);
+        if (m_impl->handlers.erase(token) == 0)
+            return;
+
+        auto* sqe = m_impl->GetSqe();
+        if (sqe == nullptr)
+            return;
+
+        io_uring_prep_cancel64(sqe, token, 0);
+        io_uring_sqe_set_data64(sqe, 0);
+    }
+
+    ScheduleFlush();
+}
+
+void IoUringContext::ScheduleFlush()
+{
+    /* 同一轮循环只注册一次提交事件 */
+    bool expect = false;
+    if (m_impl->flush_pending.compare_exchange_strong(expect, true))
+        m_impl->flush_event->StartListen(0);
+}
+
+void IoUringContext::Flush()
+{
+    m_impl->flush_pending.exchange(false);
+    std::lock_guard<std::mutex> _(m_impl->mutex);
+    io_uring_submit(&m_impl->ring);
+}
+
+void IoUringContext::OnCompletion()
+{
+    uint64_t count;
+    while (::read(m_impl->event_fd, &count, sizeof(count)) > 0) {}
+
+    while (true) {
+        int                 res     = 0;
+        uint32_t            flags   = 0;
+        Impl::HandlerSPtr   handler = nullptr;
+        {
+            std::lock_guard<std::mutex> _(m_impl->mutex);
+            io_uring_cqe* cqe = nullptr;
+            if (io_uring_peek_cqe(&m_impl->ring, &cqe) != 0 || cqe == nullptr)
+                break;
+
+            res = cqe->res;
+            flags = cqe->flags;
+            if (!(flags & IORING_CQE_F_MORE))
+                --m_impl->inflight;
+            auto it = m_impl->handlers.find(io_uring_cqe_get_data64(cqe));
+            if (it != m_impl->handlers.end()) {
+                handler = it->second;
+                if (!(flags & IORING_CQE_F_MORE))
+                    m_impl->handlers.erase(it);
+            }
+            io_uring_cqe_seen(&m_impl->ring, cqe);
+        }
+
+        int         bid  = -1;
+        const char* data = nullptr;
+        if (flags & IORING_CQE_F_BUFFER) {
+            bid = flags >> IORING_CQE_BUFFER_SHIFT;
+            data = m_impl->BufferAt(bid);
+        }
+
+        if (handler)
+            (*handler)(res, data, flags & IORING_CQE_F_MORE);
+
+        if (bid >= 0) {
+            std::lock_guard<std::mutex> _(m_impl->mutex);
+            m_impl->RecycleBuffer(bid);
+        }
+    }
+
+    /* 回调中产生的新请求随本轮一起提交 */
+    Flush();
+}
+
+void IoUringContext::Drain()
+{
+    std::lock_guard<std::mutex> _(m_impl->mutex);
+    if (!m_impl->ring_inited)
+        return;
+
+    /* 不再回调，取消所有还在等待的请求，已经在执行的发送会正常结束 */
+    m_impl->handlers.clear();
+    if (m_impl->inflight > 0) {
+        if (auto* sqe = m_impl->GetSqe(); sqe != nullptr) {
+            io_uring_prep_cancel64(sqe, 0, IORING_ASYNC_CANCEL_ANY);
+            io_uring_sqe_set_data64(sqe, 0);
+        }
+    }
+    io_uring_submit(&m_impl->ring);
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(IO_URING_DRAIN_TIMEOUT_MS);
+    while (m_impl->inflight > 0 && std::chrono::steady_clock::now() < deadline) {
+        __kernel_timespec ts{0, 10 * 1000 * 1000};
+        io_uring_cqe* cqe = nullptr;
+        if (io_uring_wait_cqe_timeout(&m_impl->ring, &cqe, &ts) != 0 || cqe == nullptr)
+            continue;
+
+        if (!(cqe->flags & IORING_CQE_F_MORE))
+            --m_impl->inflight;
+        io_uring_cqe_seen(&m_impl->ring, cqe);
+    }
+}
+
+#else
+
+struct IoUringContext::Impl {};
+
+IoUringContext::IoUringContext() {}
+IoUringContext::~IoUringContext() {}
+
+ErrOpt IoUringContext::Init(std::shared_ptr<EvThread>)
+{
+    return FASTERR_ERROR("io_uring backend is not enabled! please build with BBT_NETWORK_WITH_IO_URING");
+}
+
+uint64_t IoUringContext::RecvMultishot(evutil_socket_t, const CompleteHandler&) { return 0; }
+uint64_t IoUringContext::AcceptMultishot(evutil_socket_t, const CompleteHandler&) { return 0; }
+uint64_t IoUringContext::Send(evutil_socket_t, const char*, size_t, const CompleteHandler&) { return 0; }
+void IoUringContext::Cancel(uint64_t) {}
+void IoUringContext::ScheduleFlush() {}
+void IoUringContext::Flush() {}
+void IoUringContext::OnCompletion() {}
+void IoUringContext::Drain() {}
+
+#endif
+
+/**
+ *  上下文由注册表持有，生命周期跟随EvThread，不会在线程上的最后一个连接
+ *  关闭时释放，避免反复创建ring和注册接收缓冲区。EvThread销毁后在下一次
+ *  查找时清理，停止的线程通过Release立即释放
+ */
+struct IoUringRegistry
+{
+    struct Entry
+    {
+        std::weak_ptr<EvThread> thread;
+        std::shared_ptr<IoUringContext> ctx;
+    };
+
+    std::mutex              mutex;
+    std::unordered_map<EvThread*, Entry> contexts;
+};
+
+static IoUringRegistry& GetRegistry()
+{
+    static IoUringRegistry registry;
+    return registry;
+}
+
+std::shared_ptr<IoUringContext> IoUringContext::GetOrCreate(std::shared_ptr<EvThread> thread, ErrOpt& err)
+{
+    if (thread == nullptr) {
+        err = FASTERR_ERROR("evthread is null!");
+        return nullptr;
+    }
+
+    /* 已经销毁的线程留下的上下文在解锁后释放，等待在途请求时不持有锁 */
+    auto& registry = GetRegistry();
+    std::vector<std::shared_ptr<IoUringContext>> expired;
+    std::lock_guard<std::mutex> _(registry.mutex);
+    for (auto it = registry.contexts.begin(); it != registry.contexts.end();) {
+        if (it->second.thread.expired()) {
+            expired.push_back(std::move(it->second.ctx));
+            it = registry.contexts.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    if (auto it = registry.contexts.find(thread.get()); it != registry.contexts.end())
+        return it->second.ctx;
+
+    auto ctx = std::make_shared<IoUringContext>();
+    if (err = ctx->Init(thread); err.has_value())
+        return nullptr;
+
+    registry.contexts[thread.get()] = IoUringRegistry::Entry{thread, ctx};
+    return ctx;
+}
+
+void IoUringContext::Release(std::shared_ptr<EvThread> thread)
+{
+    if (thread == nullptr)
+        return;
+
+    /* 在锁外释放 */
+    std::shared_ptr<IoUringContext> ctx = nullptr;
+    {
+        auto& registry = GetRegistry();
+        std::lock_guard<std::mutex> _(registry.mutex);
+        auto it = registry.contexts.find(thread.get());
+        if (it == registry.contexts.end())
+            return;
+
+        ctx = std::move(it->second.ctx);
+        registry.contexts.erase(it);
+    }
+}
+
+} // namespace bbt::network::detail
@@ -0,0 +1,88 @@
+/**
+ * @file IoUringContext.hpp
+ * @author yangqingmiao
+ * @brief io_uring io后端，每个EvThread一个ring
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#pragma once
+#include <boost/noncopyable.hpp>
+#include <bbt/pollevent/EvThread.hpp>
+#include <bbt/network/detail/Define.hpp>
+
+namespace bbt::network::detail
+{
+
+/**
+ * io_uring 上下文，和 EvThread 一一对应。
+ *
+ * ring 的完成通知通过 eventfd 注册到 EvThread 上，因此事件
+ * 循环仍然由 libevent 驱动，完成回调在 EvThread 中执行，对
+ * 上层保持原有的回调模型。
+ *
+ * 提交是批量的：Recv/Send/Accept 只准备sqe，同一轮事件循环中
+ * 准备的sqe由一个0超时的定时事件统一提交，处理完成队列后也会
+ * 顺带提交，从而减少io_uring_enter的调用次数。
+ *
+ * 上下文由EvThread持有，线程上没有连接时也保留，销毁前取消并
+ * 等待所有在途请求结束，内核不会再访问已经释放的缓冲区。
+ *
+ * 需要编译时开启 BBT_NETWORK_WITH_IO_URING，否则 GetOrCreate
+ * 总是返回错误，调用方应回退到 libevent 后端。
+ */
+class IoUringContext:
+    public std::enable_shared_from_this<IoUringContext>,
+    boost::noncopyable
+{
+public:
+    /**
+     * 完成回调
+     * res：系统调用返回值，负数为 -errno
+     * data：recv 时为内核选择的缓冲区，其余为 nullptr，回调返回后缓冲区被回收
+     * more：multishot 请求是否还会继续产生完成事件
+     */
+    typedef std::function<void(int res, const char* data, bool more)> CompleteHandler;
+
+    BBTATTR_FUNC_CTOR_HIDDEN IoUringContext();
+    ~IoUringContext();
+
+    /**
+     * @brief 获取EvThread对应的io_uring上下文，不存在则创建
+     *
+     * @param thread
+     * @param err 创建失败的原因
+     * @return std::shared_ptr<IoUringContext> 失败返回nullptr
+     */
+    static std::shared_ptr<IoUringContext> GetOrCreate(std::shared_ptr<EvThread> thread, core::errcode::ErrOpt& err);
+
+    /**
+     * @brief 释放EvThread对应的io_uring上下文，在线程停止后调用，
+     * 还在使用上下文的连接持有引用，最后一个引用释放时销毁
+     *
+     * @param thread
+     */
+    static void             Release(std::shared_ptr<EvThread> thread);
+
+    /* 以下接口线程安全，返回请求的token，失败返回0 */
+    uint64_t                RecvMultishot(evutil_socket_t fd, const CompleteHandler& handler);
+    uint64_t                AcceptMultishot(evutil_socket_t fd, const CompleteHandler& handler);
+    uint64_t                Send(evutil_socket_t fd, const char* data, size_t len, const CompleteHandler& handler);
+    /* 取消请求，被取消的请求不再回调 */
+    void                    Cancel(uint64_t token);
+
+protected:
+    core::errcode::ErrOpt   Init(std::shared_ptr<EvThread> thread);
+    void                    OnCompletion();
+    void                    Flush();
+    void                    ScheduleFlush();
+    /* 取消所有在途请求并等待完成，不再回调 */
+    void                    Drain();
+private:
+    struct Impl;
+    std::unique_ptr<Impl>   m_impl;
+};
+
+} // namespace bbt::network::detail
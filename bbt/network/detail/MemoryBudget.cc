@@ -0,0 +1,145 @@
+/**
+ * @file MemoryBudget.cc
+ * @author yangqingmiao
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include <bbt/network/detail/MemoryBudget.hpp>
+#include <bbt/network/detail/Connection.hpp>
+
+namespace bbt::network::detail
+{
+
+MemoryBudget::MemoryBudget(const MemoryBudgetOptions& opts):
+    m_opts(opts)
+{
+}
+
+std::shared_ptr<MemoryBudget> MemoryBudget::Create(const MemoryBudgetOptions& opts)
+{
+    return std::make_shared<MemoryBudget>(opts);
+}
+
+bool MemoryBudget::Charge(size_t conn_used, size_t n, bool rejectable)
+{
+    if (rejectable && m_opts.policy == emMEMORY_POLICY_REJECT_SEND) {
+        bool over_conn = m_opts.conn_limit > 0 && conn_used + n > m_opts.conn_limit;
+        bool over_global = m_opts.global_limit > 0 && m_used.load() + n > m_opts.global_limit;
+        if (over_conn || over_global) {
+            ++m_rejected_sends;
+            return false;
+        }
+    }
+
+    size_t used = (m_used += n);
+    size_t peak = m_peak.load();
+    while (used > peak && !m_peak.compare_exchange_weak(peak, used)) {}
+    return true;
+}
+
+void MemoryBudget::Release(size_t n)
+{
+    m_used -= n;
+}
+
+bool MemoryBudget::GlobalExceeded() const
+{
+    return m_opts.global_limit > 0 && m_used.load() > m_opts.global_limit;
+}
+
+bool MemoryBudget::ConnExceeded(size_t conn_used) const
+{
+    return m_opts.conn_limit > 0 && conn_used > m_opts.conn_limit;
+}
+
+bool MemoryBudget::Exceeded(size_t conn_used) const
+{
+    return GlobalExceeded() || ConnExceeded(conn_used);
+}
+
+void MemoryBudget::OnRecvThrottled()
+{
+    ++m_recv_throttled;
+}
+
+void MemoryBudget::Register(Connection* conn)
+{
+    std::lock_guard<std::mutex> _(m_conns_mutex);
+    m_conns[conn->GetConnId()] = conn;
+}
+
+void MemoryBudget::Unregister(ConnId connid)
+{
+    std::lock_guard<std::mutex> _(m_conns_mutex);
+    m_conns.erase(connid);
+}
+
+void MemoryBudget::EvictLargest()
+{
+    int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now().time_since_epoch()).count();
+    int64_t last = m_last_evict_ms.load();
+    if (now - last < MEMORY_BUDGET_EVICT_INTERVAL_MS || !m_last_evict_ms.compare_exchange_strong(last, now))
+        return;
+
+    /**
+     * 连接在关闭时持锁反注册，所以锁内的裸指针都有效。只对选中的
+     * 连接取引用，并在锁外释放，避免在锁内析构连接
+     */
+    ConnectionSPtr largest = nullptr;
+    {
+        std::lock_guard<std::mutex> _(m_conns_mutex);
+        Connection* max_conn = nullptr;
+        size_t max_used = 0;
+        for (auto& [connid, conn] : m_conns) {
+            size_t used = conn->GetMemoryUsage();
+            if (used > max_used) {
+                max_used = used;
+                max_conn = conn;
+            }
+        }
+
+        if (max_conn != nullptr)
+            largest = max_conn->weak_from_this().lock();
+    }
+
+    if (largest != nullptr)
+        largest->Evict();
+}
+
+void MemoryBudget::OnEvicted()
+{
+    ++m_evicted;
+}
+
+MemoryPolicy MemoryBudget::GetPolicy() const
+{
+    return m_opts.policy;
+}
+
+const MemoryBudgetOptions& MemoryBudget::GetOptions() const
+{
+    return m_opts;
+}
+
+MemoryStats MemoryBudget::GetStats()
+{
+    MemoryStats stats;
+    stats.used = m_used.load();
+    stats.peak = m_peak.load();
+    stats.global_limit = m_opts.global_limit;
+    stats.conn_limit = m_opts.conn_limit;
+    stats.recv_throttled = m_recv_throttled.load();
+    stats.rejected_sends = m_rejected_sends.load();
+    stats.evicted = m_evicted.load();
+    {
+        std::lock_guard<std::mutex> _(m_conns_mutex);
+        stats.connections = m_conns.size();
+    }
+    return stats;
+}
+
+} // namespace bbt::network::detail
@@ -0,0 +1,83 @@
+/**
+ * @file MemoryBudget.hpp
+ * @author yangqingmiao
+ * @brief 连接缓冲区内存预算
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#pragma once
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <unordered_map>
+#include <bbt/network/detail/Define.hpp>
+
+namespace bbt::network::detail
+{
+
+/**
+ * 内存预算，统计使用同一预算的所有连接的缓冲区占用。
+ *
+ * 占用由连接自己记账：数据追加到输出缓存时增加，写入socket或者被
+ * 丢弃时减少；分帧接收缓冲区同理。连接关闭时归还剩余的全部占用。
+ *
+ * 预算只做记账和判断，超出后的处理由连接按策略完成：暂停读取时走
+ * 和限流相同的读暂停路径；拒绝发送时AsyncSend直接返回错误；关闭
+ * 最大连接时由预算找到占用最大的连接，投递到其所在线程关闭。
+ *
+ * 可以被多个TcpServer、TcpClient共享，线程安全。
+ */
+class MemoryBudget
+{
+public:
+    explicit MemoryBudget(const MemoryBudgetOptions& opts);
+    ~MemoryBudget() = default;
+
+    static std::shared_ptr<MemoryBudget> Create(const MemoryBudgetOptions& opts);
+
+    /**
+     * @brief 连接占用增加n字节
+     *
+     * @param conn_used 连接增加前的占用
+     * @param n
+     * @param rejectable 为true且策略为拒绝发送时，超出预算则不占用
+     * @return false 被拒绝
+     */
+    bool                    Charge(size_t conn_used, size_t n, bool rejectable);
+    void                    Release(size_t n);
+    /* 全局或者连接占用是否超出预算 */
+    bool                    Exceeded(size_t conn_used) const;
+    bool                    GlobalExceeded() const;
+    bool                    ConnExceeded(size_t conn_used) const;
+    /* 记录一次因超出预算推迟的读取 */
+    void                    OnRecvThrottled();
+
+    /* 连接需要在析构前反注册，Connection::Close中完成 */
+    void                    Register(Connection* conn);
+    void                    Unregister(ConnId connid);
+    /* 关闭占用最大的连接，两次淘汰之间至少间隔MEMORY_BUDGET_EVICT_INTERVAL_MS */
+    void                    EvictLargest();
+    void                    OnEvicted();
+
+    MemoryPolicy            GetPolicy() const;
+    const MemoryBudgetOptions& GetOptions() const;
+    MemoryStats             GetStats();
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    const MemoryBudgetOptions m_opts;
+    std::atomic_size_t      m_used{0};
+    std::atomic_size_t      m_peak{0};
+    std::atomic_uint64_t    m_recv_throttled{0};
+    std::atomic_uint64_t    m_rejected_sends{0};
+    std::atomic_uint64_t    m_evicted{0};
+    std::atomic_int64_t     m_last_evict_ms{0};
+
+    std::mutex              m_conns_mutex;
+    std::unordered_map<ConnId, Connection*> m_conns;
+};
+
+} // namespace bbt::network::detail
@@ -0,0 +1,103 @@
+/**
+ * @file RateLimiter.cc
+ * @author yangqingmiao
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include <algorithm>
+#include <bbt/network/detail/RateLimiter.hpp>
+
+namespace bbt::network::detail
+{
+
+RateLimiter::RateLimiter(const RateLimitOptions& opts):
+    m_opts(opts),
+    m_recv_bytes(opts.recv_bytes_per_sec, opts.burst_bytes),
+    m_recv_msgs(opts.recv_msgs_per_sec, opts.burst_msgs),
+    m_send_bytes(opts.send_bytes_per_sec, opts.burst_bytes),
+    m_send_msgs(opts.send_msgs_per_sec, opts.burst_msgs)
+{
+}
+
+std::shared_ptr<RateLimiter> RateLimiter::Create(const RateLimitOptions& opts)
+{
+    return std::make_shared<RateLimiter>(opts);
+}
+
+const RateLimitOptions& RateLimiter::GetOptions() const
+{
+    return m_opts;
+}
+
+size_t RateLimiter::Quota(TokenBucket& bytes, size_t want)
+{
+    if (bytes.Unlimited())
+        return want;
+
+    bytes.Refill();
+    if (bytes.Available() < 1)
+        return 0;
+
+    return std::min(want, static_cast<size_t>(bytes.Available()));
+}
+
+size_t RateLimiter::RecvQuota(size_t want)
+{
+    std::lock_guard<std::mutex> _(m_mutex);
+    if (!m_recv_msgs.Unlimited()) {
+        m_recv_msgs.Refill();
+        if (m_recv_msgs.Available() < 0)
+            return 0;
+    }
+
+    return Quota(m_recv_bytes, want);
+}
+
+void RateLimiter::OnRecv(size_t bytes)
+{
+    std::lock_guard<std::mutex> _(m_mutex);
+    m_recv_bytes.Consume(bytes);
+    m_recv_msgs.Consume(1);
+}
+
+int RateLimiter::RecvWaitMS()
+{
+    std::lock_guard<std::mutex> _(m_mutex);
+    return std::max(m_recv_bytes.WaitTimeMS(), m_recv_msgs.WaitTimeMS(0));
+}
+
+size_t RateLimiter::SendQuota(size_t want)
+{
+    std::lock_guard<std::mutex> _(m_mutex);
+    if (!m_send_msgs.Unlimited()) {
+        m_send_msgs.Refill();
+        if (m_send_msgs.Available() < 0)
+            return 0;
+    }
+
+    return Quota(m_send_bytes, want);
+}
+
+void RateLimiter::OnSend(size_t bytes)
+{
+    std::lock_guard<std::mutex> _(m_mutex);
+    m_send_bytes.Consume(bytes);
+}
+
+void RateLimiter::OnSendMessage()
+{
+    std::lock_guard<std::mutex> _(m_mutex);
+    m_send_msgs.Consume(1);
+}
+
+int RateLimiter::SendWaitMS()
+{
+    std::lock_guard<std::mutex> _(m_mutex);
+    return std::max(m_send_bytes.WaitTimeMS(), m_send_msgs.WaitTimeMS(0));
+}
+
+} // namespace bbt::network::detail
@@ -0,0 +1,67 @@
+/**
+ * @file RateLimiter.hpp
+ * @author yangqingmiao
+ * @brief 连接收发限流器
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#pragma once
+#include <bbt/network/detail/TokenBucket.hpp>
+
+namespace bbt::network::detail
+{
+
+/**
+ * 收发限流器，内部由字节、消息两组令牌桶组成。
+ *
+ * 一个限流器可以只被一个连接持有（连接级限流），也可以被
+ * 多个连接共享（组级限流），因此内部加锁保证线程安全。
+ *
+ * 限流器本身不做调度，连接根据 Quota 决定本次可以读写的
+ * 字节数，为0时暂停读/写事件，并在 WaitMS 后通过所属
+ * EvThread 的定时器恢复。
+ *
+ * 消息令牌两个方向使用同一规则：可用令牌不为负时放行，放行后
+ * 扣除一个令牌，因此空桶时仍放行一条并透支，之后暂停到透支补回。
+ * 发送在AsyncSend时扣除，接收在每次读取后扣除。
+ */
+class RateLimiter
+{
+public:
+    explicit RateLimiter(const RateLimitOptions& opts);
+    ~RateLimiter() = default;
+
+    static std::shared_ptr<RateLimiter> Create(const RateLimitOptions& opts);
+
+    /* 本次最多可以接收的字节数，为0表示需要暂停读，消息令牌透支时为0 */
+    size_t                  RecvQuota(size_t want);
+    /* 记录一次接收 */
+    void                    OnRecv(size_t bytes);
+    /* 接收令牌恢复还需要的时间(ms) */
+    int                     RecvWaitMS();
+
+    /* 本次最多可以发送的字节数，为0表示需要暂停写，消息令牌透支时为0 */
+    size_t                  SendQuota(size_t want);
+    /* 记录一次写入socket的字节数 */
+    void                    OnSend(size_t bytes);
+    /* 记录一次AsyncSend，允许透支，透支期间暂停写 */
+    void                    OnSendMessage();
+    /* 发送令牌恢复还需要的时间(ms) */
+    int                     SendWaitMS();
+
+    const RateLimitOptions& GetOptions() const;
+private:
+    static size_t           Quota(TokenBucket& bytes, size_t want);
+
+    const RateLimitOptions  m_opts;
+    std::mutex              m_mutex;
+    TokenBucket             m_recv_bytes;
+    TokenBucket             m_recv_msgs;
+    TokenBucket             m_send_bytes;
+    TokenBucket             m_send_msgs;
+};
+
+} // namespace bbt::network::detail
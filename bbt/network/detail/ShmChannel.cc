@@ -0,0 +1,257 @@
+/**
+ * @file ShmChannel.cc
+ * @author yangqingmiao
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include <new>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <bbt/network/detail/ShmChannel.hpp>
+#include <bbt/network/detail/UnixSocket.hpp>
+
+using namespace bbt::core::errcode;
+
+namespace bbt::network::detail
+{
+
+static constexpr uint64_t SHM_MAGIC = 0x314d48535442424eULL;   // "NBBTSHM1"
+static constexpr int SHM_REQUIRED_SEALS = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL;
+
+// 握手消息，随消息通过SCM_RIGHTS传递 memfd、发起方门铃、接收方门铃
+struct ShmHello
+{
+    uint64_t    magic;
+    uint64_t    ring_size;
+};
+
+ShmChannel::ShmChannel(PrivateTag, bool initiator):
+    m_initiator(initiator)
+{
+}
+
+ShmChannel::~ShmChannel()
+{
+    if (m_header != nullptr)
+        ::munmap(m_header, m_map_size);
+
+    if (m_memfd >= 0)
+        ::close(m_memfd);
+
+    for (int efd : m_efds) {
+        if (efd >= 0)
+            ::close(efd);
+    }
+}
+
+size_t ShmChannel::MapSize(size_t ring_size)
+{
+    /* 控制块单独占用若干页，数据区按页对齐 */
+    size_t page = ::sysconf(_SC_PAGESIZE);
+    size_t header = (sizeof(Header) + page - 1) / page * page;
+    return header + 2 * ring_size;
+}
+
+ErrOpt ShmChannel::Create(size_t ring_size, std::shared_ptr<ShmChannel>& channel)
+{
+    if (ring_size == 0 || (ring_size & (ring_size - 1)) != 0)
+        return FASTERR_ERROR("shm ring size must be power of 2! size=" + std::to_string(ring_size));
+
+    auto shm = std::make_shared<ShmChannel>(PrivateTag{}, true);
+
+    int memfd = ::memfd_create("bbt_network_shm", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (memfd < 0)
+        return FASTERR_ERROR("memfd_create failed! " + std::string{strerror(errno)});
+
+    shm->m_memfd = memfd;
+    if (::ftruncate(memfd, MapSize(ring_size)) != 0)
+        return FASTERR_ERROR("ftruncate memfd failed! " + std::string{strerror(errno)});
+
+    /* 固定大小，接收方映射后不用担心被截断，接收方会检查封印 */
+    if (::fcntl(memfd, F_ADD_SEALS, SHM_REQUIRED_SEALS) != 0)
+        return FASTERR_ERROR("seal memfd failed! " + std::string{strerror(errno)});
+
+    for (int& efd : shm->m_efds) {
+        efd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (efd < 0)
+            return FASTERR_ERROR("create eventfd failed! " + std::string{strerror(errno)});
+    }
+
+    if (auto err = shm->Map(memfd, ring_size); err.has_value())
+        return err;
+
+    new (shm->m_header) Header();
+    shm->m_header->ring_size = ring_size;
+    shm->m_header->magic = SHM_MAGIC;
+
+    channel = shm;
+    return FASTERR_NOTHING;
+}
+
+ErrOpt ShmChannel::SendHello(evutil_socket_t sockfd)
+{
+    ShmHello hello{SHM_MAGIC, m_ring_size};
+    std::vector<int> fds{m_memfd, m_efds[0], m_efds[1]};
+
+    ssize_t n = SendWithFds(sockfd, reinterpret_cast<const char*>(&hello), sizeof(hello), fds);
+    if (n != (ssize_t)sizeof(hello))
+        return FASTERR_ERROR("send shm hello failed! " + std::string{n < 0 ? strerror(errno) : "partial write"});
+
+    return FASTERR_NOTHING;
+}
+
+size_t ShmChannel::HelloSize()
+{
+    return sizeof(ShmHello);
+}
+
+ErrOpt ShmChannel::Accept(const char* data, size_t len, std::vector<int>& fds, std::shared_ptr<ShmChannel>& channel)
+{
+    auto shm = std::make_shared<ShmChannel>(PrivateTag{}, false);
+
+    /* fd先交给通道，出错时由析构关闭 */
+    if (fds.size() >= 1) shm->m_memfd = fds[0];
+    if (fds.size() >= 2) shm->m_efds[0] = fds[1];
+    if (fds.size() >= 3) shm->m_efds[1] = fds[2];
+    for (size_t i = 3; i < fds.size(); ++i)
+        ::close(fds[i]);
+    fds.clear();
+
+    ShmHello hello;
+    if (len != sizeof(hello) || shm->m_efds[1] < 0)
+        return FASTERR_ERROR("bad shm hello! len=" + std::to_string(len));
+
+    memcpy(&hello, data, sizeof(hello));
+    if (hello.magic != SHM_MAGIC || hello.ring_size == 0 || (hello.ring_size & (hello.ring_size - 1)) != 0)
+        return FASTERR_ERROR("bad shm hello magic or ring size!");
+
+    /* 没有封住大小时对端可以在映射后截断memfd，访问映射会触发SIGBUS */
+    int seals = ::fcntl(shm->m_memfd, F_GET_SEALS);
+    if (seals < 0 || (seals & SHM_REQUIRED_SEALS) != SHM_REQUIRED_SEALS)
+        return FASTERR_ERROR("shm memfd is not sealed!");
+
+    /* 不信任对端声明的大小，以memfd的实际大小为准 */
+    struct stat st;
+    if (::fstat(shm->m_memfd, &st) != 0 || (size_t)st.st_size != MapSize(hello.ring_size))
+        return FASTERR_ERROR("shm memfd size mismatch!");
+
+    if (auto err = shm->Map(shm->m_memfd, hello.ring_size); err.has_value())
+        return err;
+
+    if (shm->m_header->magic != SHM_MAGIC || shm->m_header->ring_size != hello.ring_size)
+        return FASTERR_ERROR("shm header mismatch!");
+
+    channel = shm;
+    return FASTERR_NOTHING;
+}
+
+ErrOpt ShmChannel::Map(int memfd, size_t ring_size)
+{
+    size_t map_size = MapSize(ring_size);
+    void* addr = ::mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, memfd, 0);
+    if (addr == MAP_FAILED)
+        return FASTERR_ERROR("mmap shm failed! " + std::string{strerror(errno)});
+
+    m_header = static_cast<Header*>(addr);
+    m_data = static_cast<char*>(addr) + (map_size - 2 * ring_size);
+    m_map_size = map_size;
+    m_ring_size = ring_size;
+    return FASTERR_NOTHING;
+}
+
+size_t ShmChannel::Write(const char* data, size_t len)
+{
+    auto& ctrl = TxCtrl();
+    uint64_t head = ctrl.head.load(std::memory_order_relaxed);
+    uint64_t tail = ctrl.tail.load(std::memory_order_acquire);
+    size_t n = std::min<size_t>(len, m_ring_size - (head - tail));
+    if (n == 0)
+        return 0;
+
+    size_t offset = head & (m_ring_size - 1);
+    size_t first = std::min(n, m_ring_size - offset);
+    memcpy(TxRing() + offset, data, first);
+    if (n > first)
+        memcpy(TxRing(), data + first, n - first);
+
+    ctrl.head.store(head + n, std::memory_order_release);
+
+    /* 和WaitForData配对，保证对端要么看到新数据，要么我们看到等待标志 */
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (ctrl.consumer_waiting.load(std::memory_order_relaxed) && ctrl.consumer_waiting.exchange(0))
+        Notify(m_efds[m_initiator ? 1 : 0]);
+
+    return n;
+}
+
+size_t ShmChannel::Readable() const
+{
+    auto& ctrl = RxCtrl();
+    return ctrl.head.load(std::memory_order_acquire) - ctrl.tail.load(std::memory_order_relaxed);
+}
+
+size_t ShmChannel::Writable() const
+{
+    auto& ctrl = TxCtrl();
+    return m_ring_size - (ctrl.head.load(std::memory_order_relaxed) - ctrl.tail.load(std::memory_order_acquire));
+}
+
+bool ShmChannel::WaitForData()
+{
+    auto& ctrl = RxCtrl();
+    ctrl.consumer_waiting.store(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (Readable() == 0)
+        return true;
+
+    ctrl.consumer_waiting.store(0);
+    return false;
+}
+
+bool ShmChannel::WaitForSpace()
+{
+    auto& ctrl = TxCtrl();
+    ctrl.producer_waiting.store(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (Writable() == 0)
+        return true;
+
+    ctrl.producer_waiting.store(0);
+    return false;
+}
+
+int ShmChannel::GetNotifyFd() const
+{
+    return m_efds[m_initiator ? 0 : 1];
+}
+
+void ShmChannel::DrainNotify()
+{
+    uint64_t value = 0;
+    while (::read(GetNotifyFd(), &value, sizeof(value)) > 0);
+}
+
+void ShmChannel::NotifySelf()
+{
+    Notify(GetNotifyFd());
+}
+
+void ShmChannel::Notify(int efd)
+{
+    uint64_t value = 1;
+    ssize_t n = ::write(efd, &value, sizeof(value));
+    (void)n;
+}
+
+size_t ShmChannel::GetRingSize() const
+{
+    return m_ring_size;
+}
+
+} // namespace bbt::network::detail
@@ -0,0 +1,175 @@
+/**
+ * @file ShmChannel.hpp
+ * @author yangqingmiao
+ * @brief 同主机进程间的共享内存双向通道
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#pragma once
+#include <atomic>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <bbt/network/detail/Define.hpp>
+
+namespace bbt::network::detail
+{
+
+/**
+ * 共享内存通道。
+ *
+ * 一个memfd中放两个单生产者单消费者的字节环形缓冲区，每个方向一个。
+ * 双方各有一个eventfd作为门铃，注册到自己的 EvThread 上。
+ *
+ * 门铃只在对方准备阻塞等待时才敲：消费方读空后置consumer_waiting，
+ * 生产方写入后发现该标志才写eventfd；生产方写满后置producer_waiting，
+ * 消费方腾出空间后发现该标志才写eventfd。双方都在忙时收发完全不经
+ * 过系统调用。
+ *
+ * 握手由发起方完成：创建memfd和两个eventfd，通过AF_UNIX连接以
+ * SCM_RIGHTS发给接收方，之后数据只经过共享内存。
+ *
+ * 同一时刻只能有一个线程写、一个线程读。
+ */
+class ShmChannel:
+    boost::noncopyable
+{
+    struct PrivateTag {};
+public:
+    BBTATTR_FUNC_CTOR_HIDDEN ShmChannel(PrivateTag, bool initiator);
+    ~ShmChannel();
+
+    /**
+     * @brief 发起方创建通道
+     *
+     * @param ring_size 单向环形缓冲区大小，必须是2的幂
+     * @param channel 成功时返回通道
+     * @return core::errcode::ErrOpt
+     */
+    static core::errcode::ErrOpt Create(size_t ring_size, std::shared_ptr<ShmChannel>& channel);
+
+    /**
+     * @brief 发起方把握手消息和fd发给接收方
+     *
+     * @param sockfd AF_UNIX连接
+     * @return core::errcode::ErrOpt
+     */
+    core::errcode::ErrOpt   SendHello(evutil_socket_t sockfd);
+
+    /**
+     * @brief 接收方根据收到的握手消息和fd映射通道，无论成功与否都会取走fds的所有权
+     *
+     * @param data 握手消息
+     * @param len
+     * @param fds 随握手消息收到的fd
+     * @param channel 成功时返回通道
+     * @return core::errcode::ErrOpt
+     */
+    static core::errcode::ErrOpt Accept(const char* data, size_t len, std::vector<int>& fds, std::shared_ptr<ShmChannel>& channel);
+
+    /* 握手消息长度 */
+    static size_t           HelloSize();
+
+    /**
+     * @brief 写入发送环，返回实际写入的字节数，环满时可能小于len
+     */
+    size_t                  Write(const char* data, size_t len);
+
+    /**
+     * @brief 读取接收环，on_data直接拿到共享内存中的数据，不做拷贝，
+     * 数据在on_data返回前有效。环形回绕时on_data会被调用两次
+     *
+     * @param max 最多读取的字节数
+     * @param on_data void(const char*, size_t)
+     * @return size_t 读取的字节数
+     */
+    template<class F>
+    size_t                  Read(size_t max, F&& on_data);
+
+    size_t                  Readable() const;
+    size_t                  Writable() const;
+
+    /**
+     * @brief 准备阻塞等待数据，返回false表示已经有数据可读，不需要等待
+     */
+    bool                    WaitForData();
+
+    /**
+     * @brief 准备阻塞等待发送环的空间，返回false表示已经有空间，不需要等待
+     */
+    bool                    WaitForSpace();
+
+    /* 自己的门铃，可读时说明有数据或有空间 */
+    int                     GetNotifyFd() const;
+    /* 清空门铃计数 */
+    void                    DrainNotify();
+    /* 敲自己的门铃，用于读取预算用完后在下一轮事件循环继续读取 */
+    void                    NotifySelf();
+    size_t                  GetRingSize() const;
+
+protected:
+    struct alignas(64) RingCtrl
+    {
+        alignas(64) std::atomic<uint64_t> head{0};     // 生产者写入位置
+        alignas(64) std::atomic<uint64_t> tail{0};     // 消费者读取位置
+        alignas(64) std::atomic<uint32_t> consumer_waiting{0};
+        std::atomic<uint32_t>             producer_waiting{0};
+    };
+
+    struct Header
+    {
+        uint64_t    magic{0};
+        uint64_t    ring_size{0};
+        RingCtrl    rings[2];                   // [0] 发起方->接收方，[1] 接收方->发起方
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared memory atomics must be lock free");
+
+    static size_t           MapSize(size_t ring_size);
+    core::errcode::ErrOpt   Map(int memfd, size_t ring_size);
+    void                    Notify(int efd);
+
+    RingCtrl&               TxCtrl() const { return m_header->rings[m_initiator ? 0 : 1]; }
+    RingCtrl&               RxCtrl() const { return m_header->rings[m_initiator ? 1 : 0]; }
+    char*                   TxRing() const { return m_data + (m_initiator ? 0 : m_ring_size); }
+    char*                   RxRing() const { return m_data + (m_initiator ? m_ring_size : 0); }
+
+private:
+    const bool              m_initiator;
+    int                     m_memfd{-1};
+    int                     m_efds[2]{-1, -1};          // [0] 发起方的门铃，[1] 接收方的门铃
+    Header*                 m_header{nullptr};
+    char*                   m_data{nullptr};
+    size_t                  m_map_size{0};
+    size_t                  m_ring_size{0};
+};
+
+template<class F>
+size_t ShmChannel::Read(size_t max, F&& on_data)
+{
+    auto& ctrl = RxCtrl();
+    uint64_t head = ctrl.head.load(std::memory_order_acquire);
+    uint64_t tail = ctrl.tail.load(std::memory_order_relaxed);
+    size_t len = std::min<size_t>(head - tail, max);
+    if (len == 0)
+        return 0;
+
+    /* tail推进前生产者不会覆盖这段数据，可以直接交给上层 */
+    size_t offset = tail & (m_ring_size - 1);
+    size_t first = std::min(len, m_ring_size - offset);
+    on_data(RxRing() + offset, first);
+    if (len > first)
+        on_data(RxRing(), len - first);
+
+    ctrl.tail.store(tail + len, std::memory_order_release);
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (ctrl.producer_waiting.load(std::memory_order_relaxed) && ctrl.producer_waiting.exchange(0))
+        Notify(m_efds[m_initiator ? 1 : 0]);
+
+    return len;
+}
+
+} // namespace bbt::network::detail
@@ -0,0 +1,74 @@
+/**
+ * @file SocketOptions.cc
+ * @author yangqingmiao
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include <string>
+#include <cstring>
+#include <netinet/tcp.h>
+#include <bbt/network/detail/SocketOptions.hpp>
+
+using namespace bbt::core::errcode;
+
+namespace bbt::network::detail
+{
+
+static bool SetIntOpt(evutil_socket_t fd, int level, int optname, int value)
+{
+    return ::setsockopt(fd, level, optname, &value, sizeof(value)) == 0;
+}
+
+core::errcode::ErrOpt ApplySocketOptions(evutil_socket_t fd, const SocketOptions& opts)
+{
+    std::string failed;
+    auto apply = [fd, &failed](const char* name, int level, int optname, int value) {
+        if (!SetIntOpt(fd, level, optname, value))
+            failed += std::string{name} + "(" + std::string{strerror(errno)} + ") ";
+    };
+
+    if (opts.tcp_nodelay.has_value())
+        apply("TCP_NODELAY", IPPROTO_TCP, TCP_NODELAY, opts.tcp_nodelay.value() ? 1 : 0);
+    if (opts.send_buffer.has_value())
+        apply("SO_SNDBUF", SOL_SOCKET, SO_SNDBUF, opts.send_buffer.value());
+    if (opts.recv_buffer.has_value())
+        apply("SO_RCVBUF", SOL_SOCKET, SO_RCVBUF, opts.recv_buffer.value());
+    if (opts.keepalive.has_value())
+        apply("SO_KEEPALIVE", SOL_SOCKET, SO_KEEPALIVE, opts.keepalive.value() ? 1 : 0);
+    if (opts.keepalive_idle_s.has_value())
+        apply("TCP_KEEPIDLE", IPPROTO_TCP, TCP_KEEPIDLE, opts.keepalive_idle_s.value());
+    if (opts.keepalive_interval_s.has_value())
+        apply("TCP_KEEPINTVL", IPPROTO_TCP, TCP_KEEPINTVL, opts.keepalive_interval_s.value());
+    if (opts.keepalive_count.has_value())
+        apply("TCP_KEEPCNT", IPPROTO_TCP, TCP_KEEPCNT, opts.keepalive_count.value());
+#ifdef TCP_NOTSENT_LOWAT
+    if (opts.notsent_lowat.has_value())
+        apply("TCP_NOTSENT_LOWAT", IPPROTO_TCP, TCP_NOTSENT_LOWAT, opts.notsent_lowat.value());
+#endif
+#ifdef SO_BUSY_POLL
+    if (opts.busy_poll_us.has_value())
+        apply("SO_BUSY_POLL", SOL_SOCKET, SO_BUSY_POLL, opts.busy_poll_us.value());
+#endif
+#ifdef TCP_QUICKACK
+    if (opts.quickack.has_value())
+        apply("TCP_QUICKACK", IPPROTO_TCP, TCP_QUICKACK, opts.quickack.value() ? 1 : 0);
+#endif
+
+    if (!failed.empty())
+        return FASTERR_ERROR("set socket option failed! fd=" + std::to_string(fd) + " " + failed);
+
+    return FASTERR_NOTHING;
+}
+
+void ReArmQuickAck(evutil_socket_t fd)
+{
+#ifdef TCP_QUICKACK
+    SetIntOpt(fd, IPPROTO_TCP, TCP_QUICKACK, 1);
+#endif
+}
+
+} // namespace bbt::network::detail
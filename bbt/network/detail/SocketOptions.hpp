@@ -0,0 +1,35 @@
+/**
+ * @file SocketOptions.hpp
+ * @author yangqingmiao
+ * @brief socket选项设置
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#pragma once
+#include <bbt/network/detail/Define.hpp>
+
+namespace bbt::network::detail
+{
+
+/**
+ * @brief 将opts中设置过的选项应用到socket上
+ * 某个选项设置失败不会中断后续选项的设置，返回的错误中
+ * 包含所有失败的选项
+ *
+ * @param fd
+ * @param opts
+ * @return core::errcode::ErrOpt
+ */
+core::errcode::ErrOpt ApplySocketOptions(evutil_socket_t fd, const SocketOptions& opts);
+
+/**
+ * @brief 重新打开TCP_QUICKACK，内核在ack之后会自动关闭该选项
+ *
+ * @param fd
+ */
+void ReArmQuickAck(evutil_socket_t fd);
+
+} // namespace bbt::network::detail
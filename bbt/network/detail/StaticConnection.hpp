@@ -0,0 +1,106 @@
+/**
+ * @file StaticConnection.hpp
+ * @author yangqingmiao
+ * @brief 静态类型Handler的连接，事件直接派发给Handler
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#pragma once
+#include <bbt/network/detail/Connection.hpp>
+
+namespace bbt::network::detail
+{
+
+// 创建连接对象，用于替换默认的Connection
+typedef std::function<ConnectionSPtr(std::weak_ptr<EvThread>, evutil_socket_t, const IPAddress&)> ConnFactory;
+
+/**
+ * 默认的空Handler，用户Handler继承它后只需要实现关心的事件，
+ * 同名函数会隐藏这里的实现，调用在编译期确定。
+ *
+ * Handler需要提供以下函数（不需要是虚函数）：
+ *  void OnRecv(Connection& conn, const char* data, size_t len);
+ *  void OnSend(Connection& conn, core::errcode::ErrOpt err, size_t len);
+ *  void OnTimeout(Connection& conn);
+ *  void OnClose(ConnId connid, const IPAddress& addr);
+ */
+struct StaticHandlerBase
+{
+    void OnRecv(Connection&, const char*, size_t) {}
+    void OnSend(Connection&, core::errcode::ErrOpt, size_t) {}
+    void OnTimeout(Connection&) {}
+    void OnClose(ConnId, const IPAddress&) {}
+};
+
+/**
+ * 通过静态类型的Handler派发事件的连接。
+ *
+ * 默认Connection的每次收发回调要经过多层std::function、weak_ptr
+ * 的lock和shared_from_this的引用计数，TcpServer还会为每次接收构
+ * 造一个Buffer。StaticConnection覆盖了事件派发函数，直接调用
+ * Handler，除了一次虚函数调用外，Handler的实现可以被内联，收发
+ * 路径上没有类型擦除和引用计数操作。
+ *
+ * 关闭事件在通知Handler后仍然走ConnCallbacks，让TcpServer、
+ * TcpClient完成连接的清理；错误仍然通过OnErr通知。
+ *
+ * Handler由所有连接共享，回调在连接所属的EvThread中执行，多线程
+ * 时Handler需要自己保证线程安全。
+ */
+template<class Handler>
+class StaticConnection final:
+    public Connection
+{
+public:
+    StaticConnection(std::weak_ptr<EvThread> thread, evutil_socket_t socket, const IPAddress& ipaddr, std::shared_ptr<Handler> handler):
+        Connection(thread, socket, ipaddr),
+        m_handler(handler.get()),
+        m_handler_holder(handler)
+    {
+        Assert(m_handler != nullptr);
+    }
+
+    ~StaticConnection()
+    {
+        /* 基类析构中的Close无法派发到派生类，需要在这里关闭 */
+        Close();
+    }
+
+    static ConnectionSPtr Create(std::weak_ptr<EvThread> thread, evutil_socket_t socket, const IPAddress& ipaddr, std::shared_ptr<Handler> handler)
+    {
+        return std::make_shared<StaticConnection<Handler>>(thread, socket, ipaddr, handler);
+    }
+
+    /**
+     * @brief 获取创建连接的工厂，用于TcpServer、TcpClient
+     */
+    static ConnFactory      Factory(std::shared_ptr<Handler> handler)
+    {
+        return [handler](std::weak_ptr<EvThread> thread, evutil_socket_t socket, const IPAddress& ipaddr) {
+            return Create(thread, socket, ipaddr, handler);
+        };
+    }
+
+    Handler&                GetHandler() { return *m_handler; }
+    /* 数据直接派发给Handler */
+    bool                    DeliversRecvCallback() const override { return false; }
+
+protected:
+    void                    OnRecv(const char* data, size_t len) override { m_handler->OnRecv(*this, data, len); }
+    void                    OnSend(core::errcode::ErrOpt err, size_t succ_len) override { m_handler->OnSend(*this, err, succ_len); }
+    void                    OnTimeout() override { m_handler->OnTimeout(*this); }
+    void                    OnClose() override
+    {
+        m_handler->OnClose(GetConnId(), GetPeerAddress());
+        Connection::OnClose();
+    }
+
+private:
+    Handler*                m_handler{nullptr};         // 派发时直接使用裸指针
+    std::shared_ptr<Handler> m_handler_holder{nullptr}; // 只用于保证Handler的生命期
+};
+
+} // namespace bbt::network::detail
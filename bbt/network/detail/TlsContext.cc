@@ -0,0 +1,418 @@
+/**
+ * @file TlsContext.cc
+ * @author yangqingmiao
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include <mutex>
+#include <atomic>
+#include <climits>
+#include <algorithm>
+#include <bbt/network/detail/TlsContext.hpp>
+
+#ifdef BBT_NETWORK_WITH_OPENSSL
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#endif
+
+using namespace bbt::core::errcode;
+
+namespace bbt::network::detail
+{
+
+#ifdef BBT_NETWORK_WITH_OPENSSL
+
+// 服务端会话缓存的id上下文，开启会话恢复时必须设置
+static const unsigned char TLS_SESSION_ID_CONTEXT[] = "bbt_network";
+
+static std::string SslError()
+{
+    char buf[256];
+    unsigned long code = ERR_get_error();
+    if (code == 0)
+        return "unknown ssl error (errno=" + std::to_string(errno) + ")";
+
+    ERR_error_string_n(code, buf, sizeof(buf));
+    ERR_clear_error();
+    return buf;
+}
+
+struct TlsContext::Impl
+{
+    SSL_CTX*                ctx{nullptr};
+
+    /* 客户端缓存的最近一次会话，用于重连时恢复 */
+    std::mutex              session_mutex;
+    SSL_SESSION*            session{nullptr};
+
+    std::atomic_uint64_t    handshakes{0};
+    std::atomic_uint64_t    resumed{0};
+    std::atomic_uint64_t    failed{0};
+    std::atomic_uint64_t    ktls_send{0};
+    std::atomic_uint64_t    ktls_recv{0};
+
+    ~Impl()
+    {
+        if (session != nullptr)
+            SSL_SESSION_free(session);
+        if (ctx != nullptr)
+            SSL_CTX_free(ctx);
+    }
+
+    /* tls1.3的会话在握手后才由服务端下发，通过回调保存 */
+    static int OnNewSession(SSL* ssl, SSL_SESSION* session)
+    {
+        auto* impl = static_cast<Impl*>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+        if (impl == nullptr)
+            return 0;
+
+        std::lock_guard<std::mutex> _(impl->session_mutex);
+        if (impl->session != nullptr)
+            SSL_SESSION_free(impl->session);
+        impl->session = session;
+        return 1;   // 取得session的所有权
+    }
+};
+
+TlsContext::TlsContext(PrivateTag, const TlsOptions& opts, bool server):
+    m_impl(std::make_unique<Impl>()),
+    m_opts(opts),
+    m_server(server)
+{
+}
+
+TlsContext::~TlsContext()
+{
+}
+
+ErrOpt TlsContext::Init()
+{
+    SSL_CTX* ctx = SSL_CTX_new(m_server ? TLS_server_method() : TLS_client_method());
+    if (ctx == nullptr)
+        return FASTERR_ERROR("create ssl ctx failed! " + SslError());
+
+    m_impl->ctx = ctx;
+    SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+    /* 发送缓存在连接输出缓存中，重试时地址可能变化 */
+    SSL_CTX_set_mode(ctx, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+    /* 对端不发close_notify直接关闭时按正常关闭处理 */
+    SSL_CTX_set_options(ctx, SSL_OP_IGNORE_UNEXPECTED_EOF);
+#endif
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+    if (m_opts.ktls)
+        SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+#endif
+
+    if (!m_opts.ciphers.empty() && SSL_CTX_set_cipher_list(ctx, m_opts.ciphers.c_str()) != 1)
+        return FASTERR_ERROR("set ciphers failed! " + SslError());
+
+    if (m_server && (m_opts.cert_file.empty() || m_opts.key_file.empty()))
+        return FASTERR_ERROR("tls server requires cert_file and key_file!");
+
+    if (!m_opts.cert_file.empty()) {
+        if (SSL_CTX_use_certificate_chain_file(ctx, m_opts.cert_file.c_str()) != 1)
+            return FASTERR_ERROR("load cert failed! file=" + m_opts.cert_file + " " + SslError());
+        if (SSL_CTX_use_PrivateKey_file(ctx, m_opts.key_file.c_str(), SSL_FILETYPE_PEM) != 1)
+            return FASTERR_ERROR("load private key failed! file=" + m_opts.key_file + " " + SslError());
+        if (SSL_CTX_check_private_key(ctx) != 1)
+            return FASTERR_ERROR("private key does not match cert! " + SslError());
+    }
+
+    /* 客户端默认校验服务端证书和主机名，只有显式设置insecure时跳过 */
+    bool verify = m_server ? m_opts.verify_peer : !m_opts.insecure;
+    if (!m_server && verify && m_opts.server_name.empty())
+        return FASTERR_ERROR("tls client requires server_name to verify the peer! set insecure to skip verification");
+
+    if (verify) {
+        SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER | (m_server ? SSL_VERIFY_FAIL_IF_NO_PEER_CERT : 0), nullptr);
+        int ret = m_opts.ca_file.empty() ?
+            SSL_CTX_set_default_verify_paths(ctx) :
+            SSL_CTX_load_verify_locations(ctx, m_opts.ca_file.c_str(), nullptr);
+        if (ret != 1)
+            return FASTERR_ERROR("load ca failed! " + SslError());
+    }
+
+    if (!m_opts.session_resumption) {
+        SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+    } else if (m_server) {
+        SSL_CTX_set_session_id_context(ctx, TLS_SESSION_ID_CONTEXT, sizeof(TLS_SESSION_ID_CONTEXT) - 1);
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+    } else {
+        SSL_CTX_set_app_data(ctx, m_impl.get());
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(ctx, &Impl::OnNewSession);
+    }
+
+    return FASTERR_NOTHING;
+}
+
+TlsStats TlsContext::GetStats() const
+{
+    TlsStats stats;
+    stats.handshakes = m_impl->handshakes;
+    stats.resumed = m_impl->resumed;
+    stats.failed = m_impl->failed;
+    stats.ktls_send = m_impl->ktls_send;
+    stats.ktls_recv = m_impl->ktls_recv;
+    return stats;
+}
+
+struct TlsSession::Impl
+{
+    std::shared_ptr<TlsContext> ctx{nullptr};
+    SSL*                    ssl{nullptr};
+    bool                    established{false};
+    bool                    ktls_send{false};
+    bool                    ktls_recv{false};
+    size_t                  retry_len{0};               // 上一次未完成的写的长度
+
+    ~Impl()
+    {
+        if (ssl != nullptr)
+            SSL_free(ssl);
+    }
+
+    /* 把SSL_get_error转换为TlsStatus */
+    TlsStatus Status(int ret, const std::string& what, ErrOpt& err)
+    {
+        int code = SSL_get_error(ssl, ret);
+        switch (code) {
+        case SSL_ERROR_WANT_READ:
+            return emTLS_WANT_READ;
+        case SSL_ERROR_WANT_WRITE:
+            return emTLS_WANT_WRITE;
+        case SSL_ERROR_ZERO_RETURN:
+            return emTLS_CLOSED;
+        case SSL_ERROR_SYSCALL:
+            if (errno == 0 || errno == ECONNRESET || errno == EPIPE)
+                return emTLS_CLOSED;
+            [[fallthrough]];
+        default:
+            err = FASTERR_ERROR("tls " + what + " failed! " + SslError());
+            return emTLS_ERROR;
+        }
+    }
+};
+
+TlsSession::TlsSession(PrivateTag, std::shared_ptr<TlsContext> ctx):
+    m_impl(std::make_unique<Impl>())
+{
+    m_impl->ctx = ctx;
+}
+
+TlsSession::~TlsSession()
+{
+}
+
+ErrOpt TlsSession::Create(std::shared_ptr<TlsContext> ctx, evutil_socket_t fd, std::unique_ptr<TlsSession>& session)
+{
+    if (ctx == nullptr)
+        return FASTERR_ERROR("tls context is null!");
+
+    auto tls = std::make_unique<TlsSession>(PrivateTag{}, ctx);
+    auto& impl = *tls->m_impl;
+    const auto& opts = ctx->GetOptions();
+
+    impl.ssl = SSL_new(ctx->m_impl->ctx);
+    if (impl.ssl == nullptr || SSL_set_fd(impl.ssl, fd) != 1)
+        return FASTERR_ERROR("create ssl failed! " + SslError());
+
+    if (ctx->IsServer()) {
+        SSL_set_accept_state(impl.ssl);
+    } else {
+        SSL_set_connect_state(impl.ssl);
+        if (!opts.server_name.empty())
+            SSL_set_tlsext_host_name(impl.ssl, opts.server_name.c_str());
+        if (!opts.insecure)
+            SSL_set1_host(impl.ssl, opts.server_name.c_str());
+
+        std::lock_guard<std::mutex> _(ctx->m_impl->session_mutex);
+        if (ctx->m_impl->session != nullptr)
+            SSL_set_session(impl.ssl, ctx->m_impl->session);
+    }
+
+    session = std::move(tls);
+    return FASTERR_NOTHING;
+}
+
+TlsStatus TlsSession::Handshake(ErrOpt& err)
+{
+    auto& impl = *m_impl;
+    if (impl.established)
+        return emTLS_OK;
+
+    ERR_clear_error();
+    int ret = SSL_do_handshake(impl.ssl);
+    if (ret != 1) {
+        auto status = impl.Status(ret, "handshake", err);
+        if (status == emTLS_ERROR || status == emTLS_CLOSED)
+            ++impl.ctx->m_impl->failed;
+        return status;
+    }
+
+    impl.established = true;
+#ifndef OPENSSL_NO_KTLS
+    impl.ktls_send = BIO_get_ktls_send(SSL_get_wbio(impl.ssl));
+    impl.ktls_recv = BIO_get_ktls_recv(SSL_get_rbio(impl.ssl));
+#endif
+
+    auto& stats = *impl.ctx->m_impl;
+    ++stats.handshakes;
+    if (SSL_session_reused(impl.ssl)) ++stats.resumed;
+    if (impl.ktls_send) ++stats.ktls_send;
+    if (impl.ktls_recv) ++stats.ktls_recv;
+    return emTLS_OK;
+}
+
+TlsStatus TlsSession::Read(char* buf, size_t len, size_t& read_len, ErrOpt& err)
+{
+    read_len = 0;
+    ERR_clear_error();
+    int ret = SSL_read(m_impl->ssl, buf, std::min<size_t>(len, INT_MAX));
+    if (ret > 0) {
+        read_len = ret;
+        return emTLS_OK;
+    }
+
+    return m_impl->Status(ret, "read", err);
+}
+
+TlsStatus TlsSession::Write(const char* buf, size_t len, size_t& written, ErrOpt& err)
+{
+    auto& impl = *m_impl;
+    written = 0;
+    if (len < impl.retry_len)
+        return emTLS_WANT_WRITE;
+
+    while (written < len) {
+        ERR_clear_error();
+        int want = std::min<size_t>(len - written, INT_MAX);
+        int ret = SSL_write(impl.ssl, buf + written, want);
+        if (ret > 0) {
+            impl.retry_len = 0;
+            written += ret;
+            continue;
+        }
+
+        auto status = impl.Status(ret, "write", err);
+        if (status == emTLS_WANT_READ || status == emTLS_WANT_WRITE)
+            impl.retry_len = want;
+        return status;
+    }
+
+    return emTLS_OK;
+}
+
+ssize_t TlsSession::SendFile(int fd, off_t offset, size_t len)
+{
+#ifndef OPENSSL_NO_KTLS
+    if (m_impl->ktls_send) {
+        ERR_clear_error();
+        return SSL_sendfile(m_impl->ssl, fd, offset, len, 0);
+    }
+#endif
+    errno = ENOTSUP;
+    return -1;
+}
+
+size_t TlsSession::Pending() const
+{
+    return SSL_pending(m_impl->ssl);
+}
+
+size_t TlsSession::RetryLen() const
+{
+    return m_impl->retry_len;
+}
+
+void TlsSession::Shutdown()
+{
+    if (!m_impl->established)
+        return;
+
+    ERR_clear_error();
+    SSL_shutdown(m_impl->ssl);
+    ERR_clear_error();
+}
+
+bool TlsSession::IsResumed() const
+{
+    return m_impl->established && SSL_session_reused(m_impl->ssl);
+}
+
+#else
+
+struct TlsContext::Impl {};
+struct TlsSession::Impl { bool established{false}; bool ktls_send{false}; bool ktls_recv{false}; };
+
+TlsContext::TlsContext(PrivateTag, const TlsOptions& opts, bool server): m_opts(opts), m_server(server) {}
+TlsContext::~TlsContext() {}
+
+ErrOpt TlsContext::Init()
+{
+    return FASTERR_ERROR("tls is not enabled! please build with BBT_NETWORK_WITH_OPENSSL");
+}
+
+TlsStats TlsContext::GetStats() const { return TlsStats{}; }
+
+TlsSession::TlsSession(PrivateTag, std::shared_ptr<TlsContext>): m_impl(std::make_unique<Impl>()) {}
+TlsSession::~TlsSession() {}
+
+ErrOpt TlsSession::Create(std::shared_ptr<TlsContext>, evutil_socket_t, std::unique_ptr<TlsSession>&)
+{
+    return FASTERR_ERROR("tls is not enabled! please build with BBT_NETWORK_WITH_OPENSSL");
+}
+
+TlsStatus TlsSession::Handshake(ErrOpt&) { return emTLS_ERROR; }
+TlsStatus TlsSession::Read(char*, size_t, size_t& read_len, ErrOpt&) { read_len = 0; return emTLS_ERROR; }
+TlsStatus TlsSession::Write(const char*, size_t, size_t& written, ErrOpt&) { written = 0; return emTLS_ERROR; }
+ssize_t TlsSession::SendFile(int, off_t, size_t) { errno = ENOTSUP; return -1; }
+size_t TlsSession::Pending() const { return 0; }
+size_t TlsSession::RetryLen() const { return 0; }
+void TlsSession::Shutdown() {}
+bool TlsSession::IsResumed() const { return false; }
+
+#endif
+
+ErrOpt TlsContext::Create(const TlsOptions& opts, bool server, std::shared_ptr<TlsContext>& ctx)
+{
+    auto tls = std::make_shared<TlsContext>(PrivateTag{}, opts, server);
+    if (auto err = tls->Init(); err.has_value())
+        return err;
+
+    ctx = tls;
+    return FASTERR_NOTHING;
+}
+
+bool TlsContext::IsServer() const
+{
+    return m_server;
+}
+
+const TlsOptions& TlsContext::GetOptions() const
+{
+    return m_opts;
+}
+
+bool TlsSession::IsEstablished() const
+{
+    return m_impl->established;
+}
+
+bool TlsSession::IsKtlsSend() const
+{
+    return m_impl->ktls_send;
+}
+
+bool TlsSession::IsKtlsRecv() const
+{
+    return m_impl->ktls_recv;
+}
+
+} // namespace bbt::network::detail
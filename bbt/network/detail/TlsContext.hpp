@@ -0,0 +1,147 @@
+/**
+ * @file TlsContext.hpp
+ * @author yangqingmiao
+ * @brief 基于OpenSSL的tls，握手后切换到内核TLS
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#pragma once
+#include <boost/noncopyable.hpp>
+#include <bbt/network/detail/Define.hpp>
+
+namespace bbt::network::detail
+{
+
+enum TlsStatus
+{
+    emTLS_OK            = 0,    // 成功
+    emTLS_WANT_READ     = 1,    // 需要等待socket可读后重试
+    emTLS_WANT_WRITE    = 2,    // 需要等待socket可写后重试
+    emTLS_CLOSED        = 3,    // 对端关闭
+    emTLS_ERROR         = 4,    // 出错，需要关闭连接
+};
+
+/**
+ * tls上下文，对应一个SSL_CTX，由一个TcpServer或TcpClient的所有连接共享。
+ *
+ * 开启会话恢复时，服务端签发session ticket，客户端缓存最近一次握手
+ * 得到的会话，重连时直接恢复，省掉证书校验和密钥交换。
+ *
+ * 开启ktls时，握手完成后由OpenSSL设置TCP_ULP "tls"，把会话密钥交给
+ * 内核，之后的加解密在内核中完成，SendFile也可以保持零拷贝。内核没有
+ * 加载tls模块或OpenSSL编译时没有开启ktls时，仍由OpenSSL在用户态加解密。
+ *
+ * 需要编译时开启 BBT_NETWORK_WITH_OPENSSL，否则 Create 总是返回错误。
+ */
+class TlsContext:
+    public std::enable_shared_from_this<TlsContext>,
+    boost::noncopyable
+{
+    friend class TlsSession;
+    struct PrivateTag {};
+public:
+    BBTATTR_FUNC_CTOR_HIDDEN TlsContext(PrivateTag, const TlsOptions& opts, bool server);
+    ~TlsContext();
+
+    /**
+     * @brief 创建tls上下文，加载证书和私钥
+     *
+     * @param opts
+     * @param server 服务端还是客户端
+     * @param ctx 成功时返回上下文
+     * @return core::errcode::ErrOpt
+     */
+    static core::errcode::ErrOpt Create(const TlsOptions& opts, bool server, std::shared_ptr<TlsContext>& ctx);
+
+    bool                    IsServer() const;
+    const TlsOptions&       GetOptions() const;
+    /* 线程安全 */
+    TlsStats                GetStats() const;
+
+protected:
+    core::errcode::ErrOpt   Init();
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl>   m_impl;
+    const TlsOptions        m_opts;
+    const bool              m_server;
+};
+
+/**
+ * 连接的tls会话，直接读写连接的socket。只能在连接所在线程中使用。
+ */
+class TlsSession:
+    boost::noncopyable
+{
+    struct PrivateTag {};
+public:
+    BBTATTR_FUNC_CTOR_HIDDEN TlsSession(PrivateTag, std::shared_ptr<TlsContext> ctx);
+    ~TlsSession();
+
+    /**
+     * @brief 在socket上创建tls会话
+     *
+     * @param ctx
+     * @param fd 已经建立连接的socket
+     * @param session 成功时返回会话
+     * @return core::errcode::ErrOpt
+     */
+    static core::errcode::ErrOpt Create(std::shared_ptr<TlsContext> ctx, evutil_socket_t fd, std::unique_ptr<TlsSession>& session);
+
+    /* 推进握手，返回emTLS_OK时握手完成 */
+    TlsStatus               Handshake(core::errcode::ErrOpt& err);
+
+    /**
+     * @brief 读取明文
+     *
+     * @param buf
+     * @param len
+     * @param read_len 读到的字节数
+     * @param err 返回emTLS_ERROR时的原因
+     * @return TlsStatus
+     */
+    TlsStatus               Read(char* buf, size_t len, size_t& read_len, core::errcode::ErrOpt& err);
+
+    /**
+     * @brief 写入明文，尽量全部写入，socket写满时返回emTLS_WANT_WRITE
+     * 上一次未完成的写，OpenSSL要求重试时长度不小于上次，长度不足时
+     * 直接返回emTLS_WANT_WRITE，等待更多数据。调用方限流时不能把长度
+     * 截断到RetryLen以下，否则写永远无法继续
+     *
+     * @param buf
+     * @param len
+     * @param written 写入的字节数
+     * @param err 返回emTLS_ERROR时的原因
+     * @return TlsStatus
+     */
+    TlsStatus               Write(const char* buf, size_t len, size_t& written, core::errcode::ErrOpt& err);
+
+    /**
+     * @brief 发送文件，只在发送方向已经切换到内核TLS时可用，否则返回-1并设置errno为ENOTSUP
+     *
+     * @return ssize_t 同sendfile
+     */
+    ssize_t                 SendFile(int fd, off_t offset, size_t len);
+
+    /* 已经解密但还没有读取的字节数，这部分数据不会再触发可读事件 */
+    size_t                  Pending() const;
+    /* 上一次未完成的写要求重试的最小长度，没有未完成的写时为0 */
+    size_t                  RetryLen() const;
+    /* 发送close_notify，不等待对端回应 */
+    void                    Shutdown();
+
+    bool                    IsEstablished() const;
+    bool                    IsResumed() const;
+    bool                    IsKtlsSend() const;
+    bool                    IsKtlsRecv() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl>   m_impl;
+};
+
+} // namespace bbt::network::detail
@@ -0,0 +1,77 @@
+/**
+ * @file TokenBucket.cc
+ * @author yangqingmiao
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include <cmath>
+#include <algorithm>
+#include <bbt/network/detail/TokenBucket.hpp>
+
+namespace bbt::network::detail
+{
+
+TokenBucket::TokenBucket(double rate, size_t burst):
+    m_rate(rate),
+    m_burst(burst > 0 ? burst : std::max(rate, 1.0)),
+    m_tokens(m_burst),
+    m_last_refill(Clock::now())
+{
+}
+
+bool TokenBucket::Unlimited() const
+{
+    return m_rate <= 0;
+}
+
+void TokenBucket::Refill()
+{
+    if (Unlimited())
+        return;
+
+    auto now = Clock::now();
+    double elapsed_s = std::chrono::duration<double>(now - m_last_refill).count();
+    m_last_refill = now;
+    m_tokens = std::min(m_burst, m_tokens + elapsed_s * m_rate);
+}
+
+bool TokenBucket::TryConsume(size_t n)
+{
+    if (Unlimited())
+        return true;
+
+    Refill();
+    if (m_tokens < n)
+        return false;
+
+    m_tokens -= n;
+    return true;
+}
+
+void TokenBucket::Consume(size_t n)
+{
+    if (Unlimited())
+        return;
+
+    Refill();
+    m_tokens -= n;
+}
+
+double TokenBucket::Available() const
+{
+    return m_tokens;
+}
+
+int TokenBucket::WaitTimeMS(size_t n) const
+{
+    if (Unlimited() || m_tokens >= n)
+        return 0;
+
+    return static_cast<int>(std::ceil((n - m_tokens) * 1000 / m_rate));
+}
+
+} // namespace bbt::network::detail
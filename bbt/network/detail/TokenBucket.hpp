@@ -0,0 +1,53 @@
+/**
+ * @file TokenBucket.hpp
+ * @author yangqingmiao
+ * @brief 令牌桶，用于连接接入速率、收发速率等限流场景
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#pragma once
+#include <chrono>
+#include <bbt/network/detail/Define.hpp>
+
+namespace bbt::network::detail
+{
+
+/**
+ * 令牌桶，非线程安全，由持有者保证在同一线程或锁内使用。
+ *
+ * 令牌按 rate 个/秒 的速度补充，最多积累 burst 个。
+ */
+class TokenBucket
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    /**
+     * @param rate 每秒补充的令牌数，小于等于0表示不限制
+     * @param burst 桶容量，为0时取 rate
+     */
+    TokenBucket(double rate, size_t burst);
+    ~TokenBucket() = default;
+
+    /* 尝试消耗 n 个令牌，令牌不足时不消耗并返回false */
+    bool                    TryConsume(size_t n = 1);
+    /* 强制消耗 n 个令牌，允许透支，透支部分需要后续补充偿还 */
+    void                    Consume(size_t n);
+    /* 根据流逝的时间补充令牌 */
+    void                    Refill();
+    /* 当前可用令牌数，透支时为负数 */
+    double                  Available() const;
+    /* 令牌补充到 n 个还需要的时间(ms) */
+    int                     WaitTimeMS(size_t n = 1) const;
+    bool                    Unlimited() const;
+private:
+    const double            m_rate{0};
+    const double            m_burst{0};
+    double                  m_tokens{0};
+    Clock::time_point       m_last_refill;
+};
+
+} // namespace bbt::network::detail
@@ -0,0 +1,165 @@
+/**
+ * @file UnixSocket.cc
+ * @author yangqingmiao
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include <cstring>
+#include <cstddef>
+#include <sys/mman.h>
+#include <bbt/network/detail/UnixSocket.hpp>
+
+using namespace bbt::core::errcode;
+
+namespace bbt::network::detail
+{
+
+ErrOpt MakeUnixAddress(const std::string& path, sockaddr_un& addr, socklen_t& len)
+{
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+
+    if (path.empty())
+        return FASTERR_ERROR("unix socket path is empty!");
+
+    if (path.size() >= sizeof(addr.sun_path))
+        return FASTERR_ERROR("unix socket path is too long! path=" + path);
+
+    memcpy(addr.sun_path, path.data(), path.size());
+    /* 抽象命名空间以'\0'开头，名字长度由地址长度决定 */
+    if (path[0] == '@')
+        addr.sun_path[0] = '\0';
+
+    len = offsetof(sockaddr_un, sun_path) + path.size() + (path[0] == '@' ? 0 : 1);
+    return FASTERR_NOTHING;
+}
+
+ErrOpt CreateUnixSocket(bool noblock, int& fd)
+{
+    fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | (noblock ? SOCK_NONBLOCK : 0), 0);
+    if (fd < 0)
+        return FASTERR_ERROR("create unix socket failed! " + std::string{strerror(errno)});
+
+    return FASTERR_NOTHING;
+}
+
+ErrOpt CreateUnixListen(const std::string& path, int& fd)
+{
+    sockaddr_un addr;
+    socklen_t   len = 0;
+    if (auto err = MakeUnixAddress(path, addr, len); err.has_value())
+        return err;
+
+    if (auto err = CreateUnixSocket(true, fd); err.has_value())
+        return err;
+
+    /* 上次进程退出遗留的socket文件会导致bind失败 */
+    if (path[0] != '@')
+        ::unlink(path.c_str());
+
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), len) != 0 || ::listen(fd, SOMAXCONN) != 0) {
+        std::string errstr = strerror(errno);
+        ::close(fd);
+        fd = -1;
+        return FASTERR_ERROR("unix socket listen failed! path=" + path + " " + errstr);
+    }
+
+    return FASTERR_NOTHING;
+}
+
+ssize_t SendWithFds(evutil_socket_t sockfd, const char* data, size_t len, const std::vector<int>& fds)
+{
+    iovec   iov{const_cast<char*>(data), len};
+    msghdr  msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    std::vector<char> control;
+    if (!fds.empty()) {
+        control.resize(CMSG_SPACE(sizeof(int) * fds.size()));
+        msg.msg_control = control.data();
+        msg.msg_controllen = control.size();
+
+        cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+        memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+    }
+
+    return ::sendmsg(sockfd, &msg, MSG_NOSIGNAL);
+}
+
+ssize_t RecvWithFds(evutil_socket_t sockfd, char* data, size_t len, std::vector<int>& fds)
+{
+    iovec   iov{data, len};
+    msghdr  msg;
+    char    control[CMSG_SPACE(sizeof(int) * UNIX_MAX_PASS_FDS)];
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t n = ::recvmsg(sockfd, &msg, MSG_CMSG_CLOEXEC);
+    if (n <= 0)
+        return n;
+
+    std::vector<int> received;
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+            continue;
+
+        size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        const int* begin = reinterpret_cast<const int*>(CMSG_DATA(cmsg));
+        received.insert(received.end(), begin, begin + count);
+    }
+
+    /* 控制缓冲区放不下时内核丢弃了多出的fd，数据和fd已经无法对应，按错误处理 */
+    if (msg.msg_flags & MSG_CTRUNC) {
+        for (int fd : received) ::close(fd);
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    fds.insert(fds.end(), received.begin(), received.end());
+    return n;
+}
+
+ErrOpt CreateSealedMemfd(const std::string& name, const char* data, size_t len, int& fd)
+{
+    fd = ::memfd_create(name.c_str(), MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0)
+        return FASTERR_ERROR("memfd_create failed! " + std::string{strerror(errno)});
+
+    size_t written = 0;
+    while (written < len) {
+        ssize_t n = ::write(fd, data + written, len - written);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            std::string errstr = strerror(errno);
+            ::close(fd);
+            fd = -1;
+            return FASTERR_ERROR("write memfd failed! " + errstr);
+        }
+        written += n;
+    }
+
+    /* 封住后接收方可以放心地mmap，不用担心内容或大小被修改 */
+    if (::fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) != 0) {
+        std::string errstr = strerror(errno);
+        ::close(fd);
+        fd = -1;
+        return FASTERR_ERROR("seal memfd failed! " + errstr);
+    }
+
+    return FASTERR_NOTHING;
+}
+
+} // namespace bbt::network::detail
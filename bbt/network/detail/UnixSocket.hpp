@@ -0,0 +1,83 @@
+/**
+ * @file UnixSocket.hpp
+ * @author yangqingmiao
+ * @brief AF_UNIX流式socket和fd传递
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#pragma once
+#include <string>
+#include <vector>
+#include <sys/un.h>
+#include <bbt/network/detail/Define.hpp>
+
+namespace bbt::network::detail
+{
+
+/**
+ * 路径以'@'开头时使用抽象命名空间（linux），不会在文件系统中创建文件，
+ * 否则为文件系统路径。
+ */
+
+/**
+ * @brief 把路径转换为sockaddr_un
+ *
+ * @param path
+ * @param addr
+ * @param len 地址的实际长度，抽象命名空间需要用它来确定名字长度
+ * @return core::errcode::ErrOpt 路径过长或为空时返回错误
+ */
+core::errcode::ErrOpt MakeUnixAddress(const std::string& path, sockaddr_un& addr, socklen_t& len);
+
+/**
+ * @brief 创建监听在path上的非阻塞AF_UNIX socket，已存在的文件系统路径会被先删除
+ *
+ * @param path
+ * @param fd 成功时返回监听socket
+ * @return core::errcode::ErrOpt
+ */
+core::errcode::ErrOpt CreateUnixListen(const std::string& path, int& fd);
+
+/**
+ * @brief 创建AF_UNIX socket，连接由调用方发起
+ *
+ * @param noblock
+ * @param fd 成功时返回socket
+ * @return core::errcode::ErrOpt
+ */
+core::errcode::ErrOpt CreateUnixSocket(bool noblock, int& fd);
+
+/**
+ * @brief 通过sendmsg发送数据，并以SCM_RIGHTS附带fds
+ * fds附着在本次发送的第一个字节上，len必须大于0
+ *
+ * @return ssize_t 同send
+ */
+ssize_t SendWithFds(evutil_socket_t sockfd, const char* data, size_t len, const std::vector<int>& fds);
+
+/**
+ * @brief 通过recvmsg接收数据，收到的fd追加到fds中
+ * 对端一次附带的fd超过UNIX_MAX_PASS_FDS被内核截断时，关闭收到的fd，
+ * 返回-1并设置errno为EMSGSIZE。此时同一次读到的数据也已经丢失，
+ * 字节流不再完整，调用方只能关闭连接
+ *
+ * @return ssize_t 同read
+ */
+ssize_t RecvWithFds(evutil_socket_t sockfd, char* data, size_t len, std::vector<int>& fds);
+
+/**
+ * @brief 创建一个内容为data的memfd，并封住写入和大小，接收方可以
+ * 直接mmap读取，大块数据只传递fd，不经过socket拷贝
+ *
+ * @param name 调试用名字
+ * @param data
+ * @param len
+ * @param fd 成功时返回memfd
+ * @return core::errcode::ErrOpt
+ */
+core::errcode::ErrOpt CreateSealedMemfd(const std::string& name, const char* data, size_t len, int& fd);
+
+} // namespace bbt::network::detail
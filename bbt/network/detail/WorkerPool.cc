@@ -0,0 +1,288 @@
+/**
+ * @file WorkerPool.cc
+ * @author yangqingmiao
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <bbt/network/detail/WorkerPool.hpp>
+
+namespace bbt::network::detail
+{
+
+struct WorkerPool::Strand
+{
+    std::mutex              mutex;
+    std::deque<Task>        tasks;
+    bool                    scheduled{false};           // 是否在就绪队列中或正在执行
+};
+
+struct WorkerPool::Impl
+{
+    struct WorkQueue
+    {
+        std::mutex              mutex;
+        std::deque<StrandSPtr>  strands;
+    };
+
+    explicit Impl(const WorkerPoolOptions& o): opts(o) {}
+
+    bool                    Submit(StrandSPtr strand, Task&& task);
+    void                    Stop();
+    void                    WorkerMain(size_t index);
+    bool                    PopStrand(size_t index, StrandSPtr& strand);
+    void                    RunStrand(StrandSPtr strand);
+    void                    Schedule(StrandSPtr strand);
+    void                    PushReady(size_t index, StrandSPtr strand);
+    void                    OnTaskDone();
+
+    // 当前线程所属的线程池和队列下标，用于把新就绪的strand放入自己的队列
+    static inline thread_local const Impl* t_current = nullptr;
+    static inline thread_local size_t t_current_index = 0;
+
+    const WorkerPoolOptions opts;
+    std::vector<std::unique_ptr<WorkQueue>>
+                            queues;                     // 每个工作线程一个就绪队列
+    std::vector<std::thread> threads;
+    std::atomic_size_t      next_queue{0};              // 非工作线程提交时轮询选择队列
+
+    std::mutex              sleep_mutex;                // 同时保护stop，提交在其中完成入队
+    std::condition_variable sleep_cond;
+    std::atomic_size_t      ready{0};                   // 所有就绪队列中的strand数
+    std::atomic_bool        stop{false};
+
+    std::atomic_size_t      pending{0};
+    std::atomic_uint64_t    submitted{0};
+    std::atomic_uint64_t    completed{0};
+    std::atomic_uint64_t    stolen{0};
+    std::atomic_uint64_t    saturated{0};
+};
+
+WorkerPool::WorkerPool(PrivateTag, const WorkerPoolOptions& opts):
+    m_impl(std::make_shared<Impl>(opts))
+{
+    size_t nthread = std::max<size_t>(opts.threads, 1);
+    for (size_t i = 0; i < nthread; ++i)
+        m_impl->queues.emplace_back(std::make_unique<Impl::WorkQueue>());
+
+    /* 工作线程持有impl，线程池在工作线程中析构时状态仍然有效 */
+    for (size_t i = 0; i < nthread; ++i)
+        m_impl->threads.emplace_back([impl{m_impl}, i](){ impl->WorkerMain(i); });
+}
+
+WorkerPool::~WorkerPool()
+{
+    Stop();
+}
+
+std::shared_ptr<WorkerPool> WorkerPool::Create(const WorkerPoolOptions& opts)
+{
+    return std::make_shared<WorkerPool>(PrivateTag{}, opts);
+}
+
+WorkerPool::StrandSPtr WorkerPool::NewStrand()
+{
+    return std::make_shared<Strand>();
+}
+
+bool WorkerPool::Submit(StrandSPtr strand, Task&& task)
+{
+    return m_impl->Submit(strand, std::move(task));
+}
+
+bool WorkerPool::Saturated() const
+{
+    return m_impl->opts.high_watermark > 0 && m_impl->pending >= m_impl->opts.high_watermark;
+}
+
+WorkerPoolStats WorkerPool::GetStats() const
+{
+    WorkerPoolStats stats;
+    stats.submitted = m_impl->submitted;
+    stats.completed = m_impl->completed;
+    stats.stolen = m_impl->stolen;
+    stats.saturated = m_impl->saturated;
+    stats.pending = m_impl->pending;
+    return stats;
+}
+
+void WorkerPool::Stop()
+{
+    m_impl->Stop();
+}
+
+bool WorkerPool::Impl::Submit(StrandSPtr strand, Task&& task)
+{
+    Assert(strand != nullptr);
+    bool need_schedule = false;
+
+    /**
+     *  提交不阻塞，提交方可能是EvThread，积压由连接在高水位暂停读取控制。
+     *  stop的检查和入队都在sleep_mutex中完成，工作线程在同一把锁中判断
+     *  退出，Stop之后不会再有任务入队后无人执行
+     */
+    {
+        std::lock_guard<std::mutex> _(sleep_mutex);
+        if (stop)
+            return false;
+
+        ++submitted;
+        if (++pending == opts.high_watermark)
+            ++saturated;
+
+        {
+            std::lock_guard<std::mutex> _(strand->mutex);
+            strand->tasks.push_back(std::move(task));
+            need_schedule = !strand->scheduled;
+            strand->scheduled = true;
+        }
+
+        if (need_schedule)
+            PushReady((t_current == this) ? t_current_index : (next_queue++ % queues.size()), strand);
+    }
+
+    if (need_schedule)
+        sleep_cond.notify_one();
+
+    return true;
+}
+
+void WorkerPool::Impl::OnTaskDone()
+{
+    --pending;
+    ++completed;
+}
+
+void WorkerPool::Impl::Stop()
+{
+    {
+        std::lock_guard<std::mutex> _(sleep_mutex);
+        if (stop)
+            return;
+        stop = true;
+    }
+    sleep_cond.notify_all();
+
+    /* 在工作线程中停止时不能join自己，全部分离，执行完剩余任务后自行退出，最后退出的线程释放impl */
+    if (t_current == this) {
+        for (auto& thread : threads)
+            if (thread.joinable())
+                thread.detach();
+        return;
+    }
+
+    for (auto& thread : threads)
+        if (thread.joinable())
+            thread.join();
+}
+
+void WorkerPool::Impl::Schedule(StrandSPtr strand)
+{
+    /* 工作线程中就绪的strand放入自己的队列，保持缓存局部性 */
+    size_t index = (t_current == this) ? t_current_index : (next_queue++ % queues.size());
+    {
+        std::lock_guard<std::mutex> _(sleep_mutex);
+        PushReady(index, strand);
+    }
+    sleep_cond.notify_one();
+}
+
+void WorkerPool::Impl::PushReady(size_t index, StrandSPtr strand)
+{
+    {
+        auto& queue = *queues[index];
+        std::lock_guard<std::mutex> _(queue.mutex);
+        queue.strands.push_back(strand);
+    }
+    ++ready;
+}
+
+bool WorkerPool::Impl::PopStrand(size_t index, StrandSPtr& strand)
+{
+    /* 先从自己队列头部取，再从其他队列尾部窃取 */
+    {
+        auto& queue = *queues[index];
+        std::lock_guard<std::mutex> _(queue.mutex);
+        if (!queue.strands.empty()) {
+            strand = std::move(queue.strands.front());
+            queue.strands.pop_front();
+            --ready;
+            return true;
+        }
+    }
+
+    for (size_t i = 1; i < queues.size(); ++i) {
+        auto& queue = *queues[(index + i) % queues.size()];
+        std::lock_guard<std::mutex> _(queue.mutex);
+        if (!queue.strands.empty()) {
+            strand = std::move(queue.strands.back());
+            queue.strands.pop_back();
+            --ready;
+            ++stolen;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void WorkerPool::Impl::RunStrand(StrandSPtr strand)
+{
+    for (int i = 0; i < WORKER_POOL_STRAND_BATCH; ++i) {
+        Task task = nullptr;
+        {
+            std::lock_guard<std::mutex> _(strand->mutex);
+            if (strand->tasks.empty()) {
+                strand->scheduled = false;
+                return;
+            }
+            task = std::move(strand->tasks.front());
+            strand->tasks.pop_front();
+        }
+
+        task();
+        task = nullptr;
+        OnTaskDone();
+    }
+
+    {
+        std::lock_guard<std::mutex> _(strand->mutex);
+        if (strand->tasks.empty()) {
+            strand->scheduled = false;
+            return;
+        }
+    }
+
+    /* 仍有任务，重新排到队尾，让其他strand先执行 */
+    Schedule(strand);
+}
+
+void WorkerPool::Impl::WorkerMain(size_t index)
+{
+    t_current = this;
+    t_current_index = index;
+
+    while (true) {
+        StrandSPtr strand = nullptr;
+        if (PopStrand(index, strand)) {
+            RunStrand(strand);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        sleep_cond.wait(lock, [this](){ return stop || ready > 0; });
+        /* 停止前执行完已提交的任务 */
+        if (stop && ready == 0)
+            return;
+    }
+}
+
+} // namespace bbt::network::detail
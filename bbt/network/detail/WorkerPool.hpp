@@ -0,0 +1,71 @@
+/**
+ * @file WorkerPool.hpp
+ * @author yangqingmiao
+ * @brief 工作线程池，用于把耗时的回调从EvThread中卸载出去
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#pragma once
+#include <boost/noncopyable.hpp>
+#include <bbt/network/detail/Define.hpp>
+
+namespace bbt::network::detail
+{
+
+/**
+ * 带工作窃取的线程池。
+ *
+ * 任务按 Strand 串行化：同一个 Strand 中的任务按提交顺序依次
+ * 执行，同一时刻最多只有一个线程在执行，不同 Strand 之间并行。
+ * 每个连接对应一个 Strand，从而保证单个连接的回调有序。
+ *
+ * 每个工作线程有自己的就绪队列，空闲时从其他线程的队列尾部窃
+ * 取 Strand。一个 Strand 连续执行 WORKER_POOL_STRAND_BATCH 个
+ * 任务后重新排队，避免单个繁忙连接独占线程。
+ *
+ * Submit 从不阻塞，提交方通常是EvThread。积压任务数达到 high_watermark
+ * 后 Saturated 返回true，由连接暂停读取形成背压；发送、超时和关闭回调
+ * 不受此限制，始终入队，保证连接状态完整。
+ *
+ * 工作线程持有内部状态的引用，线程池在工作线程中析构时（例如最后一
+ * 个引用随任务释放），工作线程执行完剩余任务后自行退出并释放状态。
+ */
+class WorkerPool:
+    public std::enable_shared_from_this<WorkerPool>,
+    boost::noncopyable
+{
+    struct PrivateTag {};
+public:
+    typedef std::function<void()> Task;
+    struct Strand;
+    typedef std::shared_ptr<Strand> StrandSPtr;
+
+    BBTATTR_FUNC_CTOR_HIDDEN
+    WorkerPool(PrivateTag, const WorkerPoolOptions& opts);
+    ~WorkerPool();
+
+    static std::shared_ptr<WorkerPool> Create(const WorkerPoolOptions& opts = WorkerPoolOptions{});
+
+    /* 创建一个串行执行单元 */
+    StrandSPtr              NewStrand();
+    /**
+     * @brief 线程安全，不阻塞，提交到strand中，在strand之前的任务执行完后执行
+     *
+     * @return 线程池已经停止时返回false，任务未被接收，由调用方处理
+     */
+    bool                    Submit(StrandSPtr strand, Task&& task);
+    /* 积压任务数是否达到高水位 */
+    bool                    Saturated() const;
+    WorkerPoolStats         GetStats() const;
+    /* 执行完已提交的任务后停止所有工作线程 */
+    void                    Stop();
+
+private:
+    struct Impl;
+    std::shared_ptr<Impl>   m_impl;                     // 工作线程共同持有
+};
+
+} // namespace bbt::network::detail
@@ -0,0 +1,135 @@
+#include <thread>
+#include <sys/resource.h>
+#include <arpa/inet.h>
+#include <bbt/network/TcpServer.hpp>
+#include <bbt/network/detail/Connection.hpp>
+#include <bbt/pollevent/EvThread.hpp>
+#include <bbt/core/clock/Clock.hpp>
+
+using namespace bbt::network;
+using namespace bbt::core::clock;
+
+/**
+ * 空闲连接内存压测，同一进程内的服务端和客户端。
+ * 客户端用原始socket建立N个连接后保持空闲，统计建连前后进程常驻内存
+ * 的增量，得到服务端每个空闲连接的用户态内存占用（不含内核socket内存）。
+ *
+ * 单个源地址的端口不够用，客户端每5万个连接换一个127.0.0.x源地址。
+ * 需要先调大fd上限：
+ *  sysctl -w fs.nr_open=2100000 && ulimit -n 2100000
+ */
+
+static const int            CONNS_PER_SOURCE = 50000;
+static std::atomic_uint64_t g_accepted{0};
+
+static size_t GetRss()
+{
+    long pages = 0, rss = 0;
+    FILE* fp = fopen("/proc/self/statm", "r");
+    if (fp == nullptr)
+        return 0;
+
+    if (fscanf(fp, "%ld %ld", &pages, &rss) != 2)
+        rss = 0;
+    fclose(fp);
+    return rss * sysconf(_SC_PAGESIZE);
+}
+
+static int ConnectFrom(int index, int port)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+
+    /* 推迟到connect时再按四元组选择源端口 */
+    int opt = 1;
+    ::setsockopt(fd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &opt, sizeof(opt));
+
+    sockaddr_in local{};
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_LOOPBACK + 1 + index / CONNS_PER_SOURCE);
+    sockaddr_in peer{};
+    peer.sin_family = AF_INET;
+    peer.sin_port = htons(port);
+    peer.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&local), sizeof(local)) != 0 ||
+        (::connect(fd, reinterpret_cast<sockaddr*>(&peer), sizeof(peer)) != 0 && errno != EINPROGRESS)) {
+        ::close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+int main(int args, char* argv[])
+{
+    if (args < 3) {
+        printf("[usage] ./{exec_name} {port} {connections} [server threads]\n");
+        exit(-1);
+    }
+
+    int port = std::atoi(argv[1]);
+    int count = std::atoi(argv[2]);
+    int nthread = (args > 3) ? std::atoi(argv[3]) : 1;
+
+    /* 每个连接两端各占一个fd */
+    rlimit limit{(rlim_t)count * 2 + 1024, (rlim_t)count * 2 + 1024};
+    if (::setrlimit(RLIMIT_NOFILE, &limit) != 0)
+        std::cout << getnow_str() << "[C1MBench] raise fd limit failed, continue with current limit" << std::endl;
+
+    auto rlt = bbt::core::net::make_ip_address("127.0.0.1", port);
+    if (rlt.IsErr()) {
+        std::cout << "make ip address failed! " << rlt.Err().CWhat() << std::endl;
+        return -1;
+    }
+
+    auto server = TcpServer::Create(nthread);
+    server->Init();
+    server->SetOnRecv([](auto, auto&){});
+    server->SetOnClose([](auto){});
+    server->SetTimeout(24 * 3600 * 1000);
+    if (auto err = server->AsyncListen(rlt.Ok(), [](ConnId){ ++g_accepted; }); err.has_value()) {
+        std::cout << getnow_str() << "[C1MBench] listen error: " << err->CWhat() << std::endl;
+        return -1;
+    }
+
+    std::vector<int> fds;
+    fds.reserve(count);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    size_t begin_rss = GetRss();
+
+    for (int i = 0; i < count; ++i) {
+        int fd = ConnectFrom(i, port);
+        if (fd < 0) {
+            std::cout << getnow_str() << "[C1MBench] connect failed at " << i << ": " << strerror(errno) << std::endl;
+            break;
+        }
+        fds.push_back(fd);
+
+        /* 不要超过监听队列太多，否则内核会丢弃握手 */
+        while (fds.size() > g_accepted.load() + 1024)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        if ((i + 1) % 100000 == 0)
+            std::cout << getnow_str() << "[C1MBench] connected=" << i + 1 << std::endl;
+    }
+
+    for (int i = 0; i < 100 && g_accepted.load() < fds.size(); ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    size_t end_rss = GetRss();
+    uint64_t accepted = g_accepted.load();
+
+    std::cout << "[C1MBench] idle connections: " << accepted << std::endl;
+    std::cout << "[C1MBench] rss: " << begin_rss / (1024 * 1024) << "MB -> " << end_rss / (1024 * 1024) << "MB" << std::endl;
+    if (accepted > 0)
+        std::cout << "[C1MBench] bytes per idle connection: " << (end_rss - begin_rss) / accepted << std::endl;
+    std::cout << "[C1MBench] sizeof(Connection): " << sizeof(detail::Connection) << std::endl;
+
+    for (int fd : fds)
+        ::close(fd);
+
+    exit(0);
+}
@@ -0,0 +1,67 @@
+#include <bbt/network/TcpServer.hpp>
+#include <bbt/network/Coroutine.hpp>
+#include <bbt/core/log/Logger.hpp>
+#include <bbt/pollevent/EvThread.hpp>
+#include <bbt/core/clock/Clock.hpp>
+
+using namespace bbt::network;
+using namespace bbt::core::clock;
+
+/* 读取一行并原样返回，直到连接关闭 */
+CoTask EchoSession(std::shared_ptr<CoConnection> conn)
+{
+    while (true) {
+        if (auto err = co_await conn->Read(1); err.has_value()) {
+            std::cout << getnow_str() << "[CoEchoServer] read error: " << err->CWhat() << std::endl;
+            co_return;
+        }
+
+        size_t len = conn->Size();
+        if (auto err = co_await conn->Write(conn->Peek(), len); err.has_value()) {
+            std::cout << getnow_str() << "[CoEchoServer] write error: " << err->CWhat() << std::endl;
+            co_return;
+        }
+
+        conn->Consume(len);
+    }
+}
+
+int main(int args, char* argv[])
+{
+    if (args != 2) {
+        printf("[usage] ./{exec_name} {port}\n");
+        exit(-1);
+    }
+
+    auto evthread = std::make_shared<EvThread>(std::make_shared<bbt::pollevent::EventLoop>());
+    auto server = TcpServer::Create(evthread);
+
+    server->Init();
+    server->SetTimeout(5000);
+    server->SetOnClose([](ConnId connid){
+        std::cout << getnow_str() << "[CoEchoServer] on close " << connid << std::endl;
+    });
+
+    auto rlt = bbt::core::net::make_ip_address("127.0.0.1", std::atoi(argv[1]));
+    if (rlt.IsErr()) {
+        std::cout << "make ip address failed! " << rlt.Err().CWhat() << std::endl;
+        return -1;
+    }
+
+    /**
+     * OnAccept 在监听所在的线程中执行，不一定是连接所属的EvThread，
+     * 但一定在连接启动之前：协程在这里运行到第一次co_await Read挂起，
+     * 之后都由连接的回调在连接所属的EvThread中恢复
+     */
+    auto err = server->AsyncListen(rlt.Ok(), [server](ConnId connid){
+        EchoSession(CoConnection::Create(server->GetConnection(connid)));
+    });
+
+    if (err.has_value()) {
+        std::cout << getnow_str() << "[CoEchoServer] listen error: " << err->CWhat() << std::endl;
+        return -1;
+    }
+
+    evthread->Start();
+    evthread->Join();
+}
@@ -1,3 +1,4 @@
+#include <atomic>
 #include <bbt/network/TcpClient.hpp>
 #include <bbt/core/log/Logger.hpp>
 #include <bbt/pollevent/EvThread.hpp>
@@ -12,7 +13,11 @@ std::shared_ptr<Event> signal_event = nullptr;
 
 std::map<ConnId, std::shared_ptr<Event>> SendEventMap;
 
-std::map<ConnId, std::tuple<size_t, size_t>> MonitorInfoMap; // connid -> (recv, send)
+// 在连接线程中累加，在打印事件中读取
+struct MonitorInfo { std::atomic_size_t recv{0}; std::atomic_size_t send{0}; };
+
+// 只用于打印，收发回调通过连接上下文直接访问MonitorInfo
+std::map<ConnId, std::shared_ptr<MonitorInfo>> MonitorInfoMap;
 std::mutex MonitorInfoMapMutex;
 
 std::shared_ptr<TcpClient> NewClient(std::shared_ptr<EvThread> evthread)
@@ -20,7 +25,7 @@ std::shared_ptr<TcpClient> NewClient(std::shared_ptr<EvThread> evthread)
     auto client = TcpClient::Create(evthread);
 
     // ctrl z 事件监听
-    signal_event = evthread->RegisterEvent(0, EventOpt::SIGNAL, [](auto, short events, auto){
+    signal_event = evthread->RegisterEvent(0, EventOpt::SIGNAL, [](auto, short, auto){
         std::cout << getnow_str() << "[Echo Client] ctrl z" << std::endl;
     });
 
@@ -35,20 +40,19 @@ std::shared_ptr<TcpClient> NewClient(std::shared_ptr<EvThread> evthread)
 
         std::lock_guard<std::mutex> _(MonitorInfoMapMutex);
 
-        SendEventMap[id] = evthread->RegisterEvent(0, EventOpt::TIMEOUT | EventOpt::PERSIST, [id, client](auto, short events, auto){
+        SendEventMap[id] = evthread->RegisterEvent(0, EventOpt::TIMEOUT | EventOpt::PERSIST, [client](auto, short, auto){
             client->Send(bbt::core::Buffer{"hello world!"});
         });
 
-        Print = evthread->RegisterEvent(0, EventOpt::TIMEOUT | EventOpt::PERSIST, [id, client](auto, short events, auto){
+        Print = evthread->RegisterEvent(0, EventOpt::TIMEOUT | EventOpt::PERSIST, [](auto, short, auto){
             std::lock_guard<std::mutex> _(MonitorInfoMapMutex);
 
             for (auto& [connid, event] : SendEventMap) {
                 auto it = MonitorInfoMap.find(connid);
                 if (it != MonitorInfoMap.end()) {
-                    auto& [recv, send] = it->second;
                     std::cout << "[EchoClient] connid: " << connid
-                        << ", recv: " << recv
-                        << ", send: " << send
+                        << ", recv: " << it->second->recv.load()
+                        << ", send: " << it->second->send.load()
                         << std::endl;
                 }
             }
@@ -57,34 +61,26 @@ std::shared_ptr<TcpClient> NewClient(std::shared_ptr<EvThread> evthread)
         Assert(Print->StartListen(1000) == 0);
         Assert(SendEventMap[id]->StartListen(10) == 0);
 
-        MonitorInfoMap[id] = std::make_tuple(0, 0);
+        auto info = std::make_shared<MonitorInfo>();
+        client->GetConnection()->SetContext(info);
+        MonitorInfoMap[id] = info;
     });
 
     client->SetOnClose([client](ConnId id){
         std::cout << getnow_str() << "[Echo Client] close success! " << id << " err=" << errno << std::endl;
     });
 
-    client->SetOnRecv([client](ConnId id, auto& buffer){
+    client->SetOnRecv<MonitorInfo>([](ConnId, MonitorInfo* info, const bbt::core::Buffer& buffer){
         // std::cout << "[Echo Client] recv: " << buffer.Peek() << std::endl;
-        std::lock_guard<std::mutex> _(MonitorInfoMapMutex);
-        auto it = MonitorInfoMap.find(id);
-        if (it != MonitorInfoMap.end()) {
-            auto& [recv, send] = it->second;
-            recv += buffer.Size();
-        }
+        if (info != nullptr)
+            info->recv += buffer.Size();
     });
 
-    client->SetOnSend([client](ConnId id, auto err, auto send_len){
+    client->SetOnSend<MonitorInfo>([](ConnId, MonitorInfo* info, bbt::core::errcode::ErrOpt err, size_t send_len){
         if (err.has_value())
             std::cout << getnow_str() << "[Echo Client] send error: " << err->CWhat() << std::endl;
-        else {
-            std::lock_guard<std::mutex> _(MonitorInfoMapMutex);
-            auto it = MonitorInfoMap.find(id);
-            if (it != MonitorInfoMap.end()) {
-                auto& [recv, send] = it->second;
-                send += send_len;
-            }
-        }
+        else if (info != nullptr)
+            info->send += send_len;
     });
 
     client->SetConnectionTimeout(5000);
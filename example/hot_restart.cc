@@ -0,0 +1,90 @@
+#include <thread>
+#include <bbt/network/TcpServer.hpp>
+#include <bbt/core/clock/Clock.hpp>
+
+using namespace bbt::network;
+using namespace bbt::core::clock;
+
+/**
+ * 热重启演示，回显服务，每个连接记录收到的消息数。
+ * 启动时先尝试从控制socket上的旧进程接管，没有旧进程时正常监听；
+ * 之后开启交接等待下一个新进程。再启动一个同样的进程即完成重启：
+ * 新进程接管监听socket和空闲连接，消息数随连接一起交接，旧进程在
+ * 剩余连接关闭后退出，客户端不会被拒绝，也不需要重连。
+ *  ./hot_restart 10001 @bbt_hot_restart &
+ *  ./hot_restart 10001 @bbt_hot_restart    # 重启
+ */
+
+static std::mutex g_mtx;
+static std::unordered_map<ConnId, uint64_t> g_counts;
+static std::atomic_bool g_drained{false};
+
+int main(int args, char* argv[])
+{
+    if (args < 3) {
+        printf("[usage] ./{exec_name} {port} {control path}\n");
+        exit(-1);
+    }
+
+    std::string path = argv[2];
+    auto rlt = bbt::core::net::make_ip_address("0.0.0.0", std::atoi(argv[1]));
+    if (rlt.IsErr()) {
+        std::cout << "make ip address failed! " << rlt.Err().CWhat() << std::endl;
+        return -1;
+    }
+
+    auto server = TcpServer::Create(2);
+    server->Init();
+    server->SetTimeout(60000);
+    server->SetOnRecv([server](ConnId connid, const bbt::core::Buffer& buffer){
+        {
+            std::lock_guard<std::mutex> _(g_mtx);
+            ++g_counts[connid];
+        }
+        server->Send(connid, buffer);
+    });
+    server->SetOnClose([](ConnId connid){
+        std::lock_guard<std::mutex> _(g_mtx);
+        g_counts.erase(connid);
+    });
+    /* 接管的连接恢复旧进程中的消息数 */
+    server->SetOnInherit([](ConnId connid, const std::string& state){
+        std::lock_guard<std::mutex> _(g_mtx);
+        g_counts[connid] = std::strtoull(state.c_str(), nullptr, 10);
+    });
+
+    if (auto err = server->TakeoverListen(path, [](ConnId){}); err.has_value()) {
+        std::cout << getnow_str() << "[HotRestart] no old process, listen directly. " << err->CWhat() << std::endl;
+        if (auto err = server->AsyncListen(rlt.Ok(), [](ConnId){}); err.has_value()) {
+            std::cout << getnow_str() << "[HotRestart] listen error: " << err->CWhat() << std::endl;
+            return -1;
+        }
+    } else {
+        std::cout << getnow_str() << "[HotRestart] takeover done, inherited connections: "
+            << server->GetHotRestartStats().conns_inherited << std::endl;
+    }
+
+    HotRestartOptions opts;
+    opts.handoff_connections = true;
+    opts.drain_timeout_ms = 10000;
+    opts.export_state = [](ConnId connid){
+        std::lock_guard<std::mutex> _(g_mtx);
+        return std::to_string(g_counts[connid]);
+    };
+    opts.on_drained = [](){ g_drained = true; };
+    if (auto err = server->EnableHotRestart(path, opts); err.has_value()) {
+        std::cout << getnow_str() << "[HotRestart] enable hot restart error: " << err->CWhat() << std::endl;
+        return -1;
+    }
+
+    while (!g_drained.load()) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        std::lock_guard<std::mutex> _(g_mtx);
+        std::cout << getnow_str() << "[HotRestart] pid=" << getpid() << " connections=" << g_counts.size() << std::endl;
+    }
+
+    auto stats = server->GetHotRestartStats();
+    std::cout << getnow_str() << "[HotRestart] drained, exit. handed off=" << stats.conns_sent
+        << " drained in place=" << stats.conns_skipped << std::endl;
+    exit(0);
+}
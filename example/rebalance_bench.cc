@@ -0,0 +1,99 @@
+#include <thread>
+#include <bbt/network/TcpServer.hpp>
+#include <bbt/network/TcpClient.hpp>
+#include <bbt/pollevent/EvThread.hpp>
+#include <bbt/core/clock/Clock.hpp>
+
+using namespace bbt::network;
+using namespace bbt::core::clock;
+
+/**
+ * 连接再均衡演示，同一进程内的服务端和客户端。
+ * 客户端建立N个回显连接，偶数连接保持16个消息在途，奇数连接只有1个。
+ * 服务端两个线程轮询分配连接，忙连接全部落在同一个线程上，开启再均衡
+ * 后逐步迁移到空闲的线程；之后运行时增加两个线程，再移除一个线程，
+ * 每秒输出各线程的连接数和事件数。
+ */
+
+static const int PIPELINE_HOT = 16;
+
+int main(int args, char* argv[])
+{
+    if (args < 3) {
+        printf("[usage] ./{exec_name} {port} {connections}\n");
+        exit(-1);
+    }
+
+    int count = std::atoi(argv[2]);
+    auto rlt = bbt::core::net::make_ip_address("127.0.0.1", std::atoi(argv[1]));
+    if (rlt.IsErr()) {
+        std::cout << "make ip address failed! " << rlt.Err().CWhat() << std::endl;
+        return -1;
+    }
+
+    auto server = TcpServer::Create(2);
+    server->Init();
+    server->SetTimeout(60000);
+    server->SetOnRecv([server](ConnId connid, const bbt::core::Buffer& buffer){
+        server->Send(connid, buffer);
+    });
+    server->SetOnClose([](auto){});
+    server->SetOnErr([](auto connid, const bbt::core::errcode::Errcode& err){
+        std::cout << getnow_str() << "[RebalanceBench] server error: " << err.CWhat() << std::endl;
+    });
+
+    RebalanceOptions opts;
+    opts.enable = true;
+    opts.interval_ms = 1000;
+    server->SetRebalance(opts);
+
+    if (auto err = server->AsyncListen(rlt.Ok(), [](ConnId){}); err.has_value()) {
+        std::cout << getnow_str() << "[RebalanceBench] listen error: " << err->CWhat() << std::endl;
+        return -1;
+    }
+
+    /* 客户端收到回显后原样发回，在途消息数保持不变 */
+    auto client_thread = std::make_shared<EvThread>(std::make_shared<bbt::pollevent::EventLoop>());
+    std::vector<std::shared_ptr<TcpClient>> clients;
+    for (int i = 0; i < count; ++i) {
+        auto client = TcpClient::Create(client_thread);
+        client->Init();
+        client->SetConnectionTimeout(60000);
+        client->SetOnRecv([client](ConnId, const bbt::core::Buffer& buffer){
+            client->Send(buffer);
+        });
+        int pipeline = (i % 2 == 0) ? PIPELINE_HOT : 1;
+        client->SetOnConnect([client, pipeline](ConnId, bbt::core::errcode::ErrOpt err){
+            if (err.has_value()) {
+                std::cout << getnow_str() << "[RebalanceBench] connect error: " << err->CWhat() << std::endl;
+                return;
+            }
+
+            for (int n = 0; n < pipeline; ++n)
+                client->Send(bbt::core::Buffer{"ping"});
+        });
+        clients.push_back(client);
+    }
+
+    client_thread->Start();
+    for (auto& client : clients)
+        client->AsyncConnect(rlt.Ok(), 3000);
+
+    for (int second = 1; second <= 15; ++second) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        if (second == 5)
+            server->AddThreads(2);
+        else if (second == 10)
+            server->RemoveThreads(1);
+
+        auto stats = server->GetRebalanceStats();
+        std::cout << getnow_str() << "[RebalanceBench] threads=" << server->GetThreadCount()
+            << " migrations=" << stats.migrations << " failed=" << stats.failed << std::endl;
+
+        auto loads = server->GetThreadLoad();
+        for (size_t i = 0; i < loads.size(); ++i)
+            std::cout << "    thread " << i << ": connections=" << loads[i].connections << " events=" << loads[i].events << std::endl;
+    }
+
+    exit(0);
+}
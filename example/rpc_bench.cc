@@ -0,0 +1,126 @@
+#include <thread>
+#include <bbt/network/TcpServer.hpp>
+#include <bbt/network/TcpClient.hpp>
+#include <bbt/network/RpcChannel.hpp>
+#include <bbt/pollevent/EvThread.hpp>
+#include <bbt/core/clock/Clock.hpp>
+
+using namespace bbt::network;
+using namespace bbt::core::clock;
+
+/**
+ * rpc压测，同一进程内的服务端和客户端，单连接上保持inflight个调用在途。
+ *  方法1：同步回显
+ *  方法2：在其他线程中延迟后异步回复，回复与请求乱序
+ */
+
+enum RpcMethod : uint32_t { emECHO = 1, emDELAY_ECHO = 2 };
+
+static std::atomic_uint64_t g_done{0};
+static std::atomic_uint64_t g_failed{0};
+
+static void CallOnce(std::shared_ptr<RpcChannel> channel, uint64_t seq)
+{
+    std::string req = std::to_string(seq);
+    uint32_t method = (seq % 16 == 0) ? emDELAY_ECHO : emECHO;
+
+    /* 完成一个再补一个，保持在途数量不变 */
+    auto err = channel->Call(method, req.data(), req.size(), 1000, [channel, seq, req](auto err, const char* data, size_t len){
+        if (err.has_value() || std::string(data, len) != req)
+            ++g_failed;
+        else
+            ++g_done;
+
+        CallOnce(channel, seq + 1);
+    });
+
+    if (err.has_value())
+        std::cout << getnow_str() << "[RpcBench] call error: " << err->CWhat() << std::endl;
+}
+
+int main(int args, char* argv[])
+{
+    if (args != 3) {
+        printf("[usage] ./{exec_name} {port} {inflight}\n");
+        exit(-1);
+    }
+
+    int inflight = std::atoi(argv[2]);
+    auto rlt = bbt::core::net::make_ip_address("127.0.0.1", std::atoi(argv[1]));
+    if (rlt.IsErr()) {
+        std::cout << "make ip address failed! " << rlt.Err().CWhat() << std::endl;
+        return -1;
+    }
+
+    auto server_thread = std::make_shared<EvThread>(std::make_shared<bbt::pollevent::EventLoop>());
+    auto client_thread = std::make_shared<EvThread>(std::make_shared<bbt::pollevent::EventLoop>());
+
+    auto service = std::make_shared<RpcService>();
+    service->Register(emECHO, [](RpcReply reply, const char* data, size_t len){
+        reply.Reply(data, len);
+    });
+    /* 延迟回复放到单独的线程中批量处理 */
+    static std::mutex delay_mtx;
+    static std::vector<std::pair<RpcReply, std::string>> delay_queue;
+    service->Register(emDELAY_ECHO, [](RpcReply reply, const char* data, size_t len){
+        std::lock_guard<std::mutex> _(delay_mtx);
+        delay_queue.emplace_back(reply, std::string(data, len));
+    });
+    std::thread([](){
+        while (true) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            std::vector<std::pair<RpcReply, std::string>> replies;
+            {
+                std::lock_guard<std::mutex> _(delay_mtx);
+                replies.swap(delay_queue);
+            }
+            for (auto& [reply, req] : replies)
+                reply.Reply(req.data(), req.size());
+        }
+    }).detach();
+
+    auto server = TcpServer::Create(server_thread);
+    server->Init();
+    server->SetOnRecv([](auto, auto&){});
+    server->SetTimeout(60000);
+    if (auto err = server->AsyncListen(rlt.Ok(), [server, service](ConnId connid){
+        std::shared_ptr<RpcChannel> channel = nullptr;
+        if (auto err = RpcChannel::Create(server->GetConnection(connid), service, channel); err.has_value())
+            std::cout << getnow_str() << "[RpcBench] create channel error: " << err->CWhat() << std::endl;
+    }); err.has_value()) {
+        std::cout << getnow_str() << "[RpcBench] listen error: " << err->CWhat() << std::endl;
+        return -1;
+    }
+
+    auto client = TcpClient::Create(client_thread);
+    client->Init();
+    client->SetOnRecv([](auto, auto&){});
+    client->SetConnectionTimeout(60000);
+    client->SetOnConnect([client, inflight](ConnId, bbt::core::errcode::ErrOpt err){
+        if (err.has_value()) {
+            std::cout << getnow_str() << "[RpcBench] connect error: " << err->CWhat() << std::endl;
+            return;
+        }
+
+        std::shared_ptr<RpcChannel> channel = nullptr;
+        if (auto err = RpcChannel::Create(client->GetConnection(), nullptr, channel); err.has_value()) {
+            std::cout << getnow_str() << "[RpcBench] create channel error: " << err->CWhat() << std::endl;
+            return;
+        }
+
+        for (int i = 0; i < inflight; ++i)
+            CallOnce(channel, (uint64_t)i * 1000000000);
+    });
+
+    server_thread->Start();
+    client_thread->Start();
+    client->AsyncConnect(rlt.Ok(), 3000);
+
+    uint64_t last = 0;
+    while (true) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        uint64_t done = g_done.load();
+        std::cout << getnow_str() << "[RpcBench] qps=" << done - last << " failed=" << g_failed.load() << std::endl;
+        last = done;
+    }
+}
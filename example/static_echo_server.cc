@@ -0,0 +1,64 @@
+#include <bbt/network/TcpServer.hpp>
+#include <bbt/core/log/Logger.hpp>
+#include <bbt/pollevent/EvThread.hpp>
+#include <bbt/core/clock/Clock.hpp>
+
+using namespace bbt::network;
+using namespace bbt::core::clock;
+
+/* 只实现关心的事件，其余使用StaticHandlerBase中的空实现 */
+struct EchoHandler:
+    public detail::StaticHandlerBase
+{
+    void OnRecv(detail::Connection& conn, const char* data, size_t len)
+    {
+        if (auto err = conn.AsyncSend(data, len); err.has_value())
+            std::cout << getnow_str() << "[StaticEchoServer] send error: " << err->CWhat() << std::endl;
+    }
+
+    void OnTimeout(detail::Connection& conn)
+    {
+        std::cout << getnow_str() << "[StaticEchoServer] on timeout " << conn.GetConnId() << std::endl;
+    }
+
+    void OnClose(ConnId connid, const IPAddress& addr)
+    {
+        std::cout << getnow_str() << "[StaticEchoServer] on close " << connid << " " << addr.GetIPPort() << std::endl;
+    }
+};
+
+int main(int args, char* argv[])
+{
+    if (args != 2) {
+        printf("[usage] ./{exec_name} {port}\n");
+        exit(-1);
+    }
+
+    auto evthread = std::make_shared<EvThread>(std::make_shared<bbt::pollevent::EventLoop>());
+    auto server = TcpServer::Create(evthread);
+
+    server->Init();
+    server->SetTimeout(5000);
+    server->SetStaticHandler(std::make_shared<EchoHandler>());
+    server->SetOnErr([](auto connid, const bbt::core::errcode::Errcode& err){
+        std::cout << getnow_str() << "[StaticEchoServer] error: " << err.CWhat() << std::endl;
+    });
+
+    auto rlt = bbt::core::net::make_ip_address("127.0.0.1", std::atoi(argv[1]));
+    if (rlt.IsErr()) {
+        std::cout << "make ip address failed! " << rlt.Err().CWhat() << std::endl;
+        return -1;
+    }
+
+    auto err = server->AsyncListen(rlt.Ok(), [](ConnId connid){
+        std::cout << getnow_str() << "[StaticEchoServer] onaccept " << connid << std::endl;
+    });
+
+    if (err.has_value()) {
+        std::cout << getnow_str() << "[StaticEchoServer] listen error: " << err->CWhat() << std::endl;
+        return -1;
+    }
+
+    evthread->Start();
+    evthread->Join();
+}
@@ -0,0 +1,155 @@
+#include <thread>
+#include <bbt/network/TcpServer.hpp>
+#include <bbt/network/TcpClient.hpp>
+#include <bbt/pollevent/EvThread.hpp>
+#include <bbt/core/clock/Clock.hpp>
+
+using namespace bbt::network;
+using namespace bbt::core::clock;
+
+/**
+ * tls压测，同一进程内的服务端和客户端，依次测量：
+ *  1、完整握手的速率（关闭会话恢复，每次建连后ping一次再断开）
+ *  2、会话恢复握手的速率
+ *  3、单连接稳态吞吐
+ *
+ * 证书可以在本地生成：
+ *  openssl req -x509 -newkey rsa:2048 -nodes -keyout key.pem -out cert.pem -days 1 -subj /CN=localhost
+ */
+
+enum BenchPhase { emFULL, emRESUMED, emTHROUGHPUT, emDONE };
+
+static const size_t         CHUNK_SIZE = 64 * 1024;
+static std::atomic_int      g_phase{emFULL};
+static std::atomic_uint64_t g_handshakes[2];
+static std::atomic_uint64_t g_recv_bytes{0};
+
+int main(int args, char* argv[])
+{
+    if (args < 4) {
+        printf("[usage] ./{exec_name} {cert.pem} {key.pem} {port} [seconds per phase]\n");
+        exit(-1);
+    }
+
+    int seconds = (args > 4) ? std::atoi(argv[4]) : 3;
+    auto rlt = bbt::core::net::make_ip_address("127.0.0.1", std::atoi(argv[3]));
+    if (rlt.IsErr()) {
+        std::cout << "make ip address failed! " << rlt.Err().CWhat() << std::endl;
+        return -1;
+    }
+
+    auto server_thread = std::make_shared<EvThread>(std::make_shared<bbt::pollevent::EventLoop>());
+    auto client_thread = std::make_shared<EvThread>(std::make_shared<bbt::pollevent::EventLoop>());
+
+    /* 服务端：握手阶段回显ping，吞吐阶段只计数 */
+    auto server = TcpServer::Create(server_thread);
+    server->Init();
+    TlsOptions server_opts;
+    server_opts.cert_file = argv[1];
+    server_opts.key_file = argv[2];
+    if (auto err = server->SetTls(server_opts); err.has_value()) {
+        std::cout << getnow_str() << "[TlsBench] server tls error: " << err->CWhat() << std::endl;
+        return -1;
+    }
+
+    server->SetOnRecv([server](ConnId connid, const bbt::core::Buffer& buffer){
+        if (g_phase.load() == emTHROUGHPUT)
+            g_recv_bytes += buffer.Size();
+        else
+            server->Send(connid, buffer);
+    });
+    server->SetOnErr([](auto connid, const bbt::core::errcode::Errcode& err){
+        std::cout << getnow_str() << "[TlsBench] server error: " << err.CWhat() << std::endl;
+    });
+
+    if (auto err = server->AsyncListen(rlt.Ok(), [](ConnId){}); err.has_value()) {
+        std::cout << getnow_str() << "[TlsBench] listen error: " << err->CWhat() << std::endl;
+        return -1;
+    }
+
+    /* 客户端：所有操作都在客户端线程中执行，阶段切换时重新设置tls */
+    auto client = TcpClient::Create(client_thread);
+    client->Init();
+    TlsOptions client_opts;
+    client_opts.insecure = true;        // 自签名证书，压测不校验
+    client_opts.session_resumption = false;
+    client->SetTls(client_opts);
+
+    int client_phase = emFULL;
+    bbt::core::Buffer chunk;
+    chunk.WriteNull(CHUNK_SIZE);
+
+    auto next_event = client_thread->RegisterEvent(-1, EventOpt::TIMEOUT, [client, &client_opts, &client_phase](auto, short, auto){
+        client->Close();
+        int phase = g_phase.load();
+        if (phase == emDONE)
+            return;
+
+        if (phase != client_phase) {
+            client_phase = phase;
+            client_opts.session_resumption = true;
+            client->SetTls(client_opts);
+        }
+
+        client->ReConnect();
+    });
+
+    client->SetOnConnect([client, &chunk, &next_event](ConnId, bbt::core::errcode::ErrOpt err){
+        if (err.has_value()) {
+            std::cout << getnow_str() << "[TlsBench] connect error: " << err->CWhat() << std::endl;
+            next_event->StartListen(100);
+            return;
+        }
+
+        /* 握手完成前发送的数据暂存，握手完成后发出 */
+        if (g_phase.load() == emTHROUGHPUT) {
+            for (int i = 0; i < 4; ++i)
+                client->Send(chunk);
+        } else {
+            client->Send(bbt::core::Buffer{"ping"});
+        }
+    });
+
+    client->SetOnRecv([&next_event](ConnId, const bbt::core::Buffer&){
+        int phase = g_phase.load();
+        if (phase == emFULL || phase == emRESUMED)
+            ++g_handshakes[phase];
+
+        next_event->StartListen(0);
+    });
+
+    /* 吞吐阶段每发完一块补一块，保持管道中有数据 */
+    client->SetOnSend([client, &chunk](ConnId, bbt::core::errcode::ErrOpt err, size_t){
+        if (!err.has_value() && g_phase.load() == emTHROUGHPUT)
+            client->Send(chunk);
+    });
+
+    client->SetOnErr([](auto, const bbt::core::errcode::Errcode& err){
+        std::cout << getnow_str() << "[TlsBench] client error: " << err.CWhat() << std::endl;
+    });
+
+    server_thread->Start();
+    client_thread->Start();
+
+    client->AsyncConnect(rlt.Ok(), 3000);
+
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    g_phase = emRESUMED;
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    g_phase = emTHROUGHPUT;
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    uint64_t begin_bytes = g_recv_bytes.load();
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    uint64_t bytes = g_recv_bytes.load() - begin_bytes;
+    g_phase = emDONE;
+
+    auto server_stats = server->GetTlsStats();
+    std::cout << "[TlsBench] full handshake: " << g_handshakes[emFULL].load() / seconds << "/s" << std::endl;
+    std::cout << "[TlsBench] resumed handshake: " << g_handshakes[emRESUMED].load() / seconds << "/s" << std::endl;
+    std::cout << "[TlsBench] throughput: " << bytes / seconds / (1024 * 1024) << "MB/s" << std::endl;
+    std::cout << "[TlsBench] server handshakes=" << server_stats.handshakes << " resumed=" << server_stats.resumed
+        << " failed=" << server_stats.failed << " ktls_send=" << server_stats.ktls_send
+        << " ktls_recv=" << server_stats.ktls_recv << std::endl;
+
+    exit(0);
+}
@@ -0,0 +1,50 @@
+#include <thread>
+#include <bbt/network/UdpServer.hpp>
+#include <bbt/core/clock/Clock.hpp>
+
+using namespace bbt::network;
+using namespace bbt::core::clock;
+
+int main(int args, char* argv[])
+{
+    if (args != 3) {
+        printf("[usage] ./{exec_name} {port} {nthread}\n");
+        exit(-1);
+    }
+
+    auto server = UdpServer::Create(std::atoi(argv[2]));
+
+    UdpOptions opts;
+    opts.gro = true;
+    opts.gso = true;
+    server->SetOptions(opts);
+    server->Init();
+
+    /* 回调在收到数据报的socket所在线程执行，直接用该socket回复 */
+    server->SetOnRecv([](UdpSocket& socket, const IPAddress& from, const char* data, size_t len){
+        if (auto err = socket.SendTo(from, data, len); err.has_value())
+            std::cout << getnow_str() << "[UdpEchoServer] send error: " << err->CWhat() << std::endl;
+    });
+
+    server->SetOnErr([](auto, const bbt::core::errcode::Errcode& err){
+        std::cout << getnow_str() << "[UdpEchoServer] error: " << err.CWhat() << std::endl;
+    });
+
+    auto rlt = bbt::core::net::make_ip_address("0.0.0.0", std::atoi(argv[1]));
+    if (rlt.IsErr()) {
+        std::cout << "make ip address failed! " << rlt.Err().CWhat() << std::endl;
+        return -1;
+    }
+
+    if (auto err = server->AsyncListen(rlt.Ok()); err.has_value()) {
+        std::cout << getnow_str() << "[UdpEchoServer] listen error: " << err->CWhat() << std::endl;
+        return -1;
+    }
+
+    while (true) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        auto stats = server->GetStats();
+        std::cout << getnow_str() << "[UdpEchoServer] rx=" << stats.rx_packets << " rx_batches=" << stats.rx_batches
+            << " tx=" << stats.tx_packets << " tx_batches=" << stats.tx_batches << " dropped=" << stats.tx_dropped << std::endl;
+    }
+}
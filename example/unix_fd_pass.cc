@@ -0,0 +1,105 @@
+#include <thread>
+#include <bbt/network/TcpServer.hpp>
+#include <bbt/network/TcpClient.hpp>
+#include <bbt/network/detail/UnixSocket.hpp>
+#include <bbt/pollevent/EvThread.hpp>
+#include <bbt/core/clock/Clock.hpp>
+
+using namespace bbt::core::errcode;
+using namespace bbt::network;
+using namespace bbt::core::clock;
+
+/**
+ * unix socket fd传递自检，成功返回0，失败返回非0。
+ * 客户端在同一次回调中连续发送两条各附带一个memfd的消息，两条消息会在
+ * 同一次写出中合并发送；服务端检查每次收到的数据只对应自己的fd：
+ *  消息"A"附带内容为"A"的memfd，消息"B"附带内容为"B"的memfd
+ *  ./unix_fd_pass
+ */
+
+static std::atomic_int g_checked{0};
+static std::atomic_bool g_failed{false};
+
+static void Fail(const std::string& msg)
+{
+    std::cout << getnow_str() << "[UnixFdPass] failed: " << msg << std::endl;
+    g_failed = true;
+}
+
+int main()
+{
+    std::string path = "@bbt_unix_fd_pass_" + std::to_string(getpid());
+
+    auto server = TcpServer::Create(1);
+    server->Init();
+    server->SetOnRecv([server](ConnId connid, const bbt::core::Buffer& buffer){
+        auto conn = server->GetConnection(connid);
+        if (conn == nullptr)
+            return Fail("connection not found!");
+
+        /* 附带fd的数据不会和其他数据合并在同一次读取中 */
+        std::vector<int> fds = conn->TakeRecvFds();
+        if (buffer.Size() != 1 || fds.size() != 1) {
+            for (int fd : fds) ::close(fd);
+            return Fail("recv " + std::to_string(buffer.Size()) + " bytes with " + std::to_string(fds.size()) + " fds");
+        }
+
+        char content = 0;
+        ssize_t n = ::pread(fds[0], &content, 1, 0);
+        ::close(fds[0]);
+        if (n != 1 || content != buffer.Peek()[0])
+            return Fail(std::string{"message "} + buffer.Peek()[0] + " carries the wrong fd");
+
+        ++g_checked;
+    });
+
+    if (auto err = server->AsyncListenUnix(path, [](ConnId){}); err.has_value()) {
+        std::cout << getnow_str() << "[UnixFdPass] listen error: " << err->CWhat() << std::endl;
+        return -1;
+    }
+
+    int fd_a = -1, fd_b = -1;
+    if (auto err = detail::CreateSealedMemfd("A", "A", 1, fd_a); err.has_value()) {
+        std::cout << getnow_str() << "[UnixFdPass] create memfd error: " << err->CWhat() << std::endl;
+        return -1;
+    }
+    if (auto err = detail::CreateSealedMemfd("B", "B", 1, fd_b); err.has_value()) {
+        std::cout << getnow_str() << "[UnixFdPass] create memfd error: " << err->CWhat() << std::endl;
+        return -1;
+    }
+
+    auto evthread = std::make_shared<EvThread>(std::make_shared<bbt::pollevent::EventLoop>());
+    auto client = TcpClient::Create(evthread);
+    client->Init();
+    client->SetOnRecv([](ConnId, const bbt::core::Buffer&){});
+    /* 在EvThread中连续发送，保证两条消息写出前都已经进入发送缓冲 */
+    client->SetOnConnect([client, fd_a, fd_b](ConnId, ErrOpt err){
+        if (err.has_value())
+            return Fail(err->CWhat());
+
+        if (auto err = client->Send(bbt::core::Buffer{"A", 1}, {fd_a}); err.has_value())
+            return Fail(err->CWhat());
+        if (auto err = client->Send(bbt::core::Buffer{"B", 1}, {fd_b}); err.has_value())
+            return Fail(err->CWhat());
+    });
+
+    if (auto err = client->AsyncConnectUnix(path, 1000); err.has_value()) {
+        std::cout << getnow_str() << "[UnixFdPass] connect error: " << err->CWhat() << std::endl;
+        return -1;
+    }
+    evthread->Start();
+
+    for (int i = 0; i < 300 && g_checked < 2 && !g_failed; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    ::close(fd_a);
+    ::close(fd_b);
+
+    if (g_failed || g_checked != 2) {
+        std::cout << getnow_str() << "[UnixFdPass] failed! checked=" << g_checked << std::endl;
+        exit(-1);
+    }
+
+    std::cout << getnow_str() << "[UnixFdPass] ok" << std::endl;
+    exit(0);
+}